@@ -4,6 +4,7 @@ call setup_environment.bat > nul
 
 set BOOST_DIR=c:\libraries\boost\boost_1_57_0
 set FREEIMAGELIB_DIR=%~dp0\3rd_party\FreeImage\%FreeImage_VERSION%
+set ZLIB_DIR=c:\libraries\zlib\zlib-1.2.8
 ::set AIMP_PLUGINS_DIR=%ProgramFiles%\AIMP3\Plugins
 set AIMP_PLUGINS_DIR=c:\AIMP\AIMP3.60.1468_beta\Plugins
 ::for API 3.55- it should be
@@ -0,0 +1,689 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "aimp/entries_search.h"
+#include "sqlite/sqlite.h"
+#include <boost/noncopyable.hpp>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AIMPPlayer
+{
+
+namespace {
+
+typedef sqlite3_int64 EntryKey; // playlist id in high 32 bits, entry id in low ones. Entry id is unique only inside playlist in AIMP2.
+typedef sqlite3_uint64 Trigram; // three UTF-16 characters.
+
+EntryKey makeEntryKey(int playlist_id, int entry_id)
+{
+    return static_cast<EntryKey>(   (static_cast<sqlite3_uint64>( static_cast<unsigned int>(playlist_id) ) << 32)
+                                  | static_cast<unsigned int>(entry_id)
+                                 );
+}
+
+int playlistIDFromKey(EntryKey key)
+    { return static_cast<int>( static_cast<unsigned int>(static_cast<sqlite3_uint64>(key) >> 32) ); }
+
+int entryIDFromKey(EntryKey key)
+    { return static_cast<int>( static_cast<unsigned int>(static_cast<sqlite3_uint64>(key) & 0xFFFFFFFF) ); }
+
+//! Folds character the same way LIKE operator of sqlite_unicode extension does: accent is removed, then case is folded.
+wchar_t foldChar(wchar_t c)
+{
+    return sqlite3_unicode_fold( sqlite3_unicode_unacc(c, nullptr, nullptr) );
+}
+
+void appendFolded(const void* text16, std::wstring* out)
+{
+    if (const wchar_t* c = static_cast<const wchar_t*>(text16)) {
+        for (; *c != L'\0'; ++c) {
+            out->push_back( foldChar(*c) );
+        }
+    }
+}
+
+/*!
+    \brief Fills sorted distinct trigrams of text.
+    Trigrams which include field separator('\0') are skipped, so pattern can not be found across fields, like in separate LIKE per field.
+*/
+void getTrigrams(const std::wstring& text, std::vector<Trigram>* trigrams)
+{
+    trigrams->clear();
+    for (size_t i = 0; i + 2 < text.size(); ++i) {
+        if (text[i] != L'\0' && text[i + 1] != L'\0' && text[i + 2] != L'\0') {
+            trigrams->push_back(   (static_cast<Trigram>(text[i])     << 32)
+                                 | (static_cast<Trigram>(text[i + 1]) << 16)
+                                 |  static_cast<Trigram>(text[i + 2])
+                                );
+        }
+    }
+    std::sort( trigrams->begin(), trigrams->end() );
+    trigrams->erase( std::unique( trigrams->begin(), trigrams->end() ), trigrams->end() );
+}
+
+/*!
+    \brief Keeps folded searchable text of entries and lists of entries for each trigram of text.
+    Pattern of 3+ characters is searched only in entries which contain its rarest trigram, shorter pattern is searched in all entries.
+    Slots of removed entries are not removed from trigram lists immediately but are reused, so lists can point to entries
+    which do not have trigram anymore; each candidate is verified by substring search, lists are rebuilt when half of them is stale.
+    Changes done inside transaction are logged and reverted on rollback, so index follows content of PlaylistsEntries table.
+    Savepoints mark positions in the log: ROLLBACK TO(and failed statement) reverts changes done after mark only.
+*/
+class EntriesSearchIndex : boost::noncopyable
+{
+public:
+
+    EntriesSearchIndex()
+        :
+        postings_count_(0),
+        stale_postings_count_(0),
+        in_transaction_(false)
+    {}
+
+    //! Adds entry or replaces its text. Text is folded fields separated by '\0'.
+    void insert(EntryKey key, const std::wstring& text)
+    {
+        saveUndo(key);
+        eraseEntry(key);
+        insertEntry(key, text);
+    }
+
+    void erase(EntryKey key)
+    {
+        saveUndo(key);
+        eraseEntry(key);
+    }
+
+    bool contains(EntryKey key) const
+        { return slots_.find(key) != slots_.end(); }
+
+    //! Fills keys of entries which text contains folded pattern. Only entries of specified playlist are checked if by_playlist is true.
+    void find(const std::wstring& pattern, bool by_playlist, int playlist_id, std::vector<EntryKey>* keys) const;
+
+    //! Fills keys of all entries or of entries of specified playlist.
+    void getAll(bool by_playlist, int playlist_id, std::vector<EntryKey>* keys) const;
+
+    void beginTransaction()
+    {
+        undo_log_.clear();
+        savepoints_.clear();
+        in_transaction_ = true;
+    }
+
+    void commit()
+    {
+        undo_log_.clear();
+        savepoints_.clear();
+        in_transaction_ = false;
+    }
+
+    void rollback()
+    {
+        undoUpTo(0);
+        savepoints_.clear();
+        in_transaction_ = false;
+    }
+
+    //! Marks current state as savepoint with given nesting level. Savepoints of the same or deeper level are replaced.
+    void savepoint(int level)
+    {
+        savepoints_.resize(level, undo_log_.size()); // levels skipped by SQLite start at the same state.
+        savepoints_.push_back( undo_log_.size() );
+    }
+
+    //! Forgets savepoints of given and deeper levels, their changes stay in log until end of transaction.
+    void releaseSavepoint(int level)
+    {
+        if ( static_cast<size_t>(level) < savepoints_.size() ) {
+            savepoints_.resize(level);
+        }
+    }
+
+    //! Reverts changes done after savepoint of given level. Savepoint itself stays active, deeper ones are forgotten.
+    void rollbackToSavepoint(int level)
+    {
+        if ( static_cast<size_t>(level) < savepoints_.size() ) {
+            undoUpTo(savepoints_[level]);
+            savepoints_.resize(level + 1);
+        }
+    }
+
+private:
+
+    static const size_t kMIN_STALE_POSTINGS_TO_REBUILD = 65536; // avoids frequent rebuild of small index.
+
+    typedef std::vector<unsigned int> Slots;
+
+    struct Entry
+    {
+        EntryKey key;
+        std::wstring text;
+        size_t trigrams_count;
+        bool alive;
+    };
+
+    struct UndoRecord
+    {
+        EntryKey key;
+        bool existed;
+        std::wstring text;
+    };
+
+    bool matches(const Entry& entry, const std::wstring& pattern, bool by_playlist, int playlist_id) const
+    {
+        return    entry.alive
+               && (!by_playlist || playlistIDFromKey(entry.key) == playlist_id)
+               && entry.text.find(pattern) != std::wstring::npos;
+    }
+
+    void insertEntry(EntryKey key, const std::wstring& text);
+    void eraseEntry(EntryKey key);
+    //! Adds slot to lists of all trigrams of its text, returns count of trigrams.
+    size_t addPostings(unsigned int slot);
+    void rebuildPostings();
+    //! Remembers state of entry before its change inside transaction.
+    void saveUndo(EntryKey key);
+    //! Reverts and removes log records starting from given position.
+    void undoUpTo(size_t log_size);
+
+    std::vector<Entry> entries_;
+    Slots free_slots_;
+    std::unordered_map<EntryKey, unsigned int> slots_;
+    std::unordered_map<Trigram, Slots> postings_;
+    size_t postings_count_,
+           stale_postings_count_;
+
+    std::vector<UndoRecord> undo_log_;
+    std::vector<size_t> savepoints_; // size of undo_log_ at each savepoint level.
+    bool in_transaction_;
+};
+
+void EntriesSearchIndex::insertEntry(EntryKey key, const std::wstring& text)
+{
+    unsigned int slot;
+    if ( !free_slots_.empty() ) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = static_cast<unsigned int>( entries_.size() );
+        entries_.push_back( Entry() );
+    }
+
+    Entry& entry = entries_[slot];
+    entry.key = key;
+    entry.text = text;
+    entry.alive = true;
+    entry.trigrams_count = addPostings(slot);
+    slots_[key] = slot;
+}
+
+void EntriesSearchIndex::eraseEntry(EntryKey key)
+{
+    auto it = slots_.find(key);
+    if ( it == slots_.end() ) {
+        return;
+    }
+
+    Entry& entry = entries_[it->second];
+    entry.alive = false;
+    std::wstring().swap(entry.text);
+    stale_postings_count_ += entry.trigrams_count;
+    free_slots_.push_back(it->second);
+    slots_.erase(it);
+
+    if (stale_postings_count_ >= kMIN_STALE_POSTINGS_TO_REBUILD && stale_postings_count_ * 2 > postings_count_) {
+        rebuildPostings();
+    }
+}
+
+size_t EntriesSearchIndex::addPostings(unsigned int slot)
+{
+    std::vector<Trigram> trigrams;
+    getTrigrams(entries_[slot].text, &trigrams);
+    for (auto trigram : trigrams) {
+        postings_[trigram].push_back(slot);
+    }
+    postings_count_ += trigrams.size();
+    return trigrams.size();
+}
+
+void EntriesSearchIndex::rebuildPostings()
+{
+    postings_.clear();
+    postings_count_ = 0;
+    stale_postings_count_ = 0;
+    for (unsigned int slot = 0, size = static_cast<unsigned int>( entries_.size() ); slot != size; ++slot) {
+        if (entries_[slot].alive) {
+            addPostings(slot);
+        }
+    }
+}
+
+void EntriesSearchIndex::find(const std::wstring& pattern, bool by_playlist, int playlist_id, std::vector<EntryKey>* keys) const
+{
+    keys->clear();
+
+    std::vector<Trigram> trigrams;
+    getTrigrams(pattern, &trigrams);
+    if ( trigrams.empty() ) { // too short pattern, check all entries.
+        for (const Entry& entry : entries_) {
+            if ( matches(entry, pattern, by_playlist, playlist_id) ) {
+                keys->push_back(entry.key);
+            }
+        }
+        return;
+    }
+
+    const Slots* rarest = nullptr;
+    for (auto trigram : trigrams) {
+        auto it = postings_.find(trigram);
+        if ( it == postings_.end() ) {
+            return; // no entry contains this part of pattern.
+        }
+        if ( !rarest || it->second.size() < rarest->size() ) {
+            rarest = &it->second;
+        }
+    }
+
+    Slots candidates(*rarest);
+    std::sort( candidates.begin(), candidates.end() );
+    candidates.erase( std::unique( candidates.begin(), candidates.end() ), candidates.end() ); // reused slot can be listed twice.
+    for (auto slot : candidates) {
+        const Entry& entry = entries_[slot];
+        if ( matches(entry, pattern, by_playlist, playlist_id) ) {
+            keys->push_back(entry.key);
+        }
+    }
+}
+
+void EntriesSearchIndex::getAll(bool by_playlist, int playlist_id, std::vector<EntryKey>* keys) const
+{
+    keys->clear();
+    for (const Entry& entry : entries_) {
+        if ( entry.alive && (!by_playlist || playlistIDFromKey(entry.key) == playlist_id) ) {
+            keys->push_back(entry.key);
+        }
+    }
+}
+
+void EntriesSearchIndex::saveUndo(EntryKey key)
+{
+    if (!in_transaction_) {
+        return;
+    }
+
+    UndoRecord record;
+    record.key = key;
+    auto it = slots_.find(key);
+    record.existed = it != slots_.end();
+    if (record.existed) {
+        record.text = entries_[it->second].text;
+    }
+    undo_log_.push_back( std::move(record) );
+}
+
+void EntriesSearchIndex::undoUpTo(size_t log_size)
+{
+    while (undo_log_.size() > log_size) {
+        const UndoRecord& record = undo_log_.back();
+        eraseEntry(record.key);
+        if (record.existed) {
+            insertEntry(record.key, record.text);
+        }
+        undo_log_.pop_back();
+    }
+}
+
+// Virtual table is thin adapter of EntriesSearchIndex to SQLite: index lives as long as module registered in db.
+
+const char kTABLE_SCHEMA[] = "CREATE TABLE x(playlist_id INTEGER, entry_id INTEGER,"
+                                            "album HIDDEN, artist HIDDEN, date HIDDEN, genre HIDDEN, title HIDDEN,"
+                                            "pattern HIDDEN)";
+
+enum COLUMN { COLUMN_PLAYLIST_ID = 0, COLUMN_ENTRY_ID,
+              COLUMN_ALBUM, COLUMN_ARTIST, COLUMN_DATE, COLUMN_GENRE, COLUMN_TITLE,
+              COLUMN_PATTERN,
+              COLUMNS_COUNT
+};
+
+// bits of idxNum, constraint args are passed to filter() in the same order.
+enum PLAN { PLAN_BY_PATTERN = 1, PLAN_BY_PLAYLIST = 2, PLAN_BY_ENTRY = 4 };
+
+struct SearchTable
+{
+    sqlite3_vtab base; // must be first member.
+    EntriesSearchIndex* index;
+};
+
+struct SearchCursor
+{
+    sqlite3_vtab_cursor base; // must be first member.
+    std::vector<EntryKey> keys;
+    size_t position;
+};
+
+EntriesSearchIndex& getIndex(sqlite3_vtab* vtab)
+    { return *reinterpret_cast<SearchTable*>(vtab)->index; }
+
+int createTable(sqlite3* db, void* aux, int /*argc*/, const char* const* /*argv*/, sqlite3_vtab** vtab, char** /*errmsg*/)
+{
+    const int rc = sqlite3_declare_vtab(db, kTABLE_SCHEMA);
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+
+    SearchTable* table = new(std::nothrow) SearchTable();
+    if (!table) {
+        return SQLITE_NOMEM;
+    }
+    table->index = static_cast<EntriesSearchIndex*>(aux);
+    *vtab = &table->base;
+    return SQLITE_OK;
+}
+
+int disconnectTable(sqlite3_vtab* vtab)
+{
+    delete reinterpret_cast<SearchTable*>(vtab);
+    return SQLITE_OK;
+}
+
+int bestIndex(sqlite3_vtab* /*vtab*/, sqlite3_index_info* info)
+{
+    int constraint_by_column[COLUMNS_COUNT];
+    std::fill(constraint_by_column, constraint_by_column + COLUMNS_COUNT, -1);
+    for (int i = 0; i < info->nConstraint; ++i) {
+        const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+        if (constraint.usable && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ && constraint.iColumn >= 0) {
+            constraint_by_column[constraint.iColumn] = i;
+        }
+    }
+
+    const struct { COLUMN column; PLAN plan; } kPLAN_COLUMNS[] = { { COLUMN_PATTERN,     PLAN_BY_PATTERN  },
+                                                                   { COLUMN_PLAYLIST_ID, PLAN_BY_PLAYLIST },
+                                                                   { COLUMN_ENTRY_ID,    PLAN_BY_ENTRY    }
+                                                                 };
+    int argv_index = 0;
+    info->idxNum = 0;
+    for (const auto& plan_column : kPLAN_COLUMNS) {
+        const int constraint = constraint_by_column[plan_column.column];
+        if (constraint >= 0) {
+            info->aConstraintUsage[constraint].argvIndex = ++argv_index;
+            info->aConstraintUsage[constraint].omit = 1; // pattern column has no value, so SQLite must not check it.
+            info->idxNum |= plan_column.plan;
+        }
+    }
+
+    if ( (info->idxNum & PLAN_BY_PLAYLIST) && (info->idxNum & PLAN_BY_ENTRY) ) {
+        info->estimatedCost = 1;
+    } else if (info->idxNum & PLAN_BY_PATTERN) {
+        info->estimatedCost = 1000;
+    } else if (info->idxNum & PLAN_BY_PLAYLIST) {
+        info->estimatedCost = 100000;
+    } else {
+        info->estimatedCost = 1000000;
+    }
+    return SQLITE_OK;
+}
+
+int openCursor(sqlite3_vtab* /*vtab*/, sqlite3_vtab_cursor** cursor)
+{
+    SearchCursor* search_cursor = new(std::nothrow) SearchCursor();
+    if (!search_cursor) {
+        return SQLITE_NOMEM;
+    }
+    search_cursor->position = 0;
+    *cursor = &search_cursor->base;
+    return SQLITE_OK;
+}
+
+int closeCursor(sqlite3_vtab_cursor* cursor)
+{
+    delete reinterpret_cast<SearchCursor*>(cursor);
+    return SQLITE_OK;
+}
+
+int filterRows(sqlite3_vtab_cursor* cursor, int idx_num, const char* /*idx_str*/, int /*argc*/, sqlite3_value** argv)
+{
+    SearchCursor& search_cursor = *reinterpret_cast<SearchCursor*>(cursor);
+    const EntriesSearchIndex& index = getIndex(cursor->pVtab);
+    std::vector<EntryKey>& keys = search_cursor.keys;
+    keys.clear();
+    search_cursor.position = 0;
+
+    try {
+        int arg = 0;
+        const bool by_pattern  = (idx_num & PLAN_BY_PATTERN)  != 0,
+                   by_playlist = (idx_num & PLAN_BY_PLAYLIST) != 0,
+                   by_entry    = (idx_num & PLAN_BY_ENTRY)    != 0;
+        sqlite3_value* const pattern_value = by_pattern  ? argv[arg++] : nullptr;
+        const int playlist_id              = by_playlist ? sqlite3_value_int(argv[arg++]) : 0;
+        const int entry_id                 = by_entry    ? sqlite3_value_int(argv[arg++]) : 0;
+
+        if (by_pattern) {
+            if (sqlite3_value_type(pattern_value) == SQLITE_NULL) {
+                return SQLITE_OK; // nothing is equal to NULL.
+            }
+            std::wstring pattern;
+            appendFolded(sqlite3_value_text16(pattern_value), &pattern);
+            index.find(pattern, by_playlist, playlist_id, &keys);
+        } else if (by_playlist && by_entry) { // lookup of entry on deletion.
+            const EntryKey key = makeEntryKey(playlist_id, entry_id);
+            if ( index.contains(key) ) {
+                keys.push_back(key);
+            }
+            return SQLITE_OK;
+        } else {
+            index.getAll(by_playlist, playlist_id, &keys);
+        }
+
+        if (by_entry) {
+            keys.erase( std::remove_if( keys.begin(), keys.end(),
+                                        [entry_id](EntryKey key) { return entryIDFromKey(key) != entry_id; }
+                                       ),
+                        keys.end()
+                       );
+        }
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int nextRow(sqlite3_vtab_cursor* cursor)
+{
+    ++reinterpret_cast<SearchCursor*>(cursor)->position;
+    return SQLITE_OK;
+}
+
+int isEof(sqlite3_vtab_cursor* cursor)
+{
+    const SearchCursor& search_cursor = *reinterpret_cast<SearchCursor*>(cursor);
+    return search_cursor.position >= search_cursor.keys.size();
+}
+
+int getColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int column_index)
+{
+    const SearchCursor& search_cursor = *reinterpret_cast<SearchCursor*>(cursor);
+    const EntryKey key = search_cursor.keys[search_cursor.position];
+    switch (column_index) {
+    case COLUMN_PLAYLIST_ID:
+        sqlite3_result_int( context, playlistIDFromKey(key) );
+        break;
+    case COLUMN_ENTRY_ID:
+        sqlite3_result_int( context, entryIDFromKey(key) );
+        break;
+    default:
+        sqlite3_result_null(context); // text is kept folded only, original fields are in PlaylistsEntries.
+        break;
+    }
+    return SQLITE_OK;
+}
+
+int getRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid)
+{
+    const SearchCursor& search_cursor = *reinterpret_cast<SearchCursor*>(cursor);
+    *rowid = search_cursor.keys[search_cursor.position];
+    return SQLITE_OK;
+}
+
+int updateTable(sqlite3_vtab* vtab, int argc, sqlite3_value** argv, sqlite3_int64* rowid)
+{
+    EntriesSearchIndex& index = getIndex(vtab);
+    try {
+        if (argc == 1) { // DELETE
+            index.erase( sqlite3_value_int64(argv[0]) );
+            return SQLITE_OK;
+        }
+
+        if (sqlite3_value_type(argv[0]) != SQLITE_NULL) { // UPDATE is treated as DELETE + INSERT.
+            index.erase( sqlite3_value_int64(argv[0]) );
+        }
+
+        // argv[1] is rowid requested by INSERT, it is ignored since rowid is built from playlist and entry ids. Columns start from argv[2].
+        sqlite3_value** const columns = argv + 2;
+        const EntryKey key = makeEntryKey( sqlite3_value_int(columns[COLUMN_PLAYLIST_ID]),
+                                           sqlite3_value_int(columns[COLUMN_ENTRY_ID])
+                                          );
+        std::wstring text;
+        for (int column_index = COLUMN_ALBUM; column_index <= COLUMN_TITLE; ++column_index) {
+            if (column_index != COLUMN_ALBUM) {
+                text.push_back(L'\0');
+            }
+            appendFolded(sqlite3_value_text16(columns[column_index]), &text);
+        }
+        index.insert(key, text);
+        *rowid = key;
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int beginTransaction(sqlite3_vtab* vtab)
+{
+    getIndex(vtab).beginTransaction();
+    return SQLITE_OK;
+}
+
+int syncTransaction(sqlite3_vtab* /*vtab*/)
+{
+    return SQLITE_OK;
+}
+
+int commitTransaction(sqlite3_vtab* vtab)
+{
+    getIndex(vtab).commit();
+    return SQLITE_OK;
+}
+
+int rollbackTransaction(sqlite3_vtab* vtab)
+{
+    try {
+        getIndex(vtab).rollback();
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int savepoint(sqlite3_vtab* vtab, int level)
+{
+    try {
+        getIndex(vtab).savepoint(level);
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int releaseSavepoint(sqlite3_vtab* vtab, int level)
+{
+    getIndex(vtab).releaseSavepoint(level);
+    return SQLITE_OK;
+}
+
+int rollbackToSavepoint(sqlite3_vtab* vtab, int level)
+{
+    try {
+        getIndex(vtab).rollbackToSavepoint(level);
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int renameTable(sqlite3_vtab* /*vtab*/, const char* /*new_name*/)
+{
+    return SQLITE_OK;
+}
+
+void destroyIndex(void* index)
+{
+    delete static_cast<EntriesSearchIndex*>(index);
+}
+
+const sqlite3_module kMODULE = {
+    2, // iVersion: savepoints are needed to revert index on ROLLBACK TO and on failure of single statement.
+    &createTable,
+    &createTable, // xConnect
+    &bestIndex,
+    &disconnectTable,
+    &disconnectTable, // xDestroy
+    &openCursor,
+    &closeCursor,
+    &filterRows,
+    &nextRow,
+    &isEof,
+    &getColumn,
+    &getRowid,
+    &updateTable,
+    &beginTransaction,
+    &syncTransaction,
+    &commitTransaction,
+    &rollbackTransaction,
+    nullptr, // xFindFunction
+    &renameTable,
+    &savepoint,
+    &releaseSavepoint,
+    &rollbackToSavepoint
+};
+
+// fields must be the same as GetPlaylistEntries searches in.
+const char kCREATE_SEARCH_QUERY[] =
+    "PRAGMA recursive_triggers=ON;" // otherwise rows replaced by INSERT OR REPLACE do not fire delete trigger, see createPlaylistsEntriesSearch() doc.
+    "CREATE VIRTUAL TABLE PlaylistsEntriesSearch USING playlists_entries_search;"
+    "CREATE TRIGGER PlaylistsEntriesSearchInsert AFTER INSERT ON PlaylistsEntries BEGIN "
+        "INSERT INTO PlaylistsEntriesSearch(playlist_id, entry_id, album, artist, date, genre, title) "
+        "VALUES (NEW.playlist_id, NEW.entry_id, NEW.album, NEW.artist, NEW.date, NEW.genre, NEW.title);"
+    "END;"
+    "CREATE TRIGGER PlaylistsEntriesSearchDelete AFTER DELETE ON PlaylistsEntries BEGIN "
+        "DELETE FROM PlaylistsEntriesSearch WHERE playlist_id=OLD.playlist_id AND entry_id=OLD.entry_id;"
+    "END;"
+    "CREATE TRIGGER PlaylistsEntriesSearchUpdate AFTER UPDATE OF playlist_id, entry_id, album, artist, date, genre, title ON PlaylistsEntries BEGIN "
+        "DELETE FROM PlaylistsEntriesSearch WHERE playlist_id=OLD.playlist_id AND entry_id=OLD.entry_id;"
+        "INSERT INTO PlaylistsEntriesSearch(playlist_id, entry_id, album, artist, date, genre, title) "
+        "VALUES (NEW.playlist_id, NEW.entry_id, NEW.album, NEW.artist, NEW.date, NEW.genre, NEW.title);"
+    "END;";
+
+} // namespace anonymous
+
+int createPlaylistsEntriesSearch(sqlite3* db)
+{
+    EntriesSearchIndex* index = new(std::nothrow) EntriesSearchIndex();
+    if (!index) {
+        return SQLITE_NOMEM;
+    }
+
+    const int rc = sqlite3_create_module_v2(db, "playlists_entries_search", &kMODULE, index, &destroyIndex); // db owns index from now.
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+
+    return sqlite3_exec(db, kCREATE_SEARCH_QUERY, nullptr, nullptr, nullptr);
+}
+
+} // namespace AIMPPlayer
@@ -0,0 +1,26 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+struct sqlite3;
+
+namespace AIMPPlayer
+{
+
+/*!
+    \brief Creates PlaylistsEntriesSearch virtual table: trigram index of searchable fields of PlaylistsEntries table.
+    Index is kept in sync with PlaylistsEntries by triggers, so inserted, replaced and deleted entries update it incrementally.
+    Usage:
+        SELECT entry_id FROM PlaylistsEntriesSearch WHERE pattern=? AND playlist_id=?
+    returns entries with album, artist, date, genre or title containing pattern as substring.
+    Characters are compared case and accent insensitively like LIKE operator of sqlite_unicode extension does,
+    pattern is literal text: '%' and '_' have no special meaning.
+
+    Must be called after PlaylistsEntries table creation.
+    Enables recursive triggers on whole db(PRAGMA recursive_triggers=ON): entry replaced by INSERT OR REPLACE may belong
+    to other playlist and only delete trigger removes it from index. Other triggers of db must not rely on old non-recursive behavior.
+    \return SQLite result code, sqlite3_errmsg(db) describes error.
+*/
+int createPlaylistsEntriesSearch(sqlite3* db);
+
+} // namespace AIMPPlayer
@@ -0,0 +1,1668 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "aimp/entries_store.h"
+#include "sqlite/sqlite.h"
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AIMPPlayer
+{
+
+namespace {
+
+// Columns are in the same order as in usual PlaylistsEntries table: managers insert rows without column names.
+const char kTABLE_SCHEMA[] = "CREATE TABLE x(playlist_id INTEGER, entry_id INTEGER, entry_index INTEGER,"
+                                            "album TEXT, artist TEXT, date TEXT, filename TEXT, genre TEXT, title TEXT,"
+                                            "bitrate INTEGER, channels_count INTEGER, duration INTEGER, filesize INTEGER,"
+                                            "rating REAL, samplerate INTEGER, crc32 INTEGER,"
+                                            "pattern HIDDEN)";
+
+enum COLUMN { COLUMN_PLAYLIST_ID = 0, COLUMN_ENTRY_ID, COLUMN_ENTRY_INDEX,
+              COLUMN_ALBUM, COLUMN_ARTIST, COLUMN_DATE, COLUMN_FILENAME, COLUMN_GENRE, COLUMN_TITLE,
+              COLUMN_BITRATE, COLUMN_CHANNELS_COUNT, COLUMN_DURATION, COLUMN_FILESIZE,
+              COLUMN_RATING, COLUMN_SAMPLERATE, COLUMN_CRC32,
+              COLUMN_PATTERN,
+              COLUMNS_COUNT,
+              STORED_COLUMNS_COUNT = COLUMN_PATTERN
+};
+
+//! How column is stored. Slot is index of array of this kind.
+enum KIND { KIND_PLAYLIST, KIND_INT, KIND_INT64, KIND_REAL, KIND_DICTIONARY, KIND_ARENA, KIND_PATTERN };
+
+enum INT_SLOT { INT_ENTRY_ID = 0, INT_ENTRY_INDEX, INT_BITRATE, INT_CHANNELS_COUNT, INT_DURATION, INT_SAMPLERATE, INT_SLOTS_COUNT };
+enum INT64_SLOT { INT64_FILESIZE = 0, INT64_CRC32, INT64_SLOTS_COUNT }; // crc32 is uint32, it does not fit int.
+enum DICTIONARY_SLOT { DICTIONARY_ALBUM = 0, DICTIONARY_ARTIST, DICTIONARY_DATE, DICTIONARY_GENRE, DICTIONARY_SLOTS_COUNT };
+enum ARENA_SLOT { ARENA_FILENAME = 0, ARENA_TITLE, ARENA_SLOTS_COUNT };
+
+const int kTEXT_SLOTS_COUNT = DICTIONARY_SLOTS_COUNT + ARENA_SLOTS_COUNT;
+
+struct ColumnStorage
+{
+    KIND kind;
+    int slot;
+};
+
+const ColumnStorage kCOLUMN_STORAGE[COLUMNS_COUNT] = {
+    { KIND_PLAYLIST,   0                  },
+    { KIND_INT,        INT_ENTRY_ID       },
+    { KIND_INT,        INT_ENTRY_INDEX    },
+    { KIND_DICTIONARY, DICTIONARY_ALBUM   },
+    { KIND_DICTIONARY, DICTIONARY_ARTIST  },
+    { KIND_DICTIONARY, DICTIONARY_DATE    },
+    { KIND_ARENA,      ARENA_FILENAME     },
+    { KIND_DICTIONARY, DICTIONARY_GENRE   },
+    { KIND_ARENA,      ARENA_TITLE        },
+    { KIND_INT,        INT_BITRATE        },
+    { KIND_INT,        INT_CHANNELS_COUNT },
+    { KIND_INT,        INT_DURATION       },
+    { KIND_INT64,      INT64_FILESIZE     },
+    { KIND_REAL,       0                  },
+    { KIND_INT,        INT_SAMPLERATE     },
+    { KIND_INT64,      INT64_CRC32        },
+    { KIND_PATTERN,    0                  }
+};
+
+//! Index of text column in Row::texts.
+int textSlot(const ColumnStorage& storage)
+{
+    return storage.kind == KIND_DICTIONARY ? storage.slot
+                                           : DICTIONARY_SLOTS_COUNT + storage.slot;
+}
+
+/*!
+    \brief Values of all stored columns of entry, it does not refer to store memory.
+    Numeric NULL is kept as 0, text NULL is kept since it differs from empty string in comparisons.
+*/
+struct Row
+{
+    sqlite3_int64 integers[STORED_COLUMNS_COUNT]; // by column, used for integer columns only.
+    double rating;
+    std::string texts[kTEXT_SLOTS_COUNT]; // by textSlot().
+    bool text_is_null[kTEXT_SLOTS_COUNT];
+};
+
+//! Folds character the same way LIKE operator of sqlite_unicode extension does: accent is removed, then case is folded.
+wchar_t foldChar(wchar_t c)
+{
+    return sqlite3_unicode_fold( sqlite3_unicode_unacc(c, nullptr, nullptr) );
+}
+
+//! Appends folded UTF-16 characters of UTF-8 text, characters are the same as sqlite3_value_text16() returns for valid UTF-8.
+void appendFolded(const char* text, size_t size, std::wstring* out)
+{
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(text);
+    const unsigned char* const end = c + size;
+    while (c != end) {
+        unsigned int code_point = *c++;
+        int trailing_bytes = code_point >= 0xF0 ? 3 : code_point >= 0xE0 ? 2 : code_point >= 0xC0 ? 1 : 0;
+        if (trailing_bytes > 0) {
+            code_point &= 0x3F >> trailing_bytes;
+        }
+        for (; trailing_bytes > 0 && c != end && (*c & 0xC0) == 0x80; --trailing_bytes) {
+            code_point = (code_point << 6) | (*c++ & 0x3F);
+        }
+
+        if (code_point > 0xFFFF) { // surrogate pair.
+            code_point -= 0x10000;
+            out->push_back( foldChar( static_cast<wchar_t>(0xD800 + (code_point >> 10)) ) );
+            out->push_back( foldChar( static_cast<wchar_t>(0xDC00 + (code_point & 0x3FF)) ) );
+        } else {
+            out->push_back( foldChar( static_cast<wchar_t>(code_point) ) );
+        }
+    }
+}
+
+typedef unsigned int Code; // code of dictionary value.
+const Code kNULL_CODE = 0;
+
+/*!
+    \brief Distinct values of column which has few of them, rows keep codes of values.
+    Value lives while any row refers to it, code of released value is reused.
+    Values are compared as SQLite BINARY collation does, by rank of code: position of value among sorted values.
+*/
+class Dictionary : boost::noncopyable
+{
+public:
+
+    Dictionary()
+        :
+        values_(1, nullptr), // kNULL_CODE
+        refs_(1, 0),
+        ranks_valid_(false)
+    {}
+
+    //! Returns code of value, value is added if it is new.
+    Code add(const std::string& value, bool is_null);
+
+    void release(Code code);
+
+    //! Returns null for NULL.
+    const std::string* value(Code code) const
+        { return values_[code]; }
+
+    size_t codesCount() const
+        { return values_.size(); }
+
+    //! Returns ranks by code. NULL is less than any value like in SQLite.
+    const std::vector<unsigned int>& ranks() const;
+
+    //! Marks codes which values contain folded pattern.
+    void match(const std::wstring& pattern, std::vector<char>* matched) const;
+
+private:
+
+    typedef std::unordered_map<std::string, Code> Codes;
+
+    Codes codes_;
+    std::vector<const std::string*> values_; // points to keys of codes_, they do not move.
+    std::vector<unsigned int> refs_;
+    std::vector<Code> free_codes_;
+    mutable std::vector<unsigned int> ranks_;
+    mutable bool ranks_valid_; // release does not change order of remaining values, only new value does.
+};
+
+Code Dictionary::add(const std::string& value, bool is_null)
+{
+    if (is_null) {
+        return kNULL_CODE;
+    }
+
+    Codes::iterator it = codes_.find(value);
+    if ( it != codes_.end() ) {
+        ++refs_[it->second];
+        return it->second;
+    }
+
+    values_.reserve(values_.size() + 1);
+    refs_.reserve(refs_.size() + 1);
+    free_codes_.reserve(free_codes_.size() + 1); // release() must not fail.
+
+    it = codes_.insert( std::make_pair(value, kNULL_CODE) ).first;
+    Code code;
+    if ( !free_codes_.empty() ) {
+        code = free_codes_.back();
+        free_codes_.pop_back();
+    } else {
+        code = static_cast<Code>( values_.size() );
+        values_.push_back(nullptr);
+        refs_.push_back(0);
+    }
+    it->second = code;
+    values_[code] = &it->first;
+    refs_[code] = 1;
+    ranks_valid_ = false;
+    return code;
+}
+
+void Dictionary::release(Code code)
+{
+    if (code == kNULL_CODE || --refs_[code] != 0) {
+        return;
+    }
+    codes_.erase( codes_.find(*values_[code]) );
+    values_[code] = nullptr;
+    free_codes_.push_back(code);
+}
+
+const std::vector<unsigned int>& Dictionary::ranks() const
+{
+    if (!ranks_valid_) {
+        std::vector<Code> codes;
+        codes.reserve( codes_.size() );
+        for (Code code = 0, end = static_cast<Code>( values_.size() ); code != end; ++code) {
+            if (values_[code]) {
+                codes.push_back(code);
+            }
+        }
+        std::sort( codes.begin(), codes.end(),
+                   [this](Code lhs, Code rhs) { return *values_[lhs] < *values_[rhs]; } // std::string compares chars as unsigned like memcmp().
+                  );
+
+        ranks_.assign(values_.size(), 0); // NULL and free codes.
+        for (size_t i = 0, size = codes.size(); i != size; ++i) {
+            ranks_[codes[i]] = static_cast<unsigned int>(i + 1);
+        }
+        ranks_valid_ = true;
+    }
+    return ranks_;
+}
+
+void Dictionary::match(const std::wstring& pattern, std::vector<char>* matched) const
+{
+    matched->assign(values_.size(), 0);
+    std::wstring folded;
+    for (Code code = 0, end = static_cast<Code>( values_.size() ); code != end; ++code) {
+        if (const std::string* value = values_[code]) {
+            folded.clear();
+            appendFolded(value->data(), value->size(), &folded);
+            (*matched)[code] = folded.find(pattern) != std::wstring::npos;
+        }
+    }
+}
+
+//! Text in arena of playlist.
+struct TextRef
+{
+    unsigned int offset,
+                 size; // kNULL_TEXT_SIZE for NULL.
+};
+
+const unsigned int kNULL_TEXT_SIZE = UINT_MAX;
+
+struct OrderTerm
+{
+    int column;
+    bool descending;
+};
+
+typedef std::vector<OrderTerm> OrderTerms;
+
+bool operator==(const OrderTerm& lhs, const OrderTerm& rhs)
+{
+    return lhs.column == rhs.column && lhs.descending == rhs.descending;
+}
+
+typedef std::vector<unsigned int> Permutation; // rows of playlist in some order.
+
+/*!
+    \brief Rows of playlist sorted by order terms. It is built on first request of the order and is kept sorted on each change of playlist,
+    so sorted page is slice of permutation.
+*/
+struct SortPermutation
+{
+    OrderTerms order;
+    boost::shared_ptr<Permutation> rows; // cursor keeps rows alive when permutation is dropped.
+    size_t updates_count; // incremental updates since build.
+};
+
+/*!
+    \brief Entries of one playlist as struct of arrays, row is index in every array.
+    Removed row is replaced by last one, so rows have no particular order.
+*/
+struct PlaylistColumns
+{
+    int playlist_id;
+    std::vector<int> ints[INT_SLOTS_COUNT];
+    std::vector<sqlite3_int64> int64s[INT64_SLOTS_COUNT];
+    std::vector<double> ratings;
+    std::vector<Code> codes[DICTIONARY_SLOTS_COUNT];
+    std::vector<TextRef> texts[ARENA_SLOTS_COUNT];
+    std::vector<char> arena; // characters of texts. Texts of removed and changed rows are garbage until compaction.
+    size_t arena_garbage;
+    std::vector<SortPermutation> permutations; // least recently used first.
+
+    explicit PlaylistColumns(int playlist_id)
+        :
+        playlist_id(playlist_id),
+        arena_garbage(0)
+    {}
+
+    unsigned int size() const
+        { return static_cast<unsigned int>( ints[INT_ENTRY_ID].size() ); }
+
+    int entryID(unsigned int row) const
+        { return ints[INT_ENTRY_ID][row]; }
+
+    //! Returns pointer to text or null for NULL text. Pointer is valid until arena is changed.
+    const char* text(int slot, unsigned int row, size_t* size) const
+    {
+        const TextRef& ref = texts[slot][row];
+        if (ref.size == kNULL_TEXT_SIZE) {
+            *size = 0;
+            return nullptr;
+        }
+        *size = ref.size;
+        return ref.size != 0 ? &arena[ref.offset] : "";
+    }
+};
+
+/*!
+    Row of playlist. Refs of cursor stay valid since SQLite collects rowids before it calls xUpdate of virtual table.
+    Any change of store invalidates refs, cursor detects it by PlaylistsEntriesStore::changesCount().
+*/
+struct RowRef
+{
+    const PlaylistColumns* playlist;
+    unsigned int row;
+};
+
+typedef std::vector<RowRef> RowRefs;
+
+template <typename T>
+int compareValues(const T& lhs, const T& rhs)
+{
+    return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+}
+
+//! Compares as SQLite BINARY collation: NULL is less than any text, texts are compared bytewise.
+int compareTexts(const char* lhs, size_t lhs_size, const char* rhs, size_t rhs_size)
+{
+    if (!lhs || !rhs) {
+        return compareValues(lhs != nullptr, rhs != nullptr);
+    }
+    const int result = std::memcmp( lhs, rhs, std::min(lhs_size, rhs_size) );
+    return result != 0 ? result : compareValues(lhs_size, rhs_size);
+}
+
+/*!
+    \brief Compares rows by order terms, equal rows are ordered by entry_index then by entry_id.
+    Entry id is unique, so order is total: each row has the only place among sorted rows.
+*/
+class RowsComparator
+{
+public:
+
+    /*!
+        \param use_ranks - compare dictionary values by ranks. It is faster for sorting,
+                           but ranks are rebuilt after new value is added, so single comparisons use values.
+    */
+    RowsComparator(const Dictionary* dictionaries, const OrderTerms& order, bool use_ranks)
+        :
+        dictionaries_(dictionaries),
+        order_(order)
+    {
+        for (int slot = 0; slot != DICTIONARY_SLOTS_COUNT; ++slot) {
+            ranks_[slot] = use_ranks ? &dictionaries_[slot].ranks() : nullptr;
+        }
+    }
+
+    int compare(const PlaylistColumns& lhs, unsigned int lhs_row, const PlaylistColumns& rhs, unsigned int rhs_row) const
+    {
+        for (const OrderTerm& term : order_) {
+            const int result = compareColumn(term.column, lhs, lhs_row, rhs, rhs_row);
+            if (result != 0) {
+                return term.descending ? -result : result;
+            }
+        }
+        const int result = compareColumn(COLUMN_ENTRY_INDEX, lhs, lhs_row, rhs, rhs_row);
+        return result != 0 ? result : compareColumn(COLUMN_ENTRY_ID, lhs, lhs_row, rhs, rhs_row);
+    }
+
+    int compareColumn(int column, const PlaylistColumns& l, unsigned int lhs_row, const PlaylistColumns& r, unsigned int rhs_row) const
+    {
+        const ColumnStorage& storage = kCOLUMN_STORAGE[column];
+        switch (storage.kind) {
+        case KIND_PLAYLIST:
+            return compareValues(l.playlist_id, r.playlist_id);
+        case KIND_INT:
+            return compareValues(l.ints[storage.slot][lhs_row], r.ints[storage.slot][rhs_row]);
+        case KIND_INT64:
+            return compareValues(l.int64s[storage.slot][lhs_row], r.int64s[storage.slot][rhs_row]);
+        case KIND_REAL:
+            return compareValues(l.ratings[lhs_row], r.ratings[rhs_row]);
+        case KIND_DICTIONARY:
+            {
+            const Code lhs_code = l.codes[storage.slot][lhs_row],
+                       rhs_code = r.codes[storage.slot][rhs_row];
+            if (const std::vector<unsigned int>* ranks = ranks_[storage.slot]) {
+                return compareValues( (*ranks)[lhs_code], (*ranks)[rhs_code] );
+            }
+            const std::string* lhs_value = dictionaries_[storage.slot].value(lhs_code);
+            const std::string* rhs_value = dictionaries_[storage.slot].value(rhs_code);
+            return compareTexts(lhs_value ? lhs_value->data() : nullptr, lhs_value ? lhs_value->size() : 0,
+                                rhs_value ? rhs_value->data() : nullptr, rhs_value ? rhs_value->size() : 0);
+            }
+        case KIND_ARENA:
+            {
+            size_t lhs_size, rhs_size;
+            const char* lhs_text = l.text(storage.slot, lhs_row, &lhs_size);
+            const char* rhs_text = r.text(storage.slot, rhs_row, &rhs_size);
+            return compareTexts(lhs_text, lhs_size, rhs_text, rhs_size);
+            }
+        default:
+            return 0;
+        }
+    }
+
+    bool operator()(const RowRef& lhs, const RowRef& rhs) const
+        { return compare(*lhs.playlist, lhs.row, *rhs.playlist, rhs.row) < 0; }
+
+private:
+
+    const Dictionary* dictionaries_;
+    const OrderTerms& order_;
+    const std::vector<unsigned int>* ranks_[DICTIONARY_SLOTS_COUNT]; // nulls if values are compared.
+};
+
+//! Compares rows of the same playlist, it is used for permutations.
+class PlaylistRowsComparator
+{
+public:
+
+    PlaylistRowsComparator(const RowsComparator& comparator, const PlaylistColumns& playlist)
+        :
+        comparator_(comparator),
+        playlist_(playlist)
+    {}
+
+    bool operator()(unsigned int lhs, unsigned int rhs) const
+        { return comparator_.compare(playlist_, lhs, playlist_, rhs) < 0; }
+
+private:
+
+    const RowsComparator& comparator_;
+    const PlaylistColumns& playlist_;
+};
+
+const size_t kMIN_ROWS_TO_SORT_IN_PARALLEL = 50000; // thread start is not worth it for less rows.
+
+//! Sorts parts of rows in separate threads, then merges them. Comparator is used from several threads, so it must not change anything.
+void parallelSort(Permutation* rows, const PlaylistRowsComparator& comparator)
+{
+    const size_t parts_count = std::min<size_t>( std::max(1u, boost::thread::hardware_concurrency()),
+                                                 rows->size() / (kMIN_ROWS_TO_SORT_IN_PARALLEL / 2)
+                                                );
+    if (parts_count < 2) {
+        std::sort(rows->begin(), rows->end(), comparator);
+        return;
+    }
+
+    std::vector<Permutation::iterator> bounds;
+    for (size_t part = 0; part != parts_count; ++part) {
+        bounds.push_back( rows->begin() + rows->size() * part / parts_count );
+    }
+    bounds.push_back( rows->end() );
+
+    const auto sort_part = [&bounds, &comparator](size_t part) {
+        std::sort(bounds[part], bounds[part + 1], comparator);
+    };
+
+    boost::thread_group threads;
+    size_t part = 1; // first part is sorted by current thread.
+    try {
+        for (; part != parts_count; ++part) {
+            threads.create_thread( boost::bind<void>(sort_part, part) );
+        }
+    } catch (boost::thread_resource_error&) {
+        // sort rest parts in current thread.
+    }
+    for (size_t rest_part = part; rest_part != parts_count; ++rest_part) {
+        sort_part(rest_part);
+    }
+    sort_part(0);
+    threads.join_all();
+
+    for (size_t step = 1; step < parts_count; step *= 2) {
+        for (size_t part = 0; part + step < parts_count; part += step * 2) {
+            std::inplace_merge( bounds[part], bounds[part + step], bounds[std::min(part + step * 2, parts_count)], comparator );
+        }
+    }
+}
+
+//! Folded pattern and matches of dictionary values, it is prepared once for all rows.
+class Search : boost::noncopyable
+{
+public:
+
+    Search(const Dictionary* dictionaries, const std::wstring& pattern)
+        :
+        pattern_(pattern)
+    {
+        for (int slot = 0; slot != DICTIONARY_SLOTS_COUNT; ++slot) {
+            dictionaries[slot].match(pattern_, &dictionary_matches_[slot]);
+        }
+    }
+
+    //! Checks dictionary columns by code first, title is folded only if they do not match.
+    bool matches(const PlaylistColumns& playlist, unsigned int row)
+    {
+        for (int slot = 0; slot != DICTIONARY_SLOTS_COUNT; ++slot) {
+            if ( dictionary_matches_[slot][ playlist.codes[slot][row] ] ) {
+                return true;
+            }
+        }
+
+        size_t size;
+        const char* title = playlist.text(ARENA_TITLE, row, &size);
+        if (!title) {
+            return false;
+        }
+        folded_title_.clear();
+        appendFolded(title, size, &folded_title_);
+        return folded_title_.find(pattern_) != std::wstring::npos;
+    }
+
+private:
+
+    const std::wstring pattern_;
+    std::vector<char> dictionary_matches_[DICTIONARY_SLOTS_COUNT];
+    std::wstring folded_title_; // buffer is reused for all rows.
+};
+
+} // namespace anonymous
+
+/*!
+    \brief Columnar storage of entries of all playlists. See createPlaylistsEntriesStore() description.
+    Changes done inside transaction are logged with state of entry before change and are reverted on rollback.
+    Savepoints mark positions in the log: ROLLBACK TO(and failed statement) reverts changes done after mark only.
+*/
+class PlaylistsEntriesStore : boost::noncopyable
+{
+public:
+
+    PlaylistsEntriesStore()
+        :
+        changes_count_(0),
+        in_transaction_(false)
+    {}
+
+    //! Adds entry or replaces entry with the same id.
+    void insert(const Row& row);
+
+    void erase(int entry_id);
+
+    bool contains(int entry_id) const
+        { return locations_.find(entry_id) != locations_.end(); }
+
+    //! Fills rows of all entries or of entries of specified playlist.
+    void getRows(bool by_playlist, int playlist_id, RowRefs* rows) const;
+
+    //! Fills row of entry if it exists.
+    void getEntryRow(int entry_id, RowRefs* rows) const;
+
+    /*!
+        \brief Returns rows of playlist sorted by terms like sortRows() does. Permutation is cached until playlist is changed much.
+        \return null if playlist does not exist.
+    */
+    boost::shared_ptr<const Permutation> getSortPermutation(int playlist_id, const OrderTerms& order, const PlaylistColumns** playlist);
+
+    //! Leaves only rows which contain folded pattern in searchable fields.
+    void filterRows(const std::wstring& pattern, RowRefs* rows) const;
+
+    //! Sorts rows by terms, equal rows are ordered by entry_index then by entry_id.
+    void sortRows(const OrderTerms& order, RowRefs* rows) const;
+
+    //! Prepares search of folded pattern.
+    Search* createSearch(const std::wstring& pattern) const
+        { return new Search(dictionaries_, pattern); }
+
+    void count(int playlist_id, const std::string& pattern, size_t* total_entries_count, size_t* found_entries_count) const;
+
+    //! Sets SQLite result to value of column of row. Text is copied by SQLite since it can outlive any change of store.
+    void getColumn(const RowRef& row_ref, int column, sqlite3_context* context) const;
+
+    //! Returns count of changes of rows. Row refs and permutations taken before change must not be used after it.
+    unsigned int changesCount() const
+        { return changes_count_; }
+
+    void beginTransaction()
+    {
+        undo_log_.clear();
+        savepoints_.clear();
+        in_transaction_ = true;
+    }
+
+    void commit()
+    {
+        undo_log_.clear();
+        savepoints_.clear();
+        in_transaction_ = false;
+    }
+
+    void rollback()
+    {
+        undoUpTo(0);
+        savepoints_.clear();
+        in_transaction_ = false;
+    }
+
+    //! Marks current state as savepoint with given nesting level. Savepoints of the same or deeper level are replaced.
+    void savepoint(int level)
+    {
+        savepoints_.resize(level, undo_log_.size()); // levels skipped by SQLite start at the same state.
+        savepoints_.push_back( undo_log_.size() );
+    }
+
+    //! Forgets savepoints of given and deeper levels, their changes stay in log until end of transaction.
+    void releaseSavepoint(int level)
+    {
+        if ( static_cast<size_t>(level) < savepoints_.size() ) {
+            savepoints_.resize(level);
+        }
+    }
+
+    //! Reverts changes done after savepoint of given level. Savepoint itself stays active, deeper ones are forgotten.
+    void rollbackToSavepoint(int level)
+    {
+        if ( static_cast<size_t>(level) < savepoints_.size() ) {
+            undoUpTo(savepoints_[level]);
+            savepoints_.resize(level + 1);
+        }
+    }
+
+private:
+
+    static const size_t kMIN_ARENA_GARBAGE_TO_COMPACT = 64 * 1024; // avoids frequent compaction of small arena.
+    static const size_t kMAX_PERMUTATIONS_PER_PLAYLIST = 8; // enough for several columns in both directions.
+    static const size_t kMIN_UPDATES_TO_DROP_PERMUTATION = 64;
+
+    struct Location
+    {
+        PlaylistColumns* playlist;
+        unsigned int row;
+    };
+
+    struct UndoRecord
+    {
+        int entry_id;
+        bool existed;
+        Row row;
+    };
+
+    void insertEntry(const Row& row);
+    void eraseEntry(int entry_id);
+    void setFields(PlaylistColumns* playlist, unsigned int row, const Row& values, bool new_row);
+    void readRow(const PlaylistColumns& playlist, unsigned int row, Row* values) const;
+    void compactArena(PlaylistColumns* playlist);
+    //! Remembers state of entry before its change inside transaction.
+    void saveUndo(int entry_id);
+    //! Reverts and removes log records starting from given position.
+    void undoUpTo(size_t log_size);
+
+    void buildSortPermutation(const PlaylistColumns& playlist, const OrderTerms& order, Permutation* rows);
+    // Following functions keep sort permutations of playlist sorted when rows are changed.
+    //! Must be called after row is added.
+    void insertIntoPermutations(PlaylistColumns* playlist, unsigned int row);
+    //! Must be called before row is removed, while data of rows is valid. Last row will be moved to place of removed one.
+    void eraseFromPermutations(PlaylistColumns* playlist, unsigned int row);
+    //! Fills positions of row in permutations, it is called before change of row.
+    void findInPermutations(const PlaylistColumns& playlist, unsigned int row, std::vector<size_t>* positions) const;
+    //! Moves changed row to its new place in permutations.
+    void reorderInPermutations(PlaylistColumns* playlist, unsigned int row, const std::vector<size_t>& positions);
+    //! Drops permutations which failed to update or were updated so many times that rebuild is cheaper.
+    void dropStalePermutations(PlaylistColumns* playlist);
+
+    typedef std::unordered_map<int, PlaylistColumns> Playlists; // references to elements stay valid on rehash.
+    Playlists playlists_;
+    std::unordered_map<int, Location> locations_; // by entry id.
+    Dictionary dictionaries_[DICTIONARY_SLOTS_COUNT];
+    unsigned int changes_count_;
+
+    std::vector<UndoRecord> undo_log_;
+    std::vector<size_t> savepoints_; // size of undo_log_ at each savepoint level.
+    bool in_transaction_;
+};
+
+void PlaylistsEntriesStore::insert(const Row& row)
+{
+    const int playlist_id = static_cast<int>(row.integers[COLUMN_PLAYLIST_ID]),
+              entry_id    = static_cast<int>(row.integers[COLUMN_ENTRY_ID]);
+    saveUndo(entry_id);
+    ++changes_count_;
+
+    auto it = locations_.find(entry_id);
+    if ( it != locations_.end() && it->second.playlist->playlist_id == playlist_id ) {
+        // row keeps its place, unchanged texts are not copied.
+        PlaylistColumns* playlist = it->second.playlist;
+        const unsigned int row_index = it->second.row;
+        std::vector<size_t> positions;
+        findInPermutations(*playlist, row_index, &positions);
+        setFields(playlist, row_index, row, false);
+        reorderInPermutations(playlist, row_index, positions);
+        compactArena(playlist);
+        return;
+    }
+
+    eraseEntry(entry_id);
+    insertEntry(row);
+}
+
+void PlaylistsEntriesStore::erase(int entry_id)
+{
+    saveUndo(entry_id);
+    ++changes_count_;
+    eraseEntry(entry_id);
+}
+
+void PlaylistsEntriesStore::insertEntry(const Row& row)
+{
+    const int playlist_id = static_cast<int>(row.integers[COLUMN_PLAYLIST_ID]);
+    Playlists::iterator playlist_it = playlists_.find(playlist_id);
+    if ( playlist_it == playlists_.end() ) {
+        playlist_it = playlists_.insert( std::make_pair( playlist_id, PlaylistColumns(playlist_id) ) ).first;
+    }
+    PlaylistColumns& playlist = playlist_it->second;
+
+    const unsigned int row_index = playlist.size();
+    for (auto& column : playlist.ints)   { column.push_back(0); }
+    for (auto& column : playlist.int64s) { column.push_back(0); }
+    playlist.ratings.push_back(0.);
+    for (auto& column : playlist.codes)  { column.push_back(kNULL_CODE); }
+    const TextRef null_text = { 0, kNULL_TEXT_SIZE };
+    for (auto& column : playlist.texts)  { column.push_back(null_text); }
+
+    setFields(&playlist, row_index, row, true);
+
+    const Location location = { &playlist, row_index };
+    locations_[ playlist.entryID(row_index) ] = location;
+
+    insertIntoPermutations(&playlist, row_index);
+}
+
+void PlaylistsEntriesStore::eraseEntry(int entry_id)
+{
+    auto it = locations_.find(entry_id);
+    if ( it == locations_.end() ) {
+        return;
+    }
+    PlaylistColumns& playlist = *it->second.playlist;
+    const unsigned int row = it->second.row;
+    locations_.erase(it);
+
+    eraseFromPermutations(&playlist, row);
+
+    for (int slot = 0; slot != DICTIONARY_SLOTS_COUNT; ++slot) {
+        dictionaries_[slot].release(playlist.codes[slot][row]);
+    }
+    for (const auto& column : playlist.texts) {
+        if (column[row].size != kNULL_TEXT_SIZE) {
+            playlist.arena_garbage += column[row].size;
+        }
+    }
+
+    // move last row to place of removed one.
+    const unsigned int last_row = playlist.size() - 1;
+    if (row != last_row) {
+        for (auto& column : playlist.ints)   { column[row] = column[last_row]; }
+        for (auto& column : playlist.int64s) { column[row] = column[last_row]; }
+        playlist.ratings[row] = playlist.ratings[last_row];
+        for (auto& column : playlist.codes)  { column[row] = column[last_row]; }
+        for (auto& column : playlist.texts)  { column[row] = column[last_row]; }
+        locations_[ playlist.entryID(row) ].row = row;
+    }
+    for (auto& column : playlist.ints)   { column.pop_back(); }
+    for (auto& column : playlist.int64s) { column.pop_back(); }
+    playlist.ratings.pop_back();
+    for (auto& column : playlist.codes)  { column.pop_back(); }
+    for (auto& column : playlist.texts)  { column.pop_back(); }
+
+    if (playlist.size() == 0) {
+        const int playlist_id = playlist.playlist_id; // key must not refer to erased element.
+        playlists_.erase(playlist_id);
+    } else {
+        compactArena(&playlist);
+    }
+}
+
+void PlaylistsEntriesStore::setFields(PlaylistColumns* playlist, unsigned int row, const Row& values, bool new_row)
+{
+    for (int column = COLUMN_ENTRY_ID; column != STORED_COLUMNS_COUNT; ++column) {
+        const ColumnStorage& storage = kCOLUMN_STORAGE[column];
+        switch (storage.kind) {
+        case KIND_INT:
+            playlist->ints[storage.slot][row] = static_cast<int>(values.integers[column]);
+            break;
+        case KIND_INT64:
+            playlist->int64s[storage.slot][row] = values.integers[column];
+            break;
+        case KIND_REAL:
+            playlist->ratings[row] = values.rating;
+            break;
+        case KIND_DICTIONARY:
+            {
+            Dictionary& dictionary = dictionaries_[storage.slot];
+            Code& code = playlist->codes[storage.slot][row];
+            const Code old_code = code;
+            code = dictionary.add( values.texts[textSlot(storage)], values.text_is_null[textSlot(storage)] ); // add before release keeps the same value alive.
+            if (!new_row) {
+                dictionary.release(old_code);
+            }
+            }
+            break;
+        case KIND_ARENA:
+            {
+            const std::string& text = values.texts[textSlot(storage)];
+            const bool is_null = values.text_is_null[textSlot(storage)];
+            TextRef& ref = playlist->texts[storage.slot][row];
+            if (!new_row) {
+                size_t old_size;
+                const char* old_text = playlist->text(storage.slot, row, &old_size);
+                if (   (is_null && !old_text)
+                    || (!is_null && old_text && old_size == text.size() && std::memcmp(old_text, text.data(), old_size) == 0)
+                    )
+                {
+                    break; // keep unchanged text in place.
+                }
+                if (old_text) {
+                    playlist->arena_garbage += old_size;
+                }
+            }
+
+            if (is_null) {
+                ref.offset = 0;
+                ref.size = kNULL_TEXT_SIZE;
+            } else {
+                ref.offset = static_cast<unsigned int>( playlist->arena.size() );
+                ref.size = static_cast<unsigned int>( text.size() );
+                playlist->arena.insert( playlist->arena.end(), text.begin(), text.end() );
+            }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void PlaylistsEntriesStore::readRow(const PlaylistColumns& playlist, unsigned int row, Row* values) const
+{
+    values->integers[COLUMN_PLAYLIST_ID] = playlist.playlist_id;
+    for (int column = COLUMN_ENTRY_ID; column != STORED_COLUMNS_COUNT; ++column) {
+        const ColumnStorage& storage = kCOLUMN_STORAGE[column];
+        switch (storage.kind) {
+        case KIND_INT:
+            values->integers[column] = playlist.ints[storage.slot][row];
+            break;
+        case KIND_INT64:
+            values->integers[column] = playlist.int64s[storage.slot][row];
+            break;
+        case KIND_REAL:
+            values->rating = playlist.ratings[row];
+            break;
+        case KIND_DICTIONARY:
+            {
+            const std::string* value = dictionaries_[storage.slot].value(playlist.codes[storage.slot][row]);
+            values->text_is_null[textSlot(storage)] = value == nullptr;
+            values->texts[textSlot(storage)] = value ? *value : std::string();
+            }
+            break;
+        case KIND_ARENA:
+            {
+            size_t size;
+            const char* text = playlist.text(storage.slot, row, &size);
+            values->text_is_null[textSlot(storage)] = text == nullptr;
+            values->texts[textSlot(storage)].assign(text ? text : "", size);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void PlaylistsEntriesStore::compactArena(PlaylistColumns* playlist)
+{
+    if (playlist->arena_garbage < kMIN_ARENA_GARBAGE_TO_COMPACT || playlist->arena_garbage * 2 < playlist->arena.size()) {
+        return;
+    }
+
+    std::vector<char> arena;
+    arena.reserve(playlist->arena.size() - playlist->arena_garbage);
+    for (auto& column : playlist->texts) {
+        for (TextRef& ref : column) {
+            if (ref.size != kNULL_TEXT_SIZE) {
+                const unsigned int offset = static_cast<unsigned int>( arena.size() );
+                arena.insert(arena.end(), playlist->arena.begin() + ref.offset, playlist->arena.begin() + ref.offset + ref.size);
+                ref.offset = offset;
+            }
+        }
+    }
+    playlist->arena.swap(arena);
+    playlist->arena_garbage = 0;
+}
+
+void PlaylistsEntriesStore::getRows(bool by_playlist, int playlist_id, RowRefs* rows) const
+{
+    rows->clear();
+    const auto add_playlist_rows = [rows](const PlaylistColumns& playlist) {
+        const RowRef first = { &playlist, 0 };
+        rows->resize(rows->size() + playlist.size(), first);
+        RowRef* ref = &rows->back() - (playlist.size() - 1);
+        for (unsigned int row = 0, size = playlist.size(); row != size; ++row, ++ref) {
+            ref->row = row;
+        }
+    };
+
+    if (by_playlist) {
+        Playlists::const_iterator it = playlists_.find(playlist_id);
+        if ( it != playlists_.end() ) {
+            add_playlist_rows(it->second);
+        }
+    } else {
+        rows->reserve( locations_.size() );
+        for (const auto& playlist : playlists_) {
+            add_playlist_rows(playlist.second);
+        }
+    }
+}
+
+void PlaylistsEntriesStore::getEntryRow(int entry_id, RowRefs* rows) const
+{
+    rows->clear();
+    auto it = locations_.find(entry_id);
+    if ( it != locations_.end() ) {
+        const RowRef ref = { it->second.playlist, it->second.row };
+        rows->push_back(ref);
+    }
+}
+
+boost::shared_ptr<const Permutation> PlaylistsEntriesStore::getSortPermutation(int playlist_id, const OrderTerms& order, const PlaylistColumns** playlist_columns)
+{
+    Playlists::iterator it = playlists_.find(playlist_id);
+    if ( it == playlists_.end() ) {
+        return boost::shared_ptr<const Permutation>();
+    }
+    PlaylistColumns& playlist = it->second;
+    *playlist_columns = &playlist;
+
+    auto& permutations = playlist.permutations;
+    auto permutation_it = std::find_if( permutations.begin(), permutations.end(),
+                                        [&order](const SortPermutation& permutation) { return permutation.order == order; }
+                                       );
+    if ( permutation_it != permutations.end() ) {
+        std::rotate(permutation_it, permutation_it + 1, permutations.end()); // mark as most recently used.
+        return permutations.back().rows;
+    }
+
+    SortPermutation permutation;
+    permutation.order = order;
+    permutation.rows = boost::make_shared<Permutation>();
+    permutation.updates_count = 0;
+    buildSortPermutation(playlist, order, permutation.rows.get());
+
+    if (permutations.size() >= kMAX_PERMUTATIONS_PER_PLAYLIST) {
+        permutations.erase( permutations.begin() );
+    }
+    permutations.push_back(permutation);
+    return permutation.rows;
+}
+
+/*!
+    Single term permutation is sorted from scratch. Permutation of several terms is refined from permutation of first term:
+    only runs of rows with equal first term value are sorted.
+*/
+void PlaylistsEntriesStore::buildSortPermutation(const PlaylistColumns& playlist, const OrderTerms& order, Permutation* rows)
+{
+    const RowsComparator comparator(dictionaries_, order, true);
+    const PlaylistRowsComparator rows_comparator(comparator, playlist);
+
+    if (order.size() > 1) {
+        const OrderTerms first_term(1, order.front());
+        const PlaylistColumns* unused;
+        *rows = *getSortPermutation(playlist.playlist_id, first_term, &unused);
+
+        const int first_column = order.front().column;
+        for (Permutation::iterator run_begin = rows->begin(); run_begin != rows->end(); ) {
+            Permutation::iterator run_end = run_begin + 1;
+            while (   run_end != rows->end()
+                   && comparator.compareColumn(first_column, playlist, *run_begin, playlist, *run_end) == 0
+                   )
+            {
+                ++run_end;
+            }
+            if (run_end - run_begin > 1) {
+                std::sort(run_begin, run_end, rows_comparator);
+            }
+            run_begin = run_end;
+        }
+        return;
+    }
+
+    rows->resize( playlist.size() );
+    for (unsigned int row = 0, size = playlist.size(); row != size; ++row) {
+        (*rows)[row] = row;
+    }
+    parallelSort(rows, rows_comparator);
+}
+
+void PlaylistsEntriesStore::insertIntoPermutations(PlaylistColumns* playlist, unsigned int row)
+{
+    for (SortPermutation& permutation : playlist->permutations) {
+        const RowsComparator comparator(dictionaries_, permutation.order, false);
+        Permutation& rows = *permutation.rows;
+        try {
+            rows.insert( std::lower_bound( rows.begin(), rows.end(), row, PlaylistRowsComparator(comparator, *playlist) ), row );
+            ++permutation.updates_count;
+        } catch (std::bad_alloc&) {
+            permutation.rows.reset(); // it is rebuilt on next request.
+        }
+    }
+    dropStalePermutations(playlist);
+}
+
+void PlaylistsEntriesStore::eraseFromPermutations(PlaylistColumns* playlist, unsigned int row)
+{
+    const unsigned int last_row = playlist->size() - 1;
+    for (SortPermutation& permutation : playlist->permutations) {
+        const RowsComparator comparator(dictionaries_, permutation.order, false);
+        const PlaylistRowsComparator rows_comparator(comparator, *playlist);
+        Permutation& rows = *permutation.rows;
+        rows.erase( std::lower_bound(rows.begin(), rows.end(), row, rows_comparator) );
+        if (row != last_row) {
+            *std::lower_bound(rows.begin(), rows.end(), last_row, rows_comparator) = row; // data of last row is moved to removed row.
+        }
+        ++permutation.updates_count;
+    }
+    dropStalePermutations(playlist);
+}
+
+void PlaylistsEntriesStore::findInPermutations(const PlaylistColumns& playlist, unsigned int row, std::vector<size_t>* positions) const
+{
+    positions->clear();
+    for (const SortPermutation& permutation : playlist.permutations) {
+        const RowsComparator comparator(dictionaries_, permutation.order, false);
+        const Permutation& rows = *permutation.rows;
+        positions->push_back( std::lower_bound( rows.begin(), rows.end(), row, PlaylistRowsComparator(comparator, playlist) ) - rows.begin() );
+    }
+}
+
+void PlaylistsEntriesStore::reorderInPermutations(PlaylistColumns* playlist, unsigned int row, const std::vector<size_t>& positions)
+{
+    for (size_t i = 0, size = playlist->permutations.size(); i != size; ++i) {
+        SortPermutation& permutation = playlist->permutations[i];
+        const RowsComparator comparator(dictionaries_, permutation.order, false);
+        const PlaylistRowsComparator rows_comparator(comparator, *playlist);
+        Permutation& rows = *permutation.rows;
+        const Permutation::iterator position = rows.begin() + positions[i];
+        if (   (position == rows.begin() || rows_comparator(*(position - 1), row))
+            && (position + 1 == rows.end() || rows_comparator(row, *(position + 1)))
+            )
+        {
+            continue; // changed fields do not affect order.
+        }
+
+        rows.erase(position);
+        rows.insert( std::lower_bound(rows.begin(), rows.end(), row, rows_comparator), row ); // does not allocate since one row was erased.
+        ++permutation.updates_count;
+    }
+    dropStalePermutations(playlist);
+}
+
+void PlaylistsEntriesStore::dropStalePermutations(PlaylistColumns* playlist)
+{
+    // each update moves half of permutation on average, so after many updates rebuild on demand is cheaper.
+    auto& permutations = playlist->permutations;
+    permutations.erase( std::remove_if( permutations.begin(), permutations.end(),
+                                        [](const SortPermutation& permutation) {
+                                            return    !permutation.rows
+                                                   || permutation.updates_count > kMIN_UPDATES_TO_DROP_PERMUTATION + permutation.rows->size() / 8;
+                                        }
+                                       ),
+                        permutations.end()
+                       );
+}
+
+void PlaylistsEntriesStore::filterRows(const std::wstring& pattern, RowRefs* rows) const
+{
+    Search search(dictionaries_, pattern);
+    rows->erase( std::remove_if( rows->begin(), rows->end(),
+                                 [&search](const RowRef& ref) { return !search.matches(*ref.playlist, ref.row); }
+                                ),
+                 rows->end()
+                );
+}
+
+void PlaylistsEntriesStore::count(int playlist_id, const std::string& pattern, size_t* total_entries_count, size_t* found_entries_count) const
+{
+    Playlists::const_iterator it = playlists_.find(playlist_id);
+    if ( it == playlists_.end() ) {
+        *total_entries_count = *found_entries_count = 0;
+        return;
+    }
+
+    const PlaylistColumns& playlist = it->second;
+    *total_entries_count = *found_entries_count = playlist.size();
+    if ( pattern.empty() ) {
+        return;
+    }
+
+    std::wstring folded_pattern;
+    appendFolded(pattern.data(), pattern.size(), &folded_pattern);
+    Search search(dictionaries_, folded_pattern);
+    size_t found = 0;
+    for (unsigned int row = 0, size = playlist.size(); row != size; ++row) {
+        found += search.matches(playlist, row);
+    }
+    *found_entries_count = found;
+}
+
+void PlaylistsEntriesStore::sortRows(const OrderTerms& order, RowRefs* rows) const
+{
+    std::sort( rows->begin(), rows->end(), RowsComparator(dictionaries_, order, true) ); // dictionary values are compared once here, rows are compared by integer ranks.
+}
+
+void PlaylistsEntriesStore::getColumn(const RowRef& row_ref, int column, sqlite3_context* context) const
+{
+    const PlaylistColumns& playlist = *row_ref.playlist;
+    const unsigned int row = row_ref.row;
+    const ColumnStorage& storage = kCOLUMN_STORAGE[column];
+    switch (storage.kind) {
+    case KIND_PLAYLIST:
+        sqlite3_result_int(context, playlist.playlist_id);
+        break;
+    case KIND_INT:
+        sqlite3_result_int(context, playlist.ints[storage.slot][row]);
+        break;
+    case KIND_INT64:
+        sqlite3_result_int64(context, playlist.int64s[storage.slot][row]);
+        break;
+    case KIND_REAL:
+        sqlite3_result_double(context, playlist.ratings[row]);
+        break;
+    case KIND_DICTIONARY:
+        if ( const std::string* value = dictionaries_[storage.slot].value(playlist.codes[storage.slot][row]) ) {
+            sqlite3_result_text( context, value->c_str(), static_cast<int>( value->size() ), SQLITE_TRANSIENT ); // value is freed when last entry with it is changed.
+        } else {
+            sqlite3_result_null(context);
+        }
+        break;
+    case KIND_ARENA:
+        {
+        size_t size;
+        if ( const char* text = playlist.text(storage.slot, row, &size) ) {
+            sqlite3_result_text( context, text, static_cast<int>(size), SQLITE_TRANSIENT ); // arena is reallocated by change of any entry of playlist.
+        } else {
+            sqlite3_result_null(context);
+        }
+        }
+        break;
+    default:
+        sqlite3_result_null(context); // pattern column has no value.
+        break;
+    }
+}
+
+void PlaylistsEntriesStore::saveUndo(int entry_id)
+{
+    if (!in_transaction_) {
+        return;
+    }
+
+    undo_log_.push_back( UndoRecord() );
+    UndoRecord& record = undo_log_.back();
+    record.entry_id = entry_id;
+    auto it = locations_.find(entry_id);
+    record.existed = it != locations_.end();
+    if (record.existed) {
+        readRow(*it->second.playlist, it->second.row, &record.row);
+    }
+}
+
+void PlaylistsEntriesStore::undoUpTo(size_t log_size)
+{
+    if (undo_log_.size() > log_size) {
+        ++changes_count_;
+    }
+    while (undo_log_.size() > log_size) {
+        const UndoRecord& record = undo_log_.back();
+        eraseEntry(record.entry_id);
+        if (record.existed) {
+            insertEntry(record.row);
+        }
+        undo_log_.pop_back();
+    }
+}
+
+void countPlaylistEntries(const PlaylistsEntriesStore& store, PlaylistID playlist_id, const std::string& pattern,
+                          size_t* total_entries_count, size_t* found_entries_count)
+{
+    store.count(playlist_id, pattern, total_entries_count, found_entries_count);
+}
+
+namespace {
+
+// Virtual table is thin adapter of PlaylistsEntriesStore to SQLite: store lives as long as module registered in db.
+
+// bits of idxNum, constraint args are passed to filterRows() in the same order.
+enum PLAN { PLAN_BY_PATTERN = 1, PLAN_BY_PLAYLIST = 2, PLAN_BY_ENTRY = 4 };
+
+struct StoreTable
+{
+    sqlite3_vtab base; // must be first member.
+    sqlite3* db;
+    PlaylistsEntriesStore* store;
+};
+
+/*!
+    \brief Cursor iterates selected rows or sort permutation of playlist.
+    Permutation is filtered on the fly, so LIMIT stops scan at page end and whole playlist is neither sorted nor filtered.
+    Rows and playlist pointer are valid only until store is changed: reading of cursor after change fails with SQLITE_ABORT.
+*/
+struct StoreCursor
+{
+    sqlite3_vtab_cursor base; // must be first member.
+    unsigned int store_changes_count; // store state which rows were selected in.
+    RowRefs rows; // used if there is no permutation.
+    boost::shared_ptr<const Permutation> permutation;
+    const PlaylistColumns* playlist; // owner of permutation rows.
+    boost::scoped_ptr<Search> search; // null if permutation is not filtered.
+    size_t position;
+};
+
+PlaylistsEntriesStore& getStore(sqlite3_vtab* vtab)
+    { return *reinterpret_cast<StoreTable*>(vtab)->store; }
+
+int createTable(sqlite3* db, void* aux, int /*argc*/, const char* const* /*argv*/, sqlite3_vtab** vtab, char** /*errmsg*/)
+{
+    int rc = sqlite3_declare_vtab(db, kTABLE_SCHEMA);
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+    rc = sqlite3_vtab_config(db, SQLITE_VTAB_CONSTRAINT_SUPPORT, 1); // updateTable() checks uniqueness of entry id before any change.
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+
+    StoreTable* table = new(std::nothrow) StoreTable();
+    if (!table) {
+        return SQLITE_NOMEM;
+    }
+    table->db = db;
+    table->store = static_cast<PlaylistsEntriesStore*>(aux);
+    *vtab = &table->base;
+    return SQLITE_OK;
+}
+
+int disconnectTable(sqlite3_vtab* vtab)
+{
+    delete reinterpret_cast<StoreTable*>(vtab);
+    return SQLITE_OK;
+}
+
+/*!
+    ORDER BY is consumed if all terms are stored columns, terms are passed to filterRows() in idxStr:
+    two characters per term, column as 'A' + column index and direction as 'a' or 'd'.
+*/
+int bestIndex(sqlite3_vtab* /*vtab*/, sqlite3_index_info* info)
+{
+    int constraint_by_column[COLUMNS_COUNT];
+    std::fill(constraint_by_column, constraint_by_column + COLUMNS_COUNT, -1);
+    for (int i = 0; i < info->nConstraint; ++i) {
+        const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+        if (constraint.usable && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            const int column = constraint.iColumn >= 0 ? constraint.iColumn : COLUMN_ENTRY_ID; // rowid is entry id.
+            constraint_by_column[column] = i;
+        }
+    }
+
+    const struct { COLUMN column; PLAN plan; } kPLAN_COLUMNS[] = { { COLUMN_PATTERN,     PLAN_BY_PATTERN  },
+                                                                   { COLUMN_PLAYLIST_ID, PLAN_BY_PLAYLIST },
+                                                                   { COLUMN_ENTRY_ID,    PLAN_BY_ENTRY    }
+                                                                 };
+    int argv_index = 0;
+    info->idxNum = 0;
+    for (const auto& plan_column : kPLAN_COLUMNS) {
+        const int constraint = constraint_by_column[plan_column.column];
+        if (constraint >= 0) {
+            info->aConstraintUsage[constraint].argvIndex = ++argv_index;
+            info->aConstraintUsage[constraint].omit = 1; // store checks constraint itself, pattern column has no value to check.
+            info->idxNum |= plan_column.plan;
+        }
+    }
+
+    bool order_supported = info->nOrderBy > 0;
+    for (int i = 0; i < info->nOrderBy; ++i) {
+        const int column = info->aOrderBy[i].iColumn;
+        order_supported = order_supported && column >= 0 && column < STORED_COLUMNS_COUNT;
+    }
+    if (order_supported) {
+        char* order = static_cast<char*>( sqlite3_malloc(info->nOrderBy * 2 + 1) );
+        if (!order) {
+            return SQLITE_NOMEM;
+        }
+        for (int i = 0; i < info->nOrderBy; ++i) {
+            order[i * 2]     = static_cast<char>('A' + info->aOrderBy[i].iColumn);
+            order[i * 2 + 1] = info->aOrderBy[i].desc ? 'd' : 'a';
+        }
+        order[info->nOrderBy * 2] = '\0';
+        info->idxStr = order;
+        info->needToFreeIdxStr = 1;
+        info->orderByConsumed = 1;
+    }
+
+    if (info->idxNum & PLAN_BY_ENTRY) {
+        info->estimatedCost = 1;
+    } else if (info->idxNum & PLAN_BY_PLAYLIST) {
+        info->estimatedCost = (info->idxNum & PLAN_BY_PATTERN) ? 1000 : 10000;
+    } else {
+        info->estimatedCost = 1000000;
+    }
+    return SQLITE_OK;
+}
+
+int openCursor(sqlite3_vtab* /*vtab*/, sqlite3_vtab_cursor** cursor)
+{
+    StoreCursor* store_cursor = new(std::nothrow) StoreCursor();
+    if (!store_cursor) {
+        return SQLITE_NOMEM;
+    }
+    store_cursor->store_changes_count = 0;
+    store_cursor->playlist = nullptr;
+    store_cursor->position = 0;
+    *cursor = &store_cursor->base;
+    return SQLITE_OK;
+}
+
+int closeCursor(sqlite3_vtab_cursor* cursor)
+{
+    delete reinterpret_cast<StoreCursor*>(cursor);
+    return SQLITE_OK;
+}
+
+//! Returns SQLITE_ABORT if store was changed after rows of cursor were selected: they can refer to removed or moved rows.
+int checkStoreNotChanged(const StoreCursor& cursor)
+{
+    sqlite3_vtab* vtab = cursor.base.pVtab;
+    if (cursor.store_changes_count == getStore(vtab).changesCount()) {
+        return SQLITE_OK;
+    }
+    sqlite3_free(vtab->zErrMsg);
+    vtab->zErrMsg = sqlite3_mprintf("PlaylistsEntries was changed while it was read");
+    return SQLITE_ABORT;
+}
+
+//! Skips permutation rows which do not match search.
+void skipNotMatchedRows(StoreCursor* cursor)
+{
+    if (cursor->permutation && cursor->search) {
+        const Permutation& rows = *cursor->permutation;
+        while (   cursor->position < rows.size()
+               && !cursor->search->matches(*cursor->playlist, rows[cursor->position])
+               )
+        {
+            ++cursor->position;
+        }
+    }
+}
+
+RowRef currentRow(const StoreCursor& cursor)
+{
+    if (cursor.permutation) {
+        const RowRef ref = { cursor.playlist, (*cursor.permutation)[cursor.position] };
+        return ref;
+    }
+    return cursor.rows[cursor.position];
+}
+
+int filterRows(sqlite3_vtab_cursor* cursor, int idx_num, const char* idx_str, int /*argc*/, sqlite3_value** argv)
+{
+    StoreCursor& store_cursor = *reinterpret_cast<StoreCursor*>(cursor);
+    PlaylistsEntriesStore& store = getStore(cursor->pVtab);
+    RowRefs& rows = store_cursor.rows;
+    rows.clear();
+    store_cursor.permutation.reset();
+    store_cursor.playlist = nullptr;
+    store_cursor.search.reset();
+    store_cursor.position = 0;
+    store_cursor.store_changes_count = store.changesCount();
+
+    try {
+        int arg = 0;
+        const bool by_pattern  = (idx_num & PLAN_BY_PATTERN)  != 0,
+                   by_playlist = (idx_num & PLAN_BY_PLAYLIST) != 0,
+                   by_entry    = (idx_num & PLAN_BY_ENTRY)    != 0;
+        sqlite3_value* const pattern_value = by_pattern  ? argv[arg++] : nullptr;
+        const int playlist_id              = by_playlist ? sqlite3_value_int(argv[arg++]) : 0;
+        const int entry_id                 = by_entry    ? sqlite3_value_int(argv[arg++]) : 0;
+
+        if ( by_pattern && sqlite3_value_type(pattern_value) == SQLITE_NULL ) {
+            return SQLITE_OK; // nothing is equal to NULL.
+        }
+        std::wstring pattern;
+        if (by_pattern) {
+            appendFolded( reinterpret_cast<const char*>( sqlite3_value_text(pattern_value) ), sqlite3_value_bytes(pattern_value), &pattern );
+        }
+
+        OrderTerms order;
+        if (idx_str) {
+            for (const char* term = idx_str; *term != '\0'; term += 2) {
+                const OrderTerm order_term = { term[0] - 'A', term[1] == 'd' };
+                order.push_back(order_term);
+            }
+        }
+
+        if ( by_playlist && !by_entry && !order.empty() ) {
+            // sorted rows of playlist are taken from cached permutation.
+            store_cursor.permutation = store.getSortPermutation(playlist_id, order, &store_cursor.playlist);
+            if (store_cursor.permutation && by_pattern) {
+                store_cursor.search.reset( store.createSearch(pattern) );
+                skipNotMatchedRows(&store_cursor);
+            }
+            return SQLITE_OK;
+        }
+
+        if (by_entry) {
+            store.getEntryRow(entry_id, &rows);
+            if ( by_playlist && !rows.empty() && rows.front().playlist->playlist_id != playlist_id ) {
+                rows.clear();
+            }
+        } else {
+            store.getRows(by_playlist, playlist_id, &rows);
+        }
+
+        if (by_pattern) {
+            store.filterRows(pattern, &rows);
+        }
+
+        if ( !order.empty() ) {
+            store.sortRows(order, &rows);
+        }
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int nextRow(sqlite3_vtab_cursor* cursor)
+{
+    StoreCursor& store_cursor = *reinterpret_cast<StoreCursor*>(cursor);
+    const int rc = checkStoreNotChanged(store_cursor);
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+    ++store_cursor.position;
+    skipNotMatchedRows(&store_cursor);
+    return SQLITE_OK;
+}
+
+int isEof(sqlite3_vtab_cursor* cursor)
+{
+    const StoreCursor& store_cursor = *reinterpret_cast<StoreCursor*>(cursor);
+    return store_cursor.position >= (store_cursor.permutation ? store_cursor.permutation->size() : store_cursor.rows.size());
+}
+
+int getColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int column_index)
+{
+    const StoreCursor& store_cursor = *reinterpret_cast<StoreCursor*>(cursor);
+    const int rc = checkStoreNotChanged(store_cursor);
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+    getStore(cursor->pVtab).getColumn(currentRow(store_cursor), column_index, context);
+    return SQLITE_OK;
+}
+
+int getRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid)
+{
+    const StoreCursor& store_cursor = *reinterpret_cast<StoreCursor*>(cursor);
+    const int rc = checkStoreNotChanged(store_cursor);
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+    const RowRef ref = currentRow(store_cursor);
+    *rowid = ref.playlist->entryID(ref.row);
+    return SQLITE_OK;
+}
+
+void readRow(sqlite3_value** columns, Row* row)
+{
+    for (int column = 0; column != STORED_COLUMNS_COUNT; ++column) {
+        const ColumnStorage& storage = kCOLUMN_STORAGE[column];
+        sqlite3_value* value = columns[column];
+        switch (storage.kind) {
+        case KIND_DICTIONARY:
+        case KIND_ARENA:
+            {
+            const int slot = textSlot(storage);
+            row->text_is_null[slot] = sqlite3_value_type(value) == SQLITE_NULL;
+            if ( const unsigned char* text = sqlite3_value_text(value) ) {
+                row->texts[slot].assign( reinterpret_cast<const char*>(text), sqlite3_value_bytes(value) );
+            } else {
+                row->texts[slot].clear();
+            }
+            }
+            break;
+        case KIND_REAL:
+            row->rating = sqlite3_value_double(value);
+            break;
+        default:
+            row->integers[column] = sqlite3_value_int64(value);
+            break;
+        }
+    }
+}
+
+int updateTable(sqlite3_vtab* vtab, int argc, sqlite3_value** argv, sqlite3_int64* rowid)
+{
+    StoreTable& table = *reinterpret_cast<StoreTable*>(vtab);
+    PlaylistsEntriesStore& store = *table.store;
+    try {
+        if (argc == 1) { // DELETE
+            store.erase( static_cast<int>( sqlite3_value_int64(argv[0]) ) );
+            return SQLITE_OK;
+        }
+
+        // argv[1] is rowid requested by INSERT, it is ignored since rowid is entry id. Columns start from argv[2].
+        Row row;
+        readRow(argv + 2, &row);
+        const int entry_id = static_cast<int>(row.integers[COLUMN_ENTRY_ID]);
+
+        const bool is_update = sqlite3_value_type(argv[0]) != SQLITE_NULL;
+        const int old_entry_id = is_update ? static_cast<int>( sqlite3_value_int64(argv[0]) ) : entry_id;
+        const bool conflict = ( is_update ? old_entry_id != entry_id : true ) && store.contains(entry_id);
+        if ( conflict && sqlite3_vtab_on_conflict(table.db) != SQLITE_REPLACE ) {
+            sqlite3_free(vtab->zErrMsg);
+            vtab->zErrMsg = sqlite3_mprintf("PRIMARY KEY must be unique");
+            return SQLITE_CONSTRAINT;
+        }
+
+        if (old_entry_id != entry_id) {
+            store.erase(old_entry_id);
+        }
+        store.insert(row); // replaces entry with the same id.
+        *rowid = entry_id;
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int beginTransaction(sqlite3_vtab* vtab)
+{
+    getStore(vtab).beginTransaction();
+    return SQLITE_OK;
+}
+
+int syncTransaction(sqlite3_vtab* /*vtab*/)
+{
+    return SQLITE_OK;
+}
+
+int commitTransaction(sqlite3_vtab* vtab)
+{
+    getStore(vtab).commit();
+    return SQLITE_OK;
+}
+
+int rollbackTransaction(sqlite3_vtab* vtab)
+{
+    try {
+        getStore(vtab).rollback();
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int savepoint(sqlite3_vtab* vtab, int level)
+{
+    try {
+        getStore(vtab).savepoint(level);
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int releaseSavepoint(sqlite3_vtab* vtab, int level)
+{
+    getStore(vtab).releaseSavepoint(level);
+    return SQLITE_OK;
+}
+
+int rollbackToSavepoint(sqlite3_vtab* vtab, int level)
+{
+    try {
+        getStore(vtab).rollbackToSavepoint(level);
+    } catch (std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int renameTable(sqlite3_vtab* /*vtab*/, const char* /*new_name*/)
+{
+    return SQLITE_OK;
+}
+
+void destroyStore(void* store)
+{
+    delete static_cast<PlaylistsEntriesStore*>(store);
+}
+
+const sqlite3_module kMODULE = {
+    2, // iVersion: savepoints are needed to revert store on ROLLBACK TO and on failure of single statement.
+    &createTable,
+    &createTable, // xConnect
+    &bestIndex,
+    &disconnectTable,
+    &disconnectTable, // xDestroy
+    &openCursor,
+    &closeCursor,
+    &filterRows,
+    &nextRow,
+    &isEof,
+    &getColumn,
+    &getRowid,
+    &updateTable,
+    &beginTransaction,
+    &syncTransaction,
+    &commitTransaction,
+    &rollbackTransaction,
+    nullptr, // xFindFunction
+    &renameTable,
+    &savepoint,
+    &releaseSavepoint,
+    &rollbackToSavepoint
+};
+
+} // namespace anonymous
+
+int createPlaylistsEntriesStore(sqlite3* db, PlaylistsEntriesStore** store)
+{
+    PlaylistsEntriesStore* entries_store = new(std::nothrow) PlaylistsEntriesStore();
+    if (!entries_store) {
+        return SQLITE_NOMEM;
+    }
+
+    const int rc = sqlite3_create_module_v2(db, "playlists_entries_store", &kMODULE, entries_store, &destroyStore); // db owns store from now.
+    if (SQLITE_OK != rc) {
+        return rc;
+    }
+
+    *store = entries_store;
+    return sqlite3_exec(db, "CREATE VIRTUAL TABLE PlaylistsEntries USING playlists_entries_store", nullptr, nullptr, nullptr);
+}
+
+} // namespace AIMPPlayer
@@ -0,0 +1,43 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "common_types.h"
+#include <string>
+
+struct sqlite3;
+
+namespace AIMPPlayer
+{
+
+class PlaylistsEntriesStore;
+
+/*!
+    \brief Creates PlaylistsEntries table as virtual table over columnar in-memory store, it is used instead of usual SQLite table.
+    Table has the same columns as usual one, so all existing queries work unchanged, but data is kept in other way:
+        - entries of each playlist are kept as array per column;
+        - album, artist, date and genre values are dictionary encoded, rows keep codes of distinct values;
+        - filename and title are kept in string arena of playlist.
+    Constraints playlist_id=? and entry_id=? do not scan other playlists/entries, ORDER BY on table columns is done by store.
+    Sorted rows of playlist are cached per ORDER BY and kept sorted on changes, so page of sorted playlist is read without sorting.
+    Hidden column 'pattern' is used for search: constraint pattern=? selects entries which contain pattern in album, artist, date, genre or title,
+    characters are compared like in PlaylistsEntriesSearch(see entries_search.h).
+
+    Entry id must be unique across all playlists like in PRIMARY KEY(entry_id) of usual table, INSERT OR REPLACE replaces entry with the same id.
+    Triggers can not be created on virtual table, so PlaylistsEntriesSearch must not be used together with store.
+    Open cursor refers to rows of store, it is not snapshot: statement which is stepped again after other statement changed PlaylistsEntries
+    fails with SQLITE_ABORT and must be reset. Single statement which reads and writes table(INSERT ... SELECT, UPDATE, DELETE) is safe
+    since SQLite reads all rows before first change. Column text values are copied, so they stay valid after change.
+    \param store - receives store, it is owned by db and lives until db is closed.
+    \return SQLite result code, sqlite3_errmsg(db) describes error.
+*/
+int createPlaylistsEntriesStore(sqlite3* db, PlaylistsEntriesStore** store);
+
+/*!
+    \brief Counts entries of playlist and entries which contain pattern, the same way as pattern=? constraint selects them. Rows are not copied.
+    \param pattern - utf8 literal text. Empty pattern matches all entries.
+*/
+void countPlaylistEntries(const PlaylistsEntriesStore& store, PlaylistID playlist_id, const std::string& pattern,
+                          size_t* total_entries_count, size_t* found_entries_count); // throws std::bad_alloc
+
+} // namespace AIMPPlayer
@@ -12,6 +12,7 @@
 #include "utils/scope_guard.h"
 #include "utils/sqlite_util.h"
 #include "sqlite/sqlite.h"
+#include "entries_search.h"
 #include <boost/assign/std.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
@@ -301,24 +302,16 @@ void AIMPManager26::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
 {
     PROFILE_EXECUTION_TIME(__FUNCTION__);
 
-    { // handle crc32.
-        try {
-            getPlaylistCRC32Object(playlist_id).reset_entries();
-        } catch (std::exception& e) {
-            throw std::runtime_error(MakeString() << "expected crc32 struct for playlist " << playlist_id << " not found in "__FUNCTION__". Reason: " << e.what());
-        }
-    }
-
     // PROFILE_EXECUTION_TIME(__FUNCTION__);
     const int entries_count = aimp2_playlist_manager_->AIMP_PLS_GetFilesCount(playlist_id);
 
     AIMP2FileInfoHelper file_info_helper; // used for get entries from AIMP conveniently.
     
-    deletePlaylistEntriesFromPlaylistDB(playlist_id); // remove old entries before adding new ones.
+    PlaylistEntriesMirror entries_mirror(playlist_id, playlists_db_); // only new, changed and removed entries touch DB.
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
-                                                                                         "?,?,?,?,?,"
-                                                                                         "?,?,?,?,?)"
+    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT OR REPLACE INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
+                                                                                                    "?,?,?,?,?,"
+                                                                                                    "?,?,?,?,?)"
                                     );
     ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
 
@@ -351,6 +344,11 @@ void AIMPManager26::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
             {
                 // bind all values
                 const AIMP2SDK::AIMP2FileInfo& info = file_info_helper.getFileInfoWithCorrectStringLengthsAndNonEmptyTitle();
+                const crc32_t entry_crc32 = crc32(info);
+                if ( !entries_mirror.entryNeedsWrite(entry_index, entry_index, entry_crc32) ) {
+                    continue; // stored entry is actual.
+                }
+
                 bind(int,    2, entry_index); // id is the index for AIMP2.
                 bind(int,    3, entry_index); // for consistency with AIMP3.
                 bindText(    4, Album);
@@ -365,7 +363,7 @@ void AIMPManager26::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
                 bind(int64, 13, info.nFileSize);
                 bind(int,   14, info.nRating);
                 bind(int,   15, info.nSampleRate);
-                bind(int64, 16, crc32(info));
+                bind(int64, 16, entry_crc32);
 
                 rc_db = sqlite3_step(stmt);
                 if (SQLITE_DONE != rc_db) {
@@ -382,6 +380,16 @@ void AIMPManager26::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     }
 #undef bind
 #undef bindText
+
+    entries_mirror.commit();
+
+    if ( entries_mirror.changed() ) { // handle crc32.
+        try {
+            getPlaylistCRC32Object(playlist_id).reset_entries();
+        } catch (std::exception& e) {
+            throw std::runtime_error(MakeString() << "expected crc32 struct for playlist " << playlist_id << " not found in "__FUNCTION__". Reason: " << e.what());
+        }
+    }
 }
 
 #ifdef MANUAL_PLAYLISTS_CONTENT_CHANGES_DETERMINATION
@@ -1391,9 +1399,10 @@ void AIMPManager26::notifyAllExternalListeners(EVENTS event) const
 
 AIMPManager26::EventsListenerID AIMPManager26::registerListener(AIMPManager26::EventsListener listener)
 {
-    external_listeners_[next_listener_id_] = listener;
     assert(next_listener_id_ != UINT32_MAX);
-    return ++next_listener_id_; // get next unique listener ID using simple increment.
+    ++next_listener_id_; // get next unique listener ID using simple increment, so IDs start from 1.
+    external_listeners_[next_listener_id_] = listener;
+    return next_listener_id_;
 }
 
 void AIMPManager26::unRegisterListener(AIMPManager26::EventsListenerID listener_id)
@@ -1803,6 +1812,13 @@ void AIMPManager26::initPlaylistDB() // throws std::runtime_error
                                                << rc << ": " << errmsg );
     }
 
+    { // create search index of playlist content, it is updated by triggers on PlaylistsEntries table.
+    // note: enables PRAGMA recursive_triggers for whole playlists_db_, REPLACE INTO PlaylistsEntries relies on it to update index.
+    rc = createPlaylistsEntriesSearch(playlists_db_);
+    THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist content search index creation failure. Reason: createPlaylistsEntriesSearch() error "
+                                               << rc << ": " << sqlite3_errmsg(playlists_db_) );
+    }
+
     { // create table for playlist.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
@@ -13,6 +13,7 @@
 #include "utils/scope_guard.h"
 #include "utils/sqlite_util.h"
 #include "sqlite/sqlite.h"
+#include "entries_search.h"
 #include <boost/assign/std.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
@@ -579,14 +580,6 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
 {
     PROFILE_EXECUTION_TIME(__FUNCTION__);
 
-    { // handle crc32.
-        try {
-            getPlaylistCRC32Object(playlist_id).reset_entries();
-        } catch (std::exception& e) {
-            throw std::runtime_error(MakeString() << "expected crc32 struct for playlist " << playlist_id << " not found in "__FUNCTION__". Reason: " << e.what());
-        }
-    }
-
     using namespace AIMP3SDK;
     // PROFILE_EXECUTION_TIME(__FUNCTION__);
 
@@ -595,11 +588,11 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     const AIMP3SDK::HPLS playlist_handle = cast<AIMP3SDK::HPLS>(playlist_id);
     const int entries_count = aimp3_playlist_manager_->StorageGetEntryCount(playlist_handle);
 
-    deletePlaylistEntriesFromPlaylistDB(playlist_id); // remove old entries before adding new ones.
+    PlaylistEntriesMirror entries_mirror(playlist_id, playlists_db_); // only new, changed, moved and removed entries touch DB.
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
-                                                                                        "?,?,?,?,?,"
-                                                                                        "?,?,?,?,?)"
+    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT OR REPLACE INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
+                                                                                                   "?,?,?,?,?,"
+                                                                                                   "?,?,?,?,?)"
                                     );
     ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
 
@@ -648,6 +641,14 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
             
 
             const AIMP3SDK::TAIMPFileInfo& info = file_info_helper.getFileInfoWithCorrectStringLengthsAndNonEmptyTitle();
+
+            AIMP3SDK::TAIMPFileInfo info_with_rating = info; // rating is stored, so it must affect entry crc32 too.
+            info_with_rating.Rating = static_cast<DWORD>(rating);
+            const crc32_t entry_crc32 = crc32(info_with_rating);
+            if ( !entries_mirror.entryNeedsWrite(entry_id, entry_index, entry_crc32) ) {
+                continue; // stored entry is actual.
+            }
+
             bind(int,    2, entry_id);
             bind(int,    3, entry_index);
             bindText(    4, Album);
@@ -662,7 +663,7 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
             bind(int64, 13, info.FileSize);
             bind(int,   14, rating);
             bind(int,   15, info.SampleRate);
-            bind(int64, 16, crc32(info));
+            bind(int64, 16, entry_crc32);
 
             rc_db = sqlite3_step(stmt);
             if (SQLITE_DONE != rc_db) {
@@ -675,6 +676,16 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     }
 #undef bind
 #undef bindText
+
+    entries_mirror.commit();
+
+    if ( entries_mirror.changed() ) { // handle crc32.
+        try {
+            getPlaylistCRC32Object(playlist_id).reset_entries();
+        } catch (std::exception& e) {
+            throw std::runtime_error(MakeString() << "expected crc32 struct for playlist " << playlist_id << " not found in "__FUNCTION__". Reason: " << e.what());
+        }
+    }
 }
 
 void AIMPManager30::startPlayback()
@@ -1610,9 +1621,10 @@ void AIMPManager30::notifyAllExternalListeners(EVENTS event) const
 
 AIMPManager30::EventsListenerID AIMPManager30::registerListener(AIMPManager30::EventsListener listener)
 {
-    external_listeners_[next_listener_id_] = listener;
     assert(next_listener_id_ != UINT32_MAX);
-    return ++next_listener_id_; // get next unique listener ID using simple increment.
+    ++next_listener_id_; // get next unique listener ID using simple increment, so IDs start from 1.
+    external_listeners_[next_listener_id_] = listener;
+    return next_listener_id_;
 }
 
 void AIMPManager30::unRegisterListener(AIMPManager30::EventsListenerID listener_id)
@@ -1735,6 +1747,13 @@ void AIMPManager30::initPlaylistDB() // throws std::runtime_error
                                                << rc << ": " << errmsg );
     }
 
+    { // create search index of playlist content, it is updated by triggers on PlaylistsEntries table.
+    // note: enables PRAGMA recursive_triggers for whole playlists_db_, REPLACE INTO PlaylistsEntries relies on it to update index.
+    rc = createPlaylistsEntriesSearch(playlists_db_);
+    THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist content search index creation failure. Reason: createPlaylistsEntriesSearch() error "
+                                               << rc << ": " << sqlite3_errmsg(playlists_db_) );
+    }
+
     { // create table for playlist.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
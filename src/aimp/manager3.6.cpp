@@ -5,6 +5,8 @@
 #include "plugin/logger.h"
 #include "utils/sqlite_util.h"
 #include "sqlite/sqlite.h"
+#include "entries_search.h"
+#include "entries_store.h"
 #include "utils/iunknown_impl.h"
 #include "utils/string_encoding.h"
 #include "utils/image.h"
@@ -125,15 +127,17 @@ private:
     AIMPManager36* aimp36_manager_;
 };
 
-AIMPManager36::AIMPManager36(boost::intrusive_ptr<AIMP36SDK::IAIMPCore> aimp36_core, boost::asio::io_service& io_service)
+AIMPManager36::AIMPManager36(boost::intrusive_ptr<AIMP36SDK::IAIMPCore> aimp36_core, boost::asio::io_service& io_service,
+                             bool use_columnar_entries_store)
     :   playlists_db_(nullptr),
+        playlists_entries_store_(nullptr),
         aimp36_core_(aimp36_core),
         io_service_(io_service)
 {
     try {
         initializeAIMPObjects();
 
-        initPlaylistDB();
+        initPlaylistDB(use_columnar_entries_store);
 
         // register listeners here
         HRESULT r = aimp36_core->RegisterExtension(IID_IAIMPServicePlaylistManager, new AIMPExtensionPlaylistManagerListener(this));
@@ -223,7 +227,7 @@ void AIMPManager36::initializeAIMPObjects()
     aimp_service_album_art->Release();
 }
 
-void AIMPManager36::initPlaylistDB()
+void AIMPManager36::initPlaylistDB(bool use_columnar_entries_store)
 {
 #define THROW_IF_NOT_OK_WITH_MSG(rc, msg_expr)  if (SQLITE_OK != rc) { \
                                                     const std::string msg = msg_expr; \
@@ -241,7 +245,11 @@ void AIMPManager36::initPlaylistDB()
                                                << rc << ": " << sqlite3_errmsg(playlists_db_) );
     }
 
-    { // create table for content of all playlists.
+    if (use_columnar_entries_store) { // create table for content of all playlists as virtual table over columnar store.
+    rc = createPlaylistsEntriesStore(playlists_db_, &playlists_entries_store_);
+    THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist content store creation failure. Reason: createPlaylistsEntriesStore() error "
+                                               << rc << ": " << sqlite3_errmsg(playlists_db_) );
+    } else { // create table for content of all playlists.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
     rc = sqlite3_exec(playlists_db_,
@@ -271,6 +279,13 @@ void AIMPManager36::initPlaylistDB()
                                                << rc << ": " << errmsg );
     }
 
+    if (!playlists_entries_store_) { // create search index of playlist content, it is updated by triggers on PlaylistsEntries table. Store searches itself.
+    // note: enables PRAGMA recursive_triggers for whole playlists_db_, REPLACE INTO PlaylistsEntries relies on it to update index.
+    rc = createPlaylistsEntriesSearch(playlists_db_);
+    THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist content search index creation failure. Reason: createPlaylistsEntriesSearch() error "
+                                               << rc << ": " << sqlite3_errmsg(playlists_db_) );
+    }
+
     { // create table for playlist.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
@@ -330,6 +345,7 @@ void AIMPManager36::shutdownPlaylistDB()
         BOOST_LOG_SEV(logger(), error) << "sqlite3_close error: " << rc;
     }
     playlists_db_ = nullptr;
+    playlists_entries_store_ = nullptr; // destroyed with db.
 }
 
 void AIMPManager36::playlistActivated(AIMP36SDK::IAIMPPlaylist* /*playlist*/)
@@ -862,6 +878,13 @@ double getDouble(IAIMPPlaylistItem* playlist_item, const int property_id, const
     return value;
 }
 
+//! Returns crc32 of string content, 0 for null or empty string like crc32_entry() does for stored text.
+crc32_t crc32(IAIMPString* string)
+{
+    return string && string->GetLength() > 0 ? Utilities::crc32( string->GetData(), string->GetLength() * sizeof(WCHAR) )
+                                             : 0;
+}
+
 } // namespace Support
 
 void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
@@ -871,25 +894,16 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
 
     PlaylistID playlist_id = cast<PlaylistID>(playlist);
 
-    { // handle crc32.
-        try {
-            getPlaylistCRC32Object(playlist_id).reset_entries();
-        } catch (std::exception& e) {
-            throw std::runtime_error(MakeString() << "expected crc32 struct for playlist " << playlist_id << " not found in "__FUNCTION__". Reason: " << e.what());
-        }
-    }
-
     const int entries_count = playlist->GetItemCount();
 
-    deletePlaylistEntriesFromPlaylistDB(playlist_id); // remove old entries before adding new ones.
+    PlaylistEntriesMirror entries_mirror(playlist_id, playlists_db_); // only new, changed, moved and removed entries touch DB.
 
-    PlaylistItems& playlist_items = getPlaylistHelper(playlist).items_;
-    playlist_items.clear();
+    PlaylistItems playlist_items; // replaces helper's items only if all entries are loaded, as DB changes are.
     playlist_items.reserve(entries_count);
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
-                                                                                        "?,?,?,?,?,"
-                                                                                        "?,?,?,?,?)"
+    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT OR REPLACE INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
+                                                                                                   "?,?,?,?,?,"
+                                                                                                   "?,?,?,?,?)"
                                     );
     ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
 
@@ -981,6 +995,27 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
         }
 
         const int entry_id = castToPlaylistEntryID(item.get());
+        playlist_items.push_back(item.get()); // take ownership to access item later by the same ID.
+
+        // layout is the same as in crc32_entry() which reads stored entry.
+        const crc32_t members_crc32_list [] = {
+            Support::crc32( album.get() ),
+            Support::crc32( artist.get() ),
+            Support::crc32( date.get() ),
+            Support::crc32( fileName.get() ),
+            Support::crc32( genre.get() ),
+            Support::crc32( title.get() ),
+            bitrate,
+            channels,
+            duration_ms,
+            Utilities::crc32(filesize),
+            static_cast<int>(rating),
+            samplerate
+        };
+        const crc32_t entry_crc32 = Utilities::crc32( &members_crc32_list[0], sizeof(members_crc32_list) );
+        if ( !entries_mirror.entryNeedsWrite(entry_id, item_index, entry_crc32) ) {
+            continue; // stored entry is actual.
+        }
 
 #ifndef NDEBUG
         //BOOST_LOG_SEV(logger(), debug) << "index: " << item_index << ", entry_id: " << entry_id;
@@ -1021,7 +1056,7 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
             bind(int64, 13, filesize);
             bind(double,14, rating);
             bind(int,   15, samplerate);
-            bind(int64, 16, crc32(info));
+            bind(int64, 16, entry_crc32);
 #undef bind
 
             rc_db = sqlite3_step(stmt);
@@ -1029,15 +1064,25 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
                 const std::string msg = MakeString() << "sqlite3_step() error "
                                                      << rc_db << ": " << sqlite3_errmsg(playlists_db_);
                 throw std::runtime_error(msg);
-            } else {
-                playlist_items.push_back(item.get()); // take ownership to access item later by the same ID.
             }
             sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt); // null strings are not bound, so they must not keep previous entry's values.
         }
     }
 
+    entries_mirror.commit();
+
     // sort entry ids to use binary search later
     std::sort(playlist_items.begin(), playlist_items.end());
+    getPlaylistHelper(playlist).items_.swap(playlist_items);
+
+    if ( entries_mirror.changed() ) { // handle crc32.
+        try {
+            getPlaylistCRC32Object(playlist_id).reset_entries();
+        } catch (std::exception& e) {
+            throw std::runtime_error(MakeString() << "expected crc32 struct for playlist " << playlist_id << " not found in "__FUNCTION__". Reason: " << e.what());
+        }
+    }
 }
 
 int AIMPManager36::getPlaylistIndexByHandle(IAIMPPlaylist* playlist)
@@ -1124,9 +1169,10 @@ void AIMPManager36::notifyAllExternalListeners(AIMPManager::EVENTS event) const
 
 AIMPManager::EventsListenerID AIMPManager36::registerListener(AIMPManager::EventsListener listener)
 {
-    external_listeners_[next_listener_id_] = listener;
     assert(next_listener_id_ != UINT32_MAX);
-    return ++next_listener_id_; // get next unique listener ID using simple increment.
+    ++next_listener_id_; // get next unique listener ID using simple increment, so IDs start from 1.
+    external_listeners_[next_listener_id_] = listener;
+    return next_listener_id_;
 }
 
 void AIMPManager36::unRegisterListener(AIMPManager::EventsListenerID listener_id)
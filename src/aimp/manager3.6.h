@@ -18,6 +18,8 @@ namespace AimpRpcMethods {
 namespace AIMPPlayer
 {
 
+class PlaylistsEntriesStore;
+
 /*!
     \brief Extends AIMPManager with new functionality introduced in AIMP 3.60.
 */
@@ -29,7 +31,11 @@ class AIMPManager36 : public AIMPManager,
 {
 public:
 
-    AIMPManager36(boost::intrusive_ptr<AIMP36SDK::IAIMPCore> aimp36_core, boost::asio::io_service& io_service); // throws std::runtime_error
+    /*!
+        \param use_columnar_entries_store - keep PlaylistsEntries table in columnar in-memory store(see entries_store.h) instead of SQLite table.
+    */
+    AIMPManager36(boost::intrusive_ptr<AIMP36SDK::IAIMPCore> aimp36_core, boost::asio::io_service& io_service,
+                  bool use_columnar_entries_store); // throws std::runtime_error
 
     virtual ~AIMPManager36();
 
@@ -246,6 +252,10 @@ public:
     sqlite3* playlists_db() const
         { return playlists_db_; }
 
+    //! Returns nullptr if PlaylistsEntries is usual SQLite table.
+    const PlaylistsEntriesStore* playlists_entries_store() const
+        { return playlists_entries_store_; }
+
     // Returns nullptr if item does not exist.
     AIMP36SDK::IAIMPPlaylistItem_ptr getPlaylistItem(PlaylistEntryID id) const;
     AIMP36SDK::IAIMPPlaylistItem_ptr getPlaylistItem(PlaylistEntryID id);
@@ -258,12 +268,13 @@ public:
 protected:
     
     sqlite3* playlists_db_;
+    PlaylistsEntriesStore* playlists_entries_store_; // owned by playlists_db_.
 
 private:
     
     void initializeAIMPObjects();
     
-    void initPlaylistDB();
+    void initPlaylistDB(bool use_columnar_entries_store);
     void shutdownPlaylistDB();
     void deletePlaylistEntriesFromPlaylistDB(PlaylistID playlist_id);
     void deletePlaylistFromPlaylistDB(PlaylistID playlist_id);
@@ -115,4 +115,12 @@ inline sqlite3* getPlaylistsDB(const AIMPPlayer::AIMPManager& aimp_manager) {
     }
 }
 
+//! Returns nullptr if PlaylistsEntries is usual SQLite table. Only AIMPManager36 supports columnar store.
+inline const PlaylistsEntriesStore* getPlaylistsEntriesStore(const AIMPPlayer::AIMPManager& aimp_manager) {
+    if (const AIMPPlayer::AIMPManager36* mgr36 = dynamic_cast<const AIMPPlayer::AIMPManager36*>(&aimp_manager) ) {
+        return mgr36->playlists_entries_store();
+    }
+    return nullptr;
+}
+
 } // namespace AIMPPlayer
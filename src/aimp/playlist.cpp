@@ -3,6 +3,7 @@
 #include "stdafx.h"
 #include "aimp/playlist.h"
 #include "utils/util.h"
+#include <algorithm>
 
 namespace AIMPPlayer {
 
@@ -115,6 +116,136 @@ crc32_t PlaylistCRC32::calc_crc32_entries()
     return crc32_calculator.checksum();
 }
 
+namespace {
+
+void executeQuery(sqlite3* db, const char* query) // throws std::runtime_error
+{
+    char* errmsg = nullptr;
+    const int rc_db = sqlite3_exec(db, query, nullptr, nullptr, &errmsg);
+    if (SQLITE_OK != rc_db) {
+        const std::string msg = MakeString() << "sqlite3_exec() error "
+                                             << rc_db << ": " << (errmsg ? errmsg : "")
+                                             << ". Query: " << query;
+        sqlite3_free(errmsg);
+        throw std::runtime_error(msg);
+    }
+}
+
+} // namespace anonymous
+
+PlaylistEntriesMirror::PlaylistEntriesMirror(PlaylistID playlist_id, sqlite3* playlist_db)
+    :
+    playlist_id_(playlist_id),
+    playlist_db_(playlist_db),
+    update_index_stmt_(nullptr),
+    committed_(false),
+    changed_(false)
+{
+    using namespace Utilities;
+
+    executeQuery(playlist_db_, "BEGIN TRANSACTION");
+    try {
+        std::ostringstream query;
+        query << "SELECT entry_id, entry_index, crc32 FROM PlaylistsEntries WHERE playlist_id=" << playlist_id_;
+
+        sqlite3_stmt* stmt = createStmt( playlist_db_, query.str() );
+        ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+
+        for(;;) {
+            int rc_db = sqlite3_step(stmt);
+            if (SQLITE_ROW == rc_db) {
+                StoredEntry& entry = stored_entries_[sqlite3_column_int(stmt, 0)];
+                entry.entry_index = sqlite3_column_int(stmt, 1);
+                entry.crc32 = static_cast<crc32_t>( sqlite3_column_int64(stmt, 2) );
+                entry.present = false;
+            } else if (SQLITE_DONE == rc_db) {
+                break;
+            } else {
+                const std::string msg = MakeString() << "sqlite3_step() error "
+                                                     << rc_db << ": " << sqlite3_errmsg(playlist_db_)
+                                                     << ". Query: " << query.str();
+                throw std::runtime_error(msg);
+            }
+        }
+    } catch (...) {
+        sqlite3_exec(playlist_db_, "ROLLBACK", nullptr, nullptr, nullptr);
+        throw;
+    }
+}
+
+PlaylistEntriesMirror::~PlaylistEntriesMirror()
+{
+    sqlite3_finalize(update_index_stmt_); // harmless for null.
+    if (!committed_) {
+        sqlite3_exec(playlist_db_, "ROLLBACK", nullptr, nullptr, nullptr); // destructor must not throw, error is ignored.
+    }
+}
+
+bool PlaylistEntriesMirror::entryNeedsWrite(PlaylistEntryID entry_id, int entry_index, crc32_t entry_crc32)
+{
+    StoredEntries::iterator it = stored_entries_.find(entry_id);
+    if (it == stored_entries_.end() || it->second.present) { // new entry. Duplicated id is written again, row keeps the last one like full reload did.
+        changed_ = true;
+        return true;
+    }
+
+    StoredEntry& entry = it->second;
+    entry.present = true;
+    if (entry.crc32 != entry_crc32) {
+        changed_ = true;
+        return true; // written row contains new index too.
+    }
+
+    if (entry.entry_index != entry_index) {
+        if (!update_index_stmt_) {
+            update_index_stmt_ = Utilities::createStmt(playlist_db_, "UPDATE PlaylistsEntries SET entry_index=? WHERE playlist_id=? AND entry_id=?");
+        }
+        sqlite3_bind_int(update_index_stmt_, 1, entry_index);
+        stepEntryStmt(update_index_stmt_, entry_id);
+        changed_ = true;
+    }
+    return false;
+}
+
+void PlaylistEntriesMirror::commit()
+{
+    assert(!committed_);
+
+    const bool has_removed_entries = std::any_of( stored_entries_.begin(), stored_entries_.end(),
+                                                  [](const StoredEntries::value_type& entry) { return !entry.second.present; }
+                                                 );
+    if (has_removed_entries) {
+        sqlite3_stmt* stmt = Utilities::createStmt(playlist_db_, "DELETE FROM PlaylistsEntries WHERE playlist_id=? AND entry_id=?");
+        ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+
+        for (const auto& stored_entry : stored_entries_) {
+            if (!stored_entry.second.present) {
+                stepEntryStmt(stmt, stored_entry.first);
+            }
+        }
+        changed_ = true;
+    }
+
+    executeQuery(playlist_db_, "COMMIT");
+    committed_ = true;
+}
+
+void PlaylistEntriesMirror::stepEntryStmt(sqlite3_stmt* stmt, PlaylistEntryID entry_id)
+{
+    // playlist_id and entry_id are the last two parameters of statement.
+    const int params_count = sqlite3_bind_parameter_count(stmt);
+    sqlite3_bind_int(stmt, params_count - 1, playlist_id_);
+    sqlite3_bind_int(stmt, params_count,     entry_id);
+
+    const int rc_db = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (SQLITE_DONE != rc_db) {
+        const std::string msg = MakeString() << "sqlite3_step() error "
+                                             << rc_db << ": " << sqlite3_errmsg(playlist_db_);
+        throw std::runtime_error(msg);
+    }
+}
+
 crc32_t crc32_entry(sqlite3_stmt* stmt)
 {
     assert(sqlite3_column_count(stmt) == 12);
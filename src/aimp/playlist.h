@@ -4,6 +4,8 @@
 
 #include "../utils/sqlite_util.h"
 #include "common_types.h"
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
 
 namespace AIMPPlayer
 {
@@ -45,5 +47,56 @@ private:
             crc32_entries_;
 };
 
+/*!
+    \brief Applies actual content of AIMP playlist to its entries in PlaylistsEntries table incrementally.
+    Manager passes every entry of actual playlist in order to entryNeedsWrite() and writes rows only for new and changed entries,
+    moved entries get new index here, entries which disappeared from playlist are deleted by commit().
+    All changes are done in one transaction, it is rolled back if commit() is not reached(AIMP error for example).
+    Entries are compared by id and crc32 column, so crc32 of entry must cover all stored fields except index.
+*/
+class PlaylistEntriesMirror : boost::noncopyable
+{
+public:
+
+    //! Begins transaction and loads id, index and crc32 of stored entries of playlist.
+    PlaylistEntriesMirror(PlaylistID playlist_id, sqlite3* playlist_db); // throws std::runtime_error
+
+    //! Rolls back transaction if it was not committed.
+    ~PlaylistEntriesMirror();
+
+    /*!
+        \brief Compares entry of actual playlist with stored one. Stored index of moved entry is updated here.
+        \return true if entry is new or its content is changed, caller must write whole row(INSERT OR REPLACE) then.
+    */
+    bool entryNeedsWrite(PlaylistEntryID entry_id, int entry_index, crc32_t entry_crc32); // throws std::runtime_error
+
+    //! Deletes stored entries which were not passed to entryNeedsWrite() and commits transaction.
+    void commit(); // throws std::runtime_error
+
+    //! Returns true if any entry was added, changed, moved or deleted.
+    bool changed() const
+        { return changed_; }
+
+private:
+
+    struct StoredEntry
+    {
+        int entry_index;
+        crc32_t crc32;
+        bool present; // entry is still in playlist.
+    };
+
+    typedef std::unordered_map<PlaylistEntryID, StoredEntry> StoredEntries;
+
+    void stepEntryStmt(sqlite3_stmt* stmt, PlaylistEntryID entry_id); // throws std::runtime_error
+
+    PlaylistID playlist_id_;
+    sqlite3* playlist_db_;
+    StoredEntries stored_entries_;
+    sqlite3_stmt* update_index_stmt_; // prepared on first moved entry.
+    bool committed_;
+    bool changed_;
+};
+
 } // namespace AIMPPlayer
 
@@ -7,6 +7,9 @@
 #include "../http_server/reply.h"
 #include "../http_server/request.h"
 #include "../http_server/mime_types.h"
+#include "../http_server/request_parser.h"
+#include "../http_server/byte_ranges.h"
+#include "../http_server/static_file_cache.h"
 
 #include "utils/string_encoding.h"
 #include "utils/util.h"
@@ -77,26 +80,125 @@ std::wstring RequestHandler::getTrackSourcePath(const std::string& request_uri)
     return entry_filename;
 }
 
+void addHeader(const std::string& name, const std::string& value, Http::Reply& rep)
+{
+    rep.headers.push_back( Http::header() );
+    rep.headers.back().name = name;
+    rep.headers.back().value = value;
+}
+
+//! Track file does not have content hash, so entity tag is built from modification time and size.
+std::string makeEntityTag(std::time_t last_write_time, boost::uint64_t file_size)
+{
+    std::ostringstream os;
+    os << '"' << std::hex << last_write_time << '-' << file_size << '"';
+    return os.str();
+}
+
+/*!
+    Returns true if Range header should be applied: If-Range header is absent or
+    it contains current entity tag(strong comparison) or Last-Modified date of file.
+    Weak entity tag never matches(RFC 7233, 3.2), empty If-Range is treated as mismatch.
+*/
+bool rangeConditionHolds(const Http::Request& req, const std::string& etag, const std::string& last_modified)
+{
+    boost::string_ref if_range;
+    if ( !Http::get_header_value(req.headers, "If-Range", if_range) ) {
+        return true;
+    }
+    const std::string value = boost::trim_copy( if_range.to_string() );
+    if ( value.empty() || boost::starts_with(value, "W/") ) {
+        return false;
+    }
+    if (value[0] == '"') {
+        return value == etag;
+    }
+    return !last_modified.empty() && value == last_modified;
+}
+
+//! Fills 206 reply with single part of file.
+void fillSingleRangeReply(const Http::ByteRange& range, boost::uint64_t file_size, const std::string& content_type, Http::Reply& rep)
+{
+    using namespace Http;
+    rep.status = Reply::partial_content;
+    addHeader( "Content-Range", contentRange(range, file_size), rep );
+    addHeader( "Content-Length", boost::lexical_cast<std::string>( range.length() ), rep );
+    addHeader( "Content-Type", content_type, rep );
+    rep.file_ranges.push_back( Reply::FileRange( range.first, range.length() ) );
+}
+
+//! Fills 206 reply with multipart/byteranges content.
+void fillMultipleRangesReply(const Http::ByteRanges& ranges, boost::uint64_t file_size, const std::string& content_type,
+                             const std::string& boundary, Http::Reply& rep)
+{
+    using namespace Http;
+    rep.status = Reply::partial_content;
+
+    boost::uint64_t content_length = 0;
+    for (const ByteRange& range : ranges) {
+        const std::string head = Utilities::MakeString() << "\r\n--" << boundary << "\r\n"
+                                                         << "Content-Type: " << content_type << "\r\n"
+                                                         << "Content-Range: " << contentRange(range, file_size) << "\r\n"
+                                                         << "\r\n";
+        rep.file_ranges.push_back( Reply::FileRange( range.first, range.length(), head ) );
+        content_length += head.size() + range.length();
+    }
+    rep.file_tail = Utilities::MakeString() << "\r\n--" << boundary << "--\r\n";
+    content_length += rep.file_tail.size();
+
+    addHeader( "Content-Length", boost::lexical_cast<std::string>(content_length), rep );
+    addHeader( "Content-Type", "multipart/byteranges; boundary=" + boundary, rep );
+}
+
 bool RequestHandler::handle_request(const Http::Request& req, Http::Reply& rep)
 {
     using namespace Http;
 
     try {
         namespace fs = boost::filesystem;
-        rep.filename = getTrackSourcePath(req.uri);
+        rep.filename = getTrackSourcePath( req.uri.to_string() );
         const fs::wpath path(rep.filename);
         
-        const uintmax_t file_size = fs::file_size(path);
+        const boost::uint64_t file_size = fs::file_size(path);
+        const std::time_t last_write_time = fs::last_write_time(path);
+        const std::string etag = makeEntityTag(last_write_time, file_size);
+        const std::string last_modified = formatHttpDate(last_write_time);
+        const std::string content_type = mime_types::extension_to_type( path.extension().string().c_str() );
 
         // fill http headers.
-        rep.status = Reply::ok;
-        rep.headers.resize(3);
-        rep.headers[0].name = "Content-Length";
-        rep.headers[0].value = boost::lexical_cast<std::string>(file_size);
-        rep.headers[1].name = "Content-Type";
-        rep.headers[1].value = mime_types::extension_to_type( path.extension().string().c_str() );
-        rep.headers[2].name = "Content-Disposition";
-        rep.headers[2].value = Utilities::MakeString() << "attachment; filename=\"" << StringEncoding::utf16_to_utf8( path.filename().native() ) << "\"";
+        addHeader( "Accept-Ranges", "bytes", rep );
+        addHeader( "ETag", etag, rep );
+        if ( !last_modified.empty() ) {
+            addHeader( "Last-Modified", last_modified, rep );
+        }
+        addHeader( "Content-Disposition", Utilities::MakeString() << "attachment; filename=\"" << StringEncoding::utf16_to_utf8( path.filename().native() ) << "\"", rep );
+
+        boost::string_ref range_value;
+        ByteRanges ranges;
+        if (   req.method == "GET"
+            && get_header_value(req.headers, "Range", range_value)
+            && rangeConditionHolds(req, etag, last_modified)
+            && parseByteRanges(range_value.to_string(), file_size, &ranges)
+            )
+        {
+            if ( ranges.empty() ) {
+                rep.filename.clear();
+                rep.status = Reply::requested_range_not_satisfiable;
+                addHeader( "Content-Range", unsatisfiedContentRange(file_size), rep );
+                addHeader( "Content-Length", "0", rep );
+            } else if (ranges.size() == 1) {
+                fillSingleRangeReply(ranges.front(), file_size, content_type, rep);
+            } else {
+                std::ostringstream boundary;
+                boundary << "aimp_control_plugin_" << std::hex << Utilities::crc32(etag + *range_value);
+                fillMultipleRangesReply(ranges, file_size, content_type, boundary.str(), rep);
+            }
+        } else {
+            rep.status = Reply::ok;
+            addHeader( "Content-Length", boost::lexical_cast<std::string>(file_size), rep );
+            addHeader( "Content-Type", content_type, rep );
+            rep.file_ranges.push_back( Reply::FileRange(0, file_size) );
+        }
     } catch (std::exception&) {
         rep.filename.clear();
         rep = Reply::stock_reply(Reply::not_found);
@@ -99,11 +99,12 @@ struct AuthManager::Impl
     }
     
     bool isAuthenticated(const Request& req) const {
-        const std::string* autorization_value;
+        boost::string_ref autorization_value;
         if (!get_header_value(req.headers, kHEADER_AUTHORIZATION_NAME, autorization_value)) {
             return false;
         }
-        const char* hdr = autorization_value->c_str();
+        const std::string autorization_header = autorization_value.to_string(); // mg_parse_header() needs null terminated string.
+        const char* hdr = autorization_header.c_str();
 
         if (mg_strncasecmp(hdr, "Digest ", 7) != 0) return 0;
 
@@ -120,7 +121,7 @@ struct AuthManager::Impl
 
         for(auto ht_entry : ht_entries_) {
             if ( ht_entry.user == user && ht_entry.realm == realm() ) {
-                return check_password(req.method.c_str(), ht_entry.ha1.c_str(), uri, nonce, nc, cnonce, qop, resp) == MG_AUTH_OK;
+                return check_password(req.method.to_string().c_str(), ht_entry.ha1.c_str(), uri, nonce, nc, cnonce, qop, resp) == MG_AUTH_OK;
             }
         }
         return false;
@@ -0,0 +1,137 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "http_server/byte_ranges.h"
+#include "utils/util.h"
+#include <limits>
+
+namespace Http {
+
+namespace {
+
+const std::string kBYTES_UNIT_PREFIX("bytes=");
+
+//! Parses non-empty sequence of ASCII digits. Returns false on bad format or overflow.
+bool parsePosition(const std::string& digits, boost::uint64_t* position)
+{
+    if ( digits.empty() ) {
+        return false;
+    }
+    const boost::uint64_t kMAX_POSITION = std::numeric_limits<boost::uint64_t>::max();
+    boost::uint64_t result = 0;
+    for (const char c : digits) {
+        if (c < '0' || c > '9') {
+            return false; // sign, spaces and locale specific digits are not allowed.
+        }
+        const unsigned int digit = c - '0';
+        if ( result > (kMAX_POSITION - digit) / 10 ) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *position = result;
+    return true;
+}
+
+bool rangeIsBefore(const ByteRange& lhs, const ByteRange& rhs)
+{
+    return lhs.first < rhs.first;
+}
+
+} // namespace anonymous
+
+bool parseByteRanges(const std::string& value, boost::uint64_t entity_size, ByteRanges* ranges)
+{
+    assert(ranges);
+    ranges->clear();
+
+    const std::string trimmed_value = boost::trim_copy(value);
+    if ( !boost::istarts_with(trimmed_value, kBYTES_UNIT_PREFIX) ) {
+        return false;
+    }
+
+    std::vector<std::string> specs;
+    boost::split( specs, trimmed_value.substr( kBYTES_UNIT_PREFIX.size() ), boost::is_any_of(",") );
+    bool has_specs = false;
+    for (std::string& spec : specs) {
+        boost::trim(spec);
+        if ( spec.empty() ) {
+            continue; // empty list elements are allowed.
+        }
+        has_specs = true;
+        if (ranges->size() == kMAX_BYTE_RANGES_COUNT) {
+            // do not coalesce arbitrary long lists: client asking for so many ranges gets whole entity.
+            ranges->clear();
+            return false;
+        }
+
+        const std::size_t dash_pos = spec.find('-');
+        if (dash_pos == std::string::npos) {
+            return false;
+        }
+        const std::string first_string = boost::trim_copy( spec.substr(0, dash_pos) );
+        const std::string last_string = boost::trim_copy( spec.substr(dash_pos + 1) );
+
+        ByteRange range;
+        if ( first_string.empty() ) {
+            // suffix-byte-range-spec: last N bytes.
+            boost::uint64_t suffix_length;
+            if ( !parsePosition(last_string, &suffix_length) ) {
+                return false;
+            }
+            if (suffix_length == 0 || entity_size == 0) {
+                continue; // unsatisfiable.
+            }
+            range.first = suffix_length < entity_size ? entity_size - suffix_length : 0;
+            range.last = entity_size - 1;
+        } else {
+            if ( !parsePosition(first_string, &range.first) ) {
+                return false;
+            }
+            if ( last_string.empty() ) {
+                range.last = entity_size - 1;
+            } else {
+                if ( !parsePosition(last_string, &range.last) ) {
+                    return false;
+                }
+                if (range.last < range.first) {
+                    return false;
+                }
+            }
+            if (range.first >= entity_size) {
+                continue; // unsatisfiable.
+            }
+            range.last = std::min(range.last, entity_size - 1);
+        }
+        ranges->push_back(range);
+    }
+
+    if (!has_specs) {
+        return false;
+    }
+
+    // coalesce ranges to send each byte only once.
+    std::sort(ranges->begin(), ranges->end(), rangeIsBefore);
+    ByteRanges merged;
+    for (const ByteRange& range : *ranges) {
+        if ( !merged.empty() && range.first <= merged.back().last + 1 ) {
+            merged.back().last = std::max(merged.back().last, range.last);
+        } else {
+            merged.push_back(range);
+        }
+    }
+    ranges->swap(merged);
+    return true;
+}
+
+std::string contentRange(const ByteRange& range, boost::uint64_t entity_size)
+{
+    return Utilities::MakeString() << "bytes " << range.first << '-' << range.last << '/' << entity_size;
+}
+
+std::string unsatisfiedContentRange(boost::uint64_t entity_size)
+{
+    return Utilities::MakeString() << "bytes */" << entity_size;
+}
+
+} // namespace Http
@@ -0,0 +1,41 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace Http
+{
+
+//! Inclusive range of entity bytes [first, last].
+struct ByteRange
+{
+    boost::uint64_t first;
+    boost::uint64_t last;
+
+    boost::uint64_t length() const
+        { return last - first + 1; }
+};
+
+typedef std::vector<ByteRange> ByteRanges;
+
+//! Range header with more range specs(including unsatisfiable ones) is ignored and whole entity is sent.
+const std::size_t kMAX_BYTE_RANGES_COUNT = 16;
+
+/*!
+    \brief Parses value of Range header(RFC 7233) for entity of given size.
+           Resulting ranges are sorted, overlapping and adjacent ones are merged.
+    \param ranges - satisfiable ranges. Empty if none of requested ranges is satisfiable.
+    \return false if header is malformed, uses unknown unit or contains too many ranges. Such header must be ignored.
+*/
+bool parseByteRanges(const std::string& value, boost::uint64_t entity_size, ByteRanges* ranges);
+
+//! Returns value of Content-Range header for range of entity.
+std::string contentRange(const ByteRange& range, boost::uint64_t entity_size);
+
+//! Returns value of Content-Range header of 416 reply.
+std::string unsatisfiedContentRange(boost::uint64_t entity_size);
+
+} // namespace Http
@@ -0,0 +1,204 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "http_server/compression.h"
+#include "http_server/request.h"
+#include "http_server/request_parser.h"
+#include "utils/util.h"
+#include "utils/scope_guard.h"
+#include <zlib.h>
+
+namespace Http { namespace Compression {
+
+const std::string kGZIP_ENCODING("gzip");
+const std::string kDEFLATE_ENCODING("deflate");
+
+namespace {
+const int kGZIP_WINDOW_BITS = 15 + 16; // 16 asks zlib to write gzip header and trailer instead zlib ones.
+const int kDEFLATE_WINDOW_BITS = 15; // HTTP "deflate" coding is zlib format.
+const int kDEFAULT_MEMORY_LEVEL = 8;
+
+//! Returns true if quality value of Accept-Encoding element is zero(coding is not acceptable).
+bool qualityIsZero(const std::string& params)
+{
+    std::vector<std::string> parts;
+    boost::split(parts, params, boost::is_any_of(";"));
+    for (std::string& param : parts) {
+        boost::trim(param);
+        if ( boost::istarts_with(param, "q=") ) {
+            try {
+                return boost::lexical_cast<double>( param.substr(2) ) == 0.0;
+            } catch (boost::bad_lexical_cast&) {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace anonymous
+
+bool acceptsEncoding(const Request& req, const std::string& encoding)
+{
+    boost::string_ref accept_encoding;
+    if ( !get_header_value(req.headers, "Accept-Encoding", accept_encoding) ) {
+        return false;
+    }
+
+    std::vector<std::string> codings;
+    boost::split(codings, accept_encoding, boost::is_any_of(","));
+    for (std::string& coding : codings) {
+        boost::trim(coding);
+        const std::size_t params_begin = coding.find(';');
+        const std::string name = boost::trim_copy( coding.substr(0, params_begin) );
+        if ( boost::iequals(name, encoding) || name == "*" ) {
+            return params_begin == std::string::npos || !qualityIsZero( coding.substr(params_begin + 1) );
+        }
+    }
+    return false;
+}
+
+bool selectFormat(const Request& req, Format* format)
+{
+    assert(format);
+    if ( acceptsEncoding(req, kGZIP_ENCODING) ) {
+        *format = GZIP;
+        return true;
+    } else if ( acceptsEncoding(req, kDEFLATE_ENCODING) ) {
+        *format = DEFLATE;
+        return true;
+    }
+    return false;
+}
+
+const std::string& encodingName(Format format)
+{
+    return format == GZIP ? kGZIP_ENCODING : kDEFLATE_ENCODING;
+}
+
+bool isCompressibleMimeType(const std::string& mime_type)
+{
+    return boost::starts_with(mime_type, "text/")
+           || mime_type == "application/x-javascript"
+           || mime_type == "application/javascript"
+           || mime_type == "application/json"
+           || mime_type == "application/xml"
+           || mime_type == "image/svg+xml";
+}
+
+void gzip(const std::string& data, std::string* out)
+{
+    assert(out);
+
+    z_stream stream = {0};
+    int result = deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, kGZIP_WINDOW_BITS, kDEFAULT_MEMORY_LEVEL, Z_DEFAULT_STRATEGY);
+    if (result != Z_OK) {
+        throw std::runtime_error(Utilities::MakeString() << "Error in "__FUNCTION__": deflateInit2 failed with code " << result);
+    }
+    ON_BLOCK_EXIT(&deflateEnd, &stream);
+
+    out->resize( deflateBound( &stream, static_cast<uLong>( data.size() ) ) );
+
+    stream.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( data.data() ) ); // zlib does not modify input.
+    stream.avail_in = static_cast<uInt>( data.size() );
+    stream.next_out = reinterpret_cast<Bytef*>( &(*out)[0] );
+    stream.avail_out = static_cast<uInt>( out->size() );
+
+    result = deflate(&stream, Z_FINISH);
+    if (result != Z_STREAM_END) {
+        throw std::runtime_error(Utilities::MakeString() << "Error in "__FUNCTION__": deflate failed with code " << result);
+    }
+
+    out->resize(stream.total_out);
+}
+
+struct Compressor::Impl
+{
+    z_stream stream;
+    Chunks* out;
+
+    Impl(Format format, Chunks* out)
+        :
+        out(out)
+    {
+        assert(out);
+        memset( &stream, 0, sizeof(stream) );
+        const int result = deflateInit2(&stream,
+                                        Z_DEFAULT_COMPRESSION,
+                                        Z_DEFLATED,
+                                        format == GZIP ? kGZIP_WINDOW_BITS : kDEFLATE_WINDOW_BITS,
+                                        kDEFAULT_MEMORY_LEVEL,
+                                        Z_DEFAULT_STRATEGY
+                                        );
+        if (result != Z_OK) {
+            throw std::runtime_error(Utilities::MakeString() << "Error in "__FUNCTION__": deflateInit2 failed with code " << result);
+        }
+    }
+
+    ~Impl()
+    {
+        deflateEnd(&stream);
+    }
+
+    //! Deflates all available input, new chunk is appended to chain when last one is full.
+    void deflateToChunks(int flush)
+    {
+        for (;;) {
+            if ( out->empty() || out->back().size() == kCHUNK_SIZE ) {
+                out->push_back( std::string() );
+            }
+            std::string& chunk = out->back();
+            const std::size_t used = chunk.size();
+            chunk.resize(kCHUNK_SIZE);
+            stream.next_out = reinterpret_cast<Bytef*>(&chunk[used]);
+            stream.avail_out = static_cast<uInt>(kCHUNK_SIZE - used);
+
+            const int result = deflate(&stream, flush);
+            chunk.resize(kCHUNK_SIZE - stream.avail_out);
+
+            if (result == Z_STREAM_ERROR) {
+                throw std::runtime_error(Utilities::MakeString() << "Error in "__FUNCTION__": deflate failed with code " << result);
+            }
+
+            if (flush == Z_FINISH) {
+                if (result == Z_STREAM_END) {
+                    break;
+                }
+            } else if (stream.avail_out != 0) {
+                break; // all input is consumed.
+            }
+        }
+    }
+};
+
+Compressor::Compressor(Format format, Chunks* out)
+    :
+    impl_( new Impl(format, out) )
+{
+}
+
+// it is here to allow using forward declaration of Impl in class definition. Otherwise, undefined dtor error will be generated.
+Compressor::~Compressor()
+{
+}
+
+void Compressor::write(const char* data, std::size_t size)
+{
+    impl_->stream.next_in = reinterpret_cast<Bytef*>( const_cast<char*>(data) ); // zlib does not modify input.
+    impl_->stream.avail_in = static_cast<uInt>(size);
+    impl_->deflateToChunks(Z_NO_FLUSH);
+}
+
+void Compressor::finish()
+{
+    impl_->stream.next_in = nullptr;
+    impl_->stream.avail_in = 0;
+    impl_->deflateToChunks(Z_FINISH);
+}
+
+std::size_t Compressor::size() const
+{
+    return impl_->stream.total_out;
+}
+
+} } // namespace Http::Compression
@@ -0,0 +1,90 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <list>
+#include <memory>
+#include <boost/noncopyable.hpp>
+
+namespace Http
+{
+
+struct Request;
+
+//! HTTP content coding support(gzip, deflate).
+namespace Compression
+{
+
+extern const std::string kGZIP_ENCODING;    //!< "gzip" content coding name.
+extern const std::string kDEFLATE_ENCODING; //!< "deflate" content coding name.
+
+//! Supported compression formats.
+enum Format { GZIP, DEFLATE };
+
+/*!
+    \brief Checks if client accepts content coding.
+    \param req - request with Accept-Encoding header.
+    \param encoding - content coding name, for example "gzip".
+    \return true if coding is listed in Accept-Encoding header(explicitly or by '*') with non zero quality.
+*/
+bool acceptsEncoding(const Request& req, const std::string& encoding);
+
+/*!
+    \brief Selects compression format acceptable by client. gzip is preferred.
+    \return false if client does not accept any supported format.
+*/
+bool selectFormat(const Request& req, Format* format);
+
+//! Returns content coding name of format for Content-Encoding header.
+const std::string& encodingName(Format format);
+
+//! Returns true if content of MIME type can be effectively compressed. Images, audio, video are compressed already.
+bool isCompressibleMimeType(const std::string& mime_type);
+
+/*!
+    \brief Compresses data to gzip format.
+    \param data - data to compress.
+    \param out - compressed data.
+    \throw std::runtime_error if zlib fails.
+*/
+void gzip(const std::string& data, std::string* out); // throws std::runtime_error
+
+/*!
+    \brief Incremental compressor which writes compressed data into chain of fixed size chunks.
+           Using of chain avoids allocation of one big buffer for whole compressed data.
+
+    Usage:
+        Compressor compressor(GZIP, &chunks);
+        compressor.write(data1, size1);
+        compressor.write(data2, size2);
+        compressor.finish();
+*/
+class Compressor : private boost::noncopyable
+{
+public:
+
+    typedef std::list<std::string> Chunks;
+
+    static const std::size_t kCHUNK_SIZE = 16 * 1024;
+
+    Compressor(Format format, Chunks* out); // throws std::runtime_error
+    ~Compressor();
+
+    //! Compresses next portion of data.
+    void write(const char* data, std::size_t size); // throws std::runtime_error
+
+    //! Flushes all pending data and writes format trailer. No writes are allowed after this call.
+    void finish(); // throws std::runtime_error
+
+    //! Returns total size of compressed data.
+    std::size_t size() const;
+
+private:
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace Compression
+} // namespace Http
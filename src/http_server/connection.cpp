@@ -5,10 +5,28 @@
 
 #include "stdafx.h"
 #include <vector>
+#include <cstring>
 #include <boost/bind.hpp>
+#include <boost/pool/pool_alloc.hpp>
 #include "connection.h"
+#include "websocket_connection.h"
 #include "http_server/request_handler.h"
 #include "plugin/logger.h"
+#include "plugin/control_plugin.h"
+#include "plugin/settings.h"
+#include "utils/util.h"
+#include "utils/string_encoding.h"
+
+#if !defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
+# if defined(__linux__)
+#  include <sys/sendfile.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+# else
+#  include <fstream>
+# endif
+#endif
 
 //#include <ctime>
 //#include <iostream>
@@ -24,17 +42,24 @@ using boost::asio::ip::tcp;
 using boost::asio::windows::overlapped_ptr;
 using boost::asio::windows::random_access_handle;
 
+// TransmitFile can not send more than 2,147,483,646 bytes in single call.
+const boost::uint64_t kMAX_TRANSMIT_FILE_BYTES = 0x7FFFFFFE;
+
 // A wrapper for the TransmitFile overlapped I/O operation.
+// Sends 'count' bytes of file starting from 'offset'. Buffers must stay valid until operation completion.
 template <typename SocketT, typename Handler>
 void transmit_file(SocketT& socket,
-    random_access_handle& file, Handler handler)
+    random_access_handle& file, boost::uint64_t offset, DWORD count,
+    TRANSMIT_FILE_BUFFERS* buffers, Handler handler)
 {
   // Construct an OVERLAPPED-derived object to contain the handler.
   overlapped_ptr overlapped(socket.get_io_service(), handler);
+  overlapped.get()->Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+  overlapped.get()->OffsetHigh = static_cast<DWORD>(offset >> 32);
 
   // Initiate the TransmitFile operation.
   BOOL ok = ::TransmitFile(socket.native_handle(),
-      file.native_handle(), 0, 0, overlapped.get(), 0, 0);
+      file.native_handle(), count, 0, overlapped.get(), buffers, 0);
   DWORD last_error = ::GetLastError();
 
   // Check if the operation completed immediately.
@@ -65,9 +90,11 @@ public:
 
   static pointer create(boost::asio::io_service& io_service,
 						std::unique_ptr<SocketT> socket,
-                        const std::wstring& filename)
+                        const std::wstring& filename,
+                        const Reply::FileRanges& ranges,
+                        const std::string& tail)
   {
-    return pointer(new connection(io_service, std::move(socket), filename));
+    return pointer(new connection(io_service, std::move(socket), filename, ranges, tail));
   }
 
   SocketT& socket()
@@ -80,33 +107,72 @@ public:
   {
     boost::system::error_code ec;
     HANDLE h = ::CreateFile(filename_.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
-                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, 0);
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, 0);
     if (h == INVALID_HANDLE_VALUE) {
         BOOST_LOG_SEV(logger(), error) << "TransmitFile. CreateFile error: " << GetLastError();
+        return;
     }
 
     file_.assign(h, ec);
-    if (file_.is_open())
+    if (file_.is_open() && !ranges_.empty())
     {
-      transmit_file(socket(), file_,
-          boost::bind(&connection::handle_write, shared_from_this(),
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::bytes_transferred));
+      transmit_next_part();
     }
   }
 
 private:
-  connection(boost::asio::io_service& io_service, std::unique_ptr<SocketT> socket, const std::wstring& filename)
+  connection(boost::asio::io_service& io_service, std::unique_ptr<SocketT> socket, const std::wstring& filename,
+             const Reply::FileRanges& ranges, const std::string& tail)
     : socket_(std::move(socket)),
       filename_(filename),
-      file_(io_service)
+      file_(io_service),
+      ranges_(ranges),
+      tail_(tail),
+      range_index_(0),
+      range_bytes_sent_(0)
   {
 	assert(socket_);
   }
 
-  void handle_write(const boost::system::error_code& /*error*/,
-                    size_t /*bytes_transferred*/)
+  // Sends next part of current range. Range head is sent with its first part, tail is sent with last part of last range.
+  void transmit_next_part()
+  {
+    const Reply::FileRange& range = ranges_[range_index_];
+    const boost::uint64_t remaining = range.length - range_bytes_sent_;
+    const DWORD count = static_cast<DWORD>( std::min(remaining, kMAX_TRANSMIT_FILE_BYTES) );
+    const bool first_part = range_bytes_sent_ == 0;
+    const bool last_part = range_index_ + 1 == ranges_.size() && count == remaining;
+
+    memset( &buffers_, 0, sizeof(buffers_) );
+    if (first_part && !range.head.empty()) {
+      buffers_.Head = const_cast<char*>( range.head.data() );
+      buffers_.HeadLength = static_cast<DWORD>( range.head.size() );
+    }
+    if (last_part && !tail_.empty()) {
+      buffers_.Tail = const_cast<char*>( tail_.data() );
+      buffers_.TailLength = static_cast<DWORD>( tail_.size() );
+    }
+
+    transmit_file(socket(), file_, range.offset + range_bytes_sent_, count, &buffers_,
+        boost::bind(&connection::handle_write, shared_from_this(),
+          boost::asio::placeholders::error,
+          count));
+  }
+
+  void handle_write(const boost::system::error_code& e, DWORD count)
   {
+    if (!e) {
+      range_bytes_sent_ += count;
+      if (range_bytes_sent_ == ranges_[range_index_].length) {
+        ++range_index_;
+        range_bytes_sent_ = 0;
+      }
+      if (range_index_ < ranges_.size()) {
+        transmit_next_part();
+        return;
+      }
+    }
+
     boost::system::error_code ignored_ec;
     socket_->shutdown(SocketT::shutdown_both, ignored_ec);
   }
@@ -114,20 +180,271 @@ private:
   std::unique_ptr<SocketT> socket_;
   std::wstring filename_;
   random_access_handle file_;
+  Reply::FileRanges ranges_;
+  std::string tail_;
+  std::size_t range_index_;
+  boost::uint64_t range_bytes_sent_;
+  TRANSMIT_FILE_BUFFERS buffers_;
 };
 
 #else // defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
-# error Overlapped I/O not available on this platform
+
+// Portable implementation. Range heads and tail are written by async_write.
+// On Linux file data is sent by sendfile(): kernel copies it from page cache to socket directly.
+// On other platforms file is read by chunks, next chunk is read while previous one is written to socket.
+
+#if defined(__linux__)
+// sendfile() can not send more than 0x7ffff000 bytes in single call.
+const boost::uint64_t kMAX_SENDFILE_BYTES = 0x7ffff000;
+#else
+const std::size_t kCHUNK_SIZE = 64 * 1024;
+#endif
+
+template <typename SocketT>
+class connection
+  : public boost::enable_shared_from_this< connection<SocketT> >,
+	private boost::noncopyable
+{
+public:
+  typedef boost::shared_ptr< connection<SocketT> > pointer;
+
+  static pointer create(boost::asio::io_service& io_service,
+						std::unique_ptr<SocketT> socket,
+                        const std::wstring& filename,
+                        const Reply::FileRanges& ranges,
+                        const std::string& tail)
+  {
+    return pointer(new connection(io_service, std::move(socket), filename, ranges, tail));
+  }
+
+  ~connection()
+  {
+#if defined(__linux__)
+    if (fd_ != -1) {
+      ::close(fd_);
+    }
+#endif
+  }
+
+  SocketT& socket()
+  {
+    assert(socket_);
+    return *socket_;
+  }
+
+  void start()
+  {
+    const std::string path = StringEncoding::utf16_to_utf8(filename_);
+#if defined(__linux__)
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ == -1) {
+        BOOST_LOG_SEV(logger(), error) << "TransmitFile. open error: " << errno;
+        shutdown();
+        return;
+    }
+    boost::system::error_code ec;
+    socket().native_non_blocking(true, ec); // blocking sendfile() would stall network thread while client is slow.
+    if (ec) {
+        BOOST_LOG_SEV(logger(), error) << "TransmitFile. Failed to set non-blocking mode: " << ec;
+        shutdown();
+        return;
+    }
+#else
+    file_.open(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file_) {
+        BOOST_LOG_SEV(logger(), error) << "TransmitFile. Failed to open file " << path;
+        shutdown();
+        return;
+    }
+#endif
+    write_range_head();
+  }
+
+private:
+  connection(boost::asio::io_service& /*io_service*/, std::unique_ptr<SocketT> socket, const std::wstring& filename,
+             const Reply::FileRanges& ranges, const std::string& tail)
+    : socket_(std::move(socket)),
+      filename_(filename),
+      ranges_(ranges),
+      tail_(tail),
+      range_index_(0),
+      range_offset_(0),
+      range_remaining_(0)
+#if defined(__linux__)
+      , fd_(-1)
+#else
+      , read_ahead_size_(0),
+      read_ahead_ok_(true)
+#endif
+  {
+	assert(socket_);
+  }
+
+  void write_range_head()
+  {
+    if (range_index_ == ranges_.size()) {
+      boost::asio::async_write(socket(), boost::asio::buffer(tail_),
+          boost::bind(&connection::handle_write_tail, this->shared_from_this(),
+            boost::asio::placeholders::error));
+      return;
+    }
+
+    const Reply::FileRange& range = ranges_[range_index_];
+    range_offset_ = range.offset;
+    range_remaining_ = range.length;
+    boost::asio::async_write(socket(), boost::asio::buffer(range.head),
+        boost::bind(&connection::handle_write_head, this->shared_from_this(),
+          boost::asio::placeholders::error));
+  }
+
+  void handle_write_head(const boost::system::error_code& e)
+  {
+    if (e) {
+      shutdown();
+      return;
+    }
+    send_range_data();
+  }
+
+  void handle_write_tail(const boost::system::error_code& /*e*/)
+  {
+    shutdown();
+  }
+
+#if defined(__linux__)
+  void send_range_data()
+  {
+    while (range_remaining_ > 0) {
+      off_t offset = static_cast<off_t>(range_offset_);
+      const std::size_t count = static_cast<std::size_t>( std::min<boost::uint64_t>(range_remaining_, kMAX_SENDFILE_BYTES) );
+      const ssize_t sent = ::sendfile(socket().native_handle(), fd_, &offset, count);
+      if (sent > 0) {
+        range_offset_ += sent;
+        range_remaining_ -= sent;
+      } else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // socket buffer is full, continue when socket becomes writable.
+        socket().async_write_some(boost::asio::null_buffers(),
+            boost::bind(&connection::handle_socket_writable, this->shared_from_this(),
+              boost::asio::placeholders::error));
+        return;
+      } else if (sent == -1 && errno == EINTR) {
+        continue;
+      } else {
+        BOOST_LOG_SEV(logger(), error) << "TransmitFile. sendfile error: " << (sent == 0 ? 0 : errno); // 0 means file was truncated.
+        shutdown();
+        return;
+      }
+    }
+
+    ++range_index_;
+    write_range_head();
+  }
+
+  void handle_socket_writable(const boost::system::error_code& e)
+  {
+    if (e) {
+      shutdown();
+      return;
+    }
+    send_range_data();
+  }
+#else
+  // Reads next chunk of current range into read-ahead buffer. Returns false on read error.
+  bool read_ahead()
+  {
+    read_ahead_size_ = static_cast<std::size_t>( std::min<boost::uint64_t>(range_remaining_, kCHUNK_SIZE) );
+    if (read_ahead_size_ == 0) {
+      return true;
+    }
+
+    read_ahead_buffer_.resize(kCHUNK_SIZE);
+    file_.seekg( static_cast<std::streamoff>(range_offset_) );
+    if ( !file_.read(&read_ahead_buffer_[0], read_ahead_size_) ) {
+      BOOST_LOG_SEV(logger(), error) << "TransmitFile. File read error.";
+      return false;
+    }
+    range_offset_ += read_ahead_size_;
+    range_remaining_ -= read_ahead_size_;
+    return true;
+  }
+
+  void send_range_data()
+  {
+    if ( !read_ahead() ) {
+      shutdown();
+      return;
+    }
+    write_read_ahead_chunk();
+  }
+
+  void write_read_ahead_chunk()
+  {
+    if (read_ahead_size_ == 0) {
+      ++range_index_;
+      write_range_head();
+      return;
+    }
+
+    write_buffer_.swap(read_ahead_buffer_);
+    const std::size_t count = read_ahead_size_;
+    boost::asio::async_write(socket(), boost::asio::buffer(&write_buffer_[0], count),
+        boost::bind(&connection::handle_write_data, this->shared_from_this(),
+          boost::asio::placeholders::error));
+
+    // disk read overlaps with sending of previous chunk.
+    read_ahead_ok_ = read_ahead();
+  }
+
+  void handle_write_data(const boost::system::error_code& e)
+  {
+    if (e || !read_ahead_ok_) {
+      shutdown();
+      return;
+    }
+    write_read_ahead_chunk();
+  }
+#endif
+
+  void shutdown()
+  {
+    boost::system::error_code ignored_ec;
+    socket_->shutdown(SocketT::shutdown_both, ignored_ec);
+  }
+
+  std::unique_ptr<SocketT> socket_;
+  std::wstring filename_;
+  Reply::FileRanges ranges_;
+  std::string tail_;
+  std::size_t range_index_;
+  boost::uint64_t range_offset_;    // offset of data which is not sent(Linux) or not read yet.
+  boost::uint64_t range_remaining_; // size of data which is not sent(Linux) or not read yet.
+#if defined(__linux__)
+  int fd_;
+#else
+  std::ifstream file_;
+  std::vector<char> read_ahead_buffer_;
+  std::vector<char> write_buffer_;
+  std::size_t read_ahead_size_;
+  bool read_ahead_ok_;
+#endif
+};
+
 #endif // defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
 
 } // namespace TransmitFile
 
 template <typename SocketT>
-Connection<SocketT>::Connection(boost::asio::io_service& io_service, RequestHandler& handler)
+Connection<SocketT>::Connection(boost::asio::io_service& io_service, PlayerThread& player_thread, RequestHandler& handler)
     :
     strand_(io_service),
     socket_(std::unique_ptr<SocketT>(new SocketT(io_service))),
-    request_handler_(handler)
+    player_thread_(player_thread),
+    request_handler_(handler),
+    unparsed_data_begin_(0),
+    unparsed_data_end_(0),
+    idle_timer_(io_service),
+    requests_count_(0),
+    keep_alive_(false)
 {
     try {
         BOOST_LOG_SEV(logger(), info) << "Creating connection to host " << socket().remote_endpoint();
@@ -158,6 +475,22 @@ SocketT& Connection<SocketT>::socket()
     return *socket_;
 }
 
+template <typename SocketT>
+void Connection<SocketT>::recycle()
+{
+    boost::system::error_code ignored_ec;
+    if (socket_) {
+        socket_->close(ignored_ec);
+    } else {
+        socket_.reset( new SocketT( strand_.get_io_service() ) ); // socket was passed to file sending connection.
+    }
+    idle_timer_.expires_at(boost::posix_time::pos_infin);
+    unparsed_data_begin_ = 0;
+    unparsed_data_end_ = 0;
+    requests_count_ = 0;
+    reset_request_state();
+}
+
 template <typename SocketT>
 void Connection<SocketT>::start()
 {
@@ -167,12 +500,16 @@ void Connection<SocketT>::start()
 template <typename SocketT>
 void Connection<SocketT>::read_some_to_buffer()
 {
-    socket().async_read_some(boost::asio::buffer(buffer_),
-                            strand_.wrap(boost::bind(&Connection<SocketT>::handle_read,
-                                                     shared_from_this(),
-                                                     boost::asio::placeholders::error,
-                                                     boost::asio::placeholders::bytes_transferred
-                                                     )
+    start_idle_timer();
+
+    socket().async_read_some(boost::asio::buffer(buffer_.data() + unparsed_data_end_, buffer_.size() - unparsed_data_end_),
+                            strand_.wrap(make_custom_alloc_handler(read_allocator_,
+                                                                   boost::bind(&Connection<SocketT>::handle_read,
+                                                                               shared_from_this(),
+                                                                               boost::asio::placeholders::error,
+                                                                               boost::asio::placeholders::bytes_transferred
+                                                                               )
+                                                                   )
                                          )
                             );
 }
@@ -180,51 +517,63 @@ void Connection<SocketT>::read_some_to_buffer()
 template <typename SocketT>
 void Connection<SocketT>::write_reply_content()
 {
+    add_connection_headers(reply_);
+
     if ( !reply_.filename.empty() ) {
         // send large file.
         boost::asio::async_write(socket(),
                                  reply_.to_buffers_headers_only(),
-                                 strand_.wrap(boost::bind(&Connection<SocketT>::handle_write_headers_on_file_sending,
-                                                          shared_from_this(),
-                                                          boost::asio::placeholders::error
-                                                          )
+                                 strand_.wrap(make_custom_alloc_handler(write_allocator_,
+                                                                        boost::bind(&Connection<SocketT>::handle_write_headers_on_file_sending,
+                                                                                    shared_from_this(),
+                                                                                    boost::asio::placeholders::error
+                                                                                    )
+                                                                        )
                                               )
                                  );
     } else {
         // send small string data.
+        request_handler_.compress_reply(request_, reply_);
         boost::asio::async_write(socket(),
                                  reply_.to_buffers(),
-                                 strand_.wrap(boost::bind(&Connection<SocketT>::handle_write,
-                                                          shared_from_this(),
-                                                          boost::asio::placeholders::error
-                                                          )
+                                 strand_.wrap(make_custom_alloc_handler(write_allocator_,
+                                                                        boost::bind(&Connection<SocketT>::handle_write,
+                                                                                    shared_from_this(),
+                                                                                    boost::asio::placeholders::error
+                                                                                    )
+                                                                        )
                                               )
                                  );
     }
 }
 
+template <typename SocketT>
+void Connection<SocketT>::handle_request()
+{
+    ICometDelayedConnection_ptr comet_connection = boost::allocate_shared< CometDelayedConnection<SocketT> >(boost::fast_pool_allocator< CometDelayedConnection<SocketT> >(),
+                                                                                                              shared_from_this()
+                                                                                                              );
+    bool reply_immediately = request_handler_.handle_request(request_, reply_, comet_connection);
+    if (reply_immediately) {
+        // return to connection's strand if we are in player's thread now.
+        strand_.dispatch( make_custom_alloc_handler(write_allocator_,
+                                                    boost::bind(&Connection<SocketT>::write_reply_content,
+                                                                shared_from_this()
+                                                                )
+                                                    )
+                         );
+    }
+}
+
 template <typename SocketT>
 void Connection<SocketT>::handle_read(const boost::system::error_code& e,
                                       std::size_t bytes_transferred)
 {
+    // data came, connection is not idle anymore.
+    idle_timer_.expires_at(boost::posix_time::pos_infin);
+
     if (!e) {
-        boost::tribool result;
-        boost::tie(result, boost::tuples::ignore) = request_parser_.parse(request_,
-                                                                          buffer_.data(),
-                                                                          buffer_.data() + bytes_transferred
-                                                                          );
-        if (result) {
-            ICometDelayedConnection_ptr comet_connection( new CometDelayedConnection<SocketT>( shared_from_this() ) );
-            bool reply_immediately = request_handler_.handle_request(request_, reply_, comet_connection);
-            if (reply_immediately) {
-                write_reply_content();
-            }
-        } else if (!result) {
-            reply_ = Reply::stock_reply(Reply::bad_request);
-            write_reply_content();
-        } else {
-            read_some_to_buffer();
-        }
+        parse_buffer(buffer_.data() + unparsed_data_begin_, buffer_.data() + unparsed_data_end_ + bytes_transferred);
     } else {
         // BOOST_LOG_SEV(logger(), debug) << "Connection<SocketT>::handle_read(): failed to read data. Reason: " << e.message();
     }
@@ -235,10 +584,89 @@ void Connection<SocketT>::handle_read(const boost::system::error_code& e,
     // handler returns. The Connection class's destructor closes the socket.
 }
 
+template <typename SocketT>
+void Connection<SocketT>::parse_buffer(const char* begin, const char* end)
+{
+    boost::tribool result;
+    const char* parsed_end;
+    boost::tie(result, parsed_end) = request_parser_.parse(request_, begin, end);
+
+    // remember data of next pipelined request, it will be parsed after reply on current request is sent.
+    unparsed_data_begin_ = parsed_end - buffer_.data();
+    unparsed_data_end_ = end - buffer_.data();
+
+    if (result) {
+        ++requests_count_;
+        keep_alive_ = request_allows_keep_alive();
+
+        if ( request_handler_.needs_player_thread(request_) ) {
+            // AIMP is not thread safe, so requests which use it are handled in player's thread.
+            player_thread_.post( make_custom_alloc_handler(read_allocator_,
+                                                           boost::bind(&Connection<SocketT>::handle_request,
+                                                                       shared_from_this()
+                                                                       )
+                                                           )
+                                );
+        } else {
+            handle_request();
+        }
+    } else if (!result) {
+        keep_alive_ = false; // we can not find start of next request in broken stream.
+        reply_ = Reply::stock_reply(Reply::bad_request);
+        write_reply_content();
+    } else if ( keep_incomplete_request(parsed_end, end) ) {
+        read_some_to_buffer();
+    } else {
+        keep_alive_ = false;
+        reply_ = Reply::stock_reply(Reply::bad_request); // request line and headers do not fit buffer.
+        write_reply_content();
+    }
+}
+
+template <typename SocketT>
+bool Connection<SocketT>::keep_incomplete_request(const char* parsed_end, const char* end)
+{
+    if ( !request_parser_.head_parsed() ) {
+        // parser has not consumed incomplete request line and headers.
+        const std::size_t size = end - parsed_end;
+        std::memmove(buffer_.data(), parsed_end, size);
+        unparsed_data_begin_ = 0;
+        unparsed_data_end_ = size;
+    } else {
+        // content is consumed by parser, keep only request line and headers.
+        const boost::string_ref head = request_parser_.head();
+        if ( head.data() != buffer_.data() ) {
+            std::memmove(buffer_.data(), head.data(), head.size());
+            request_parser_.move_head(request_, buffer_.data());
+        }
+        unparsed_data_begin_ = head.size();
+        unparsed_data_end_ = head.size();
+    }
+    return unparsed_data_end_ < buffer_.size();
+}
+
 template <typename SocketT>
 void Connection<SocketT>::handle_write(const boost::system::error_code& e)
 {
     if (!e) {
+        if (reply_.status == Reply::switching_protocols) {
+            switch_to_websocket();
+            return;
+        }
+
+        if (keep_alive_) {
+            reset_request_state();
+            if (unparsed_data_begin_ != unparsed_data_end_) {
+                // client has already sent next request.
+                parse_buffer(buffer_.data() + unparsed_data_begin_, buffer_.data() + unparsed_data_end_);
+            } else {
+                unparsed_data_begin_ = 0;
+                unparsed_data_end_ = 0;
+                read_some_to_buffer();
+            }
+            return;
+        }
+
         // Initiate graceful connection closure.
         boost::system::error_code ignored_ec;
         socket().shutdown(SocketT::shutdown_both, ignored_ec);
@@ -250,6 +678,23 @@ void Connection<SocketT>::handle_write(const boost::system::error_code& e)
     // destructor closes the socket.
 }
 
+template <typename SocketT>
+void Connection<SocketT>::switch_to_websocket()
+{
+    typedef WebSocketConnection<SocketT> WebSocketConnectionType;
+    boost::shared_ptr<WebSocketConnectionType> websocket_connection = boost::make_shared<WebSocketConnectionType>(std::move(socket_), // this object is not socket owner anymore.
+                                                                                                                  boost::ref(player_thread_),
+                                                                                                                  boost::ref(request_handler_),
+                                                                                                                  request_.uri.to_string()
+                                                                                                                  );
+    assert(!socket_);
+
+    // client may send first messages without waiting for handshake reply.
+    websocket_connection->start(buffer_.data() + unparsed_data_begin_, buffer_.data() + unparsed_data_end_);
+
+    // No new asynchronous operations are started. This object will be destroyed or returned to pool after this handler returns.
+}
+
 template <typename SocketT>
 void Connection<SocketT>::handle_write_headers_on_file_sending(const boost::system::error_code& e)
 {
@@ -258,7 +703,9 @@ void Connection<SocketT>::handle_write_headers_on_file_sending(const boost::syst
         typedef TransmitFile::connection<SocketT> TransmitFileConnection;
         TransmitFileConnection::pointer tfc = TransmitFileConnection::create(strand_.get_io_service(),
                                                                              std::move(socket_), // this object is not socket owner anymore.
-																		     reply_.filename);
+																		     reply_.filename,
+                                                                             reply_.file_ranges,
+                                                                             reply_.file_tail);
         assert(!socket_);
         
         tfc->start();
@@ -270,17 +717,133 @@ void Connection<SocketT>::handle_write_headers_on_file_sending(const boost::syst
     // All file transferring work will do TransmitFileConnection.
 }
 
+template <typename SocketT>
+bool Connection<SocketT>::request_allows_keep_alive() const
+{
+    boost::string_ref connection_value;
+    const bool has_connection_header = get_header_value(request_.headers, "Connection", connection_value);
+
+    if ( request_.http_version_major > 1 || (request_.http_version_major == 1 && request_.http_version_minor >= 1) ) {
+        return !( has_connection_header && boost::iequals(connection_value, "close") );
+    }
+    return has_connection_header && boost::iequals(connection_value, "keep-alive");
+}
+
+template <typename SocketT>
+void Connection<SocketT>::add_connection_headers(Reply& reply)
+{
+    const auto& settings = ControlPlugin::AIMPControlPlugin::settings().http_server;
+
+    const std::string* content_length_value = nullptr;
+    const bool content_length_known = get_header_value(reply.headers, "Content-Length", content_length_value)
+                                      || reply.status == Reply::not_modified
+                                      || reply.status == Reply::no_content; // replies without body.
+    const bool requests_limit_reached = settings.max_requests_per_connection != 0
+                                        && requests_count_ >= settings.max_requests_per_connection;
+
+    if (reply.status == Reply::switching_protocols) {
+        keep_alive_ = false; // connection is passed to WebSocket, its Connection header is set by handshake.
+        return;
+    }
+
+    keep_alive_ = keep_alive_
+                  && content_length_known
+                  && reply.filename.empty() // file is sent by TransmitFile which closes socket after all.
+                  && !requests_limit_reached;
+
+    reply.headers.push_back(header());
+    reply.headers.back().name = "Connection";
+    reply.headers.back().value = keep_alive_ ? "keep-alive" : "close";
+
+    if (keep_alive_) {
+        Utilities::MakeString keep_alive_value;
+        keep_alive_value << "timeout=" << settings.keep_alive_timeout;
+        if (settings.max_requests_per_connection != 0) {
+            keep_alive_value << ", max=" << settings.max_requests_per_connection - requests_count_;
+        }
+
+        reply.headers.push_back(header());
+        reply.headers.back().name = "Keep-Alive";
+        reply.headers.back().value = keep_alive_value;
+    }
+}
+
+template <typename SocketT>
+void Connection<SocketT>::reset_request_state()
+{
+    request_parser_.reset();
+    // request strings are cleared by parser, their capacity is reused by next request.
+    request_.mpfd_parser.reset();
+    reply_ = Reply();
+    keep_alive_ = false;
+}
+
+template <typename SocketT>
+void Connection<SocketT>::start_idle_timer()
+{
+    const unsigned int timeout = ControlPlugin::AIMPControlPlugin::settings().http_server.keep_alive_timeout;
+    if (timeout == 0) {
+        return; // connection waits for request data infinitely.
+    }
+
+    idle_timer_.expires_from_now( boost::posix_time::seconds(timeout) );
+    idle_timer_.async_wait( strand_.wrap(make_custom_alloc_handler(timer_allocator_,
+                                                                   boost::bind(&Connection<SocketT>::handle_idle_timeout,
+                                                                               shared_from_this(),
+                                                                               boost::asio::placeholders::error
+                                                                               )
+                                                                   )
+                                         )
+                           );
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_idle_timeout(const boost::system::error_code& e)
+{
+    // Timer could be reset after this handler was queued, so check deadline also.
+    if ( e != boost::asio::error::operation_aborted
+         && idle_timer_.expires_at() <= boost::asio::deadline_timer::traits_type::now()
+         && socket_
+        )
+    {
+        BOOST_LOG_SEV(logger(), debug) << "Closing idle connection.";
+        // Pending read operation will fail and connection will be destroyed.
+        boost::system::error_code ignored_ec;
+        socket().shutdown(SocketT::shutdown_both, ignored_ec);
+        socket().close(ignored_ec);
+    }
+}
+
 template <typename SocketT>
 void CometDelayedConnection<SocketT>::sendResponse(DelayedResponseSender_ptr comet_http_response_sender)
+{
+    connection_->strand_.dispatch( make_custom_alloc_handler(connection_->write_allocator_,
+                                                             boost::bind(&CometDelayedConnection<SocketT>::write_response,
+                                                                         shared_from_this(),
+                                                                         comet_http_response_sender
+                                                                         )
+                                                             )
+                                  );
+}
+
+template <typename SocketT>
+void CometDelayedConnection<SocketT>::write_response(DelayedResponseSender_ptr comet_http_response_sender)
 {
     BOOST_LOG_SEV(logger(), debug) << "CometDelayedConnection::sendResponse to " << connection_->socket().remote_endpoint();
+
+    Reply& reply = comet_http_response_sender->get_reply();
+    connection_->request_handler_.compress_reply(connection_->request_, reply);
+    connection_->add_connection_headers(reply);
+
     boost::asio::async_write( connection_->socket(),
-                              comet_http_response_sender->get_reply().to_buffers(),
-                              connection_->strand_.wrap(boost::bind(&CometDelayedConnection<SocketT>::handle_write,
-                                                                    shared_from_this(),
-                                                                    comet_http_response_sender,
-                                                                    boost::asio::placeholders::error
-                                                                    )
+                              reply.to_buffers(),
+                              connection_->strand_.wrap(make_custom_alloc_handler(connection_->write_allocator_,
+                                                                                  boost::bind(&CometDelayedConnection<SocketT>::handle_write,
+                                                                                              shared_from_this(),
+                                                                                              comet_http_response_sender,
+                                                                                              boost::asio::placeholders::error
+                                                                                              )
+                                                                                  )
                                                          )
                              );
 }
@@ -290,16 +853,16 @@ void CometDelayedConnection<SocketT>::handle_write(DelayedResponseSender_ptr com
 {
     if (!e) {
         BOOST_LOG_SEV(logger(), debug) << "CometDelayedConnection::success sending response to " << connection_->socket().remote_endpoint();
-        // Initiate graceful connection closure.
-        boost::system::error_code ignored_ec;
-        connection_->socket().shutdown(SocketT::shutdown_both, ignored_ec);
     } else {
         BOOST_LOG_SEV(logger(), debug) << "CometDelayedConnection::fail to send response to "
                                        << connection_->socket().remote_endpoint()
                                        << ". Reason: " << e.message();
     }
 
-    // No new asynchronous operations are started. This means that all shared_ptr
+    // Connection continues processing of next request or initiates graceful connection closure.
+    connection_->handle_write(e);
+
+    // If no new asynchronous operations are started all shared_ptr
     // references to the CometDelayedConnection object will disappear and the object will be
     // destroyed automatically after this handler returns. The Connection class's
     // destructor closes the socket.
@@ -14,6 +14,8 @@
 #include "reply.h"
 #include "request.h"
 #include "request_parser.h"
+#include "handler_allocator.h"
+#include "player_thread.h"
 
 namespace Http {
 
@@ -28,8 +30,12 @@ class Connection : /*public Connection, */public boost::enable_shared_from_this<
 
 public:
 
-    /// Construct a connection with the given io_service.
+    /*
+        Construct a connection with the given io_service.
+        player_thread is AIMP player's thread: requests which touch player are handled there.
+    */
     Connection(boost::asio::io_service& io_service,
+               PlayerThread& player_thread,
                RequestHandler& handler);
 
     ~Connection();
@@ -40,33 +46,87 @@ public:
     /// Get the socket associated with the connection.
     SocketT& socket();
 
+    /// Close connection and prepare it to serve new client. Used by ConnectionPool.
+    void recycle();
+
 private:
 
+    /// Read data to buffer_ after unparsed data, which is parsed again together with new data.
     void read_some_to_buffer();
 
+    /// Parse data from buffer_ in range [begin, end). Data which remains unparsed belongs to the next pipelined request.
+    void parse_buffer(const char* begin, const char* end);
+
+    /*!
+        Prepare buffer_ to read the rest of current request. Request refers to its line and headers in buffer_,
+        so they are kept: incomplete ones are moved to buffer start to be parsed again, parsed ones are kept before content.
+        Returns false if there is no space for more data.
+    */
+    bool keep_incomplete_request(const char* parsed_end, const char* end);
+
     void write_reply_content();
 
+    /// Handle parsed request. Called in player's thread if request needs access to AIMP, in connection's strand otherwise.
+    void handle_request();
+
     /// Handle completion of a read operation.
     void handle_read(const boost::system::error_code& e, std::size_t bytes_transferred);
 
-    /// Handle completion of a write operation.
+    /// Handle completion of a write operation. Starts processing of next request on persistent connection or closes it.
     void handle_write(const boost::system::error_code& e);
 
+    /// Pass socket to WebSocket connection after handshake reply is sent.
+    void switch_to_websocket();
+
     /// Handle completion of a header write operation.
     void handle_write_headers_on_file_sending(const boost::system::error_code& e);
 
+    /// Return true if client asks to keep connection open after reply. HTTP/1.1 connections are persistent by default.
+    bool request_allows_keep_alive() const;
+
+    /*
+        Finally decide if connection will be kept open after sending of reply and add Connection header to reply.
+        Reply without Content-Length or with file content always closes connection.
+    */
+    void add_connection_headers(Reply& reply);
+
+    /// Prepare parser, request and reply objects for the next request on persistent connection.
+    void reset_request_state();
+
+    /// Start waiting of next request data. Connection is closed if no data come in keep-alive timeout.
+    void start_idle_timer();
+
+    /// Handle expiration of idle timer.
+    void handle_idle_timeout(const boost::system::error_code& e);
+
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
 
     /// Socket for the connection.
     std::unique_ptr<SocketT> socket_; // use pointer to be able pass it to another connection without copying.
 
+    /// AIMP player's thread.
+    PlayerThread& player_thread_;
+
     /// The handler used to process the incoming request.
     RequestHandler& request_handler_;
 
     /// Buffer for incoming data.
     boost::array<char, 8192> buffer_;
 
+    /// Range of buffer_ which contains data of pipelined requests or of incomplete request which are not parsed yet.
+    std::size_t unparsed_data_begin_;
+    std::size_t unparsed_data_end_;
+
+    /// Timer to close idle persistent connection.
+    boost::asio::deadline_timer idle_timer_;
+
+    /// Count of requests handled by this connection.
+    std::size_t requests_count_;
+
+    /// Flag is set if connection should be kept open after sending of current reply.
+    bool keep_alive_;
+
     /// The incoming request.
     Request request_;
 
@@ -75,6 +135,15 @@ private:
 
     /// The reply to be sent back to the client.
     Reply reply_;
+
+    /// Memory for handlers of read operations(strand) and of request handling posted to player's thread.
+    handler_allocator read_allocator_;
+
+    /// Memory for handlers of write operations(strand) and of delayed responses dispatched from player's thread by CometDelayedConnection.
+    handler_allocator write_allocator_;
+
+    /// Memory for handlers of idle timer(strand). Timer is cancelled and re-armed while handler of previous wait may be alive.
+    handler_allocator timer_allocator_;
 };
 
 
@@ -86,6 +155,14 @@ public:
     virtual ~ICometDelayedConnection() {}
 
     virtual void sendResponse(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender) = 0;
+
+    /// Return true if connection can send many responses on single request(WebSocket), false if only one response is allowed(HTTP).
+    virtual bool persistent() const
+        { return false; }
+
+    /// Return true if persistent connection is closed and responses can not be sent anymore.
+    virtual bool closed() const
+        { return false; }
 };
 
 typedef boost::shared_ptr<ICometDelayedConnection> ICometDelayedConnection_ptr;
@@ -106,6 +183,9 @@ public:
 
 private:
 
+    /// Starts response writing. Called in connection's strand since sendResponse() can be called from any thread.
+    void write_response(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender);
+
     void handle_write(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender, const boost::system::error_code& e);
 
     ConnectionType_ptr connection_;
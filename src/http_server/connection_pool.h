@@ -0,0 +1,106 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include "http_server/player_thread.h"
+
+namespace Http
+{
+
+class RequestHandler;
+
+/*!
+    \brief Keeps closed connections to reuse them for new clients.
+    Reused connection keeps its buffer, capacity of request strings and memory of handler allocators,
+    so accepting of new client does not touch heap in steady state.
+    Pool lives while there are connections acquired from it. Class is thread safe.
+*/
+template <typename ConnectionT>
+class ConnectionPool : public boost::enable_shared_from_this< ConnectionPool<ConnectionT> >, private boost::noncopyable
+{
+public:
+
+    typedef boost::shared_ptr<ConnectionT> Connection_ptr;
+
+    static const std::size_t kMAX_FREE_CONNECTIONS = 64; //!< connections above this limit are destroyed on release.
+
+    ConnectionPool(boost::asio::io_service& io_service, PlayerThread& player_thread, RequestHandler& request_handler)
+        :
+        io_service_(io_service),
+        player_thread_(player_thread),
+        request_handler_(request_handler)
+    {
+        free_connections_.reserve(kMAX_FREE_CONNECTIONS); // release() must not throw.
+    }
+
+    ~ConnectionPool()
+    {
+        for (ConnectionT* connection : free_connections_) {
+            delete connection;
+        }
+    }
+
+    //! Returns free connection or creates new one. Connection returns to pool when last reference to it is released.
+    Connection_ptr acquire()
+    {
+        ConnectionT* connection = nullptr;
+        {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            if ( !free_connections_.empty() ) {
+                connection = free_connections_.back();
+                free_connections_.pop_back();
+            }
+        }
+
+        if (!connection) {
+            connection = new ConnectionT(io_service_, player_thread_, request_handler_);
+        }
+
+        return Connection_ptr( connection, Recycler( this->shared_from_this() ) ); // on failure shared_ptr passes connection to Recycler itself.
+    }
+
+private:
+
+    //! Deleter of connection shared pointer.
+    struct Recycler
+    {
+        boost::shared_ptr<ConnectionPool> pool;
+
+        explicit Recycler(boost::shared_ptr<ConnectionPool> pool)
+            : pool(pool)
+        {}
+
+        void operator()(ConnectionT* connection) const
+            { pool->release(connection); }
+    };
+
+    void release(ConnectionT* connection)
+    {
+        try {
+            connection->recycle();
+
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            if (free_connections_.size() < kMAX_FREE_CONNECTIONS) {
+                free_connections_.push_back(connection);
+                return;
+            }
+        } catch (std::exception&) {
+            // connection can not be reused, destroy it.
+        }
+        delete connection;
+    }
+
+    boost::asio::io_service& io_service_;
+    PlayerThread& player_thread_;
+    RequestHandler& request_handler_;
+
+    std::vector<ConnectionT*> free_connections_;
+    boost::mutex mutex_; //!< guards free_connections_.
+};
+
+} // namespace Http
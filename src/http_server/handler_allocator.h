@@ -0,0 +1,126 @@
+// Copyright (c) 2003-2010 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_HANDLER_ALLOCATOR_H
+#define HTTP_HANDLER_ALLOCATOR_H
+
+#include <boost/aligned_storage.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/asio/handler_alloc_hook.hpp>
+#include <boost/asio/handler_invoke_hook.hpp>
+
+namespace Http {
+
+/// Class to manage the memory to be used for handler-based custom allocation.
+/// It contains a single block of memory which may be returned for allocation
+/// requests. If the memory is in use when an allocation request is made, the
+/// allocator delegates allocation to the global heap.
+/// Only one asynchronous operation may use the block at a time, so each
+/// connection keeps separate allocator for each kind of its pending operations.
+/// Handlers of one allocator may be created and destroyed in different threads
+/// (network thread and player's thread, not only connection's strand),
+/// so block is taken by atomic exchange of flag: only one of concurrent allocations gets it.
+class handler_allocator : private boost::noncopyable
+{
+public:
+    handler_allocator()
+        : in_use_(false)
+    {}
+
+    void* allocate(std::size_t size)
+    {
+        if ( size < storage_.size && !in_use_.exchange(true, boost::memory_order_acquire) ) {
+            return storage_.address();
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer)
+    {
+        if (pointer == storage_.address()) {
+            in_use_.store(false, boost::memory_order_release);
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+private:
+    /// Storage space used for handler-based custom memory allocation.
+    boost::aligned_storage<1024> storage_;
+
+    /// Whether the handler-based custom allocation storage has been used.
+    boost::atomic<bool> in_use_;
+};
+
+/// Wrapper class template for handler objects to allow handler memory
+/// allocation to be customised. Calls to operator() are forwarded to the
+/// encapsulated handler.
+template <typename Handler>
+class custom_alloc_handler
+{
+public:
+    custom_alloc_handler(handler_allocator& a, Handler h)
+        : allocator_(a),
+          handler_(h)
+    {}
+
+    void operator()()
+    {
+        handler_();
+    }
+
+    template <typename Arg1>
+    void operator()(Arg1 arg1)
+    {
+        handler_(arg1);
+    }
+
+    template <typename Arg1, typename Arg2>
+    void operator()(Arg1 arg1, Arg2 arg2)
+    {
+        handler_(arg1, arg2);
+    }
+
+    friend void* asio_handler_allocate(std::size_t size, custom_alloc_handler<Handler>* this_handler)
+    {
+        return this_handler->allocator_.allocate(size);
+    }
+
+    friend void asio_handler_deallocate(void* pointer, std::size_t /*size*/, custom_alloc_handler<Handler>* this_handler)
+    {
+        this_handler->allocator_.deallocate(pointer);
+    }
+
+    /// Handler must be invoked in the same way as encapsulated one(it is important for strand wrapped handlers).
+    template <typename Function>
+    friend void asio_handler_invoke(Function& function, custom_alloc_handler<Handler>* this_handler)
+    {
+        using boost::asio::asio_handler_invoke;
+        asio_handler_invoke(function, boost::asio::detail::addressof(this_handler->handler_));
+    }
+
+    template <typename Function>
+    friend void asio_handler_invoke(const Function& function, custom_alloc_handler<Handler>* this_handler)
+    {
+        using boost::asio::asio_handler_invoke;
+        asio_handler_invoke(function, boost::asio::detail::addressof(this_handler->handler_));
+    }
+
+private:
+    handler_allocator& allocator_;
+    Handler handler_;
+};
+
+/// Helper function to wrap a handler object to add custom allocation.
+template <typename Handler>
+inline custom_alloc_handler<Handler> make_custom_alloc_handler(handler_allocator& a, Handler h)
+{
+    return custom_alloc_handler<Handler>(a, h);
+}
+
+} // namespace Http
+
+#endif // HTTP_HANDLER_ALLOCATOR_H
@@ -7,6 +7,7 @@
 #define HTTP_HEADER_H
 
 #include <string>
+#include <boost/utility/string_ref.hpp>
 
 namespace Http {
 
@@ -16,6 +17,13 @@ struct header
     std::string value;
 };
 
+/// Header of received request. Name and value refer to data received by connection.
+struct header_ref
+{
+    boost::string_ref name;
+    boost::string_ref value;
+};
+
 } // namespace Http
 
 #endif // HTTP_HEADER_H
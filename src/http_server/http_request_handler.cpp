@@ -16,6 +16,9 @@
 #include "reply.h"
 #include "request.h"
 #include "mime_types.h"
+#include "compression.h"
+#include "websocket.h"
+#include <boost/pool/pool_alloc.hpp>
 #include "rpc/request_handler.h"
 #include "utils/util.h"
 #include "plugin/settings.h"
@@ -34,11 +37,14 @@ const std::string kDOWNLOAD_TRACK_TAG("/downloadTrack/"),
                   kUPLOAD_TRACK_TAG("/uploadTrack"),
                   kCookieHeaderName("Cookie");
 
+// Replies smaller than one TCP segment are sent as is: compression does not reduce count of packets for them.
+const std::size_t kCOMPRESSION_THRESHOLD = 1400;
+
 void RequestHandler::trySendInitCookies(const Request& req, Reply& rep)
 {
-    const std::vector<header>& headers = req.headers;
+    const std::vector<header_ref>& headers = req.headers;
     if ( std::find_if(headers.begin(), headers.end(),
-                      [](const header& h) { return h.name == kCookieHeaderName; }
+                      [](const header_ref& h) { return h.name == kCookieHeaderName; }
                       ) == headers.end()
         )
     {
@@ -73,10 +79,18 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
     }
 
     if ( Rpc::Frontend* frontend = rpc_request_handler_.getFrontEnd(req.uri) ) { // handle RPC call.        
+        if ( WebSocket::isUpgradeRequest(req) ) { // RPC calls will come in WebSocket messages.
+            fillWebSocketHandshakeReply(req, rep);
+            return true;
+        }
+
         std::string response_content_type;
-        DelayedResponseSender_ptr comet_delayed_response_sender( new DelayedResponseSender(connection, *this) );
+        DelayedResponseSender_ptr comet_delayed_response_sender = boost::allocate_shared<DelayedResponseSender>(boost::fast_pool_allocator<DelayedResponseSender>(),
+                                                                                                               connection,
+                                                                                                               *this
+                                                                                                               );
 
-        boost::tribool result = rpc_request_handler_.handleRequest(req.uri,
+        boost::tribool result = rpc_request_handler_.handleRequest(req.uri.to_string(),
                                                                    req.content,
                                                                    comet_delayed_response_sender,
                                                                    *frontend,
@@ -85,9 +99,10 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
                                                                    );
         if (result || !result) {
             if ( Utilities::stringStartsWith(rep.content, kDOWNLOAD_TRACK_TAG) ) { // handle special download track response.
+                std::string download_track_uri;
+                download_track_uri.swap(rep.content);
                 Request req_download_track(req);
-                req_download_track.uri = rep.content;
-                rep.content.clear();
+                req_download_track.uri = download_track_uri;
                 return download_track_request_handler_.handle_request(req_download_track, rep);
             } else { // usual RPC response.
                 fillReplyWithContent(response_content_type, rep);
@@ -96,9 +111,9 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
         }
 
         return false; // response sending will be delayed.
-    } else if ( Utilities::stringStartsWith(req.uri, kDOWNLOAD_TRACK_TAG) ) { // handle special download track request.
+    } else if ( req.uri.starts_with(kDOWNLOAD_TRACK_TAG) ) { // handle special download track request.
         return download_track_request_handler_.handle_request(req, rep);
-    } else if ( Utilities::stringStartsWith(req.uri, kUPLOAD_TRACK_TAG) ) { // handle special upload track request.
+    } else if ( req.uri.starts_with(kUPLOAD_TRACK_TAG) ) { // handle special upload track request.
         return upload_track_request_handler_.handle_request(req, rep);
     } else {
         handle_file_request(req, rep);
@@ -107,6 +122,34 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
     return true;
 }
 
+bool RequestHandler::handle_websocket_message(const std::string& uri, const std::string& message, ICometDelayedConnection_ptr connection, std::string* response)
+{
+    assert(response);
+    Rpc::Frontend* frontend = rpc_request_handler_.getFrontEnd(uri);
+    assert(frontend); // connection was upgraded on RPC request.
+
+    std::string response_content_type;
+    DelayedResponseSender_ptr comet_delayed_response_sender = boost::allocate_shared<DelayedResponseSender>(boost::fast_pool_allocator<DelayedResponseSender>(),
+                                                                                                           connection,
+                                                                                                           *this
+                                                                                                           );
+    boost::tribool result = rpc_request_handler_.handleRequest(uri,
+                                                               message,
+                                                               comet_delayed_response_sender,
+                                                               *frontend,
+                                                               response,
+                                                               &response_content_type
+                                                               );
+    return result || !result;
+}
+
+bool RequestHandler::needs_player_thread(const Request& req)
+{
+    return ( rpc_request_handler_.getFrontEnd(req.uri) != nullptr && !WebSocket::isUpgradeRequest(req) ) // handshake does not touch player.
+           || req.uri.starts_with(kDOWNLOAD_TRACK_TAG)
+           || req.uri.starts_with(kUPLOAD_TRACK_TAG);
+}
+
 void RequestHandler::handle_file_request(const Request& req, Reply& rep)
 {
     // Decode url to path.
@@ -129,6 +172,13 @@ void RequestHandler::handle_file_request(const Request& req, Reply& rep)
         request_path += "index.htm";
     }
 
+    if ( StaticFile_ptr file = static_file_cache_.get(request_path) ) {
+        fillReplyWithStaticFile(req, file, rep);
+        return;
+    }
+
+    // File is not cached, read it directly.
+
     // Determine the file extension.
     std::size_t last_slash_pos = request_path.find_last_of("/");
     std::size_t last_dot_pos = request_path.find_last_of(".");
@@ -154,6 +204,120 @@ void RequestHandler::handle_file_request(const Request& req, Reply& rep)
     fillReplyWithContent(mime_types::extension_to_type(extension), rep);
 }
 
+namespace {
+
+//! Returns true if If-None-Match header value contains entity tag.
+bool entityTagMatches(boost::string_ref if_none_match_value, const std::string& etag)
+{
+    const std::string if_none_match = if_none_match_value.to_string();
+    if (boost::trim_copy(if_none_match) == "*") {
+        return true;
+    }
+
+    std::vector<std::string> tags;
+    boost::split(tags, if_none_match, boost::is_any_of(","));
+    for (std::string& tag : tags) {
+        boost::trim(tag);
+        if (tag == etag) { // strong comparison.
+            return true;
+        }
+    }
+    return false;
+}
+
+void addHeader(const std::string& name, const std::string& value, Reply& rep)
+{
+    rep.headers.push_back(header());
+    rep.headers.back().name = name;
+    rep.headers.back().value = value;
+}
+
+} // namespace anonymous
+
+void RequestHandler::fillReplyWithStaticFile(const Request& req, const StaticFile_ptr& file_ptr, Reply& rep)
+{
+    const StaticFile& file = *file_ptr;
+    const bool send_gzip = !file.gzip_content.empty() && Compression::acceptsEncoding(req, Compression::kGZIP_ENCODING);
+    const std::string& etag = send_gzip ? file.gzip_etag : file.etag;
+
+    // Check if client has actual version of file. If-None-Match has priority over If-Modified-Since.
+    bool not_modified = false;
+    boost::string_ref header_value;
+    if ( get_header_value(req.headers, "If-None-Match", header_value) ) {
+        not_modified = entityTagMatches(header_value, etag);
+    } else if ( get_header_value(req.headers, "If-Modified-Since", header_value) ) {
+        std::time_t since;
+        not_modified = parseHttpDate(header_value.to_string(), &since) && file.last_write_time <= since; // invalid date is ignored.
+    }
+
+    if (not_modified) {
+        rep.status = Reply::not_modified;
+        rep.content.clear();
+    } else {
+        rep.shared_content = boost::shared_ptr<const std::string>(file_ptr, send_gzip ? &file.gzip_content : &file.content); // reply keeps cached file alive, content is not copied.
+        fillReplyWithContent(file.mime_type, rep);
+        if (send_gzip) {
+            addHeader("Content-Encoding", Compression::kGZIP_ENCODING, rep);
+        }
+    }
+
+    addHeader("ETag", etag, rep);
+    if ( !file.last_modified.empty() ) {
+        addHeader("Last-Modified", file.last_modified, rep);
+    }
+    if ( !file.gzip_content.empty() ) {
+        addHeader("Vary", "Accept-Encoding", rep);
+    }
+}
+
+void RequestHandler::compress_reply(const Request& req, Reply& rep)
+{
+    if ( rep.status != Reply::ok
+         || rep.content.size() < kCOMPRESSION_THRESHOLD
+         || !rep.filename.empty()
+         || !rep.content_chunks.empty()
+         || rep.shared_content // cached file has compressed variant already.
+        )
+    {
+        return;
+    }
+
+    const std::string* header_value;
+    if ( get_header_value(rep.headers, "Content-Encoding", header_value) ) {
+        return; // content is encoded already.
+    }
+    if ( !get_header_value(rep.headers, "Content-Type", header_value)
+         || !Compression::isCompressibleMimeType( header_value->substr(0, header_value->find(';')) )
+        )
+    {
+        return;
+    }
+
+    Compression::Format format;
+    if ( !Compression::selectFormat(req, &format) ) {
+        return;
+    }
+
+    try {
+        Compression::Compressor compressor(format, &rep.content_chunks);
+        compressor.write( rep.content.data(), rep.content.size() );
+        compressor.finish();
+    } catch (std::exception& e) {
+        BOOST_LOG_SEV(logger(), error) << "Reply compression failed, sending it as is. Reason: " << e.what();
+        rep.content_chunks.clear();
+        return;
+    }
+    std::string().swap(rep.content); // release memory of uncompressed content right now.
+
+    for (header& h : rep.headers) {
+        if ( boost::iequals(h.name, "Content-Length") ) {
+            h.value = boost::lexical_cast<std::string>( rep.content_size() );
+        }
+    }
+    addHeader("Content-Encoding", Compression::encodingName(format), rep);
+    addHeader("Vary", "Accept-Encoding", rep);
+}
+
 void RequestHandler::fillReplyWithContent(const std::string& content_type, Reply& rep)
 {
     // Fill out the reply to be sent to the client.
@@ -161,13 +325,30 @@ void RequestHandler::fillReplyWithContent(const std::string& content_type, Reply
     
     rep.headers.push_back(header());
     rep.headers.back().name = "Content-Length";
-    rep.headers.back().value = boost::lexical_cast<std::string>( rep.content.size() );
+    rep.headers.back().value = boost::lexical_cast<std::string>( rep.content_size() );
 
     rep.headers.push_back(header());
     rep.headers.back().name = "Content-Type";
     rep.headers.back().value = content_type;
 }
 
+void RequestHandler::fillWebSocketHandshakeReply(const Request& req, Reply& rep)
+{
+    if ( !WebSocket::isSupportedVersion(req) ) {
+        rep = Reply::stock_reply(Reply::bad_request);
+        addHeader("Sec-WebSocket-Version", "13", rep);
+        return;
+    }
+
+    boost::string_ref key;
+    get_header_value(req.headers, "Sec-WebSocket-Key", key); // presence is checked by WebSocket::isUpgradeRequest().
+
+    rep.status = Reply::switching_protocols;
+    addHeader("Upgrade", "websocket", rep);
+    addHeader("Connection", "Upgrade", rep);
+    addHeader( "Sec-WebSocket-Accept", WebSocket::acceptKey( key.to_string() ), rep );
+}
+
 void RequestHandler::fillAuthFailReply(Reply& rep)
 {
     rep.status = Reply::unauthorized;
@@ -175,19 +356,41 @@ void RequestHandler::fillAuthFailReply(Reply& rep)
     rep.headers.emplace_back();
     rep.headers.back().name = "WWW-Authenticate";
     rep.headers.back().value = Utilities::MakeString() << "Digest qop=\"auth\", realm=\"" << auth_manager_.realm() << "\", nonce=\"" << auth_manager_.generate_nonce() << "\"";
+
+    // client repeats request with credentials, so let it use the same connection.
+    rep.headers.emplace_back();
+    rep.headers.back().name = "Content-Length";
+    rep.headers.back().value = "0";
 }
 
-bool RequestHandler::url_decode(const std::string& in, std::string& out)
+namespace {
+
+//! Returns value of hexadecimal digit or -1 if c is not a hexadecimal digit.
+int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace anonymous
+
+bool RequestHandler::url_decode(boost::string_ref in, std::string& out)
 {
     out.clear();
     out.reserve( in.size() );
     for (std::size_t i = 0; i < in.size(); ++i) {
         if (in[i] == '%') {
             if ( i + 3 <= in.size() ) {
-                int value = 0;
-                std::istringstream is(in.substr(i + 1, 2));
-                if (is >> std::hex >> value) {
-                    out += static_cast<char>(value);
+                const int high = hexDigitValue(in[i + 1]);
+                const int low = hexDigitValue(in[i + 2]);
+                if (high >= 0 && low >= 0) {
+                    out += static_cast<char>(high * 16 + low);
                     i += 2;
                 } else {
                     return false;
@@ -211,9 +414,15 @@ const Reply& DelayedResponseSender::get_reply() const
     return reply_;
 }
 
-void DelayedResponseSender::send(const std::string& response, const std::string& response_content_type)
+Reply& DelayedResponseSender::get_reply()
+{ 
+    return reply_;
+}
+
+void DelayedResponseSender::send(std::string&& response, const std::string& response_content_type)
 {
-    reply_.content = response;
+    reply_.content = std::move(response);
+    reply_.headers.clear(); // sender of persistent connection is used for many responses.
     http_request_handler_.fillReplyWithContent(response_content_type, reply_);
     comet_connection_->sendResponse( shared_from_this() );
 }
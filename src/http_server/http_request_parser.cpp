@@ -7,7 +7,7 @@
 #include <ctype.h>
 #include "request_parser.h"
 #include "request.h"
-#include <boost/lexical_cast.hpp>
+#include <limits>
 #include "mpfd_parser_factory.h"
 #include "http_server/header.h"
 
@@ -15,264 +15,298 @@ namespace Http {
 
 request_parser::request_parser()
     :
+    state_(request_head),
+    head_scanned_(0),
+    head_begin_(nullptr),
+    head_size_(0),
     content_length_(0),
-    state_(method_start),
     content_consumed_(0)
 {
 }
 
 void request_parser::reset()
 {
-    state_ = method_start;
+    state_ = request_head;
+    head_scanned_ = 0;
+    head_begin_ = nullptr;
+    head_size_ = 0;
+    content_length_ = 0;
     content_consumed_ = 0;
 }
 
-std::string request_parser::content_length_name_ = "Content-Length";
-const std::string content_type_name = "Content-Type";
+const char kCONTENT_LENGTH_NAME[] = "Content-Length";
+const char kCONTENT_TYPE_NAME[] = "Content-Type";
 
-boost::tribool request_parser::consume(Request& req, char input)
+void request_parser::clear_request(Request& req)
 {
-    switch (state_)
-    {
-    case method_start:
-        req.method.clear();
-        req.uri.clear();
-        req.http_version_major = 0;
-        req.http_version_minor = 0;
-        req.headers.clear();
-        req.content.clear();
-        content_length_ = 0;
-
-        if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
-            return false;
-        } else {
-            state_ = method;
-            req.method.push_back(input);
-            return boost::indeterminate;
-        }
-    case method:
-        if (input == ' ') {
-            state_ = uri;
-            return boost::indeterminate;
-        } else if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
-            return false;
-        } else {
-            req.method.push_back(input);
-            return boost::indeterminate;
-        }
-    case uri_start:
-        if ( is_ctl(input) ) {
-            return false;
-        } else {
-            state_ = uri;
-            req.uri.push_back(input);
-            return boost::indeterminate;
-        }
-    case uri:
-        if (input == ' ') {
-            state_ = http_version_h;
-            return boost::indeterminate;
-        } else if ( is_ctl(input) ) {
-            return false;
-        } else {
-            req.uri.push_back(input);
-            return boost::indeterminate;
-        }
-    case http_version_h:
-        if (input == 'H') {
-            state_ = http_version_t_1;
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_t_1:
-        if (input == 'T') {
-            state_ = http_version_t_2;
-            return boost::indeterminate;
-        } else {
+    req.method.clear();
+    req.uri.clear();
+    req.http_version_major = 0;
+    req.http_version_minor = 0;
+    req.headers.clear();
+    req.content.clear();
+    content_length_ = 0;
+}
+
+namespace {
+
+/// Returns position of c in [begin, end) or end if it is not found.
+const char* find_char(const char* begin, const char* end, char c)
+{
+    const void* found = memchr(begin, c, end - begin);
+    return found ? static_cast<const char*>(found) : end;
+}
+
+/// Parses decimal number without sign. Returns false on empty value, other characters or overflow.
+bool parse_size(boost::string_ref value, std::size_t* size)
+{
+    if ( value.empty() ) {
+        return false;
+    }
+    std::size_t result = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') {
             return false;
         }
-    case http_version_t_2:
-        if (input == 'T') {
-            state_ = http_version_p;
-            return boost::indeterminate;
-        } else {
+        const std::size_t digit = c - '0';
+        if ( result > (std::numeric_limits<std::size_t>::max() - digit) / 10 ) {
             return false;
         }
-    case http_version_p:
-        if (input == 'P') {
-            state_ = http_version_slash;
-            return boost::indeterminate;
-        } else {
-            return false;
+        result = result * 10 + digit;
+    }
+    *size = result;
+    return true;
+}
+
+/// Returns view of the same length which starts at ref.data() + offset.
+boost::string_ref moved(boost::string_ref ref, std::ptrdiff_t offset)
+{
+    return ref.empty() ? ref : boost::string_ref(ref.data() + offset, ref.size());
+}
+
+} // namespace anonymous
+
+boost::tuple<boost::tribool, const char*> request_parser::parse(Request& req, const char* begin, const char* end)
+{
+    boost::tribool result = boost::indeterminate;
+
+    if (state_ == request_head) {
+        const char* head_end = find_head_end(begin, end, result);
+        if (!result) {
+            return boost::make_tuple(result, begin);
         }
-    case http_version_slash:
-        if (input == '/') {
-            req.http_version_major = 0;
-            req.http_version_minor = 0;
-            state_ = http_version_major_start;
-            return boost::indeterminate;
-        } else {
-            return false;
+        if (!head_end) {
+            return boost::make_tuple(result, begin); // wait for the rest of headers, nothing is consumed.
         }
-    case http_version_major_start:
-        if ( is_digit(input) ) {
-            req.http_version_major = req.http_version_major * 10 + input - '0';
-            state_ = http_version_major;
-            return boost::indeterminate;
-        } else {
-            return false;
+
+        result = parse_head(req, begin, head_end);
+        if (result || !result) {
+            return boost::make_tuple(result, head_end);
         }
-    case http_version_major:
-        if (input == '.') {
-            state_ = http_version_minor_start;
-            return boost::indeterminate;
-        } else if ( is_digit(input) ) {
-            req.http_version_major = req.http_version_major * 10 + input - '0';
-            return boost::indeterminate;
-        } else {
-            return false;
+        begin = head_end;
+    }
+
+    if (state_ == content_multipart_formdata) {
+        return parse_mpfd(req, begin, end);
+    }
+
+    // copy all available content at once.
+    assert(state_ == content);
+    assert(req.content.size() < content_length_);
+    const std::size_t length = std::min<std::size_t>( end - begin, content_length_ - req.content.size() );
+    req.content.append(begin, length);
+    if (req.content.size() == content_length_) {
+        result = true; // all content has been consumed, stop parsing.
+    }
+    return boost::make_tuple(result, begin + length);
+}
+
+boost::tuple<boost::tribool, const char*> request_parser::parse_mpfd(Request& req, const char* begin, const char* end)
+{
+    assert (state_ == content_multipart_formdata);
+
+    if (content_consumed_ < content_length_) {
+        assert(begin <= end);
+        // do not consume data of next pipelined request.
+        const std::size_t length = std::min<std::size_t>( end - begin, content_length_ - content_consumed_ );
+        assert(req.mpfd_parser);
+        req.mpfd_parser->AcceptSomeData(begin, length);
+        content_consumed_ += length;
+        boost::tribool result = boost::indeterminate;
+        if (content_consumed_ == content_length_) {
+            result = true; // all content has been consumed, stop parsing.
         }
-    case http_version_minor_start:
-        if ( is_digit(input) ) {
-            req.http_version_minor = req.http_version_minor * 10 + input - '0';
-            state_ = http_version_minor;
-            return boost::indeterminate;
-        } else {
-            return false;
+        return boost::make_tuple(result, begin + length);
+    }
+    return boost::make_tuple(false, begin);
+}
+
+const char* request_parser::find_head_end(const char* begin, const char* end, boost::tribool& result)
+{
+    const char* line_begin = begin + head_scanned_;
+    for (;;) {
+        const char* line_feed = find_char(line_begin, end, '\n');
+        if (line_feed == end) {
+            head_scanned_ = line_begin - begin;
+            return nullptr;
         }
-    case http_version_minor:
-        if (input == '\r') {
-            state_ = expecting_newline_1;
-            return boost::indeterminate;
-        } else if ( is_digit(input) ) {
-            req.http_version_minor = req.http_version_minor * 10 + input - '0';
-            return boost::indeterminate;
-        } else {
-            return false;
+        if (line_feed == begin || line_feed[-1] != '\r') {
+            result = false;
+            return nullptr;
         }
-    case expecting_newline_1:
-        if (input == '\n') {
-            state_ = header_line_start;
-            return boost::indeterminate;
-        } else {
-            return false;
+        if (line_feed - line_begin == 1) {
+            return line_feed + 1; // empty line terminates headers.
         }
-    case header_line_start:
-        if (input == '\r') {
-            state_ = expecting_newline_3;
-            return boost::indeterminate;
-        } else if ( !req.headers.empty() && (input == ' ' || input == '\t') ) {
-            state_ = header_lws;
-            return boost::indeterminate;
-        } else if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
-            return false;
-        } else {
-            req.headers.push_back(header());
-            req.headers.back().name.push_back(input);
-            state_ = header_name;
-            return boost::indeterminate;
+        line_begin = line_feed + 1;
+    }
+}
+
+boost::tribool request_parser::parse_head(Request& req, const char* begin, const char* end)
+{
+    clear_request(req);
+    head_begin_ = begin;
+    head_size_ = end - begin;
+
+    // all lines are terminated by CRLF, this was checked by find_head_end().
+    const char* line_feed = find_char(begin, end, '\n');
+    if ( !parse_request_line(req, begin, line_feed - 1) ) {
+        return false;
+    }
+    for (const char* line_begin = line_feed + 1; ; line_begin = line_feed + 1) {
+        line_feed = find_char(line_begin, end, '\n');
+        if (line_feed - line_begin == 1) {
+            break; // empty line.
         }
-    case header_lws:
-        if (input == '\r') {
-            state_ = expecting_newline_2;
-            return boost::indeterminate;
-        } else if (input == ' ' || input == '\t') {
-            return boost::indeterminate;
-        } else if ( is_ctl(input) ) {
+        if ( !parse_header_line(req, line_begin, line_feed - 1) ) {
             return false;
-        } else {
-            state_ = header_value;
-            req.headers.back().value.push_back(input);
-            return boost::indeterminate;
         }
-    case header_name:
-        if (input == ':') {
-            state_ = space_before_header_value;
-            return boost::indeterminate;
-        } else if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
+    }
+
+    // Check for optional Content-Length header.
+    boost::string_ref value;
+    if ( !get_header_value(req.headers, kCONTENT_LENGTH_NAME, value) ) {
+        return true; // no Content-Length header, stop parsing.
+    }
+    if ( !parse_size(value, &content_length_) ) {
+        return false;
+    }
+    if (content_length_ == 0) {
+        return true; // empty content, stop parsing.
+    }
+
+    state_ = content;
+    if ( get_header_value(req.headers, kCONTENT_TYPE_NAME, value) && value.starts_with("multipart/form-data;") ) {
+        using namespace MPFD;
+        if ( !ParserFactory::instance() ) {
             return false;
-        } else {
-            req.headers.back().name.push_back(input);
-            return boost::indeterminate;
         }
-    case space_before_header_value:
-        if (input == ' ') {
-            state_ = header_value;
-            return boost::indeterminate;
-        } else {
+        req.mpfd_parser = ParserFactory::instance()->createParser( value.to_string() );
+        state_ = content_multipart_formdata;
+    }
+    return boost::indeterminate;
+}
+
+bool request_parser::parse_request_line(Request& req, const char* begin, const char* end)
+{
+    // method, it is terminated by single space.
+    const char* method_end = find_char(begin, end, ' ');
+    if (method_end == begin || method_end == end) {
+        return false;
+    }
+    for (const char* c = begin; c != method_end; ++c) {
+        if ( !is_char(*c) || is_ctl(*c) || is_tspecial(*c) ) {
             return false;
         }
-    case header_value:
-        if (input == '\r') {
-            state_ = expecting_newline_2;
-            return boost::indeterminate;
-        } else if ( is_ctl(input) ) {
+    }
+
+    // uri.
+    const char* uri_begin = method_end + 1;
+    const char* uri_end = find_char(uri_begin, end, ' ');
+    if (uri_end == end) {
+        return false;
+    }
+    for (const char* c = uri_begin; c != uri_end; ++c) {
+        if ( is_ctl(*c) ) {
             return false;
-        } else {
-            req.headers.back().value.push_back(input);
-            return boost::indeterminate;
         }
-    case expecting_newline_2:
-        if (input == '\n') {
-            state_ = header_line_start;
-            return boost::indeterminate;
-        } else {
+    }
+
+    // version.
+    static const char http_prefix[] = "HTTP/";
+    const std::size_t http_prefix_length = sizeof(http_prefix) - 1;
+    const char* p = uri_end + 1;
+    if ( static_cast<std::size_t>(end - p) < http_prefix_length || !std::equal(http_prefix, http_prefix + http_prefix_length, p) ) {
+        return false;
+    }
+    p += http_prefix_length;
+
+    int major = 0;
+    const char* major_begin = p;
+    for (; p != end && is_digit(*p) && major < 1000; ++p) {
+        major = major * 10 + *p - '0';
+    }
+    if (p == major_begin || p == end || *p != '.') {
+        return false;
+    }
+    ++p;
+
+    int minor = 0;
+    const char* minor_begin = p;
+    for (; p != end && is_digit(*p) && minor < 1000; ++p) {
+        minor = minor * 10 + *p - '0';
+    }
+    if (p == minor_begin || p != end) {
+        return false;
+    }
+
+    req.method = boost::string_ref(begin, method_end - begin);
+    req.uri = boost::string_ref(uri_begin, uri_end - uri_begin);
+    req.http_version_major = major;
+    req.http_version_minor = minor;
+    return true;
+}
+
+bool request_parser::parse_header_line(Request& req, const char* begin, const char* end)
+{
+    // obsolete line folding is rejected as RFC 7230 allows: value would have to be copied to join lines.
+    const char* name_end = find_char(begin, end, ':');
+    if (name_end == begin || name_end == end) {
+        return false;
+    }
+    for (const char* c = begin; c != name_end; ++c) {
+        if ( !is_char(*c) || is_ctl(*c) || is_tspecial(*c) ) {
             return false;
         }
-    case expecting_newline_3:
-        if (input == '\n') {
-            // Check for optional Content-Length header.
-            const std::string* content_length_value;
-            if (get_header_value(req.headers, content_length_name_, content_length_value)) {
-                try {
-                    content_length_ = boost::lexical_cast<std::size_t>(*content_length_value);
-                    state_ = select_content_parser;
-                    return boost::indeterminate;
-                } catch (boost::bad_lexical_cast&) {
-                    return false;
-                }
-            }
-            
-            return true; // no Content-Length header, stop parsing.           
-        } else {
+    }
+
+    // single space is required before value.
+    const char* value_begin = name_end + 1;
+    if (value_begin == end || *value_begin != ' ') {
+        return false;
+    }
+    ++value_begin;
+    for (const char* c = value_begin; c != end; ++c) {
+        if ( is_ctl(*c) ) {
             return false;
         }
-    case select_content_parser: {
-        state_ = content;
-
-        const std::string* content_type_value;
-        if (get_header_value(req.headers, content_type_name, content_type_value)) {
-            if (boost::starts_with(*content_type_value, "multipart/form-data;")) {
-                using namespace MPFD;
-                if (ParserFactory::instance()) {
-                    req.mpfd_parser = ParserFactory::instance()->createParser(*content_type_value);
-                    state_ = content_multipart_formdata;
-                    return boost::indeterminate;
-                } else {
-                    return false;
-                }
-            }
-        }
+    }
 
-        return consume(req, input);
-                                }
-    case content:
-        // Content.
-        if (req.content.size() < content_length_) {
-            req.content.push_back(input);
-            if (req.content.size() == content_length_) {
-                return true;  // all content has been consumed, stop parsing.
-            }
-            return boost::indeterminate;
-        }
-        return false;
-    case content_multipart_formdata:
-        assert(!"mpfd must not be processed by one char");
-        return false;
-    default:
-        return false;
+    req.headers.push_back( header_ref() );
+    req.headers.back().name = boost::string_ref(begin, name_end - begin);
+    req.headers.back().value = boost::string_ref(value_begin, end - value_begin);
+    return true;
+}
+
+void request_parser::move_head(Request& req, const char* new_begin)
+{
+    const std::ptrdiff_t offset = new_begin - head_begin_;
+    req.method = moved(req.method, offset);
+    req.uri = moved(req.uri, offset);
+    for (header_ref& h : req.headers) {
+        h.name = moved(h.name, offset);
+        h.value = moved(h.value, offset);
     }
+    head_begin_ = new_begin;
 }
 
 bool request_parser::is_char(int c)
@@ -322,7 +356,7 @@ bool headers_equal(const std::string& a, const std::string& b)
 bool get_header_value(const std::vector<header>& headers, const std::string& header_name, const std::string*& header_value)
 {
     const auto header_it = std::find_if(headers.begin(), headers.end(),
-                                        [header_name](const header& h) { return headers_equal(h.name, header_name); }
+                                        [&header_name](const header& h) { return headers_equal(h.name, header_name); }
                                         );
     if (header_it != headers.end()) {
         header_value = &(header_it->value);
@@ -331,5 +365,15 @@ bool get_header_value(const std::vector<header>& headers, const std::string& hea
     return false;
 }
 
+bool get_header_value(const std::vector<header_ref>& headers, boost::string_ref header_name, boost::string_ref& header_value)
+{
+    for (const header_ref& h : headers) {
+        if ( h.name.size() == header_name.size() && std::equal(h.name.begin(), h.name.end(), header_name.begin(), &tolower_compare) ) {
+            header_value = h.value;
+            return true;
+        }
+    }
+    return false;
+}
 
 } // namespace Http
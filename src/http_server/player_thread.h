@@ -0,0 +1,46 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace Http
+{
+
+/*!
+    \brief io_service of AIMP player's thread. Player's thread polls io_service on tick,
+    so handler posted here from network thread also wakes player's thread: request does not wait for next tick.
+*/
+class PlayerThread : private boost::noncopyable
+{
+public:
+
+    //! Function must be thread safe, it asks player's thread to poll io_service as soon as possible.
+    typedef boost::function<void()> WakeFunction;
+
+    PlayerThread(boost::asio::io_service& io_service, WakeFunction wake)
+        :
+        io_service_(io_service),
+        wake_(wake)
+    {}
+
+    boost::asio::io_service& io_service()
+        { return io_service_; }
+
+    //! Posts handler to player's thread and wakes it.
+    template <typename Handler>
+    void post(Handler handler)
+    {
+        io_service_.post(handler);
+        wake_();
+    }
+
+private:
+
+    boost::asio::io_service& io_service_;
+    WakeFunction wake_;
+};
+
+} // namespace Http
@@ -12,43 +12,51 @@ namespace Http {
 
 namespace status_strings {
 
+const std::string switching_protocols =
+"HTTP/1.1 101 Switching Protocols\r\n";
 const std::string ok =
-"HTTP/1.0 200 OK\r\n";
+"HTTP/1.1 200 OK\r\n";
 const std::string created =
-"HTTP/1.0 201 Created\r\n";
+"HTTP/1.1 201 Created\r\n";
 const std::string accepted =
-"HTTP/1.0 202 Accepted\r\n";
+"HTTP/1.1 202 Accepted\r\n";
 const std::string no_content =
-"HTTP/1.0 204 No Content\r\n";
+"HTTP/1.1 204 No Content\r\n";
+const std::string partial_content =
+"HTTP/1.1 206 Partial Content\r\n";
 const std::string multiple_choices =
-"HTTP/1.0 300 Multiple Choices\r\n";
+"HTTP/1.1 300 Multiple Choices\r\n";
 const std::string moved_permanently =
-"HTTP/1.0 301 Moved Permanently\r\n";
+"HTTP/1.1 301 Moved Permanently\r\n";
 const std::string moved_temporarily =
-"HTTP/1.0 302 Moved Temporarily\r\n";
+"HTTP/1.1 302 Moved Temporarily\r\n";
 const std::string not_modified =
-"HTTP/1.0 304 Not Modified\r\n";
+"HTTP/1.1 304 Not Modified\r\n";
 const std::string bad_request =
-"HTTP/1.0 400 Bad Request\r\n";
+"HTTP/1.1 400 Bad Request\r\n";
 const std::string unauthorized =
-"HTTP/1.0 401 Unauthorized\r\n";
+"HTTP/1.1 401 Unauthorized\r\n";
 const std::string forbidden =
-"HTTP/1.0 403 Forbidden\r\n";
+"HTTP/1.1 403 Forbidden\r\n";
 const std::string not_found =
-"HTTP/1.0 404 Not Found\r\n";
+"HTTP/1.1 404 Not Found\r\n";
+const std::string requested_range_not_satisfiable =
+"HTTP/1.1 416 Requested Range Not Satisfiable\r\n";
 const std::string internal_server_error =
-"HTTP/1.0 500 Internal Server Error\r\n";
+"HTTP/1.1 500 Internal Server Error\r\n";
 const std::string not_implemented =
-"HTTP/1.0 501 Not Implemented\r\n";
+"HTTP/1.1 501 Not Implemented\r\n";
 const std::string bad_gateway =
-"HTTP/1.0 502 Bad Gateway\r\n";
+"HTTP/1.1 502 Bad Gateway\r\n";
 const std::string service_unavailable =
-"HTTP/1.0 503 Service Unavailable\r\n";
+"HTTP/1.1 503 Service Unavailable\r\n";
 
 boost::asio::const_buffer to_buffer(Reply::status_type status)
 {
     switch (status)
     {
+    case Reply::switching_protocols:
+        return boost::asio::buffer(switching_protocols);
     case Reply::ok:
         return boost::asio::buffer(ok);
     case Reply::created:
@@ -57,6 +65,8 @@ boost::asio::const_buffer to_buffer(Reply::status_type status)
         return boost::asio::buffer(accepted);
     case Reply::no_content:
         return boost::asio::buffer(no_content);
+    case Reply::partial_content:
+        return boost::asio::buffer(partial_content);
     case Reply::multiple_choices:
         return boost::asio::buffer(multiple_choices);
     case Reply::moved_permanently:
@@ -73,6 +83,8 @@ boost::asio::const_buffer to_buffer(Reply::status_type status)
         return boost::asio::buffer(forbidden);
     case Reply::not_found:
         return boost::asio::buffer(not_found);
+    case Reply::requested_range_not_satisfiable:
+        return boost::asio::buffer(requested_range_not_satisfiable);
     case Reply::internal_server_error:
         return boost::asio::buffer(internal_server_error);
     case Reply::not_implemented:
@@ -98,10 +110,33 @@ const char crlf[] = { '\r', '\n' };
 std::vector<boost::asio::const_buffer> Reply::to_buffers() const
 {
     std::vector<boost::asio::const_buffer> buffers( to_buffers_headers_only() ); // make code simple: rely on move semantic.
-    buffers.push_back(boost::asio::buffer(content));
+    if ( !content_chunks.empty() ) {
+        for (const std::string& chunk : content_chunks) {
+            buffers.push_back(boost::asio::buffer(chunk));
+        }
+    } else if (shared_content) {
+        buffers.push_back(boost::asio::buffer(*shared_content));
+    } else {
+        buffers.push_back(boost::asio::buffer(content));
+    }
     return buffers;
 }
 
+std::size_t Reply::content_size() const
+{
+    if ( !content_chunks.empty() ) {
+        std::size_t size = 0;
+        for (const std::string& chunk : content_chunks) {
+            size += chunk.size();
+        }
+        return size;
+    }
+    if (shared_content) {
+        return shared_content->size();
+    }
+    return content.size();
+}
+
 std::vector<boost::asio::const_buffer> Reply::to_buffers_headers_only() const
 {
     std::vector<boost::asio::const_buffer> buffers;
@@ -119,6 +154,7 @@ std::vector<boost::asio::const_buffer> Reply::to_buffers_headers_only() const
 
 namespace stock_replies {
 
+const char switching_protocols[] = "";
 const char ok[] = "";
 const char created[] =
 "<html>"
@@ -135,6 +171,7 @@ const char no_content[] =
 "<head><title>No Content</title></head>"
 "<body><h1>204 Content</h1></body>"
 "</html>";
+const char partial_content[] = "";
 const char multiple_choices[] =
 "<html>"
 "<head><title>Multiple Choices</title></head>"
@@ -175,6 +212,11 @@ const char not_found[] =
 "<head><title>Not Found</title></head>"
 "<body><h1>404 Not Found</h1></body>"
 "</html>";
+const char requested_range_not_satisfiable[] =
+"<html>"
+"<head><title>Requested Range Not Satisfiable</title></head>"
+"<body><h1>416 Requested Range Not Satisfiable</h1></body>"
+"</html>";
 const char internal_server_error[] =
 "<html>"
 "<head><title>Internal Server Error</title></head>"
@@ -200,6 +242,8 @@ std::string to_string(Reply::status_type status)
 {
     switch (status)
     {
+    case Reply::switching_protocols:
+        return switching_protocols;
     case Reply::ok:
         return ok;
     case Reply::created:
@@ -208,6 +252,8 @@ std::string to_string(Reply::status_type status)
         return accepted;
     case Reply::no_content:
         return no_content;
+    case Reply::partial_content:
+        return partial_content;
     case Reply::multiple_choices:
         return multiple_choices;
     case Reply::moved_permanently:
@@ -224,6 +270,8 @@ std::string to_string(Reply::status_type status)
         return forbidden;
     case Reply::not_found:
         return not_found;
+    case Reply::requested_range_not_satisfiable:
+        return requested_range_not_satisfiable;
     case Reply::internal_server_error:
         return internal_server_error;
     case Reply::not_implemented:
@@ -8,7 +8,10 @@
 
 #include <string>
 #include <vector>
+#include <list>
 #include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
 #include "http_server/header.h"
 
 namespace Http {
@@ -19,10 +22,12 @@ struct Reply
     /// The status of the reply.
     enum status_type
     {
+        switching_protocols = 101,
         ok = 200,
         created = 201,
         accepted = 202,
         no_content = 204,
+        partial_content = 206,
         multiple_choices = 300,
         moved_permanently = 301,
         moved_temporarily = 302,
@@ -31,6 +36,7 @@ struct Reply
         unauthorized = 401,
         forbidden = 403,
         not_found = 404,
+        requested_range_not_satisfiable = 416,
         internal_server_error = 500,
         not_implemented = 501,
         bad_gateway = 502,
@@ -43,9 +49,37 @@ struct Reply
     /// The content to be sent in the reply.
     std::string content;
 
+    /// The content split into chunks(for example, by compressor). If not empty it is sent instead 'content'.
+    std::list<std::string> content_chunks;
+
+    /// Immutable content shared with other replies, for example, cached static file. If set it is sent instead 'content'.
+    boost::shared_ptr<const std::string> shared_content;
+
+    /// Get size of content to be sent.
+    std::size_t content_size() const;
+
     /// The name of file to be sent in the reply instead 'content'. Used for effective sending large files.
     std::wstring filename;
 
+    /// Part of file 'filename' to be sent.
+    struct FileRange
+    {
+        boost::uint64_t offset;
+        boost::uint64_t length;
+        std::string head; ///< data sent before file data, for example, part header of multipart/byteranges content.
+
+        FileRange(boost::uint64_t offset, boost::uint64_t length, const std::string& head = std::string())
+            : offset(offset), length(length), head(head)
+        {}
+    };
+    typedef std::vector<FileRange> FileRanges;
+
+    /// Parts of file 'filename' to be sent in order.
+    FileRanges file_ranges;
+
+    /// Data sent after all file ranges, for example, closing boundary of multipart/byteranges content.
+    std::string file_tail;
+
     /// Convert the reply into a vector of buffers. The buffers do not own the
     /// underlying memory blocks, therefore the reply object must remain valid and
     /// not be changed until the write operation has completed.
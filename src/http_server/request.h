@@ -8,19 +8,21 @@
 
 #include <string>
 #include <vector>
+#include <boost/utility/string_ref.hpp>
 #include "http_server/header.h"
 #include "http_server/mpfd_parser/Parser.h"
 
 namespace Http {
 
 /// A request received from a client.
+/// Method, uri and headers refer to data in connection's buffer, they are valid until connection starts to parse next request.
 struct Request
 {
     /// The request method, e.g. "GET", "POST".
-    std::string method;
+    boost::string_ref method;
 
     /// The requested URI, such as a path to a file.
-    std::string uri;
+    boost::string_ref uri;
 
     /// Major version number, usually 1.
     int http_version_major;
@@ -29,7 +31,7 @@ struct Request
     int http_version_minor;
 
     /// The headers included with the request.
-    std::vector<header> headers;
+    std::vector<header_ref> headers;
 
     /// The optional content sent with the request.
     std::string content;
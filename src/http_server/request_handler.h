@@ -16,6 +16,7 @@
 // headers for DelayedResponseSender class
 #include <boost/enable_shared_from_this.hpp>
 #include "http_server/auth_manager.h"
+#include "http_server/static_file_cache.h"
 
 namespace Rpc           { class RequestHandler; }
 namespace DownloadTrack { class RequestHandler; }
@@ -41,6 +42,7 @@ public:
                             UploadTrack::RequestHandler& upload_track_request_handler)
         :
         document_root_(document_root),
+        static_file_cache_(document_root),
         rpc_request_handler_(rpc_request_handler),
         download_track_request_handler_(download_track_request_handler),
         upload_track_request_handler_(upload_track_request_handler)
@@ -52,12 +54,35 @@ public:
     */
     bool handle_request(const Request& req, Reply& rep, ICometDelayedConnection_ptr connection);
 
+    /*
+        Return true if request handling uses AIMP player(RPC call, track downloading/uploading).
+        Such requests must be handled in player's thread, all others can be handled in any network thread.
+    */
+    bool needs_player_thread(const Request& req);
+
+    /*
+        Handle RPC request received in WebSocket message. uri is URI of WebSocket handshake request, it selects RPC frontend.
+        Return true if response should be sent to client immediately, false if response will be sent later through connection.
+        Called in player's thread.
+    */
+    bool handle_websocket_message(const std::string& uri, const std::string& message, ICometDelayedConnection_ptr connection, std::string* response);
+
+    /*
+        Compress reply content if client accepts gzip or deflate coding.
+        Small replies and replies of already compressed formats are not changed.
+        Called by connection in network thread before sending of reply.
+    */
+    void compress_reply(const Request& req, Reply& rep);
+
 private:
 
     void handle_file_request(const Request& req, Reply& rep);
 
+    //! Fills reply with cached file content or with "304 Not Modified" if client has actual version of file.
+    void fillReplyWithStaticFile(const Request& req, const StaticFile_ptr& file, Reply& rep);
+
     // Perform URL-decoding on a string. \return false if the encoding was invalid.
-    static bool url_decode(const std::string& in, std::string& out);
+    static bool url_decode(boost::string_ref in, std::string& out);
 
     /*
         Fill headers of reply with content.
@@ -67,11 +92,17 @@ private:
 
     void fillAuthFailReply(Reply& rep);
 
+    //! Fills reply on WebSocket handshake request: "101 Switching Protocols" or "400 Bad Request" if protocol version is not supported.
+    void fillWebSocketHandshakeReply(const Request& req, Reply& rep);
+
     void trySendInitCookies(const Request& req, Reply& rep);
 
     // The directory containing the files to be served.
     std::string document_root_;
 
+    // Cache of files from document root.
+    StaticFileCache static_file_cache_;
+
     Authentication::AuthManager auth_manager_;
 
     Rpc::RequestHandler& rpc_request_handler_;
@@ -92,9 +123,19 @@ public:
         http_request_handler_(http_request_handler)
     {}
 
-    void send(const std::string& response, const std::string& response_content_type);
+    /// Response is moved to reply, large responses are not copied.
+    void send(std::string&& response, const std::string& response_content_type);
+
+    /// Return true if many responses can be sent through this sender.
+    bool persistent() const
+        { return comet_connection_->persistent(); }
+
+    /// Return true if connection of persistent sender is closed.
+    bool closed() const
+        { return comet_connection_->closed(); }
 
     const Reply& get_reply() const;
+    Reply& get_reply();
 
 private:
 
@@ -7,15 +7,22 @@
 #define HTTP_REQUEST_PARSER_H
 
 #include <string>
+#include <vector>
 #include <boost/logic/tribool.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/utility/string_ref.hpp>
 
 namespace Http {
 
 struct Request;
 struct header;
+struct header_ref;
 
-/// Parser for incoming requests.
+/*!
+    Parser for incoming requests.
+    Request line and headers are parsed only when they are received completely. Method, uri and headers of request
+    are not copied: they refer to the parsed data, so caller must keep it while request is handled.
+*/
 class request_parser
 {
 public:
@@ -27,66 +34,41 @@ public:
 
     /// Parse some data. The tribool return value is true when a complete request
     /// has been parsed, false if the data is invalid, indeterminate when more
-    /// data is required. The InputIterator return value indicates how much of the
-    /// input has been consumed.
-    template <typename InputIterator>
-    boost::tuple<boost::tribool, InputIterator> parse(Request& req,
-                                                      InputIterator begin,
-                                                      InputIterator end)
-    {
-        switch (state_) {
-        case content_multipart_formdata:
-            return parse_mpfd(req, begin, end);
-        default:
-            while (begin != end) {
-                boost::tribool result = consume(req, *begin++);
-                if (result || !result) {
-                    return boost::make_tuple(result, begin);
-                }
-
-                if (state_ == content_multipart_formdata) {
-                    return parse_mpfd(req, --begin, end);
-                }
-            }
-            break;
-        }
-
-        boost::tribool result = boost::indeterminate;
-        return boost::make_tuple(result, begin);
-    }
+    /// data is required. The pointer return value indicates how much of the
+    /// input has been consumed. Incomplete request line and headers are not consumed:
+    /// caller must pass them again together with the rest of data.
+    boost::tuple<boost::tribool, const char*> parse(Request& req, const char* begin, const char* end);
+
+    /// Returns true if request line and headers are parsed and parser consumes content now.
+    bool head_parsed() const
+        { return state_ != request_head; }
+
+    /// Returns request line and headers of current request. Valid if head_parsed() is true.
+    boost::string_ref head() const
+        { return boost::string_ref(head_begin_, head_size_); }
+
+    /// Rebinds method, uri and headers of request after caller has moved head() data to new_begin.
+    void move_head(Request& req, const char* new_begin);
 
 private:
 
-    template <typename InputIterator>
-    boost::tuple<boost::tribool, InputIterator> parse_mpfd(Request& req,
-                                                           InputIterator begin,
-                                                           InputIterator end)
-    {
-        assert (state_ == content_multipart_formdata);
-
-        if (content_consumed_ < content_length_) {   
-            assert(begin <= end);
-            const std::size_t length = std::distance(begin, end);
-            assert(req.mpfd_parser);
-            req.mpfd_parser->AcceptSomeData(begin, length);
-            content_consumed_ += length;
-            boost::tribool result = boost::indeterminate;
-            if (content_consumed_ == content_length_) {
-                result = true; // all content has been consumed, stop parsing.
-            }
-            return boost::make_tuple(result, end);
-        }
-        return boost::make_tuple(false, begin);
-    }
-
-    /// The name of the content length header.
-    static std::string content_length_name_;
+    boost::tuple<boost::tribool, const char*> parse_mpfd(Request& req, const char* begin, const char* end);
 
-    /// Content length as decoded from headers. Defaults to 0.
-    std::size_t content_length_;
+    /// Returns end of headers(position after empty line) or null if headers are not complete yet.
+    /// Sets result to false if line is not terminated by CRLF.
+    const char* find_head_end(const char* begin, const char* end, boost::tribool& result);
+
+    /// Parse complete request line and headers [begin, end). Returns true if request has no content.
+    boost::tribool parse_head(Request& req, const char* begin, const char* end);
 
-    /// Handle the next character of input.
-    boost::tribool consume(Request& req, char input);
+    /// Parse request line [begin, end) without trailing CRLF.
+    bool parse_request_line(Request& req, const char* begin, const char* end);
+
+    /// Parse header line [begin, end) without trailing CRLF.
+    bool parse_header_line(Request& req, const char* begin, const char* end);
+
+    /// Prepare request for parsing. Capacity of request strings and headers vector is kept.
+    void clear_request(Request& req);
 
     /// Check if a byte is an HTTP character.
     static bool is_char(int c);
@@ -103,37 +85,29 @@ private:
     /// The current state of the parser.
     enum state
     {
-        method_start,
-        method,
-        uri_start,
-        uri,
-        http_version_h,
-        http_version_t_1,
-        http_version_t_2,
-        http_version_p,
-        http_version_slash,
-        http_version_major_start,
-        http_version_major,
-        http_version_minor_start,
-        http_version_minor,
-        expecting_newline_1,
-        header_line_start,
-        header_lws,
-        header_name,
-        space_before_header_value,
-        header_value,
-        expecting_newline_2,
-        expecting_newline_3,
-        select_content_parser,
+        request_head,
         content,
         content_multipart_formdata
     } state_;
 
+    /// Count of bytes of incomplete head which contain complete lines, they are not searched for end of headers again.
+    std::size_t head_scanned_;
+
+    /// Request line and headers of current request.
+    const char* head_begin_;
+    std::size_t head_size_;
+
+    /// Content length as decoded from headers. Defaults to 0.
+    std::size_t content_length_;
+
     std::size_t content_consumed_;
 };
 
 bool get_header_value(const std::vector<header>& headers, const std::string& header_name, const std::string*& header_value);
 
+/// Finds value of request header. Name comparison is case insensitive.
+bool get_header_value(const std::vector<header_ref>& headers, boost::string_ref header_name, boost::string_ref& header_value);
+
 } // namespace Http
 
 #endif // HTTP_REQUEST_PARSER_H
@@ -15,6 +15,7 @@
 #include <iterator>
 
 #include "connection.cpp"
+#include "websocket_connection.cpp"
 
 #include <winsock2.h>
 #include <iphlpapi.h>
@@ -56,10 +57,13 @@ struct Endpoint
 
 std::set<Endpoint> getEndpointsFromSettings();
 
-Server::Server( boost::asio::io_service& io_service, RequestHandler& request_handler)
+Server::Server( boost::asio::io_service& io_service, PlayerThread& player_thread, RequestHandler& request_handler)
     :
     io_service_(io_service),
-    request_handler_(request_handler)
+    player_thread_(player_thread),
+    request_handler_(request_handler),
+    connection_pool_ip_tcp_( boost::make_shared<ConnectionIpTcpPool>( io_service, player_thread, request_handler ) ),
+    connection_pool_bluetooth_( boost::make_shared<ConnectionBluetoothRfcommPool>( io_service, player_thread, request_handler ) )
 {
     std::set<Endpoint> endpoints = getEndpointsFromSettings();
     for (auto endpoint : endpoints) {
@@ -139,14 +143,19 @@ void Server::start_accept_connections_on(boost::asio::ip::tcp::endpoint endpoint
     acceptor->bind(endpoint);
     acceptor->listen();
 
+    start_accept(acceptor);
+}
+
+void Server::start_accept(IpTcpConnectionAcceptor_ptr acceptor)
+{
     // The next connection to be accepted.
-    ConnectionIpTcp_ptr next_connection( new ConnectionIpTcp(io_service_, request_handler_) );
+    ConnectionIpTcp_ptr next_connection = connection_pool_ip_tcp_->acquire();
     acceptor->async_accept( next_connection->socket(),
                             boost::bind(&Server::handle_accept,
                                         this,
                                         acceptor,
                                         next_connection,
-                                        placeholders::error)
+                                        boost::asio::placeholders::error)
                            );
 }
 
@@ -154,24 +163,20 @@ void Server::handle_accept(IpTcpConnectionAcceptor_ptr acceptor,
                            ConnectionIpTcp_ptr accepted_connection,
                            const boost::system::error_code& e)
 {
-    const boost::asio::ip::tcp::socket::endpoint_type& endpoint = accepted_connection->socket().remote_endpoint();
-    BOOST_LOG_SEV(logger(), info) << "Connection accepted from remote host " << endpoint;
-
     if (!e) {
+        boost::system::error_code ec;
+        const boost::asio::ip::tcp::socket::endpoint_type endpoint = accepted_connection->socket().remote_endpoint(ec);
+        BOOST_LOG_SEV(logger(), info) << "Connection accepted from remote host " << endpoint;
+
         accepted_connection->start();
-        //BOOST_LOG_SEV(logger(), debug) << "Client connection started";
-        ConnectionIpTcp_ptr new_connection( new ConnectionIpTcp(io_service_, request_handler_) );
-        acceptor->async_accept(new_connection->socket(),
-                               boost::bind(&Server::handle_accept,
-                                           this,
-                                           acceptor,
-                                           new_connection,
-                                           boost::asio::placeholders::error)
-                              );
-        //BOOST_LOG_SEV(logger(), debug) << "Continue to wait for client connection";
+    } else if (e == boost::asio::error::operation_aborted || !acceptor->is_open()) {
+        return; // server is stopped.
     } else {
+        // client could reset connection before it was accepted, keep listening anyway.
         BOOST_LOG_SEV(logger(), error) << "Error in "__FUNCTION__": " << e;
     }
+
+    start_accept(acceptor);
 }
 
 namespace
@@ -326,7 +331,7 @@ void Server::open_bluetooth_socket()
     acceptor->bind(endpoint);
     acceptor->listen();
     
-    ConnectionBluetoothRfcomm_ptr new_connection( new ConnectionBluetoothRfcomm(io_service_, request_handler_) );
+    ConnectionBluetoothRfcomm_ptr new_connection = connection_pool_bluetooth_->acquire();
     acceptor->async_accept( new_connection->socket(),
                             boost::bind(&Server::handle_accept_bluetooth,
                                         this,
@@ -348,7 +353,7 @@ void Server::handle_accept_bluetooth(BluetoothConnectionAcceptor_ptr acceptor,
     if (!e) {
         accepted_connection->start();
         BOOST_LOG_SEV(logger(), debug) << "Client connection started";
-        ConnectionBluetoothRfcomm_ptr new_connection( new ConnectionBluetoothRfcomm(io_service_, request_handler_) );
+        ConnectionBluetoothRfcomm_ptr new_connection = connection_pool_bluetooth_->acquire();
         acceptor->async_accept( new_connection->socket(),
                                 boost::bind(&Server::handle_accept_bluetooth,
                                             this,
@@ -7,6 +7,7 @@
 #define HTTP_SERVER_H
 
 #include "connection.h"
+#include "connection_pool.h"
 
 #define BLUETOOTH_ENABLED // move it to config
 #include "transport/asio/bluetooth_endpoint.hpp"
@@ -21,6 +22,9 @@ typedef boost::shared_ptr<ConnectionBluetoothRfcomm> ConnectionBluetoothRfcomm_p
 typedef Connection<boost::asio::ip::tcp::socket> ConnectionIpTcp;
 typedef boost::shared_ptr<ConnectionIpTcp> ConnectionIpTcp_ptr;
 
+typedef ConnectionPool<ConnectionBluetoothRfcomm> ConnectionBluetoothRfcommPool;
+typedef ConnectionPool<ConnectionIpTcp> ConnectionIpTcpPool;
+
 typedef boost::asio::bluetooth::rfcomm::acceptor BluetoothConnectionAcceptor;
 typedef boost::shared_ptr<BluetoothConnectionAcceptor> BluetoothConnectionAcceptor_ptr;
 
@@ -36,8 +40,10 @@ class Server : private boost::noncopyable
 public:
     /*
         Construct the server to listen on the specified TCP address and port.
+        io_service is used for network I/O and can be run by several threads.
+        player_thread is AIMP player's thread, requests which access AIMP are handled there.
     */
-    Server(boost::asio::io_service& io_service, RequestHandler& request_handler); // throws std::runtime_error.
+    Server(boost::asio::io_service& io_service, PlayerThread& player_thread, RequestHandler& request_handler); // throws std::runtime_error.
 
     ~Server();
 
@@ -57,6 +63,9 @@ private:
 
     void start_accept_connections_on(boost::asio::ip::tcp::endpoint endpoint);
 
+    // Start asynchronous accept operation on acceptor(ip::tcp).
+    void start_accept(IpTcpConnectionAcceptor_ptr acceptor);
+
     void open_bluetooth_socket(); // throws std::runtime_error.
 
     void register_bluetooth_service(BluetoothConnectionAcceptor_ptr acceptor); // throws std::runtime_error.
@@ -64,8 +73,15 @@ private:
     // The io_service used to perform asynchronous operations.
     boost::asio::io_service& io_service_;
 
+    // AIMP player's thread.
+    PlayerThread& player_thread_;
+
     // The handler for all incoming requests.
     RequestHandler& request_handler_;
+
+    // Pools of connections, closed connections are reused for new clients.
+    boost::shared_ptr<ConnectionIpTcpPool> connection_pool_ip_tcp_;
+    boost::shared_ptr<ConnectionBluetoothRfcommPool> connection_pool_bluetooth_;
 };
 
 } // namespace Http
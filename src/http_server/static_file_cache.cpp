@@ -0,0 +1,236 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "http_server/static_file_cache.h"
+#include "http_server/compression.h"
+#include "http_server/mime_types.h"
+#include "http_server/server.h"
+#include "plugin/logger.h"
+#include "utils/util.h"
+#include <fstream>
+
+namespace Http {
+
+namespace {
+using namespace ControlPlugin::PluginLogger;
+ModuleLoggerType& logger()
+    { return getLogManager().getModuleLogger<Server>(); }
+
+std::string makeEntityTag(const std::string& content, const char* suffix)
+{
+    std::ostringstream os;
+    os << '"' << std::hex << Utilities::crc32(content) << '-' << content.size() << suffix << '"';
+    return os.str();
+}
+
+//! Returns month index(0-11) by its three letter name or -1 if name is unknown.
+int monthIndex(const std::string& name)
+{
+    static const char* const kMONTHS[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    for (int i = 0; i != 12; ++i) {
+        if (name == kMONTHS[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace anonymous
+
+std::string formatHttpDate(std::time_t time)
+{
+    std::tm tm_utc;
+    if (gmtime_s(&tm_utc, &time) != 0) {
+        return std::string();
+    }
+    char buffer[64];
+    const std::size_t length = std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    return std::string(buffer, length);
+}
+
+bool parseHttpDate(const std::string& value, std::time_t* time)
+{
+    // "Sun, 06 Nov 1994 08:49:37 GMT", "Sunday, 06-Nov-94 08:49:37 GMT" or "Sun Nov  6 08:49:37 1994".
+    const bool asctime_format = value.find(',') == std::string::npos;
+    std::string fields(value);
+    std::replace_if(fields.begin(), fields.end(), [](char c) { return c == ',' || c == '-' || c == ':'; }, ' ');
+
+    std::istringstream is(fields);
+    std::string weekday, month, zone;
+    std::tm tm = {};
+    is >> weekday;
+    if (asctime_format) {
+        is >> month >> tm.tm_mday >> tm.tm_hour >> tm.tm_min >> tm.tm_sec >> tm.tm_year;
+    } else {
+        is >> tm.tm_mday >> month >> tm.tm_year >> tm.tm_hour >> tm.tm_min >> tm.tm_sec >> zone;
+    }
+    if ( !is || (!asctime_format && zone != "GMT") ) {
+        return false;
+    }
+
+    tm.tm_mon = monthIndex(month);
+    if (tm.tm_mon < 0
+        || tm.tm_mday < 1 || tm.tm_mday > 31
+        || tm.tm_hour < 0 || tm.tm_hour > 23
+        || tm.tm_min < 0 || tm.tm_min > 59
+        || tm.tm_sec < 0 || tm.tm_sec > 60 // leap second.
+        || tm.tm_year < 0
+        )
+    {
+        return false;
+    }
+    if (tm.tm_year < 100) { // RFC 850 two digit year.
+        tm.tm_year += tm.tm_year < 70 ? 2000 : 1900;
+    }
+    tm.tm_year -= 1900;
+
+    const std::time_t result = _mkgmtime(&tm);
+    if (result == -1) {
+        return false;
+    }
+    *time = result;
+    return true;
+}
+
+namespace fs = boost::filesystem;
+
+StaticFileCache::StaticFileCache(const std::string& document_root)
+    :
+    document_root_(document_root),
+    memory_usage_(0)
+{
+    preload();
+}
+
+void StaticFileCache::preload()
+{
+    try {
+        const fs::path root(document_root_);
+        for (fs::recursive_directory_iterator it(root), end; it != end; ++it) {
+            if ( fs::is_regular_file( it->status() ) ) {
+                std::string request_path = it->path().string().substr( root.string().size() );
+                std::replace(request_path.begin(), request_path.end(), '\\', '/');
+                if (request_path.empty() || request_path[0] != '/') {
+                    request_path.insert(0, 1, '/');
+                }
+
+                boost::system::error_code ec;
+                const boost::uintmax_t size = fs::file_size(it->path(), ec);
+                const std::time_t last_write_time = !ec ? fs::last_write_time(it->path(), ec) : 0;
+                if (!ec) {
+                    reload(request_path, size, last_write_time);
+                }
+            }
+        }
+    } catch (std::exception& e) {
+        BOOST_LOG_SEV(logger(), error) << "Static files preloading failed. Reason: " << e.what();
+    }
+
+    BOOST_LOG_SEV(logger(), info) << "Static files cache: " << files_.size() << " files, " << memory_usage_ << " bytes.";
+}
+
+StaticFile_ptr StaticFileCache::get(const std::string& request_path)
+{
+    StaticFile_ptr cached_file;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        Files::const_iterator it = files_.find(request_path);
+        if ( it == files_.end() ) {
+            return StaticFile_ptr(); // other spellings of preloaded paths are not cached either, so clients can not fill cache.
+        }
+        cached_file = it->second;
+    }
+
+    const fs::path path(document_root_ + request_path);
+    boost::system::error_code ec;
+    const boost::uintmax_t size = fs::file_size(path, ec);
+    const std::time_t last_write_time = !ec ? fs::last_write_time(path, ec) : 0;
+    if (ec) {
+        return StaticFile_ptr(); // file was removed.
+    }
+
+    if (cached_file->size == size && cached_file->last_write_time == last_write_time) {
+        return cached_file;
+    }
+    return reload(request_path, size, last_write_time);
+}
+
+StaticFile_ptr StaticFileCache::reload(const std::string& request_path, boost::uintmax_t size, std::time_t last_write_time)
+{
+    if (size > kMAX_CACHED_FILE_SIZE) {
+        return StaticFile_ptr();
+    }
+
+    // load file without lock since compression takes time.
+    StaticFile_ptr file = load(fs::path(document_root_ + request_path), request_path, size, last_write_time);
+    if (!file) {
+        return StaticFile_ptr();
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    Files::iterator it = files_.find(request_path);
+    if ( it != files_.end() ) {
+        memory_usage_ -= memoryUsage(*it->second);
+        files_.erase(it);
+    }
+
+    const std::size_t file_memory_usage = memoryUsage(*file);
+    if (memory_usage_ + file_memory_usage <= kMEMORY_LIMIT) {
+        files_[request_path] = file;
+        memory_usage_ += file_memory_usage;
+    } else {
+        BOOST_LOG_SEV(logger(), debug) << "Static files cache is full, file " << request_path << " is not cached.";
+    }
+    return file;
+}
+
+StaticFile_ptr StaticFileCache::load(const fs::path& path, const std::string& request_path, boost::uintmax_t size, std::time_t last_write_time) const
+{
+    boost::shared_ptr<StaticFile> file = boost::make_shared<StaticFile>();
+
+    std::ifstream is(path.string().c_str(), std::ios::in | std::ios::binary);
+    if (!is) {
+        return StaticFile_ptr();
+    }
+    file->content.resize( static_cast<std::size_t>(size) );
+    if ( size > 0 && !is.read( &file->content[0], file->content.size() ) ) {
+        return StaticFile_ptr(); // file was changed during reading, it will be reloaded on next request.
+    }
+
+    // Determine the file extension.
+    std::size_t last_slash_pos = request_path.find_last_of("/");
+    std::size_t last_dot_pos = request_path.find_last_of(".");
+    std::string extension;
+    if (last_dot_pos != std::string::npos && last_dot_pos > last_slash_pos) {
+        extension = request_path.substr(last_dot_pos);
+    }
+    file->mime_type = mime_types::extension_to_type(extension);
+
+    file->size = size;
+    file->last_write_time = last_write_time;
+    file->last_modified = formatHttpDate(last_write_time);
+    file->etag = makeEntityTag(file->content, "");
+
+    if ( Compression::isCompressibleMimeType(file->mime_type) ) {
+        try {
+            Compression::gzip(file->content, &file->gzip_content);
+            if ( file->gzip_content.size() >= file->content.size() ) {
+                file->gzip_content.clear(); // compression is not effective, send file as is.
+            } else {
+                file->gzip_etag = makeEntityTag(file->content, "-gz"); // differs from identity etag since representations differ.
+            }
+        } catch (std::exception& e) {
+            BOOST_LOG_SEV(logger(), error) << "Compression of " << request_path << " failed. Reason: " << e.what();
+            file->gzip_content.clear();
+        }
+    }
+
+    return file;
+}
+
+std::size_t StaticFileCache::memoryUsage(const StaticFile& file)
+{
+    return file.content.size() + file.gzip_content.size();
+}
+
+} // namespace Http
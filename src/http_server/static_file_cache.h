@@ -0,0 +1,80 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <ctime>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/filesystem.hpp>
+
+namespace Http
+{
+
+//! Content of static file from document root prepared for sending.
+struct StaticFile
+{
+    std::string content;
+    std::string gzip_content;    //!< gzip-compressed content. Empty if compression is not effective for this file.
+    std::string mime_type;
+    std::string etag;            //!< strong entity tag of content.
+    std::string gzip_etag;       //!< strong entity tag of gzip_content.
+    std::string last_modified;   //!< last modification time in HTTP-date format.
+    std::time_t last_write_time; //!< used to detect file change.
+    boost::uintmax_t size;       //!< used to detect file change.
+};
+
+typedef boost::shared_ptr<const StaticFile> StaticFile_ptr;
+
+//! Formats time in HTTP-date format(RFC 1123). Returns empty string on error.
+std::string formatHttpDate(std::time_t time);
+
+//! Parses HTTP-date in any of RFC 1123, RFC 850 or asctime() formats. Returns false if value is not a valid date.
+bool parseHttpDate(const std::string& value, std::time_t* time);
+
+/*!
+    \brief Keeps in memory files of web-server document root with their compressed variants.
+    All files are loaded once at startup, file is reloaded if its modification time or size was changed.
+    Only files found at startup are cached: set of keys does not depend on request paths sent by clients.
+    Class is thread safe.
+*/
+class StaticFileCache : private boost::noncopyable
+{
+public:
+
+    static const std::size_t kMAX_CACHED_FILE_SIZE = 2 * 1024 * 1024; //!< larger files are not cached.
+    static const std::size_t kMEMORY_LIMIT = 32 * 1024 * 1024; //!< files are not cached after limit is reached.
+
+    //! Loads all files of document root.
+    explicit StaticFileCache(const std::string& document_root);
+
+    /*!
+        \brief Returns actual content of file.
+        \param request_path - decoded path from request URI, starts from '/'.
+        \return null if file was not preloaded, does not exist anymore or can not be cached.
+    */
+    StaticFile_ptr get(const std::string& request_path);
+
+private:
+
+    void preload();
+
+    //! Loads file and puts it to cache if memory limit allows. Returns null if file can not be read.
+    StaticFile_ptr reload(const std::string& request_path, boost::uintmax_t size, std::time_t last_write_time);
+
+    //! Reads file and prepares its compressed variant. Returns null if file can not be read.
+    StaticFile_ptr load(const boost::filesystem::path& path, const std::string& request_path, boost::uintmax_t size, std::time_t last_write_time) const;
+
+    static std::size_t memoryUsage(const StaticFile& file);
+
+    std::string document_root_;
+
+    typedef std::map<std::string, StaticFile_ptr> Files;
+    Files files_; //!< key is request path of preloaded file.
+    std::size_t memory_usage_;
+    boost::mutex mutex_; //!< guards files_ and memory_usage_.
+};
+
+} // namespace Http
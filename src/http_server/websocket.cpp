@@ -0,0 +1,299 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "http_server/websocket.h"
+#include "http_server/request.h"
+#include "http_server/request_parser.h"
+#include "utils/base64.h"
+#include <boost/uuid/sha1.hpp>
+
+namespace Http { namespace WebSocket {
+
+namespace {
+
+const std::string kACCEPT_KEY_GUID("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+const std::string kSUPPORTED_VERSION("13");
+
+//! Returns true if comma separated list of tokens contains token(case insensitive).
+bool containsToken(boost::string_ref list, const std::string& token)
+{
+    std::vector<std::string> tokens;
+    boost::split(tokens, list, boost::is_any_of(","));
+    for (std::string& t : tokens) {
+        if ( boost::iequals(boost::trim_copy(t), token) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace anonymous
+
+bool isUpgradeRequest(const Request& req)
+{
+    boost::string_ref upgrade;
+    boost::string_ref connection;
+    boost::string_ref key;
+    return req.method == "GET"
+           && get_header_value(req.headers, "Upgrade", upgrade) && boost::iequals(boost::trim_copy( upgrade.to_string() ), "websocket")
+           && get_header_value(req.headers, "Connection", connection) && containsToken(connection, "upgrade")
+           && get_header_value(req.headers, "Sec-WebSocket-Key", key);
+}
+
+bool isSupportedVersion(const Request& req)
+{
+    boost::string_ref version;
+    return get_header_value(req.headers, "Sec-WebSocket-Version", version) && containsToken(version, kSUPPORTED_VERSION);
+}
+
+std::string acceptKey(const std::string& key)
+{
+    boost::uuids::detail::sha1 sha1;
+    const std::string data = boost::trim_copy(key) + kACCEPT_KEY_GUID;
+    sha1.process_bytes( data.data(), data.size() );
+    unsigned int digest[5];
+    sha1.get_digest(digest);
+
+    unsigned char digest_bytes[20];
+    for (std::size_t i = 0; i < 5; ++i) {
+        digest_bytes[i * 4 + 0] = static_cast<unsigned char>(digest[i] >> 24);
+        digest_bytes[i * 4 + 1] = static_cast<unsigned char>(digest[i] >> 16);
+        digest_bytes[i * 4 + 2] = static_cast<unsigned char>(digest[i] >> 8);
+        digest_bytes[i * 4 + 3] = static_cast<unsigned char>(digest[i]);
+    }
+
+    std::string result;
+    Base64Utils::base64<char> encoder;
+    int state = 0;
+    encoder.put( digest_bytes, digest_bytes + sizeof(digest_bytes), std::back_inserter(result), state, Base64Utils::base64<char>::noline() );
+    return result;
+}
+
+std::string makeFrame(Opcode opcode, const std::string& payload)
+{
+    std::string frame;
+    frame.reserve(10 + payload.size());
+    frame.push_back( static_cast<char>(0x80 | opcode) ); // FIN bit is always set.
+
+    const boost::uint64_t size = payload.size();
+    if (size < 126) {
+        frame.push_back( static_cast<char>(size) );
+    } else if (size <= 0xFFFF) {
+        frame.push_back( static_cast<char>(126) );
+        frame.push_back( static_cast<char>(size >> 8) );
+        frame.push_back( static_cast<char>(size) );
+    } else {
+        frame.push_back( static_cast<char>(127) );
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.push_back( static_cast<char>(size >> shift) );
+        }
+    }
+
+    frame += payload;
+    return frame;
+}
+
+std::string makeCloseFrame(CloseCode code)
+{
+    std::string payload;
+    payload.push_back( static_cast<char>(code >> 8) );
+    payload.push_back( static_cast<char>(code) );
+    return makeFrame(CLOSE, payload);
+}
+
+MessageParser::MessageParser()
+    :
+    header_size_(0),
+    header_complete_(false),
+    fin_(false),
+    frame_opcode_(CONTINUATION),
+    payload_remaining_(0),
+    mask_offset_(0),
+    mask_position_(0),
+    message_in_progress_(false),
+    result_ready_(false),
+    message_opcode_(TEXT),
+    opcode_(CONTINUATION),
+    close_code_(CLOSE_NORMAL)
+{
+}
+
+boost::tribool MessageParser::fail(CloseCode code)
+{
+    close_code_ = code;
+    return false;
+}
+
+bool MessageParser::startFrame()
+{
+    fin_ = (header_[0] & 0x80) != 0;
+    frame_opcode_ = static_cast<Opcode>(header_[0] & 0x0F);
+
+    if ( (header_[0] & 0x70) != 0 ) {
+        return false; // no extensions are negotiated, so RSV bits must be zero.
+    }
+
+    switch (frame_opcode_) {
+    case CONTINUATION:
+        if (!message_in_progress_) {
+            return false;
+        }
+        break;
+    case TEXT:
+    case BINARY:
+        if (message_in_progress_) {
+            return false;
+        }
+        break;
+    case CLOSE:
+    case PING:
+    case PONG:
+        if (!fin_ || payload_remaining_ > 125) {
+            return false; // control frames must not be fragmented.
+        }
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool MessageParser::isValidUtf8(const std::string& text)
+{
+    const unsigned char* c = reinterpret_cast<const unsigned char*>( text.data() );
+    const unsigned char* const end = c + text.size();
+    while (c != end) {
+        if (*c < 0x80) {
+            ++c;
+            continue;
+        }
+
+        // range of the second byte excludes overlong forms, surrogates and code points above U+10FFFF.
+        std::size_t continuation_count;
+        unsigned char second_min = 0x80, second_max = 0xBF;
+        if (*c >= 0xC2 && *c <= 0xDF) {
+            continuation_count = 1;
+        } else if (*c >= 0xE0 && *c <= 0xEF) {
+            continuation_count = 2;
+            if (*c == 0xE0) {
+                second_min = 0xA0;
+            } else if (*c == 0xED) {
+                second_max = 0x9F;
+            }
+        } else if (*c >= 0xF0 && *c <= 0xF4) {
+            continuation_count = 3;
+            if (*c == 0xF0) {
+                second_min = 0x90;
+            } else if (*c == 0xF4) {
+                second_max = 0x8F;
+            }
+        } else {
+            return false;
+        }
+
+        if (static_cast<std::size_t>(end - c) <= continuation_count) {
+            return false;
+        }
+        if (c[1] < second_min || c[1] > second_max) {
+            return false;
+        }
+        for (std::size_t i = 2; i <= continuation_count; ++i) {
+            if ( (c[i] & 0xC0) != 0x80 ) {
+                return false;
+            }
+        }
+        c += continuation_count + 1;
+    }
+    return true;
+}
+
+boost::tribool MessageParser::parse(const char*& begin, const char* end)
+{
+    if (result_ready_) {
+        result_ready_ = false;
+        if ( !isControl(opcode_) ) {
+            message_.clear();
+        }
+        control_payload_.clear();
+    }
+
+    while (begin != end) {
+        if (!header_complete_) {
+            header_[header_size_++] = static_cast<unsigned char>(*begin++);
+            if (header_size_ < 2) {
+                continue;
+            }
+
+            if ( (header_[1] & 0x80) == 0 ) {
+                return fail(CLOSE_PROTOCOL_ERROR); // client frames must be masked.
+            }
+            const unsigned char length_code = header_[1] & 0x7F;
+            const std::size_t extended_length_size = length_code == 126 ? 2 : (length_code == 127 ? 8 : 0);
+            if (header_size_ < 2 + extended_length_size + 4) {
+                continue;
+            }
+
+            if (extended_length_size == 0) {
+                payload_remaining_ = length_code;
+            } else {
+                if ( extended_length_size == 8 && (header_[2] & 0x80) != 0 ) {
+                    return fail(CLOSE_PROTOCOL_ERROR); // most significant bit of 64-bit length must be 0(RFC 6455, 5.2).
+                }
+                payload_remaining_ = 0;
+                for (std::size_t i = 0; i < extended_length_size; ++i) {
+                    payload_remaining_ = (payload_remaining_ << 8) | header_[2 + i];
+                }
+            }
+
+            if ( !startFrame() ) {
+                return fail(CLOSE_PROTOCOL_ERROR);
+            }
+            if ( !isControl(frame_opcode_) && payload_remaining_ > kMAX_MESSAGE_SIZE - message_.size() ) { // message_ never exceeds limit, so subtraction does not wrap.
+                return fail(CLOSE_MESSAGE_TOO_BIG);
+            }
+
+            header_complete_ = true;
+            mask_offset_ = header_size_ - 4;
+            if (frame_opcode_ == TEXT || frame_opcode_ == BINARY) {
+                message_opcode_ = frame_opcode_;
+            }
+        }
+
+        // unmask available payload.
+        const std::size_t length = static_cast<std::size_t>( std::min<boost::uint64_t>(end - begin, payload_remaining_) );
+        std::string& destination = isControl(frame_opcode_) ? control_payload_ : message_;
+        const std::size_t offset = destination.size();
+        destination.append(begin, length);
+        const unsigned char* mask = &header_[mask_offset_];
+        for (std::size_t i = 0; i < length; ++i) {
+            destination[offset + i] ^= mask[(mask_position_ + i) & 3];
+        }
+        mask_position_ += length;
+        begin += length;
+        payload_remaining_ -= length;
+
+        if (payload_remaining_ == 0) {
+            header_size_ = 0;
+            header_complete_ = false;
+            mask_position_ = 0;
+
+            if ( isControl(frame_opcode_) ) {
+                opcode_ = frame_opcode_; // fragmented message in progress keeps its data in message_.
+                result_ready_ = true;
+                return true;
+            }
+            message_in_progress_ = !fin_;
+            if (fin_) {
+                if ( message_opcode_ == TEXT && !isValidUtf8(message_) ) {
+                    return fail(CLOSE_INVALID_PAYLOAD);
+                }
+                opcode_ = message_opcode_;
+                result_ready_ = true;
+                return true;
+            }
+        }
+    }
+    return boost::indeterminate;
+}
+
+} } // namespace Http::WebSocket
@@ -0,0 +1,122 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/logic/tribool.hpp>
+
+namespace Http
+{
+
+struct Request;
+
+//! Primitives of WebSocket protocol(RFC 6455).
+namespace WebSocket
+{
+
+enum Opcode {
+    CONTINUATION = 0x0,
+    TEXT         = 0x1,
+    BINARY       = 0x2,
+    CLOSE        = 0x8,
+    PING         = 0x9,
+    PONG         = 0xA
+};
+
+//! Status codes of close frame sent by server.
+enum CloseCode {
+    CLOSE_NORMAL           = 1000,
+    CLOSE_GOING_AWAY       = 1001,
+    CLOSE_PROTOCOL_ERROR   = 1002,
+    CLOSE_INVALID_PAYLOAD  = 1007,
+    CLOSE_POLICY_VIOLATION = 1008,
+    CLOSE_MESSAGE_TOO_BIG  = 1009
+};
+
+const std::size_t kMAX_MESSAGE_SIZE = 1024 * 1024; //!< connection is closed if client sends larger message.
+const std::size_t kMAX_QUEUED_FRAMES_COUNT = 1024; //!< connection is closed if client does not read frames sent to it.
+const long kPING_INTERVAL_SECONDS = 30; //!< silent client is pinged after this interval and is disconnected if it is silent one more interval.
+
+//! Returns true if request asks to switch connection to WebSocket protocol.
+bool isUpgradeRequest(const Request& req);
+
+//! Returns true if client uses supported protocol version(13).
+bool isSupportedVersion(const Request& req);
+
+//! Returns value of Sec-WebSocket-Accept header for value of Sec-WebSocket-Key header.
+std::string acceptKey(const std::string& key);
+
+//! Returns unfragmented server frame(server frames are not masked).
+std::string makeFrame(Opcode opcode, const std::string& payload);
+
+//! Returns close frame with status code.
+std::string makeCloseFrame(CloseCode code);
+
+/*!
+    \brief Incremental parser of frames sent by client.
+    Fragmented data messages are assembled, control frames are returned as soon as they come.
+*/
+class MessageParser
+{
+public:
+
+    MessageParser();
+
+    /*!
+        \brief Parses data in range [begin, end).
+        \param begin - is moved to the first unparsed byte.
+        \return true if complete message or control frame is parsed,
+                false on protocol error(see close_code()),
+                indeterminate if more data is required.
+    */
+    boost::tribool parse(const char*& begin, const char* end);
+
+    //! Opcode of parsed message or control frame.
+    Opcode opcode() const
+        { return opcode_; }
+
+    //! Payload of parsed message or control frame.
+    const std::string& payload() const
+        { return isControl(opcode_) ? control_payload_ : message_; }
+
+    //! Status code which must be sent to client in close frame after protocol error.
+    CloseCode close_code() const
+        { return close_code_; }
+
+private:
+
+    static bool isControl(Opcode opcode)
+        { return (opcode & 0x8) != 0; }
+
+    //! Validates frame header and prepares payload reading. Returns false on protocol error.
+    bool startFrame();
+
+    //! Returns true if string is well-formed UTF-8 text(RFC 3629): TEXT message with invalid data must fail connection.
+    static bool isValidUtf8(const std::string& text);
+
+    boost::tribool fail(CloseCode code);
+
+    boost::array<unsigned char, 14> header_; //!< max header size: 2 bytes + 8 bytes of extended length + 4 bytes of mask.
+    std::size_t header_size_;
+    bool header_complete_;
+
+    bool fin_;
+    Opcode frame_opcode_;
+    boost::uint64_t payload_remaining_;
+    std::size_t mask_offset_; //!< position of masking key in header_.
+    std::size_t mask_position_; //!< count of unmasked payload bytes of current frame.
+
+    bool message_in_progress_; //!< set between first and final frames of fragmented message.
+    bool result_ready_; //!< set when previous call returned message, it must be cleared on next call.
+    Opcode message_opcode_; //!< opcode of first frame of data message.
+    Opcode opcode_;
+    std::string message_;
+    std::string control_payload_;
+    CloseCode close_code_;
+};
+
+} // namespace WebSocket
+
+} // namespace Http
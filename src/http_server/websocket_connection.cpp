@@ -0,0 +1,267 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include <boost/bind.hpp>
+#include "http_server/websocket_connection.h"
+#include "http_server/request_handler.h"
+#include "plugin/logger.h"
+
+namespace Http {
+
+template <typename SocketT>
+WebSocketConnection<SocketT>::WebSocketConnection(std::unique_ptr<SocketT> socket,
+                                                  PlayerThread& player_thread,
+                                                  RequestHandler& request_handler,
+                                                  const std::string& uri)
+    :
+    strand_( socket->get_io_service() ),
+    socket_( std::move(socket) ),
+    player_thread_(player_thread),
+    request_handler_(request_handler),
+    uri_(uri),
+    response_opcode_(WebSocket::TEXT),
+    close_frame_queued_(false),
+    closed_(false),
+    ping_timer_( socket_->get_io_service() ),
+    data_received_(false),
+    ping_sent_(false)
+{
+    BOOST_LOG_SEV(logger(), debug) << "Connection is switched to WebSocket protocol, URI " << uri_;
+}
+
+template <typename SocketT>
+WebSocketConnection<SocketT>::~WebSocketConnection()
+{
+    BOOST_LOG_SEV(logger(), debug) << "Destroying WebSocket connection.";
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::start(const char* begin, const char* end)
+{
+    strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::start_ping_timer,
+                                  shared_from_this()
+                                  )
+                     );
+
+    if (begin != end) {
+        // copy since source buffer belongs to HTTP connection.
+        const std::size_t size = std::min<std::size_t>( end - begin, buffer_.size() );
+        std::copy(begin, begin + size, buffer_.begin());
+        strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::parse_buffer,
+                                      shared_from_this(),
+                                      buffer_.data(),
+                                      buffer_.data() + size
+                                      )
+                         );
+    } else {
+        strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::read_some_to_buffer,
+                                      shared_from_this()
+                                      )
+                         );
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::read_some_to_buffer()
+{
+    socket_->async_read_some(boost::asio::buffer(buffer_),
+                             strand_.wrap(make_custom_alloc_handler(read_allocator_,
+                                                                    boost::bind(&WebSocketConnection<SocketT>::handle_read,
+                                                                                shared_from_this(),
+                                                                                boost::asio::placeholders::error,
+                                                                                boost::asio::placeholders::bytes_transferred
+                                                                                )
+                                                                    )
+                                          )
+                             );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_read(const boost::system::error_code& e, std::size_t bytes_transferred)
+{
+    if (!e) {
+        data_received_ = true;
+        parse_buffer(buffer_.data(), buffer_.data() + bytes_transferred);
+    } else {
+        closed_ = true; // client has gone, subscriptions will be released on next event.
+        boost::system::error_code ignored_ec;
+        socket_->close(ignored_ec);
+        ping_timer_.cancel(ignored_ec); // release connection now instead of at the end of ping interval.
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::parse_buffer(const char* begin, const char* end)
+{
+    using namespace WebSocket;
+
+    while (begin != end) {
+        const boost::tribool result = message_parser_.parse(begin, end);
+        if (result) {
+            switch ( message_parser_.opcode() ) {
+            case TEXT:
+            case BINARY:
+                // AIMP is not thread safe, so requests are handled in player's thread.
+                player_thread_.post( boost::bind(&WebSocketConnection<SocketT>::handle_message,
+                                                 shared_from_this(),
+                                                 message_parser_.payload(),
+                                                 message_parser_.opcode()
+                                                 )
+                                    );
+                break;
+            case PING:
+                queue_frame( makeFrame( PONG, message_parser_.payload() ) );
+                break;
+            case CLOSE:
+                close(CLOSE_NORMAL);
+                return;
+            default: // unsolicited pong is ignored.
+                break;
+            }
+        } else if (!result) {
+            BOOST_LOG_SEV(logger(), debug) << "WebSocket protocol error, closing connection.";
+            close( message_parser_.close_code() );
+            return;
+        }
+    }
+
+    read_some_to_buffer();
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_message(const std::string& message, WebSocket::Opcode opcode)
+{
+    if (closed_) {
+        return;
+    }
+
+    response_opcode_ = opcode;
+    std::string response;
+    if ( request_handler_.handle_websocket_message(uri_, message, shared_from_this(), &response)
+         && !response.empty() // notifications have no response.
+        )
+    {
+        strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::queue_frame,
+                                      shared_from_this(),
+                                      WebSocket::makeFrame(opcode, response)
+                                      )
+                         );
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::sendResponse(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender)
+{
+    // frame is made right now since sender's reply is overwritten by next notification.
+    strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::queue_frame,
+                                  shared_from_this(),
+                                  WebSocket::makeFrame(response_opcode_, comet_http_response_sender->get_reply().content)
+                                  )
+                     );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::queue_frame(const std::string& frame)
+{
+    if (close_frame_queued_) {
+        return; // nothing can be sent after close frame.
+    }
+
+    if (frames_.size() >= WebSocket::kMAX_QUEUED_FRAMES_COUNT) {
+        BOOST_LOG_SEV(logger(), debug) << "WebSocket client does not read sent frames, closing connection.";
+        frames_.erase(frames_.begin() + 1, frames_.end()); // front frame is being written.
+        close(WebSocket::CLOSE_POLICY_VIOLATION);
+        return;
+    }
+
+    frames_.push_back(frame);
+    if (frames_.size() == 1) {
+        write_next_frame();
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::write_next_frame()
+{
+    boost::asio::async_write(*socket_,
+                             boost::asio::buffer( frames_.front() ),
+                             strand_.wrap(make_custom_alloc_handler(write_allocator_,
+                                                                    boost::bind(&WebSocketConnection<SocketT>::handle_write,
+                                                                                shared_from_this(),
+                                                                                boost::asio::placeholders::error
+                                                                                )
+                                                                    )
+                                          )
+                             );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_write(const boost::system::error_code& e)
+{
+    if (e) {
+        closed_ = true;
+        frames_.clear();
+        boost::system::error_code ignored_ec;
+        socket_->close(ignored_ec); // pending read operation will fail and connection will be destroyed.
+        return;
+    }
+
+    frames_.pop_front();
+    if ( !frames_.empty() ) {
+        write_next_frame();
+    } else if (close_frame_queued_) {
+        // Initiate graceful connection closure. Pending read operation will fail and connection will be destroyed.
+        boost::system::error_code ignored_ec;
+        socket_->shutdown(SocketT::shutdown_both, ignored_ec);
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::close(WebSocket::CloseCode code)
+{
+    closed_ = true;
+    queue_frame( WebSocket::makeCloseFrame(code) );
+    close_frame_queued_ = true;
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::start_ping_timer()
+{
+    ping_timer_.expires_from_now( boost::posix_time::seconds(WebSocket::kPING_INTERVAL_SECONDS) );
+    ping_timer_.async_wait( strand_.wrap(make_custom_alloc_handler(timer_allocator_,
+                                                                   boost::bind(&WebSocketConnection<SocketT>::handle_ping_timer,
+                                                                               shared_from_this(),
+                                                                               boost::asio::placeholders::error
+                                                                               )
+                                                                   )
+                                         )
+                           );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_ping_timer(const boost::system::error_code& e)
+{
+    if (e == boost::asio::error::operation_aborted) {
+        return;
+    }
+
+    if (data_received_ && !closed_) {
+        data_received_ = false;
+        ping_sent_ = false;
+    } else if (!ping_sent_ && !closed_) {
+        queue_frame( WebSocket::makeFrame( WebSocket::PING, std::string() ) );
+        ping_sent_ = true;
+    } else {
+        // client does not answer ping or does not complete closing handshake.
+        BOOST_LOG_SEV(logger(), debug) << "WebSocket client is not responding, closing connection.";
+        closed_ = true;
+        // Pending read and write operations will fail and connection will be destroyed.
+        boost::system::error_code ignored_ec;
+        socket_->shutdown(SocketT::shutdown_both, ignored_ec);
+        socket_->close(ignored_ec);
+        return;
+    }
+    start_ping_timer();
+}
+
+} // namespace Http
@@ -0,0 +1,132 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/array.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include "http_server/connection.h"
+#include "http_server/websocket.h"
+#include "http_server/handler_allocator.h"
+#include "http_server/player_thread.h"
+
+namespace Http
+{
+
+class RequestHandler;
+
+/*!
+    \brief Connection switched to WebSocket protocol by handshake on RPC URI.
+    Each data message is handled as RPC request by frontend selected by handshake URI,
+    response is sent in message of the same type.
+    Delayed responses(event notifications) are pushed to client each time event occurs while connection is open.
+*/
+template <typename SocketT>
+class WebSocketConnection : public ICometDelayedConnection, public boost::enable_shared_from_this< WebSocketConnection<SocketT> >, private boost::noncopyable
+{
+public:
+
+    /*!
+        \param socket - socket of HTTP connection which sent handshake reply.
+        \param uri - URI of handshake request.
+    */
+    WebSocketConnection(std::unique_ptr<SocketT> socket,
+                        PlayerThread& player_thread,
+                        RequestHandler& request_handler,
+                        const std::string& uri);
+
+    ~WebSocketConnection();
+
+    //! Starts reading of messages. Data in range [begin, end) was received by HTTP connection after handshake request.
+    void start(const char* begin, const char* end);
+
+    //! Pushes delayed response to client. Can be called from any thread.
+    virtual void sendResponse(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender);
+
+    virtual bool persistent() const
+        { return true; }
+
+    virtual bool closed() const
+        { return closed_; }
+
+private:
+
+    void read_some_to_buffer();
+
+    void handle_read(const boost::system::error_code& e, std::size_t bytes_transferred);
+
+    //! Parses frames in range [begin, end) and starts next read if connection is not closing.
+    void parse_buffer(const char* begin, const char* end);
+
+    //! Handles RPC request in player's thread.
+    void handle_message(const std::string& message, WebSocket::Opcode opcode);
+
+    //! Appends frame to queue of outgoing frames. Called in connection's strand.
+    void queue_frame(const std::string& frame);
+
+    void write_next_frame();
+
+    void handle_write(const boost::system::error_code& e);
+
+    //! Sends close frame, connection is shut down after it is written.
+    void close(WebSocket::CloseCode code);
+
+    //! Starts waiting of next ping interval.
+    void start_ping_timer();
+
+    //! Pings client which was silent during last interval, disconnects client which did not answer previous ping.
+    void handle_ping_timer(const boost::system::error_code& e);
+
+    /// Strand to ensure the connection's handlers are not called concurrently.
+    boost::asio::io_service::strand strand_;
+
+    std::unique_ptr<SocketT> socket_;
+
+    /// AIMP player's thread.
+    PlayerThread& player_thread_;
+
+    RequestHandler& request_handler_;
+
+    /// URI of handshake request, it selects RPC frontend.
+    const std::string uri_;
+
+    boost::array<char, 8192> buffer_;
+
+    WebSocket::MessageParser message_parser_;
+
+    /// Type of data messages sent to client, it is the type of last request message. Used in player's thread only.
+    WebSocket::Opcode response_opcode_;
+
+    /// Frames waiting for sending, front one is being written.
+    std::deque<std::string> frames_;
+
+    bool close_frame_queued_;
+
+    /// Set when connection is closed or closing, read from player's thread.
+    boost::atomic<bool> closed_;
+
+    /// Timer to detect clients which are gone without closing of connection.
+    boost::asio::deadline_timer ping_timer_;
+
+    /// Set when data is received from client during current ping interval.
+    bool data_received_;
+
+    /// Set when ping was sent to silent client, it will be disconnected if it is silent during next interval too.
+    bool ping_sent_;
+
+    /// Memory for handlers of read operations(strand).
+    handler_allocator read_allocator_;
+
+    /// Memory for handlers of write operations(strand). Frames queued from player's thread are written from strand too.
+    handler_allocator write_allocator_;
+
+    /// Memory for handlers of ping timer(strand).
+    handler_allocator timer_allocator_;
+};
+
+} // namespace Http
@@ -14,7 +14,7 @@ class Frontend : public Rpc::Frontend
 {
 public:
 
-    virtual bool canHandleRequest(const std::string& uri) const
+    virtual bool canHandleRequest(boost::string_ref uri) const
         { return uri == "/RPC_JSON"; }
 
     virtual Rpc::RequestParser& requestParser()
@@ -2,89 +2,407 @@
 
 #include "stdafx.h"
 #include "jsonrpc/request_parser.h"
-#include "jsonrpc/value.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
-#include "jsonrpc/reader.h"
 
 namespace JsonRpc
 {
 
-struct RequestParserImpl {
-    Json::Reader reader;
-};
+namespace {
+
+const int kMAX_NESTING_DEPTH = 256; // protects stack from malicious requests like "[[[[...".
 
-RequestParser::RequestParser()
-    :
-    impl_(new RequestParserImpl)
-{}
+/*!
+    \brief Single pass JSON reader which fills Rpc::Value directly.
 
-RequestParser::~RequestParser()
+    Accepts the same dialect as jsoncpp's Json::Reader used before: C and C++ style comments are allowed,
+    content after root value is ignored, numbers are decoded with the same int/uint/double rules.
+*/
+class Reader
 {
-    delete impl_;
-}
+public:
+
+    Reader(const char* begin, const char* end)
+        :
+        current_(begin),
+        end_(end),
+        depth_(0)
+    {}
+
+    bool parse(Rpc::Value* root)
+    {
+        return readValue(root);
+    }
+
+private:
+
+    bool readValue(Rpc::Value* value)
+    {
+        if ( !skipSpacesAndComments() ) {
+            return false;
+        }
+
+        switch (*current_) {
+        case '{':
+            return readObject(value);
+        case '[':
+            return readArray(value);
+        case '"':
+            {
+            Rpc::Value::String& string = *value;
+            return readString(&string);
+            }
+        case 't':
+            *value = true;
+            return match("true", 4);
+        case 'f':
+            *value = false;
+            return match("false", 5);
+        case 'n':
+            Rpc::Value( Rpc::Value::Null() ).swap(*value);
+            return match("null", 4);
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+            return readNumber(value);
+        default:
+            return false;
+        }
+    }
+
+    bool readObject(Rpc::Value* value)
+    {
+        if (++depth_ > kMAX_NESTING_DEPTH) {
+            return false;
+        }
+        ++current_; // skip '{'
+        Rpc::Value( Rpc::Value::Object() ).swap(*value);
+
+        if ( !skipSpacesAndComments() ) {
+            return false;
+        }
+        if (*current_ == '}') { // empty object
+            ++current_;
+            --depth_;
+            return true;
+        }
+
+        for (;;) {
+            if ( !skipSpacesAndComments() || *current_ != '"' ) {
+                return false;
+            }
+            member_name_.clear();
+            if ( !readString(&member_name_) ) {
+                return false;
+            }
+
+            if ( !skipSpacesAndComments() || *current_ != ':' ) {
+                return false;
+            }
+            ++current_;
+
+            if ( !readValue( &value->appendMember(member_name_) ) ) {
+                return false;
+            }
+
+            if ( !skipSpacesAndComments() ) {
+                return false;
+            }
+            const char c = *current_++;
+            if (c == '}') {
+                break;
+            } else if (c != ',') {
+                return false;
+            }
+        }
+        value->sortMembers(Rpc::Value::DUPLICATES_KEEP_LAST); // last of duplicated members wins.
+
+        --depth_;
+        return true;
+    }
+
+    bool readArray(Rpc::Value* value)
+    {
+        if (++depth_ > kMAX_NESTING_DEPTH) {
+            return false;
+        }
+        ++current_; // skip '['
+        Rpc::Value( Rpc::Value::Array() ).swap(*value);
+
+        if ( !skipSpacesAndComments() ) {
+            return false;
+        }
+        if (*current_ == ']') { // empty array
+            ++current_;
+        } else {
+            for (size_t size = 0; ; ) {
+                value->setSize(++size); // grows geometrically, items are moved on reallocation.
+                if ( !readValue( &(*value)[static_cast<int>(size - 1)] ) ) {
+                    return false;
+                }
+
+                if ( !skipSpacesAndComments() ) {
+                    return false;
+                }
+                const char c = *current_++;
+                if (c == ']') {
+                    break;
+                } else if (c != ',') {
+                    return false;
+                }
+            }
+        }
+
+        --depth_;
+        return true;
+    }
+
+    //! Reads string token started at current position, escape sequences are decoded into out.
+    bool readString(std::string* out)
+    {
+        ++current_; // skip '"'
+        for (;;) {
+            // copy run of plain characters at once.
+            const char* run_begin = current_;
+            while (current_ != end_ && *current_ != '"' && *current_ != '\\') {
+                ++current_;
+            }
+            out->append(run_begin, current_);
+
+            if (current_ == end_) {
+                return false; // unterminated string.
+            }
+
+            if (*current_++ == '"') {
+                return true;
+            }
+
+            // escape sequence.
+            if (current_ == end_) {
+                return false;
+            }
+            switch (*current_++) {
+            case '"':  out->push_back('"');  break;
+            case '/':  out->push_back('/');  break;
+            case '\\': out->push_back('\\'); break;
+            case 'b':  out->push_back('\b'); break;
+            case 'f':  out->push_back('\f'); break;
+            case 'n':  out->push_back('\n'); break;
+            case 'r':  out->push_back('\r'); break;
+            case 't':  out->push_back('\t'); break;
+            case 'u':
+                {
+                unsigned int code_point;
+                if ( !readCodePoint(&code_point) ) {
+                    return false;
+                }
+                appendUTF8(code_point, out);
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+    }
+
+    //! Reads XXXX part of \uXXXX escape sequence, UTF-16 surrogate pair is combined into single code point.
+    bool readCodePoint(unsigned int* code_point)
+    {
+        if ( !readHexQuad(code_point) ) {
+            return false;
+        }
+        if (*code_point >= 0xD800 && *code_point <= 0xDBFF) {
+            if (end_ - current_ < 6 || current_[0] != '\\' || current_[1] != 'u') {
+                return false;
+            }
+            current_ += 2;
+            unsigned int low_surrogate;
+            if ( !readHexQuad(&low_surrogate) ) {
+                return false;
+            }
+            *code_point = 0x10000 + ( (*code_point & 0x3FF) << 10 ) + (low_surrogate & 0x3FF);
+        }
+        return true;
+    }
+
+    bool readHexQuad(unsigned int* value)
+    {
+        if (end_ - current_ < 4) {
+            return false;
+        }
+        *value = 0;
+        for (int i = 0; i != 4; ++i) {
+            const char c = *current_++;
+            *value *= 16;
+            if (c >= '0' && c <= '9') {
+                *value += c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                *value += c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                *value += c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void appendUTF8(unsigned int cp, std::string* out)
+    {
+        if (cp <= 0x7F) {
+            out->push_back( static_cast<char>(cp) );
+        } else if (cp <= 0x7FF) {
+            out->push_back( static_cast<char>( 0xC0 | (0x1F & (cp >> 6)) ) );
+            out->push_back( static_cast<char>( 0x80 | (0x3F & cp) ) );
+        } else if (cp <= 0xFFFF) {
+            out->push_back( static_cast<char>( 0xE0 | (0xF & (cp >> 12)) ) );
+            out->push_back( static_cast<char>( 0x80 | (0x3F & (cp >> 6)) ) );
+            out->push_back( static_cast<char>( 0x80 | (0x3F & cp) ) );
+        } else if (cp <= 0x10FFFF) {
+            out->push_back( static_cast<char>( 0xF0 | (0x7 & (cp >> 18)) ) );
+            out->push_back( static_cast<char>( 0x80 | (0x3F & (cp >> 12)) ) );
+            out->push_back( static_cast<char>( 0x80 | (0x3F & (cp >> 6)) ) );
+            out->push_back( static_cast<char>( 0x80 | (0x3F & cp) ) );
+        }
+    }
+
+    /*!
+        \brief Reads number token.
+        Token is decoded as double if it contains fraction or exponent, otherwise as int or uint(only if value does not fit int).
+        Integers which are too big for 32 bits fall back to double as well.
+    */
+    bool readNumber(Rpc::Value* value)
+    {
+        const char* const begin = current_;
+        bool is_double = false;
+        while (current_ != end_) {
+            const char c = *current_;
+            if (c >= '0' && c <= '9') {
+                // digit
+            } else if (c == '.' || c == 'e' || c == 'E' || c == '+' || (c == '-' && current_ != begin) ) {
+                is_double = true;
+            } else if (c != '-') {
+                break;
+            }
+            ++current_;
+        }
+
+        if (is_double) {
+            return readDouble(begin, value);
+        }
+
+        const char* digit = begin;
+        const bool is_negative = *digit == '-';
+        if (is_negative) {
+            ++digit;
+        }
+        const unsigned int threshold = (is_negative ? 2147483648u : 4294967295u) / 10;
+        unsigned int result = 0;
+        for (; digit != current_; ++digit) {
+            if (result >= threshold) {
+                return readDouble(begin, value);
+            }
+            result = result * 10 + static_cast<unsigned int>(*digit - '0');
+        }
+
+        if (is_negative) {
+            *value = -static_cast<int>(result);
+        } else if (result <= static_cast<unsigned int>(INT_MAX)) {
+            *value = static_cast<int>(result);
+        } else {
+            *value = result;
+        }
+        return true;
+    }
+
+    bool readDouble(const char* begin, Rpc::Value* value)
+    {
+        // token is not null terminated, copy it since strtod needs terminator.
+        char buffer[64];
+        const size_t length = static_cast<size_t>(current_ - begin);
+        if ( length >= sizeof(buffer) ) {
+            return false;
+        }
+        memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+
+        char* parsed_end;
+        const double result = strtod(buffer, &parsed_end);
+        if (parsed_end == buffer) {
+            return false;
+        }
+        *value = result;
+        return true;
+    }
+
+    bool match(const char* pattern, size_t length)
+    {
+        if ( static_cast<size_t>(end_ - current_) < length || memcmp(current_, pattern, length) != 0 ) {
+            return false;
+        }
+        current_ += length;
+        return true;
+    }
 
-void convertJsonRpcValueToRpcValue(const Json::Value& json_rpc_value, Rpc::Value* rpc_value); // throws Rpc::Exception
+    //! Skips whitespaces and comments. Returns false if end of content was reached or comment is malformed.
+    bool skipSpacesAndComments()
+    {
+        for (;;) {
+            while ( current_ != end_ && (*current_ == ' ' || *current_ == '\t' || *current_ == '\r' || *current_ == '\n') ) {
+                ++current_;
+            }
+            if (current_ == end_) {
+                return false;
+            }
+            if (*current_ != '/') {
+                return true;
+            }
+
+            ++current_;
+            if (current_ == end_) {
+                return false;
+            }
+            if (*current_ == '*') { // C style comment.
+                ++current_;
+                for (;;) {
+                    if (end_ - current_ < 2) {
+                        return false;
+                    }
+                    if (current_[0] == '*' && current_[1] == '/') {
+                        current_ += 2;
+                        break;
+                    }
+                    ++current_;
+                }
+            } else if (*current_ == '/') { // C++ style comment.
+                while (current_ != end_ && *current_ != '\r' && *current_ != '\n') {
+                    ++current_;
+                }
+            } else {
+                return false;
+            }
+        }
+    }
+
+    const char* current_;
+    const char* const end_;
+    int depth_;
+    std::string member_name_; // buffer reused by all members to avoid allocation per member name.
+};
+
+} // namespace anonymous
 
 bool RequestParser::parse_(const std::string& /*request_uri*/,
                            const std::string& request_content,
                            Rpc::Value* root)
 {
-    Json::Value json_root;
+    assert(root);
 
-    if ( impl_->reader.parse(request_content, json_root) ) {
-        convertJsonRpcValueToRpcValue(json_root, root);
+    Rpc::Value value;
+    Reader reader( request_content.data(), request_content.data() + request_content.size() );
+    if ( reader.parse(&value) ) {
+        value.swap(*root);
         return true;
     }
     return false;
 }
 
-void convertJsonRpcValueToRpcValue(const Json::Value& json_rpc_value, Rpc::Value* rpc_value) // throws Rpc::Exception
-{
-    assert(rpc_value);
-
-    switch ( json_rpc_value.type() ) {
-    case Json::nullValue:
-        Rpc::Value( Rpc::Value::Null() ).swap(*rpc_value);
-        break;
-    case Json::booleanValue:
-        *rpc_value = json_rpc_value.asBool();
-        break;
-    case Json::uintValue:
-        *rpc_value = json_rpc_value.asUInt();
-        break;
-    case Json::intValue:
-        *rpc_value = json_rpc_value.asInt();
-        break;
-    case Json::realValue:
-        *rpc_value = json_rpc_value.asDouble();
-        break;
-    case Json::stringValue:
-        *rpc_value = json_rpc_value.asString();
-        break;
-    case Json::arrayValue:
-        rpc_value->setSize( json_rpc_value.size() );
-        for (size_t i = 0, size = rpc_value->size(); i != size; ++i) {
-            convertJsonRpcValueToRpcValue(json_rpc_value[i], &((*rpc_value)[i]));
-        }
-        break;
-    case Json::objectValue:
-        {
-        Rpc::Value::Object object;
-
-        const Json::Value::Members& member_names = json_rpc_value.getMemberNames();
-        auto member_name_it = member_names.begin(),
-             end            = member_names.end();
-        for (; member_name_it != end; ++member_name_it) {
-            const std::string& member_name = *member_name_it;
-            convertJsonRpcValueToRpcValue(json_rpc_value[member_name], &object[member_name]);
-        }
-        *rpc_value = object;
-        }
-        break;
-    default:
-        throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
-    }
-}
-
 } // namespace JsonRpc
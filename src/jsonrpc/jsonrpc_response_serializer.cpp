@@ -2,7 +2,6 @@
 
 #include "stdafx.h"
 #include "jsonrpc/response_serializer.h"
-#include "jsonrpc/value.h"
 #include "jsonrpc/writer.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
@@ -13,94 +12,184 @@ namespace JsonRpc
 
 const std::string kMIME_TYPE = "application/json";
 
-struct ResponseSerializerImpl {
-    Json::FastWriter writer;
-};
+namespace {
 
-ResponseSerializer::ResponseSerializer()
-    :
-    impl_(new ResponseSerializerImpl)
-{}
+const std::string kJSONRPC_MEMBER_NAME("jsonrpc");
+const std::string kJSONRPC_VERSION("2.0");
+const std::string kRESULT_MEMBER_NAME("result");
 
-ResponseSerializer::~ResponseSerializer()
+/*!
+    \brief Writes Rpc::Value as JSON text directly to output string, without intermediate Json::Value tree.
+    Output is the same as Json::FastWriter one: members are written in sorted order, the same escaping and number formatting.
+*/
+class Writer
 {
-    delete impl_;
-}
+public:
 
-void convertRpcValueToJsonRpcValue(const Rpc::Value& rpc_value, Json::Value* json_rpc_value); // throws Rpc::Exception
+    explicit Writer(std::string* out)
+        :
+        out_(*out)
+    {}
 
-void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
-{
-    Json::Value jsonrpc_response;
-    convertRpcValueToJsonRpcValue(root_response, &jsonrpc_response);
-    jsonrpc_response["jsonrpc"] = "2.0";
+    void writeValue(const Rpc::Value& value); // throws Rpc::Exception
 
-    *response = impl_->writer.write(jsonrpc_response);
-}
+    void writeString(const char* begin, const char* end);
 
-void ResponseSerializer::serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const
+    void writeString(const std::string& s)
+        { writeString( s.data(), s.data() + s.size() ); }
+
+    void writeInt(int value);
+
+    void writeUInt(unsigned int value);
+
+    /*!
+        \brief Writes object with additional member "jsonrpc":"2.0" inserted in sorted position.
+        Value which is not an object is written as object with this member only.
+        If serialized_result is not null it is written as "result" member. It is the last member in sorted order of response members(error, id, jsonrpc, result).
+    */
+    void writeRootObject(const Rpc::Value& value, const std::string* serialized_result = nullptr);
+
+    void put(char c)
+        { out_.push_back(c); }
+
+    void put(const std::string& s)
+        { out_ += s; }
+
+private:
+
+    //! Writes member name and colon.
+    void writeMemberName(const std::string& name)
+    {
+        writeString(name);
+        put(':');
+    }
+
+    std::string& out_;
+};
+
+//! Table of characters which must be escaped in JSON string: quote, backslash and control characters.
+struct EscapeTable
 {
-    Json::Value response_value;
+    bool needs_escape[256];
 
-    if ( root_request.isMember("id") ) {
-        convertRpcValueToJsonRpcValue(root_request["id"], &response_value["id"]);
-    } else {
-        response_value["id"] = Json::Value::null;
+    EscapeTable()
+    {
+        for (int c = 0; c != 256; ++c) {
+            needs_escape[c] = c < 0x20 || c == '"' || c == '\\';
+        }
     }
+};
 
-    response_value["jsonrpc"] = "2.0";
+const EscapeTable kESCAPE_TABLE;
 
-    Json::Value& error = response_value["error"];
-    error["message"] = error_msg;
-    error["code"] = error_code;
+void Writer::writeString(const char* begin, const char* end)
+{
+    static const char kHEX_DIGITS[] = "0123456789ABCDEF";
+
+    put('"');
+    const char* run_begin = begin;
+    for (const char* c = begin; c != end; ++c) {
+        const unsigned char ch = static_cast<unsigned char>(*c);
+        if ( !kESCAPE_TABLE.needs_escape[ch] ) {
+            continue;
+        }
 
-    *response = impl_->writer.write(response_value);
+        out_.append(run_begin, c); // copy run of characters which do not need escaping at once.
+        run_begin = c + 1;
+
+        put('\\');
+        switch (ch) {
+        case '"':  put('"');  break;
+        case '\\': put('\\'); break;
+        case '\b': put('b');  break;
+        case '\f': put('f');  break;
+        case '\n': put('n');  break;
+        case '\r': put('r');  break;
+        case '\t': put('t');  break;
+        default:
+            put('u');
+            put('0');
+            put('0');
+            put( kHEX_DIGITS[ch >> 4] );
+            put( kHEX_DIGITS[ch & 0xF] );
+            break;
+        }
+    }
+    out_.append(run_begin, end);
+    put('"');
 }
 
-const std::string& ResponseSerializer::mimeType() const
+void Writer::writeUInt(unsigned int value)
 {
-    return kMIME_TYPE;
+    char buffer[16];
+    char* current = buffer + sizeof(buffer);
+    do {
+        *--current = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    out_.append( current, buffer + sizeof(buffer) );
 }
 
-void convertRpcValueToJsonRpcValue(const Rpc::Value& rpc_value, Json::Value* json_rpc_value) // throws Rpc::Exception
+void Writer::writeInt(int value)
 {
-    assert(json_rpc_value);
+    if (value < 0) {
+        put('-');
+        writeUInt( 0u - static_cast<unsigned int>(value) ); // safe for minimal int value.
+    } else {
+        writeUInt( static_cast<unsigned int>(value) );
+    }
+}
 
-    switch ( rpc_value.type() ) {
+void Writer::writeValue(const Rpc::Value& value)
+{
+    switch ( value.type() ) {
     case Rpc::Value::TYPE_NONE:
         // treat none rpc value as null json value. ///???
     case Rpc::Value::TYPE_NULL:
-        Json::Value().swap(*json_rpc_value);
+        put("null");
         break;
     case Rpc::Value::TYPE_BOOL:
-        *json_rpc_value = bool(rpc_value);
+        put( bool(value) ? "true" : "false" );
         break;
     case Rpc::Value::TYPE_INT:
-        *json_rpc_value = int(rpc_value);
+        writeInt( int(value) );
         break;
     case Rpc::Value::TYPE_UINT:
-        *json_rpc_value = unsigned int(rpc_value);
+        writeUInt( static_cast<unsigned int>(value) );
         break;
     case Rpc::Value::TYPE_DOUBLE:
-        *json_rpc_value = double(rpc_value);
+        put( Json::valueToString( double(value) ) );
         break;
     case Rpc::Value::TYPE_STRING:
-        *json_rpc_value = static_cast<const std::string&>(rpc_value);
+        writeString( static_cast<const std::string&>(value) );
         break;
     case Rpc::Value::TYPE_ARRAY:
-        json_rpc_value->resize( rpc_value.size() );
-        for (size_t i = 0, size = json_rpc_value->size(); i != size; ++i) {
-            convertRpcValueToJsonRpcValue(rpc_value[i], &((*json_rpc_value)[i]));
+        put('[');
+        for (size_t i = 0, size = value.size(); i != size; ++i) {
+            if (i != 0) {
+                put(',');
+            }
+            writeValue(value[i]);
         }
+        put(']');
         break;
     case Rpc::Value::TYPE_OBJECT:
         {
-        *json_rpc_value = Json::Value();
-        auto member_it = rpc_value.getObjectMembersBegin(),
-             end       = rpc_value.getObjectMembersEnd();
-        for (; member_it != end; ++member_it) {
-            convertRpcValueToJsonRpcValue( member_it->second, &((*json_rpc_value)[member_it->first]) );
+        auto member_it = value.getObjectMembersBegin(),
+             end       = value.getObjectMembersEnd();
+        if (member_it == end) {
+            put("null"); // clients rely on Json::Value conversion where empty object became null.
+            break;
         }
+        put('{');
+        for (bool first = true; member_it != end; ++member_it, first = false) {
+            if (!first) {
+                put(',');
+            }
+            writeMemberName(member_it->first);
+            writeValue(member_it->second);
+        }
+        put('}');
         }
         break;
     default:
@@ -108,4 +197,130 @@ void convertRpcValueToJsonRpcValue(const Rpc::Value& rpc_value, Json::Value* jso
     }
 }
 
+void Writer::writeRootObject(const Rpc::Value& value, const std::string* serialized_result)
+{
+    put('{');
+    bool version_written = false;
+    bool first = true;
+    if (value.type() == Rpc::Value::TYPE_OBJECT) {
+        auto member_it = value.getObjectMembersBegin(),
+             end       = value.getObjectMembersEnd();
+        for (; member_it != end; ++member_it) {
+            if (!version_written && member_it->first >= kJSONRPC_MEMBER_NAME) {
+                if (!first) {
+                    put(',');
+                }
+                writeMemberName(kJSONRPC_MEMBER_NAME);
+                writeString(kJSONRPC_VERSION);
+                version_written = true;
+                first = false;
+                if (member_it->first == kJSONRPC_MEMBER_NAME) {
+                    continue; // version member is overwritten.
+                }
+            }
+
+            if (!first) {
+                put(',');
+            }
+            writeMemberName(member_it->first);
+            writeValue(member_it->second);
+            first = false;
+        }
+    }
+
+    if (!version_written) {
+        if (!first) {
+            put(',');
+        }
+        writeMemberName(kJSONRPC_MEMBER_NAME);
+        writeString(kJSONRPC_VERSION);
+    }
+
+    if (serialized_result) {
+        put(',');
+        writeMemberName(kRESULT_MEMBER_NAME);
+        put(*serialized_result);
+    }
+    put('}');
+}
+
+} // namespace anonymous
+
+void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
+{
+    assert(response);
+    response->clear();
+
+    Writer writer(response);
+    writer.writeRootObject(root_response);
+    writer.put('\n'); // keep output of Json::FastWriter.
+}
+
+bool ResponseSerializer::serializeResult(const Rpc::Value& result, std::string* serialized_result) const
+{
+    assert(serialized_result);
+    serialized_result->clear();
+
+    Writer writer(serialized_result);
+    writer.writeValue(result);
+    return true;
+}
+
+void ResponseSerializer::serializeSuccessWithResult(const Rpc::Value& root_response, const std::string& serialized_result, std::string* response) const
+{
+    assert(response);
+    response->clear();
+    response->reserve(serialized_result.size() + 64);
+
+    Writer writer(response);
+    writer.writeRootObject(root_response, &serialized_result);
+    writer.put('\n');
+}
+
+void ResponseSerializer::serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const
+{
+    assert(response);
+    response->clear();
+
+    // members are written in sorted order: error, id, jsonrpc.
+    Writer writer(response);
+    writer.put("{\"error\":{\"code\":");
+    writer.writeInt(error_code);
+    writer.put(",\"message\":");
+    writer.writeString(error_msg);
+    writer.put("},\"id\":");
+    if ( root_request.isMember("id") ) {
+        writer.writeValue(root_request["id"]);
+    } else {
+        writer.put("null");
+    }
+    writer.put(",\"jsonrpc\":\"2.0\"}\n");
+}
+
+const std::string& ResponseSerializer::mimeType() const
+{
+    return kMIME_TYPE;
+}
+
+void ResponseSerializer::serializeBatch(const std::vector<std::string>& responses, std::string* response) const
+{
+    assert(response);
+
+    std::size_t size = responses.size() + 1; // separators and brackets.
+    for (const std::string& r : responses) {
+        size += r.size();
+    }
+
+    response->clear();
+    response->reserve(size);
+    response->push_back('[');
+    for (std::size_t i = 0; i != responses.size(); ++i) {
+        if (i != 0) {
+            response->push_back(',');
+        }
+        *response += responses[i];
+    }
+    response->push_back(']');
+}
+
 } // namespace JsonRpc
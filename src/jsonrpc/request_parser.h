@@ -10,14 +10,11 @@ namespace Rpc { class Value; }
 namespace JsonRpc
 {
 
-struct RequestParserImpl;
-
 class RequestParser : public Rpc::RequestParser
 {
 public:
 
-    RequestParser();
-    ~RequestParser();
+    RequestParser() {}
 
 private:
 
@@ -25,8 +22,6 @@ private:
                         const std::string& request_content,
                         Rpc::Value* root);
 
-    RequestParserImpl* impl_;
-
     RequestParser(const RequestParser&);
     RequestParser& operator=(const RequestParser&);
 };
@@ -8,14 +8,12 @@
 namespace JsonRpc
 {
 
-struct ResponseSerializerImpl;
-
+//! Writes Rpc::Value directly as JSON text, intermediate Json::Value tree is not built.
 class ResponseSerializer : public Rpc::ResponseSerializer
 {
 public:
 
-    ResponseSerializer();
-    ~ResponseSerializer();
+    ResponseSerializer() {}
 
     virtual void serializeSuccess(const Rpc::Value& root_response, std::string* response) const;
 
@@ -23,9 +21,14 @@ public:
 
     virtual const std::string& mimeType() const;
 
-private:
+    //! Writes responses as JSON array.
+    virtual void serializeBatch(const std::vector<std::string>& responses, std::string* response) const;
+
+    virtual bool serializeResult(const Rpc::Value& result, std::string* serialized_result) const;
 
-    ResponseSerializerImpl* impl_;
+    virtual void serializeSuccessWithResult(const Rpc::Value& root_response, const std::string& serialized_result, std::string* response) const;
+
+private:
 
     ResponseSerializer(const ResponseSerializer&);
     ResponseSerializer& operator=(const ResponseSerializer&);
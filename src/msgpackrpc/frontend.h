@@ -0,0 +1,36 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/frontend.h"
+#include "msgpackrpc/request_parser.h"
+#include "msgpackrpc/response_serializer.h"
+
+namespace MsgPackRpc
+{
+
+/*!
+    \brief Binary frontend: JSON-RPC calls encoded with MessagePack.
+    Request and response have the same structure as JSON-RPC ones(method, params, id members), so all methods work unchanged.
+    Intended for clients on slow links where size of JSON text matters.
+*/
+class Frontend : public Rpc::Frontend
+{
+public:
+
+    virtual bool canHandleRequest(boost::string_ref uri) const
+        { return uri == "/RPC_MSGPACK"; }
+
+    virtual Rpc::RequestParser& requestParser()
+        { return request_parser_; }
+
+    virtual Rpc::ResponseSerializer& responseSerializer()
+        { return response_serializer_; }
+
+private:
+
+    RequestParser request_parser_;
+    ResponseSerializer response_serializer_;
+};
+
+} // namespace MsgPackRpc
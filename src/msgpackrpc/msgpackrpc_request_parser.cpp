@@ -0,0 +1,287 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "msgpackrpc/request_parser.h"
+#include "rpc/value.h"
+#include "rpc/exception.h"
+#include <climits>
+
+namespace MsgPackRpc
+{
+
+namespace {
+
+const int kMAX_NESTING_DEPTH = 256; // protects stack from malicious requests.
+
+/*!
+    \brief Decodes MessagePack data into Rpc::Value.
+    Integers are stored as int if they fit, as unsigned int otherwise; 64 bit integers which do not fit 32 bits become double.
+    Map keys must be strings, binary is decoded as string. Extension types are not supported.
+*/
+class Reader
+{
+public:
+
+    Reader(const char* begin, const char* end)
+        :
+        current_( reinterpret_cast<const unsigned char*>(begin) ),
+        end_( reinterpret_cast<const unsigned char*>(end) ),
+        depth_(0)
+    {}
+
+    //! Returns false if data is malformed or has trailing bytes after root value.
+    bool parse(Rpc::Value* root)
+    {
+        return readValue(root) && current_ == end_;
+    }
+
+private:
+
+    bool readValue(Rpc::Value* value)
+    {
+        if (current_ == end_) {
+            return false;
+        }
+
+        const unsigned int marker = *current_++;
+
+        if (marker <= 0x7F) { // positive fixint
+            *value = static_cast<int>(marker);
+            return true;
+        } else if (marker >= 0xE0) { // negative fixint
+            *value = static_cast<int>(marker) - 0x100;
+            return true;
+        } else if ( (marker & 0xE0) == 0xA0 ) { // fixstr
+            return readString(marker & 0x1F, value);
+        } else if ( (marker & 0xF0) == 0x90 ) { // fixarray
+            return readArray(marker & 0x0F, value);
+        } else if ( (marker & 0xF0) == 0x80 ) { // fixmap
+            return readMap(marker & 0x0F, value);
+        }
+
+        unsigned int u32;
+        switch (marker) {
+        case 0xC0: // nil
+            Rpc::Value( Rpc::Value::Null() ).swap(*value);
+            return true;
+        case 0xC2: // false
+            *value = false;
+            return true;
+        case 0xC3: // true
+            *value = true;
+            return true;
+        case 0xCC: // uint 8
+            return readBigEndian(1, &u32) && setUInt(u32, value);
+        case 0xCD: // uint 16
+            return readBigEndian(2, &u32) && setUInt(u32, value);
+        case 0xCE: // uint 32
+            return readBigEndian(4, &u32) && setUInt(u32, value);
+        case 0xCF: // uint 64
+            return readUInt64(value);
+        case 0xD0: // int 8
+            return readBigEndian(1, &u32) && setInt( static_cast<signed char>(u32), value );
+        case 0xD1: // int 16
+            return readBigEndian(2, &u32) && setInt( static_cast<short>(u32), value );
+        case 0xD2: // int 32
+            return readBigEndian(4, &u32) && setInt( static_cast<int>(u32), value );
+        case 0xD3: // int 64
+            return readInt64(value);
+        case 0xCA: // float 32
+            return readFloat(value);
+        case 0xCB: // float 64
+            return readDouble(value);
+        case 0xD9: // str 8
+        case 0xC4: // bin 8
+            return readBigEndian(1, &u32) && readString(u32, value);
+        case 0xDA: // str 16
+        case 0xC5: // bin 16
+            return readBigEndian(2, &u32) && readString(u32, value);
+        case 0xDB: // str 32
+        case 0xC6: // bin 32
+            return readBigEndian(4, &u32) && readString(u32, value);
+        case 0xDC: // array 16
+            return readBigEndian(2, &u32) && readArray(u32, value);
+        case 0xDD: // array 32
+            return readBigEndian(4, &u32) && readArray(u32, value);
+        case 0xDE: // map 16
+            return readBigEndian(2, &u32) && readMap(u32, value);
+        case 0xDF: // map 32
+            return readBigEndian(4, &u32) && readMap(u32, value);
+        default: // extension types and never used marker 0xC1.
+            return false;
+        }
+    }
+
+    size_t available() const
+        { return static_cast<size_t>(end_ - current_); }
+
+    //! Reads unsigned big endian integer of 1, 2 or 4 bytes.
+    bool readBigEndian(size_t bytes_count, unsigned int* result)
+    {
+        if (available() < bytes_count) {
+            return false;
+        }
+        *result = 0;
+        for (size_t i = 0; i != bytes_count; ++i) {
+            *result = (*result << 8) | *current_++;
+        }
+        return true;
+    }
+
+    bool readBigEndian64(unsigned long long* result)
+    {
+        unsigned int high, low;
+        if ( !readBigEndian(4, &high) || !readBigEndian(4, &low) ) {
+            return false;
+        }
+        *result = (static_cast<unsigned long long>(high) << 32) | low;
+        return true;
+    }
+
+    static bool setInt(int result, Rpc::Value* value)
+    {
+        *value = result;
+        return true;
+    }
+
+    //! Stores value as int if it fits to keep types the same as JSON parser produces.
+    static bool setUInt(unsigned int result, Rpc::Value* value)
+    {
+        if ( result <= static_cast<unsigned int>(INT_MAX) ) {
+            *value = static_cast<int>(result);
+        } else {
+            *value = result;
+        }
+        return true;
+    }
+
+    bool readUInt64(Rpc::Value* value)
+    {
+        unsigned long long result;
+        if ( !readBigEndian64(&result) ) {
+            return false;
+        }
+        if (result <= UINT_MAX) {
+            return setUInt(static_cast<unsigned int>(result), value);
+        }
+        *value = static_cast<double>(result);
+        return true;
+    }
+
+    bool readInt64(Rpc::Value* value)
+    {
+        unsigned long long bits;
+        if ( !readBigEndian64(&bits) ) {
+            return false;
+        }
+        const long long result = static_cast<long long>(bits);
+        if (result >= INT_MIN && result <= INT_MAX) {
+            return setInt(static_cast<int>(result), value);
+        } else if (result > 0 && result <= UINT_MAX) {
+            return setUInt(static_cast<unsigned int>(result), value);
+        }
+        *value = static_cast<double>(result);
+        return true;
+    }
+
+    bool readFloat(Rpc::Value* value)
+    {
+        unsigned int bits;
+        if ( !readBigEndian(4, &bits) ) {
+            return false;
+        }
+        float result;
+        memcpy( &result, &bits, sizeof(result) );
+        *value = static_cast<double>(result);
+        return true;
+    }
+
+    bool readDouble(Rpc::Value* value)
+    {
+        unsigned long long bits;
+        if ( !readBigEndian64(&bits) ) {
+            return false;
+        }
+        double result;
+        memcpy( &result, &bits, sizeof(result) );
+        *value = result;
+        return true;
+    }
+
+    bool readString(size_t size, Rpc::Value* value)
+    {
+        if (available() < size) {
+            return false;
+        }
+        Rpc::Value::String& string = *value;
+        string.assign(reinterpret_cast<const char*>(current_), size);
+        current_ += size;
+        return true;
+    }
+
+    bool readArray(size_t size, Rpc::Value* value)
+    {
+        // each item takes at least one byte, so size can be checked before allocation.
+        if (available() < size || ++depth_ > kMAX_NESTING_DEPTH) {
+            return false;
+        }
+
+        Rpc::Value( Rpc::Value::Array() ).swap(*value);
+        value->setSize(size);
+        for (size_t i = 0; i != size; ++i) {
+            if ( !readValue( &(*value)[static_cast<int>(i)] ) ) {
+                return false;
+            }
+        }
+
+        --depth_;
+        return true;
+    }
+
+    bool readMap(size_t size, Rpc::Value* value)
+    {
+        // each member takes at least two bytes.
+        if (available() / 2 < size || ++depth_ > kMAX_NESTING_DEPTH) {
+            return false;
+        }
+
+        Rpc::Value( Rpc::Value::Object() ).swap(*value);
+        for (size_t i = 0; i != size; ++i) {
+            Rpc::Value name;
+            if ( !readValue(&name) || name.type() != Rpc::Value::TYPE_STRING ) {
+                return false;
+            }
+
+            if ( !readValue( &value->appendMember( static_cast<const std::string&>(name) ) ) ) {
+                return false;
+            }
+        }
+        value->sortMembers(Rpc::Value::DUPLICATES_KEEP_LAST); // last of duplicated members wins.
+
+        --depth_;
+        return true;
+    }
+
+    const unsigned char* current_;
+    const unsigned char* const end_;
+    int depth_;
+};
+
+} // namespace anonymous
+
+bool RequestParser::parse_(const std::string& /*request_uri*/,
+                           const std::string& request_content,
+                           Rpc::Value* root)
+{
+    assert(root);
+
+    Rpc::Value value;
+    Reader reader( request_content.data(), request_content.data() + request_content.size() );
+    if ( reader.parse(&value) ) {
+        value.swap(*root);
+        return true;
+    }
+    return false;
+}
+
+} // namespace MsgPackRpc
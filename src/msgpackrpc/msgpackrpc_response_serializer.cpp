@@ -0,0 +1,284 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "msgpackrpc/response_serializer.h"
+#include "rpc/value.h"
+#include "rpc/exception.h"
+#include <cassert>
+
+namespace MsgPackRpc
+{
+
+const std::string kMIME_TYPE = "application/x-msgpack";
+
+namespace {
+
+//! Appends MessagePack representation of Rpc::Value to output string.
+class Writer
+{
+public:
+
+    explicit Writer(std::string* out)
+        :
+        out_(*out)
+    {}
+
+    void writeValue(const Rpc::Value& value); // throws Rpc::Exception
+
+    void writeNil()
+        { put('\xC0'); }
+
+    void writeInt(int value);
+
+    void writeUInt(unsigned int value);
+
+    void writeDouble(double value);
+
+    void writeString(const std::string& s);
+
+    void writeArrayHeader(size_t size)
+        { writeContainerHeader(size, 0x90, 0xDC, 0xDD); }
+
+    void writeMapHeader(size_t size)
+        { writeContainerHeader(size, 0x80, 0xDE, 0xDF); }
+
+private:
+
+    void put(char c)
+        { out_.push_back(c); }
+
+    void putByte(unsigned int byte)
+        { out_.push_back( static_cast<char>(byte) ); }
+
+    void putBigEndian16(unsigned int value)
+    {
+        putByte( (value >> 8) & 0xFF );
+        putByte( value & 0xFF );
+    }
+
+    void putBigEndian32(unsigned int value)
+    {
+        putBigEndian16(value >> 16);
+        putBigEndian16(value & 0xFFFF);
+    }
+
+    //! Writes header of array or map: fix form for up to 15 items, 16 or 32 bits size otherwise.
+    void writeContainerHeader(size_t size, unsigned int fix_marker, unsigned int marker16, unsigned int marker32);
+
+    std::string& out_;
+};
+
+void Writer::writeInt(int value)
+{
+    if (value >= 0) {
+        writeUInt( static_cast<unsigned int>(value) );
+    } else if (value >= -32) { // negative fixint
+        putByte( static_cast<unsigned int>(value) & 0xFF );
+    } else if (value >= -128) {
+        putByte(0xD0);
+        putByte( static_cast<unsigned int>(value) & 0xFF );
+    } else if (value >= -32768) {
+        putByte(0xD1);
+        putBigEndian16( static_cast<unsigned int>(value) & 0xFFFF );
+    } else {
+        putByte(0xD2);
+        putBigEndian32( static_cast<unsigned int>(value) );
+    }
+}
+
+void Writer::writeUInt(unsigned int value)
+{
+    if (value < 0x80) { // positive fixint
+        putByte(value);
+    } else if (value <= 0xFF) {
+        putByte(0xCC);
+        putByte(value);
+    } else if (value <= 0xFFFF) {
+        putByte(0xCD);
+        putBigEndian16(value);
+    } else {
+        putByte(0xCE);
+        putBigEndian32(value);
+    }
+}
+
+void Writer::writeDouble(double value)
+{
+    unsigned char bytes[sizeof(double)];
+    memcpy(bytes, &value, sizeof(bytes));
+
+    putByte(0xCB);
+    // MessagePack uses big endian, x86 is little endian.
+    for (size_t i = sizeof(bytes); i != 0; --i) {
+        putByte(bytes[i - 1]);
+    }
+}
+
+void Writer::writeString(const std::string& s)
+{
+    const size_t size = s.size();
+    if (size < 32) {
+        putByte( 0xA0 | static_cast<unsigned int>(size) );
+    } else if (size <= 0xFF) {
+        putByte(0xD9);
+        putByte( static_cast<unsigned int>(size) );
+    } else if (size <= 0xFFFF) {
+        putByte(0xDA);
+        putBigEndian16( static_cast<unsigned int>(size) );
+    } else {
+        putByte(0xDB);
+        putBigEndian32( static_cast<unsigned int>(size) );
+    }
+    out_ += s;
+}
+
+void Writer::writeContainerHeader(size_t size, unsigned int fix_marker, unsigned int marker16, unsigned int marker32)
+{
+    if (size < 16) {
+        putByte( fix_marker | static_cast<unsigned int>(size) );
+    } else if (size <= 0xFFFF) {
+        putByte(marker16);
+        putBigEndian16( static_cast<unsigned int>(size) );
+    } else {
+        putByte(marker32);
+        putBigEndian32( static_cast<unsigned int>(size) );
+    }
+}
+
+void Writer::writeValue(const Rpc::Value& value) // throws Rpc::Exception
+{
+    switch ( value.type() ) {
+    case Rpc::Value::TYPE_NONE:
+    case Rpc::Value::TYPE_NULL:
+        writeNil();
+        break;
+    case Rpc::Value::TYPE_BOOL:
+        putByte(bool(value) ? 0xC3 : 0xC2);
+        break;
+    case Rpc::Value::TYPE_INT:
+        writeInt(value);
+        break;
+    case Rpc::Value::TYPE_UINT:
+        writeUInt(value);
+        break;
+    case Rpc::Value::TYPE_DOUBLE:
+        writeDouble(value);
+        break;
+    case Rpc::Value::TYPE_STRING:
+        writeString(value);
+        break;
+    case Rpc::Value::TYPE_ARRAY:
+        {
+        const size_t size = value.size();
+        writeArrayHeader(size);
+        for (size_t i = 0; i != size; ++i) {
+            writeValue( value[static_cast<int>(i)] );
+        }
+        }
+        break;
+    case Rpc::Value::TYPE_OBJECT:
+        {
+        writeMapHeader( value.size() );
+        auto member_it = value.getObjectMembersBegin(),
+             end       = value.getObjectMembersEnd();
+        for (; member_it != end; ++member_it) {
+            writeString(member_it->first);
+            writeValue(member_it->second);
+        }
+        }
+        break;
+    default:
+        assert(!"unknown type");
+        throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
+    }
+}
+
+} // namespace anonymous
+
+void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
+{
+    assert(response);
+    response->clear();
+
+    Writer writer(response);
+    writer.writeValue(root_response);
+}
+
+bool ResponseSerializer::serializeResult(const Rpc::Value& result, std::string* serialized_result) const
+{
+    assert(serialized_result);
+    serialized_result->clear();
+
+    Writer writer(serialized_result);
+    writer.writeValue(result);
+    return true;
+}
+
+void ResponseSerializer::serializeSuccessWithResult(const Rpc::Value& root_response, const std::string& serialized_result, std::string* response) const
+{
+    assert(response);
+    assert( !root_response.isMember("result") );
+    response->clear();
+    response->reserve(serialized_result.size() + 32); // envelope is small: id and member names.
+
+    // members of root response("id") precede "result" in sorted order, so output is the same as serializeSuccess() one.
+    Writer writer(response);
+    writer.writeMapHeader(root_response.size() + 1);
+    auto member_it = root_response.getObjectMembersBegin(),
+         end       = root_response.getObjectMembersEnd();
+    for (; member_it != end; ++member_it) {
+        writer.writeString(member_it->first);
+        writer.writeValue(member_it->second);
+    }
+    writer.writeString("result");
+    *response += serialized_result;
+}
+
+void ResponseSerializer::serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const
+{
+    assert(response);
+    response->clear();
+
+    // {"error":{"code":error_code,"message":error_msg},"id":id}
+    Writer writer(response);
+    writer.writeMapHeader(2);
+    writer.writeString("error");
+    writer.writeMapHeader(2);
+    writer.writeString("code");
+    writer.writeInt(error_code);
+    writer.writeString("message");
+    writer.writeString(error_msg);
+    writer.writeString("id");
+    if ( root_request.isMember("id") ) {
+        writer.writeValue(root_request["id"]);
+    } else {
+        writer.writeNil();
+    }
+}
+
+const std::string& ResponseSerializer::mimeType() const
+{
+    return kMIME_TYPE;
+}
+
+void ResponseSerializer::serializeBatch(const std::vector<std::string>& responses, std::string* response) const
+{
+    assert(response);
+
+    std::size_t size = 5; // max array header size.
+    for (const std::string& r : responses) {
+        size += r.size();
+    }
+
+    response->clear();
+    response->reserve(size);
+
+    // each item is already encoded value, so array is header followed by items.
+    Writer writer(response);
+    writer.writeArrayHeader( responses.size() );
+    for (const std::string& r : responses) {
+        *response += r;
+    }
+}
+
+} // namespace MsgPackRpc
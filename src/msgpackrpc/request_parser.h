@@ -0,0 +1,29 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/request_parser.h"
+
+namespace Rpc { class Value; }
+
+namespace MsgPackRpc
+{
+
+//! Decodes MessagePack request directly into Rpc::Value.
+class RequestParser : public Rpc::RequestParser
+{
+public:
+
+    RequestParser() {}
+
+private:
+
+    virtual bool parse_(const std::string& /*request_uri*/,
+                        const std::string& request_content,
+                        Rpc::Value* root);
+
+    RequestParser(const RequestParser&);
+    RequestParser& operator=(const RequestParser&);
+};
+
+} // namespace MsgPackRpc
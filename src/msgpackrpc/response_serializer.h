@@ -0,0 +1,36 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/response_serializer.h"
+
+namespace MsgPackRpc
+{
+
+//! Encodes Rpc::Value with MessagePack using the most compact representation of each value.
+class ResponseSerializer : public Rpc::ResponseSerializer
+{
+public:
+
+    ResponseSerializer() {}
+
+    virtual void serializeSuccess(const Rpc::Value& root_response, std::string* response) const;
+
+    virtual void serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const;
+
+    virtual const std::string& mimeType() const;
+
+    //! Writes responses as MessagePack array.
+    virtual void serializeBatch(const std::vector<std::string>& responses, std::string* response) const;
+
+    virtual bool serializeResult(const Rpc::Value& result, std::string* serialized_result) const;
+
+    virtual void serializeSuccessWithResult(const Rpc::Value& root_response, const std::string& serialized_result, std::string* response) const;
+
+private:
+
+    ResponseSerializer(const ResponseSerializer&);
+    ResponseSerializer& operator=(const ResponseSerializer&);
+};
+
+} // namespace MsgPackRpc
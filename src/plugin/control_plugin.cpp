@@ -14,10 +14,12 @@
 #include "rpc/request_handler.h"
 #include "xmlrpc/frontend.h"
 #include "jsonrpc/frontend.h"
+#include "msgpackrpc/frontend.h"
 #include "webctlrpc/frontend.h"
 #include "http_server/request_handler.h"
 #include "http_server/request_handler.h"
 #include "http_server/server.h"
+#include "http_server/player_thread.h"
 #include "http_server/mpfd_parser_factory.h"
 #include "download_track/request_handler.h"
 #include "upload_track/request_handler.h"
@@ -91,6 +93,19 @@ const std::wstring AIMPControlPlugin::kPLUGIN_SETTINGS_FILENAME = L"settings.dat
 const UINT_PTR kTickTimerEventID = 0x01020304;
 const UINT     kTickTimerElapse = 100; // 100 ms.
 
+const wchar_t kPLAYER_THREAD_WINDOW_CLASS[] = L"AIMPControlPluginPlayerThreadWindow";
+const UINT kWAKE_PLAYER_THREAD_MESSAGE = WM_APP + 1;
+
+//! Returns handle of plugin DLL.
+HMODULE getPluginModule()
+{
+    HMODULE module = NULL;
+    GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                      (LPCWSTR)&getPluginModule,
+                      &module);
+    return module;
+}
+
 namespace PluginLogger
 {
 
@@ -119,6 +134,9 @@ boost::filesystem::wpath AIMPControlPlugin::getPluginDirectoryPath()
 AIMPControlPlugin::AIMPControlPlugin()
     :
     free_image_dll_is_available_(false),
+    aimp_events_listener_id_(0),
+    player_thread_window_(NULL),
+    player_thread_wake_pending_(false),
     tick_timer_id_(0)
 {
     plugin_instance = this;
@@ -420,16 +438,16 @@ boost::shared_ptr<AIMPPlayer::AIMPManager> AIMPControlPlugin::CreateAIMPManager(
 {
     boost::shared_ptr<AIMPPlayer::AIMPManager> result;
     if (aimp2_controller_) {
-        result.reset( new AIMPPlayer::AIMPManager26(aimp2_controller_, *server_io_service_) );
+        result.reset( new AIMPPlayer::AIMPManager26(aimp2_controller_, *player_io_service_) );
     } else if (aimp3_core_unit_) {
         const int version = getAIMPVersion(aimp3_core_unit_.get());
         if (version >= 3100) {
-            result.reset( new AIMPPlayer::AIMPManager31(aimp3_core_unit_, *server_io_service_) );
+            result.reset( new AIMPPlayer::AIMPManager31(aimp3_core_unit_, *player_io_service_) );
         } else {
-            result.reset( new AIMPPlayer::AIMPManager30(aimp3_core_unit_, *server_io_service_) );
+            result.reset( new AIMPPlayer::AIMPManager30(aimp3_core_unit_, *player_io_service_) );
         }
     } else if (aimp36_core_) {
-        result.reset( new AIMPPlayer::AIMPManager36(aimp36_core_, *server_io_service_) );
+        result.reset( new AIMPPlayer::AIMPManager36(aimp36_core_, *player_io_service_, settings().misc.use_columnar_entries_store) );
     } else {
         assert(!"both AIMP2 and AIMP3 plugin addon objects do not exist.");
         throw std::runtime_error("both AIMP2 and AIMP3 plugin addon objects do not exist. "__FUNCTION__);
@@ -453,6 +471,11 @@ HRESULT AIMPControlPlugin::initialize()
 
     // create plugin core
     try {
+        player_io_service_ = boost::make_shared<boost::asio::io_service>();
+        player_io_service_work_.reset( new boost::asio::io_service::work(*player_io_service_) );
+        player_thread_ = boost::make_shared<Http::PlayerThread>( boost::ref(*player_io_service_),
+                                                                 boost::bind(&AIMPControlPlugin::wakePlayerThread, this)
+                                                                );
         server_io_service_ = boost::make_shared<boost::asio::io_service>();
 
         // create AIMP manager.
@@ -465,6 +488,7 @@ HRESULT AIMPControlPlugin::initialize()
         rpc_request_handler_.reset( new Rpc::RequestHandler() );
         createRpcFrontends();
         createRpcMethods();
+        aimp_events_listener_id_ = aimp_manager_->registerListener( boost::bind(&AIMPControlPlugin::onAimpEvent, this, _1) );
 
         download_track_request_handler_.reset( new DownloadTrack::RequestHandler(*aimp_manager_) );
 
@@ -495,10 +519,13 @@ HRESULT AIMPControlPlugin::initialize()
                                     );
         // create XMLRPC server.
         server_.reset(new Http::Server( *server_io_service_,
+                                        *player_thread_,
                                         *http_request_handler_
                                        )
                       );
 
+        createPlayerThreadWindow();
+        startServerThreads();
         startTickTimer();
     } catch (boost::thread_resource_error& e) {
         BOOST_LOG_SEV(logger(), critical) << "Plugin initialization failed. Reason: create main server thread failed. Reason: " << e.what();
@@ -522,7 +549,10 @@ HRESULT AIMPControlPlugin::Finalize()
 
     stopTickTimer();
 
-    server_io_service_->stop();
+    stopServerThreads();
+    destroyPlayerThreadWindow();
+    player_io_service_work_.reset();
+    player_io_service_->stop();
     
     if (server_) {
         // stop the server.
@@ -538,6 +568,11 @@ HRESULT AIMPControlPlugin::Finalize()
 
     upload_track_request_handler_.reset();
 
+    if (aimp_manager_ && aimp_events_listener_id_ != 0) {
+        aimp_manager_->unRegisterListener(aimp_events_listener_id_);
+        aimp_events_listener_id_ = 0;
+    }
+
     rpc_request_handler_.reset();
 
     aimp_manager_.reset();
@@ -546,7 +581,9 @@ HRESULT AIMPControlPlugin::Finalize()
     aimp3_core_unit_.reset();
     aimp36_core_.reset();
 
-
+    // player's io_service can hold handlers with connections, so destroy it before server's io_service which owns connection sockets.
+    player_thread_.reset();
+    player_io_service_.reset();
     server_io_service_.reset();
 
     BOOST_LOG_SEV(logger(), info) << "Plugin finalization is finished";
@@ -602,10 +639,19 @@ void AIMPControlPlugin::createRpcFrontends()
                                                                       )
     REGISTER_RPC_FRONTEND(XmlRpc);
     REGISTER_RPC_FRONTEND(JsonRpc);
+    REGISTER_RPC_FRONTEND(MsgPackRpc);
     REGISTER_RPC_FRONTEND(WebCtlRpc);
 #undef REGISTER_RPC_FRONTEND
 }
 
+void AIMPControlPlugin::onAimpEvent(AIMPPlayer::AIMPManager::EVENTS event)
+{
+    rpc_request_handler_->onPlayerStateChanged();
+    if (event == AIMPPlayer::AIMPManager::EVENT_PLAYLISTS_CONTENT_CHANGE) {
+        rpc_request_handler_->invalidateResponseCache();
+    }
+}
+
 void AIMPControlPlugin::createRpcMethods()
 {
     using namespace AimpRpcMethods;
@@ -644,7 +690,7 @@ void AIMPControlPlugin::createRpcMethods()
     rpc_request_handler_->addMethod( std::auto_ptr<Rpc::Method>(
                                             new RemoveTrack(*aimp_manager_,
                                                             *rpc_request_handler_,
-                                                            *server_io_service_
+                                                            *player_io_service_
                                                             )
                                                                 )
                                     );
@@ -720,7 +766,7 @@ void AIMPControlPlugin::createRpcMethods()
     rpc_request_handler_->addMethod( std::auto_ptr<Rpc::Method>(
                                                   new Scheduler(*aimp_manager_,
                                                                 *rpc_request_handler_,
-                                                                *server_io_service_
+                                                                *player_io_service_
                                                                 )
                                                                 )
                                     );
@@ -823,6 +869,43 @@ void AIMPControlPlugin::stopTickTimer()
     }
 }
 
+void AIMPControlPlugin::startServerThreads()
+{
+    unsigned int threads_count = settings().http_server.io_threads_count;
+    if (threads_count == 0) {
+        threads_count = std::max(1u, boost::thread::hardware_concurrency());
+    }
+
+    server_io_service_work_.reset( new boost::asio::io_service::work(*server_io_service_) );
+    for (unsigned int i = 0; i != threads_count; ++i) {
+        server_threads_.create_thread( boost::bind(&AIMPControlPlugin::runServerIoService, this) );
+    }
+
+    BOOST_LOG_SEV(logger(), info) << "Server network threads started: " << threads_count;
+}
+
+void AIMPControlPlugin::stopServerThreads()
+{
+    server_io_service_work_.reset();
+    if (server_io_service_) {
+        server_io_service_->stop();
+    }
+    server_threads_.join_all();
+}
+
+void AIMPControlPlugin::runServerIoService()
+{
+    for (;;) {
+        try {
+            server_io_service_->run();
+            break; // io_service was stopped.
+        } catch (std::exception& e) {
+            // Exception in one connection should not break processing of others. Log it and continue work.
+            BOOST_LOG_SEV(logger(), error) << "Unhandled exception in server network thread: " << e.what();
+        }
+    }
+}
+
 void CALLBACK AIMPControlPlugin::onTickTimerProc(HWND /*hwnd*/,
                                                  UINT /*uMsg*/,
                                                  UINT_PTR /*idEvent*/,
@@ -832,10 +915,16 @@ void CALLBACK AIMPControlPlugin::onTickTimerProc(HWND /*hwnd*/,
 }
 
 void AIMPControlPlugin::onTick()
+{
+    pollPlayerIoService(true);
+}
+
+void AIMPControlPlugin::pollPlayerIoService(bool on_tick)
 {
     try {
-        server_io_service_->poll();
-        { // for tests
+        player_thread_wake_pending_ = false; // handlers posted from now wake thread again.
+        player_io_service_->poll();
+        if (on_tick) { // for tests
             using namespace AIMPPlayer;
             if (aimp_manager_) {
                 aimp_manager_->onTick();
@@ -844,10 +933,60 @@ void AIMPControlPlugin::onTick()
     } catch (std::exception& e) {
         // Just send error in log and stop processing.
         BOOST_LOG_SEV(logger(), critical) << "Unhandled exception inside ControlPlugin::onTick(): " << e.what();
-        server_io_service_->stop();
+        stopServerThreads();
+        player_io_service_->stop();
         stopTickTimer();
         BOOST_LOG_SEV(logger(), info) << "Service was stopped.";
     }
 }
 
+void AIMPControlPlugin::wakePlayerThread()
+{
+    if ( player_thread_window_ && !player_thread_wake_pending_.exchange(true) ) {
+        if ( !::PostMessage(player_thread_window_, kWAKE_PLAYER_THREAD_MESSAGE, 0, 0) ) {
+            player_thread_wake_pending_ = false; // handler will be run on tick.
+        }
+    }
+}
+
+void AIMPControlPlugin::createPlayerThreadWindow()
+{
+    WNDCLASSEX window_class = { sizeof(window_class) };
+    window_class.lpfnWndProc = &AIMPControlPlugin::playerThreadWindowProc;
+    window_class.hInstance = getPluginModule();
+    window_class.lpszClassName = kPLAYER_THREAD_WINDOW_CLASS;
+    if ( ::RegisterClassEx(&window_class) == 0 && GetLastError() != ERROR_CLASS_ALREADY_EXISTS ) {
+        BOOST_LOG_SEV(logger(), warning) << "RegisterClassEx failed with error: " << GetLastError() << ". Requests to player will be handled on tick.";
+        return;
+    }
+
+    player_thread_window_ = ::CreateWindowEx(0, kPLAYER_THREAD_WINDOW_CLASS, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, getPluginModule(), NULL);
+    if (!player_thread_window_) {
+        BOOST_LOG_SEV(logger(), warning) << "CreateWindowEx failed with error: " << GetLastError() << ". Requests to player will be handled on tick.";
+    }
+}
+
+void AIMPControlPlugin::destroyPlayerThreadWindow()
+{
+    if (player_thread_window_) {
+        ::DestroyWindow(player_thread_window_);
+        player_thread_window_ = NULL;
+    }
+    ::UnregisterClass( kPLAYER_THREAD_WINDOW_CLASS, getPluginModule() );
+}
+
+LRESULT CALLBACK AIMPControlPlugin::playerThreadWindowProc(HWND hwnd,
+                                                           UINT message,
+                                                           WPARAM wparam,
+                                                           LPARAM lparam)
+{
+    if (message == kWAKE_PLAYER_THREAD_MESSAGE) {
+        if (plugin_instance) {
+            plugin_instance->pollPlayerIoService(false);
+        }
+        return 0;
+    }
+    return ::DefWindowProc(hwnd, message, wparam, lparam);
+}
+
 } // namespace ControlPlugin
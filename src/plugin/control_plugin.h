@@ -5,13 +5,15 @@
 #include "aimp/aimp2_sdk.h"
 #include "aimp/aimp3_sdk/aimp3_sdk.h"
 #include "aimp/aimp3.60_sdk/aimp3_60_sdk.h"
+#include "aimp/manager.h"
 #include "settings.h"
 #include "logger.h"
 #include "utils/iunknown_impl.h"
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
+#include <boost/atomic.hpp>
 
-namespace Http          { class RequestHandler; }
+namespace Http          { class RequestHandler; class PlayerThread; }
 namespace Rpc           { class RequestHandler; }
 namespace DownloadTrack { class RequestHandler; }
 namespace UploadTrack   { class RequestHandler; }
@@ -66,9 +68,33 @@ private:
 
     HRESULT initialize();
 
-    // Runs the server's io_service loop.
+    // Runs the player's io_service loop.
     void onTick();
 
+    //! Runs ready handlers of player's io_service. on_tick is false if thread was woken by posted handler.
+    void pollPlayerIoService(bool on_tick);
+
+    //! Asks player's thread to poll its io_service as soon as possible. Called by any thread.
+    void wakePlayerThread();
+
+    //! Creates message-only window which receives wake messages in player's thread.
+    void createPlayerThreadWindow();
+    void destroyPlayerThreadWindow();
+
+    static LRESULT CALLBACK playerThreadWindowProc(HWND hwnd,
+                                                   UINT message,
+                                                   WPARAM wparam,
+                                                   LPARAM lparam);
+
+    //! Starts threads which run server's io_service. Count of threads is taken from settings.
+    void startServerThreads(); // throws boost::thread_resource_error
+
+    //! Stops server's io_service and waits until all its threads are finished.
+    void stopServerThreads();
+
+    //! Thread function of server's io_service threads.
+    void runServerIoService();
+
     static void CALLBACK onTickTimerProc(HWND hwnd,
                                          UINT uMsg,
                                          UINT_PTR idEvent,
@@ -125,6 +151,9 @@ private:
     //! Creates and register in Rpc::RequestHandler object all RPC methods.
     void createRpcMethods();
 
+    //! Drops cached and coalesced RPC results when player state is changed. Registered as AIMPManager events listener.
+    void onAimpEvent(AIMPPlayer::AIMPManager::EVENTS event);
+
     /*!
         \brief Tries to load delayed FreeImage DLL. Set flag that signals that plugin can use FreeImage functionality.
     */
@@ -163,10 +192,18 @@ private:
     boost::filesystem::wpath plugin_settings_filepath_;
 
     boost::shared_ptr<Rpc::RequestHandler> rpc_request_handler_; //!< XML/Json RPC request handler. Used by Http::RequestHandler object.
+    AIMPPlayer::AIMPManager::EventsListenerID aimp_events_listener_id_; //!< 0 if listener is not registered, AIMPManager listener IDs start from 1.
     boost::shared_ptr<DownloadTrack::RequestHandler> download_track_request_handler_; //!< Download track request handler. Used by Http::RequestHandler object.
     boost::shared_ptr<UploadTrack::RequestHandler> upload_track_request_handler_; //!< Upload track request handler. Used by Http::RequestHandler object.
     boost::shared_ptr<Http::RequestHandler> http_request_handler_; //!< Http request handler, used by Http::Server object.
-    boost::shared_ptr<boost::asio::io_service> server_io_service_;
+    boost::shared_ptr<boost::asio::io_service> player_io_service_; //!< io_service of AIMP player's thread, polled on tick and on wake. All AIMP related work is done here.
+    std::unique_ptr<boost::asio::io_service::work> player_io_service_work_; //!< poll() stops io_service which has no work, stopped io_service would not run handlers posted later.
+    boost::shared_ptr<Http::PlayerThread> player_thread_; //!< posts handlers to player_io_service_ and wakes player's thread.
+    HWND player_thread_window_; //!< null if window creation failed, then posted handlers wait for tick.
+    boost::atomic<bool> player_thread_wake_pending_; //!< wake message is posted and not received yet, so next wake does not post one more.
+    boost::shared_ptr<boost::asio::io_service> server_io_service_; //!< io_service for network I/O, it is run by server_threads_.
+    std::unique_ptr<boost::asio::io_service::work> server_io_service_work_; //!< keeps server_io_service_ running while there are no pending operations.
+    boost::thread_group server_threads_;
     boost::shared_ptr<Http::Server> server_; //!< Simple Http server.
 
     static const std::wstring kPLUGIN_SETTINGS_FILENAME; //<! default plugin settings filename.
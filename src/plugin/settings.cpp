@@ -18,6 +18,8 @@ using boost::property_tree::wptree;
 
 static std::wstring kDEFAULT_REALM = L"AIMP Control plugin";
 static std::wstring kDEFAULT_PORT = L"3333";
+static const unsigned int kDEFAULT_KEEP_ALIVE_TIMEOUT = 15; // seconds.
+static const unsigned int kDEFAULT_MAX_REQUESTS_PER_CONNECTION = 100;
 
 Manager::Manager()
 {
@@ -50,6 +52,9 @@ void Manager::setDefaultHttpServerSettings()
     s.interfaces.insert(Settings::HttpServer::NetworkInterface("", "localhost", StringEncoding::utf16_to_system_ansi_encoding_safe(kDEFAULT_PORT)));
     s.document_root = L"htdocs";
     s.realm = kDEFAULT_REALM;
+    s.io_threads_count = 0;
+    s.keep_alive_timeout = kDEFAULT_KEEP_ALIVE_TIMEOUT;
+    s.max_requests_per_connection = kDEFAULT_MAX_REQUESTS_PER_CONNECTION;
 }
 
 void loadPropertyTreeFromFile(wptree& pt, const boost::filesystem::wpath& filename) // throws std::exception
@@ -140,6 +145,10 @@ void loadSettingsFromPropertyTree(Settings& settings, const wptree& pt) // throw
     
     std::wstring realm = pt.get<std::wstring>(L"settings.httpserver.realm", kDEFAULT_REALM);
 
+    const unsigned int io_threads_count = pt.get<unsigned int>(L"settings.httpserver.io_threads_count", 0);
+    const unsigned int keep_alive_timeout = pt.get<unsigned int>(L"settings.httpserver.keep_alive_timeout", kDEFAULT_KEEP_ALIVE_TIMEOUT);
+    const unsigned int max_requests_per_connection = pt.get<unsigned int>(L"settings.httpserver.max_requests_per_connection", kDEFAULT_MAX_REQUESTS_PER_CONNECTION);
+
     std::set<std::string> init_cookies;
     try {
         for ( const auto& v : pt.get_child(L"settings.httpserver.init_cookies") ) {
@@ -161,6 +170,10 @@ void loadSettingsFromPropertyTree(Settings& settings, const wptree& pt) // throw
     tmp = pt.get<std::wstring>(L"settings.misc.enable_scheduler", L"false");
     std::transform(tmp.begin(), tmp.end(), tmp.begin(), ::tolower);
     bool enable_scheduler = tmp == L"true" || tmp == L"1";
+
+    tmp = pt.get<std::wstring>(L"settings.misc.use_columnar_entries_store", L"false");
+    std::transform(tmp.begin(), tmp.end(), tmp.begin(), ::tolower);
+    bool use_columnar_entries_store = tmp == L"true" || tmp == L"1";
     
     // all work has been done, save result.
     using std::swap;
@@ -169,6 +182,9 @@ void loadSettingsFromPropertyTree(Settings& settings, const wptree& pt) // throw
     settings.http_server.document_root.swap(server_document_root);
     settings.http_server.init_cookies.swap(init_cookies);
     settings.http_server.realm.swap(realm);
+    settings.http_server.io_threads_count = io_threads_count;
+    settings.http_server.keep_alive_timeout = keep_alive_timeout;
+    settings.http_server.max_requests_per_connection = max_requests_per_connection;
 
     settings.logger.severity_level = log_severity_level;
     settings.logger.directory.swap(log_directory);
@@ -177,6 +193,7 @@ void loadSettingsFromPropertyTree(Settings& settings, const wptree& pt) // throw
     settings.misc.enable_track_upload = enable_track_upload;
     settings.misc.enable_physical_track_deletion = enable_physical_track_deletion;
     settings.misc.enable_scheduler = enable_scheduler;
+    settings.misc.use_columnar_entries_store = use_columnar_entries_store;
 }
 
 void Manager::load(const boost::filesystem::wpath& filename)
@@ -237,10 +254,14 @@ void saveSettingsToPropertyTree(const Settings& settings, wptree& pt) // throws
 
     pt.put( L"settings.httpserver.document_root", settings.http_server.document_root );
     pt.put( L"settings.httpserver.realm", settings.http_server.realm );
+    pt.put( L"settings.httpserver.io_threads_count", settings.http_server.io_threads_count );
+    pt.put( L"settings.httpserver.keep_alive_timeout", settings.http_server.keep_alive_timeout );
+    pt.put( L"settings.httpserver.max_requests_per_connection", settings.http_server.max_requests_per_connection );
 
     pt.put(L"settings.misc.enable_track_upload", settings.misc.enable_track_upload);
     pt.put(L"settings.misc.enable_physical_track_deletion", settings.misc.enable_physical_track_deletion);
     pt.put(L"settings.misc.enable_scheduler", settings.misc.enable_scheduler);
+    pt.put(L"settings.misc.use_columnar_entries_store", settings.misc.use_columnar_entries_store);
 
     // Put log directory in property tree
     pt.put(L"settings.logging.directory", settings.logger.directory);
@@ -39,6 +39,10 @@ struct Settings
         };
 
         std::set<NetworkInterface> interfaces;
+
+        unsigned int io_threads_count; //!< Count of threads which perform network I/O. 0 means count of hardware threads.
+        unsigned int keep_alive_timeout; //!< Time in seconds to wait next request on persistent connection. 0 means infinite waiting.
+        unsigned int max_requests_per_connection; //!< Maximum count of requests handled by one persistent connection. 0 means no limit.
     } http_server;
 
     struct Logger {
@@ -51,6 +55,7 @@ struct Settings
         bool enable_track_upload;
         bool enable_physical_track_deletion;
         bool enable_scheduler;
+        bool use_columnar_entries_store; // AIMP 3.6 only.
     } misc;
 };
 
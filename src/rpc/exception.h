@@ -22,7 +22,8 @@ enum ERROR_CODES {
     INDEX_RANGE_ERROR = 4, /*!< Value of index argumet is out of range. */
     OBJECT_ACCESS_ERROR = 5, /*!< Object does not have requested field. */
     VALUE_RANGE_ERROR = 6, /*!< Value of argument is out of range. */
-    INTERNAL_ERROR = 7 /*!< Unknown error. */
+    INTERNAL_ERROR = 7, /*!< Unknown error. */
+    INVALID_REQUEST_ERROR = 8 /*!< Request is not valid RPC call, for example empty batch or batch item which is not an object. */
 };
 
 class Exception
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <string>
+#include <boost/utility/string_ref.hpp>
 
 namespace Rpc
 {
@@ -14,7 +15,7 @@ class Frontend
 {
 public:
 
-    virtual bool canHandleRequest(const std::string& uri) const = 0;
+    virtual bool canHandleRequest(boost::string_ref uri) const = 0;
 
     virtual RequestParser& requestParser() = 0;
 
@@ -2,10 +2,12 @@
 
 #include <string>
 #include <boost/noncopyable.hpp>
+#include "rpc/exception.h"
 
 namespace Rpc {
 
 class Value;
+class CallContext;
 
 //! flag to RequestHandler response, if response should be delayed or sent immediately.
 enum ResponseType { RESPONSE_DELAYED, RESPONSE_IMMEDIATE };
@@ -23,10 +25,21 @@ public:
     virtual ~Method() {}
 
     /*!
-        \brief Execute the method. Subclasses must provide a definition for this method.
-        \return true if method response should be delayed (Comet technique, "subscribe" method implementation), false if response must be sent immediately.
+        \brief Execute the method within context of the call.
+               Method which completes the call later(on AIMP event, timer or in worker thread) overrides this version,
+               takes response sender from context and returns RESPONSE_DELAYED.
+               Default implementation calls execute() without context.
+        \return RESPONSE_DELAYED if method response should be delayed (Comet technique, "subscribe" method implementation), RESPONSE_IMMEDIATE if response must be sent immediately.
     */
-    virtual ResponseType execute(const Value& root_request, Value& root_response) = 0;
+    virtual ResponseType execute(const Value& root_request, Value& root_response, CallContext& /*context*/)
+        { return execute(root_request, root_response); }
+
+    /*!
+        \brief Execute the method which does not need call context. Subclasses must override either this method or version with context.
+        \return RESPONSE_IMMEDIATE usually since response can be delayed only with help of context.
+    */
+    virtual ResponseType execute(const Value& /*root_request*/, Value& /*root_response*/)
+        { throw Exception("method is not implemented", INTERNAL_ERROR); }
 
     /*!
         \brief Returns a help string for the method.
@@ -35,6 +48,27 @@ public:
     virtual std::string help() const
         { return std::string(); }
 
+    /*!
+        \brief Returns true if execute() can return RESPONSE_DELAYED.
+               Such methods can not be called in batch request since batch response is sent at once.
+    */
+    virtual bool canRespondDelayed() const
+        { return false; }
+
+    /*!
+        \brief Returns true if result for this request depends only on request params and playlists content.
+               RequestHandler caches serialized result of such request until playlists are changed.
+    */
+    virtual bool responseCacheable(const Value& /*root_request*/) const
+        { return false; }
+
+    /*!
+        \brief Returns true if identical calls made while player state is not changed can share result of one execution.
+               Method must not change player state and its result must depend only on params and player state.
+    */
+    virtual bool coalescable(const Value& /*root_request*/) const
+        { return false; }
+
     const std::string& name() const
         { return name_; }
 
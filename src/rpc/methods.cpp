@@ -4,10 +4,12 @@
 #include "methods.h"
 #include "aimp/manager.h"
 #include "aimp/manager_impl_common.h"
+#include "aimp/entries_store.h"
 #include "plugin/logger.h"
 #include "plugin/control_plugin.h"
 #include "plugin/settings.h"
 #include "rpc/exception.h"
+#include "rpc/params.h"
 #include "rpc/value.h"
 #include "rpc/request_handler.h"
 #include "utils/util.h"
@@ -36,13 +38,125 @@ const PlaylistID kPlaylistIdNotUsed = 0;
 
 using namespace Rpc;
 
+namespace {
+
+// Parameters of methods, each schema is built once at startup and shared by all calls.
+
+struct TrackDescParams
+{
+    PlaylistID playlist_id;
+    PlaylistEntryID track_id;
+};
+
+// AIMP 2.6 needs playlist id to find track, entry ids are unique in AIMP 3.x.
+const ParamsSchema<TrackDescParams> kTrackDescParams = ParamsSchema<TrackDescParams>().optional("playlist_id", &TrackDescParams::playlist_id, kPlaylistIdNotUsed)
+                                                                                      .required("track_id", &TrackDescParams::track_id);
+const ParamsSchema<TrackDescParams> kTrackDescParams26 = ParamsSchema<TrackDescParams>().required("playlist_id", &TrackDescParams::playlist_id)
+                                                                                        .required("track_id", &TrackDescParams::track_id);
+
+//! Parameters of methods which return player mode and change it if value is passed.
+template <typename T>
+struct ModeParams
+{
+    boost::optional<T> value;
+};
+
+template <typename T>
+ParamsSchema< ModeParams<T> > modeParamsSchema(const char* name)
+{
+    return ParamsSchema< ModeParams<T> >().optional(name, &ModeParams<T>::value);
+}
+
+const ParamsSchema< ModeParams<bool> > kShuffleParams      = modeParamsSchema<bool>("shuffle_on");
+const ParamsSchema< ModeParams<bool> > kRepeatParams       = modeParamsSchema<bool>("repeat_on");
+const ParamsSchema< ModeParams<bool> > kMuteParams         = modeParamsSchema<bool>("mute_on");
+const ParamsSchema< ModeParams<bool> > kRadioCaptureParams = modeParamsSchema<bool>("radio_capture_on");
+const ParamsSchema< ModeParams<int> >  kVolumeParams       = modeParamsSchema<int>("level");
+
+struct StatusParams
+{
+    int status_id;
+    boost::optional<int> value;
+};
+
+const ParamsSchema<StatusParams> kStatusParams = ParamsSchema<StatusParams>().required("status_id", &StatusParams::status_id)
+                                                                             .optional("value", &StatusParams::value);
+
+struct EnqueueTrackParams
+{
+    bool insert_at_queue_beginning;
+};
+
+const ParamsSchema<EnqueueTrackParams> kEnqueueTrackParams = ParamsSchema<EnqueueTrackParams>().optional("insert_at_queue_beginning", &EnqueueTrackParams::insert_at_queue_beginning, false); // by default insert at the end of queue.
+
+struct QueueTrackMoveParams
+{
+    boost::optional<int> old_queue_index;
+    int new_queue_index;
+};
+
+const ParamsSchema<QueueTrackMoveParams> kQueueTrackMoveParams = ParamsSchema<QueueTrackMoveParams>().optional("old_queue_index", &QueueTrackMoveParams::old_queue_index)
+                                                                                                     .required("new_queue_index", &QueueTrackMoveParams::new_queue_index);
+
+struct FormattedEntryTitleParams
+{
+    std::string format_string;
+};
+
+const ParamsSchema<FormattedEntryTitleParams> kFormattedEntryTitleParams = ParamsSchema<FormattedEntryTitleParams>().required("format_string", &FormattedEntryTitleParams::format_string);
+
+struct PlaylistParams
+{
+    PlaylistID playlist_id;
+};
+
+const ParamsSchema<PlaylistParams> kPlaylistParams = ParamsSchema<PlaylistParams>().required("playlist_id", &PlaylistParams::playlist_id);
+
+struct TrackRatingParams
+{
+    boost::optional<double> rating;
+};
+
+const ParamsSchema<TrackRatingParams> kTrackRatingParams = ParamsSchema<TrackRatingParams>().optional("rating", &TrackRatingParams::rating);
+
+struct AddURLToPlaylistParams
+{
+    PlaylistID playlist_id;
+    std::string url;
+};
+
+const ParamsSchema<AddURLToPlaylistParams> kAddURLToPlaylistParams = ParamsSchema<AddURLToPlaylistParams>().required("playlist_id", &AddURLToPlaylistParams::playlist_id)
+                                                                                                           .required("url", &AddURLToPlaylistParams::url);
+
+struct RemoveTrackParams
+{
+    bool physically;
+};
+
+const ParamsSchema<RemoveTrackParams> kRemoveTrackParams = ParamsSchema<RemoveTrackParams>().optional("physically", &RemoveTrackParams::physically, false);
+
+struct CreatePlaylistParams
+{
+    std::string title;
+};
+
+const ParamsSchema<CreatePlaylistParams> kCreatePlaylistParams = ParamsSchema<CreatePlaylistParams>().required("title", &CreatePlaylistParams::title);
+
+} // namespace anonymous
+
 TrackDescription AIMPRPCMethod::getTrackDesc(const Rpc::Value& params) const // throws Rpc::Exception
 {
     const bool require_playlist_id = dynamic_cast<AIMPManager26*>(&aimp_manager_) != nullptr;
-    const PlaylistID playlist_id = require_playlist_id ? params["playlist_id"]
-                                                       : params.isMember("playlist_id") ? params["playlist_id"]
-                                                                                        : kPlaylistIdNotUsed;
-    return TrackDescription(playlist_id, params["track_id"]);
+    TrackDescParams track_desc_params;
+    (require_playlist_id ? kTrackDescParams26 : kTrackDescParams).bind(params, &track_desc_params);
+    return TrackDescription(track_desc_params.playlist_id, track_desc_params.track_id);
+}
+
+bool AIMPRPCMethod::concretePlaylistRequested(const Rpc::Value& root_request)
+{
+    const Rpc::Value* params = root_request.findMember("params");
+    const Rpc::Value* playlist_id = params ? params->findMember("playlist_id") : nullptr;
+    return playlist_id && playlist_id->type() == Rpc::Value::TYPE_INT && int(*playlist_id) != -1;
 }
 
 Rpc::Value::Object emptyResult()
@@ -120,12 +234,13 @@ bool Status::statusGetSetSupported(AIMPManager::STATUS status) const
 
 ResponseType Status::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    const AIMPManager::STATUS status = static_cast<AIMPManager::STATUS>(static_cast<int>(params["status_id"]));
+    StatusParams params;
+    kStatusParams.bind(root_request["params"], &params);
+    const AIMPManager::STATUS status = static_cast<AIMPManager::STATUS>(params.status_id);
     if ( aimpStatusValid(status) || !statusGetSetSupported(status) ) {
-        if ( params.isMember("value") ) { // set mode if argument was passed.
+        if (params.value) { // set mode if argument was passed.
             try {
-                aimp_manager_.setStatus(status, params["value"]);
+                aimp_manager_.setStatus(status, *params.value);
             } catch (std::runtime_error&) {
                 throw Rpc::Exception("Status set failed", STATUS_SET_FAILED);
             }
@@ -141,9 +256,10 @@ ResponseType Status::execute(const Rpc::Value& root_request, Rpc::Value& root_re
 
 ResponseType ShufflePlaybackMode::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    if (params.type() == Rpc::Value::TYPE_OBJECT && params.size() == 1) { // set mode if argument was passed.
-        const bool shuffle_mode_on = params["shuffle_on"];
+    ModeParams<bool> params;
+    kShuffleParams.bind(root_request["params"], &params);
+    if (params.value) { // set mode if argument was passed.
+        const bool shuffle_mode_on = *params.value;
         try {
             aimp_manager_.setStatus(AIMPManager::STATUS_SHUFFLE, shuffle_mode_on);
         } catch (std::runtime_error& e) {
@@ -160,9 +276,10 @@ ResponseType ShufflePlaybackMode::execute(const Rpc::Value& root_request, Rpc::V
 
 ResponseType RepeatPlaybackMode::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    if (params.type() == Rpc::Value::TYPE_OBJECT && params.size() == 1) { // set mode if argument was passed.
-        const bool repeat_mode_on = params["repeat_on"];
+    ModeParams<bool> params;
+    kRepeatParams.bind(root_request["params"], &params);
+    if (params.value) { // set mode if argument was passed.
+        const bool repeat_mode_on = *params.value;
         try {
             aimp_manager_.setStatus(AIMPManager::STATUS_REPEAT, repeat_mode_on);
         } catch (std::runtime_error& e) {
@@ -179,9 +296,10 @@ ResponseType RepeatPlaybackMode::execute(const Rpc::Value& root_request, Rpc::Va
 
 ResponseType VolumeLevel::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    if (params.type() == Rpc::Value::TYPE_OBJECT && params.size() == 1) { // set volume if value was passed.
-        const int volume_level(params["level"]);
+    ModeParams<int> params;
+    kVolumeParams.bind(root_request["params"], &params);
+    if (params.value) { // set volume if value was passed.
+        const int volume_level = *params.value;
         if ( !(0 <= volume_level && volume_level <= 100) ) {
             throw Rpc::Exception("Volume level is out of range [0, 100].", VOLUME_OUT_OF_RANGE);
         }
@@ -202,9 +320,10 @@ ResponseType VolumeLevel::execute(const Rpc::Value& root_request, Rpc::Value& ro
 
 ResponseType Mute::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    if (params.type() == Rpc::Value::TYPE_OBJECT && params.size() == 1) { // set mode if argument was passed.
-        const bool mute_on = params["mute_on"];
+    ModeParams<bool> params;
+    kMuteParams.bind(root_request["params"], &params);
+    if (params.value) { // set mode if argument was passed.
+        const bool mute_on = *params.value;
         try {
             aimp_manager_.setStatus(AIMPManager::STATUS_MUTE, mute_on);
         } catch (std::runtime_error& e) {
@@ -221,9 +340,10 @@ ResponseType Mute::execute(const Rpc::Value& root_request, Rpc::Value& root_resp
 
 ResponseType RadioCaptureMode::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    if (params.type() == Rpc::Value::TYPE_OBJECT && params.size() == 1) { // set mode if argument was passed.
-        const bool value = params["radio_capture_on"];
+    ModeParams<bool> params;
+    kRadioCaptureParams.bind(root_request["params"], &params);
+    if (params.value) { // set mode if argument was passed.
+        const bool value = *params.value;
         try {
             aimp_manager_.setStatus(AIMPManager::STATUS_RADIO_CAPTURE, value);
         } catch (std::runtime_error& e) {
@@ -240,12 +360,14 @@ ResponseType RadioCaptureMode::execute(const Rpc::Value& root_request, Rpc::Valu
 
 ResponseType GetFormattedEntryTitle::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
+    const Rpc::Value& rpc_params = root_request["params"];
+    FormattedEntryTitleParams params;
+    kFormattedEntryTitleParams.bind(rpc_params, &params);
 
-    const TrackDescription track_desc(getTrackDesc(params));
+    const TrackDescription track_desc(getTrackDesc(rpc_params));
     try {
         using namespace StringEncoding;
-        root_response["result"]["formatted_string"] = utf16_to_utf8( aimp_manager_.getFormattedEntryTitle(track_desc, params["format_string"]) );
+        root_response["result"]["formatted_string"] = utf16_to_utf8( aimp_manager_.getFormattedEntryTitle(track_desc, params.format_string) );
     } catch(std::runtime_error&) {
         throw Rpc::Exception("Specified track does not exist.", TRACK_NOT_FOUND);
     } catch (std::invalid_argument&) {
@@ -257,13 +379,13 @@ ResponseType GetFormattedEntryTitle::execute(const Rpc::Value& root_request, Rpc
 
 ResponseType EnqueueTrack::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    const TrackDescription track_desc(getTrackDesc(params));
-    const bool insert_at_queue_beginning = params.isMember("insert_at_queue_beginning") ? bool(params["insert_at_queue_beginning"]) 
-                                                                                        : false; // by default insert at the end of queue.
+    const Rpc::Value& rpc_params = root_request["params"];
+    EnqueueTrackParams params;
+    kEnqueueTrackParams.bind(rpc_params, &params);
+    const TrackDescription track_desc(getTrackDesc(rpc_params));
 
     try {
-        aimp_manager_.enqueueEntryForPlay(track_desc, insert_at_queue_beginning);
+        aimp_manager_.enqueueEntryForPlay(track_desc, params.insert_at_queue_beginning);
         root_response["result"] = emptyResult();
     } catch (std::runtime_error&) {
         throw Rpc::Exception("Enqueue track failed. Reason: internal AIMP error.", ENQUEUE_TRACK_FAILED);
@@ -274,14 +396,16 @@ ResponseType EnqueueTrack::execute(const Rpc::Value& root_request, Rpc::Value& r
 ResponseType QueueTrackMove::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
     if ( AIMPPlayer::IPlaylistQueueManager* playlist_queue_manager = dynamic_cast<AIMPPlayer::IPlaylistQueueManager*>(&aimp_manager_) ) {
-        const Rpc::Value& params = root_request["params"];
+        const Rpc::Value& rpc_params = root_request["params"];
+        QueueTrackMoveParams params;
+        kQueueTrackMoveParams.bind(rpc_params, &params);
 
         try {
-            if (params.isMember("old_queue_index")) {
-                playlist_queue_manager->moveQueueEntry(params["old_queue_index"], params["new_queue_index"]);
+            if (params.old_queue_index) {
+                playlist_queue_manager->moveQueueEntry(*params.old_queue_index, params.new_queue_index);
             } else {
-                const TrackDescription track_desc(getTrackDesc(params));
-                playlist_queue_manager->moveQueueEntry(track_desc, params["new_queue_index"]);
+                const TrackDescription track_desc(getTrackDesc(rpc_params));
+                playlist_queue_manager->moveQueueEntry(track_desc, params.new_queue_index);
             }            
             root_response["result"] = emptyResult();
         } catch (std::runtime_error&) {
@@ -574,36 +698,58 @@ std::string GetPlaylistEntries::getOrderString(const Rpc::Value& params) const
     return result;
 }
 
-std::string GetPlaylistEntries::getLimitString(const Rpc::Value& params) const
+std::string GetPlaylistEntries::getLimitString(const Rpc::Value& params, Utilities::QueryArgSetters* query_arg_setters) const
 {
-    std::ostringstream os;
+    using namespace Utilities;
+
+    std::string result;
 	if ( params.isMember(kRQST_KEY_START_INDEX) && params.isMember(kRQST_KEY_ENTRIES_COUNT) ) {
         const int entries_count = params[kRQST_KEY_ENTRIES_COUNT];
         if (entries_count != -1) { // -1 is special value which means "all available items". Included to support jQuery Datatables 1.7.6.
             const int start_entry_index = params[kRQST_KEY_START_INDEX];
-	        os << "LIMIT " << start_entry_index << ',' << entries_count;
+	        result = "LIMIT ?,?";
+            query_arg_setters->push_back( boost::bind(&bindInt, _1, _2, start_entry_index) );
+            query_arg_setters->push_back( boost::bind(&bindInt, _1, _2, entries_count) );
         }
 
         if ( entryLocationDeterminationMode() ) {
             pagination_info_->entries_on_page_ = entries_count;
         }
     }
-    return os.str();
+    return result;
 }
 
-std::string GetPlaylistEntries::getWhereString(const Rpc::Value& params, const int playlist_id) const
+std::string GetPlaylistEntries::getWhereString(const Rpc::Value& params, const int playlist_id, Utilities::QueryArgSetters* query_arg_setters) const
 {
     using namespace Utilities;
 
-    struct LikeArgSetter : public std::binary_function<sqlite3_stmt*, int, void>
+    std::string result;
+    if (!queuedEntriesMode()) {
+        result = "WHERE playlist_id=?";
+        query_arg_setters->push_back( boost::bind(&bindInt, _1, _2, playlist_id) );
+    }
+
+    const std::string filter = getFilterString(params, playlist_id, query_arg_setters);
+    if ( !filter.empty() ) {
+        result += result.empty() ? "WHERE " : " AND ";
+        result += filter;
+    }
+    return result;
+}
+
+std::string GetPlaylistEntries::getFilterString(const Rpc::Value& params, const int playlist_id, Utilities::QueryArgSetters* query_arg_setters) const
+{
+    using namespace Utilities;
+
+    struct TextArgSetter : public std::binary_function<sqlite3_stmt*, int, void>
     {
         typedef std::string StringT;
-        StringT like_arg_;
-        LikeArgSetter(const StringT& like_arg) : like_arg_(like_arg) {}
+        StringT text_arg_;
+        TextArgSetter(const StringT& text_arg) : text_arg_(text_arg) {}
         void operator()(sqlite3_stmt* stmt, int bind_index) const {
             const int rc_db = sqlite3_bind_text(stmt, bind_index,
-                                                like_arg_.c_str(),
-                                                like_arg_.size() * sizeof(StringT::value_type),
+                                                text_arg_.c_str(),
+                                                text_arg_.size() * sizeof(StringT::value_type),
                                                 SQLITE_TRANSIENT);
             if (SQLITE_OK != rc_db) {
                 const std::string msg = MakeString() << "Error sqlite3_bind_text: " << rc_db;
@@ -613,22 +759,28 @@ std::string GetPlaylistEntries::getWhereString(const Rpc::Value& params, const i
     };
 
     std::ostringstream os;
-    
-    if (!queuedEntriesMode()) {
-        os << "WHERE playlist_id=" << playlist_id;
-    }
 
 	if ( params.isMember(kRQST_KEY_SEARCH_STRING) ) {
         const std::string& search_string = params[kRQST_KEY_SEARCH_STRING];
         if ( !search_string.empty() && !fields_to_filter_.empty() ) { ///??? search in all fields or only in requested ones.
-            const std::string like_arg = '%' + search_string + '%';
-            const QueryArgSetter& setter = boost::bind<void>(LikeArgSetter(like_arg), _1, _2);
-            
-            if (!queuedEntriesMode()) {
-                os << " AND (";
-            } else {
-                os << " WHERE (";
+            // PlaylistsEntriesSearch index contains exactly fields_to_filter_ fields and treats pattern literally,
+            // so LIKE scan is needed only for queue which is not indexed, and for search strings with LIKE wildcards.
+            if (   !queuedEntriesMode()
+                && search_string.find_first_of("%_") == std::string::npos
+                )
+            {
+                query_arg_setters->push_back( boost::bind<void>(TextArgSetter(search_string), _1, _2) );
+                if ( AIMPPlayer::getPlaylistsEntriesStore(aimp_manager_) ) {
+                    return "pattern=?"; // columnar store searches the same fields itself, there is no PlaylistsEntriesSearch with it.
+                }
+                query_arg_setters->push_back( boost::bind(&bindInt, _1, _2, playlist_id) );
+                return "entry_id IN (SELECT entry_id FROM PlaylistsEntriesSearch WHERE pattern=? AND playlist_id=?)";
             }
+
+            const std::string like_arg = '%' + search_string + '%';
+            const QueryArgSetter& setter = boost::bind<void>(TextArgSetter(like_arg), _1, _2);
+
+            os << '(';
             FieldNames::const_iterator begin = fields_to_filter_.begin(),
                                        end   = fields_to_filter_.end();
             for (FieldNames::const_iterator fieldname_it = begin;
@@ -636,7 +788,7 @@ std::string GetPlaylistEntries::getWhereString(const Rpc::Value& params, const i
                                             ++fieldname_it
                  )
             {
-                query_arg_setters_.push_back(setter);
+                query_arg_setters->push_back(setter);
 
                 os << *fieldname_it << " LIKE ?";
                 if (fieldname_it + 1 != end) {
@@ -673,37 +825,75 @@ std::string GetPlaylistEntries::getColumnsString() const
     return result;
 }
 
-size_t GetPlaylistEntries::getTotalEntriesCount(sqlite3* playlists_db, const int playlist_id) const
+void GetPlaylistEntries::getEntriesCounts(sqlite3* playlists_db, const int playlist_id, const Rpc::Value& params,
+                                          size_t* total_entries_count, size_t* found_entries_count) // throws std::runtime_error
 {
     using namespace Utilities;
 
-    std::ostringstream query;
-    query << "SELECT COUNT(*) FROM ";
-    if (!queuedEntriesMode()) {
-        query << "PlaylistsEntries WHERE playlist_id=" << playlist_id;
-    } else {
-        query << "QueuedEntries";
+    const std::string search_string = params.isMember(kRQST_KEY_SEARCH_STRING) ? static_cast<const std::string&>(params[kRQST_KEY_SEARCH_STRING])
+                                                                               : std::string();
+
+    EntriesCounts& counts = last_entries_counts_;
+    const int db_total_changes = sqlite3_total_changes(playlists_db);
+    if (   counts.db_total_changes    == db_total_changes
+        && counts.playlist_id         == playlist_id
+        && counts.queued_entries_mode == queuedEntriesMode()
+        && counts.search_string       == search_string
+        )
+    {
+        *total_entries_count = counts.total_entries_count;
+        *found_entries_count = counts.found_entries_count;
+        return;
     }
 
-    sqlite3_stmt* stmt = createStmt( playlists_db,
-                                     query.str()
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    const AIMPPlayer::PlaylistsEntriesStore* entries_store = AIMPPlayer::getPlaylistsEntriesStore(aimp_manager_);
+    if (   entries_store
+        && !queuedEntriesMode()
+        && search_string.find_first_of("%_") == std::string::npos
+        )
+    {
+        // pattern=? is only constraint for store, it can not be evaluated in expression, so store counts entries itself.
+        AIMPPlayer::countPlaylistEntries(*entries_store, playlist_id, !fields_to_filter_.empty() ? search_string : std::string(),
+                                         total_entries_count, found_entries_count);
+    } else {
+        // count all entries and entries which pass filter in the same pass: SELECT COUNT(*),SUM(CASE WHEN filter THEN 1 ELSE 0 END) FROM ...
+        QueryArgSetters query_arg_setters;
+        const std::string filter = getFilterString(params, playlist_id, &query_arg_setters);
 
-    size_t total_entries_count = 0;
+        std::string query = "SELECT COUNT(*)";
+        if ( !filter.empty() ) {
+            query += ",SUM(CASE WHEN " + filter + " THEN 1 ELSE 0 END)";
+        }
+        if (!queuedEntriesMode()) {
+            query += " FROM PlaylistsEntries WHERE playlist_id=?";
+            query_arg_setters.push_back( boost::bind(&bindInt, _1, _2, playlist_id) );
+        } else {
+            query += " FROM QueuedEntries";
+        }
 
-	const int rc_db = sqlite3_step(stmt);
-    if (SQLITE_ROW == rc_db) {
-        assert(sqlite3_column_count(stmt) > 0);
-        total_entries_count = sqlite3_column_int(stmt, 0);
-    } else {
-        const std::string msg = MakeString() << "sqlite3_step() error "
-                                             << rc_db << ": " << sqlite3_errmsg(playlists_db)
-                                             << ". Query: " << query.str();
-        throw std::runtime_error(msg);
+        const StatementCache::Lease stmt_lease = statement_cache_.get(playlists_db, query); // statement is reset on lease release.
+        sqlite3_stmt* stmt = stmt_lease.get();
+        bindQueryArgs(stmt, query_arg_setters);
+
+	    const int rc_db = sqlite3_step(stmt);
+        if (SQLITE_ROW == rc_db) {
+            *total_entries_count = sqlite3_column_int(stmt, 0);
+            *found_entries_count = !filter.empty() ? sqlite3_column_int(stmt, 1) // SUM() of no rows is NULL, it is read as 0.
+                                                   : *total_entries_count;
+        } else {
+            const std::string msg = MakeString() << "sqlite3_step() error "
+                                                 << rc_db << ": " << sqlite3_errmsg(playlists_db)
+                                                 << ". Query: " << query;
+            throw std::runtime_error(msg);
+        }
     }
 
-    return total_entries_count;
+    counts.db_total_changes    = db_total_changes;
+    counts.playlist_id         = playlist_id;
+    counts.queued_entries_mode = queuedEntriesMode();
+    counts.search_string       = search_string;
+    counts.total_entries_count = *total_entries_count;
+    counts.found_entries_count = *found_entries_count;
 }
 
 Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
@@ -735,29 +925,28 @@ Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rp
     const int playlist_id = !queuedEntriesMode() ? aimp_manager_.getAbsolutePlaylistID(params["playlist_id"])
                                                  : playlist_id_not_used;
 
-    query_arg_setters_.clear();
-
-    std::ostringstream query_without_limit,
-                       query_with_limit;
-    query_without_limit << "SELECT " << getColumnsString() << " FROM "
-                        << (!queuedEntriesMode() ? "PlaylistsEntries" : "QueuedEntries")
-                        << ' '   
-                        << getWhereString(params, playlist_id) << ' ' 
-                        << getOrderString(params);
-    query_with_limit << query_without_limit.str() << ' '
-                     << getLimitString(params);
+    // values are passed as args, so query text depends only on requested fields, order, presence of search and limit, and compiled statement is reused.
+    QueryArgSetters query_arg_setters;
+    std::ostringstream query_os;
+    query_os << "SELECT " << getColumnsString() << " FROM "
+             << (!queuedEntriesMode() ? "PlaylistsEntries" : "QueuedEntries")
+             << ' '
+             << getWhereString(params, playlist_id, &query_arg_setters) << ' '
+             << getOrderString(params);
+    QueryArgSetters limit_arg_setters;
+    const std::string limit = getLimitString(params, &limit_arg_setters); // entries_on_page_ is set here in location determination mode.
+    if ( !entryLocationDeterminationMode() ) { // entry location is searched in whole representation.
+        query_os << ' ' << limit;
+        query_arg_setters.splice(query_arg_setters.end(), limit_arg_setters);
+    }
 
-    const std::string query = !entryLocationDeterminationMode() ? query_with_limit.str() : query_without_limit.str();
+    const std::string query = query_os.str();
 
     sqlite3* playlists_db = AIMPPlayer::getPlaylistsDB(aimp_manager_);
-    sqlite3_stmt* stmt = createStmt( playlists_db, query.c_str() );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    const StatementCache::Lease stmt_lease = statement_cache_.get(playlists_db, query); // statement is reset on lease release.
+    sqlite3_stmt* stmt = stmt_lease.get();
 
-    // bind all query args.
-    size_t bind_index = 1;
-    BOOST_FOREACH(auto& setter, query_arg_setters_) {
-        setter(stmt, bind_index++);
-    }
+    bindQueryArgs(stmt, query_arg_setters);
 
 #ifdef _DEBUG
     const auto& setters = entry_fields_filler_.setters_required_;
@@ -772,6 +961,7 @@ Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rp
 
     if ( !entryLocationDeterminationMode() ) {
         Rpc::Value& rpc_result = root_response["result"];
+        { // rpcvalue_entries must not outlive this block: insertion of other members into rpc_result invalidates it.
         Rpc::Value& rpcvalue_entries  = rpc_result[kRSLT_KEY_ENTRIES];
         rpcvalue_entries.setSize(0); // return zero-length array, not null if no entires found.
 
@@ -793,9 +983,13 @@ Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rp
                 throw std::runtime_error(msg);
 		    }
         }
+        }
 
-        rpc_result[kRSLT_KEY_TOTAL_ENTRIES_COUNT]    = getTotalEntriesCount(playlists_db, playlist_id);
-        rpc_result[kRSLT_KEY_COUNT_OF_FOUND_ENTRIES] = getRowsCount(playlists_db, query_without_limit.str(), &query_arg_setters_);
+        size_t total_entries_count,
+               found_entries_count;
+        getEntriesCounts(playlists_db, playlist_id, params, &total_entries_count, &found_entries_count);
+        rpc_result[kRSLT_KEY_TOTAL_ENTRIES_COUNT]    = total_entries_count;
+        rpc_result[kRSLT_KEY_COUNT_OF_FOUND_ENTRIES] = found_entries_count;
     } else {
         size_t entry_index = 0;
         for(;;) {
@@ -895,12 +1089,10 @@ Rpc::ResponseType GetQueuedEntries::execute(const Rpc::Value& root_request, Rpc:
 
 ResponseType GetPlaylistEntriesCount::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    if (params.type() != Rpc::Value::TYPE_OBJECT || params.size() != 1) {
-        throw Rpc::Exception("Wrong arguments count. Wait one integer value: playlist_id.", WRONG_ARGUMENT);
-    }
+    PlaylistParams params;
+    kPlaylistParams.bind(root_request["params"], &params);
 
-    const size_t entries_count = AIMPPlayer::getEntriesCountDB(params["playlist_id"], AIMPPlayer::getPlaylistsDB(aimp_manager_));
+    const size_t entries_count = AIMPPlayer::getEntriesCountDB(params.playlist_id, AIMPPlayer::getPlaylistsDB(aimp_manager_));
     root_response["result"] = static_cast<int>(entries_count); // max int value overflow is possible, but I doubt that we will work with such huge playlists.
     return RESPONSE_IMMEDIATE;
 }
@@ -1290,12 +1482,13 @@ SubscribeOnAIMPStateUpdateEvent::EVENTS SubscribeOnAIMPStateUpdateEvent::getEven
     throw Rpc::Exception("Event does not supported", WRONG_ARGUMENT);
 }
 
-ResponseType SubscribeOnAIMPStateUpdateEvent::execute(const Rpc::Value& root_request, Rpc::Value& /*result*/)
+ResponseType SubscribeOnAIMPStateUpdateEvent::execute(const Rpc::Value& root_request, Rpc::Value& /*result*/, Rpc::CallContext& context)
 {
     EVENTS event_id = getEventFromRpcParams(root_request["params"]);
 
-    DelayedResponseSender_ptr comet_delayed_response_sender = rpc_request_handler_.getDelayedResponseSender();
+    DelayedResponseSender_ptr comet_delayed_response_sender = context.delayedResponseSender();
     assert(comet_delayed_response_sender != nullptr);
+    removeClosedSubscribers();
     delayed_response_sender_descriptors_.insert( std::make_pair(event_id,
                                                                 ResponseSenderDescriptor(root_request, comet_delayed_response_sender)
                                                                 )
@@ -1386,10 +1579,34 @@ void SubscribeOnAIMPStateUpdateEvent::sendNotifications(EVENTS event_id)
          )
     {
         ResponseSenderDescriptor& sender_descriptor = sender_it->second;
-        sendEventNotificationToSubscriber(event_id, sender_descriptor);
+        if ( !sender_descriptor.sender->closed() ) {
+            sendEventNotificationToSubscriber(event_id, sender_descriptor);
+        }
     }
 
-    delayed_response_sender_descriptors_.erase(it_pair.first, it_pair.second);
+    // HTTP subscribers get only one notification, WebSocket ones are kept while connection is open.
+    for (DelayedResponseSenderDescriptors::iterator sender_it = it_pair.first; sender_it != it_pair.second; ) {
+        const Rpc::DelayedResponseSender& sender = *sender_it->second.sender;
+        if ( sender.persistent() && !sender.closed() ) {
+            ++sender_it;
+        } else {
+            sender_it = delayed_response_sender_descriptors_.erase(sender_it);
+        }
+    }
+}
+
+void SubscribeOnAIMPStateUpdateEvent::removeClosedSubscribers()
+{
+    for (DelayedResponseSenderDescriptors::iterator sender_it = delayed_response_sender_descriptors_.begin();
+                                                    sender_it != delayed_response_sender_descriptors_.end();
+         )
+    {
+        if ( sender_it->second.sender->closed() ) {
+            sender_it = delayed_response_sender_descriptors_.erase(sender_it);
+        } else {
+            ++sender_it;
+        }
+    }
 }
 
 void SubscribeOnAIMPStateUpdateEvent::sendEventNotificationToSubscriber(EVENTS event_id, ResponseSenderDescriptor& response_sender_descriptor)
@@ -1408,30 +1625,16 @@ ResponseType GetPlayerControlPanelState::execute(const Rpc::Value& /*root_reques
 
 ResponseType SetTrackRating::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-
-    const TrackDescription track_desc(getTrackDesc(params));
+    const Rpc::Value& rpc_params = root_request["params"];
+    TrackRatingParams params;
+    kTrackRatingParams.bind(rpc_params, &params);
 
-    double rating = -1.;
-    if (params.isMember("rating")) {
-        const Rpc::Value& ratingArg = params["rating"];
-        
-        switch (ratingArg.type()) {
-        case Rpc::Value::TYPE::TYPE_DOUBLE:
-            rating = Utilities::limit_value<double>(ratingArg, 0., 5.);
-            break;
-        case Rpc::Value::TYPE::TYPE_INT:
-            rating = Utilities::limit_value<int>(ratingArg, 0, 5);
-            break;
-        case Rpc::Value::TYPE::TYPE_UINT:
-            rating = Utilities::limit_value<unsigned int>(ratingArg, 0, 5);
-            break;
-        }
-    }
+    const TrackDescription track_desc(getTrackDesc(rpc_params));
 
-    if (rating == -1) {
+    if (!params.rating) {
         throw Rpc::Exception("Expected rating argumet, type double or int", WRONG_ARGUMENT);
     }
+    const double rating = Utilities::limit_value<double>(*params.rating, 0., 5.);
 
     IPlaylistEntryRatingManager* rating_manager = dynamic_cast<IPlaylistEntryRatingManager*>(&aimp_manager_);
     if (rating_manager) {
@@ -1490,12 +1693,11 @@ ResponseType PluginCapabilities::execute(const Rpc::Value& /*root_request*/, Rpc
 
 ResponseType AddURLToPlaylist::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
-    const Rpc::Value& params = root_request["params"];
-    const PlaylistID playlist_id = params["playlist_id"];
-    const std::string& url = params["url"];
+    AddURLToPlaylistParams params;
+    kAddURLToPlaylistParams.bind(root_request["params"], &params);
 
     try {
-        aimp_manager_.addURLToPlaylist(url, playlist_id);
+        aimp_manager_.addURLToPlaylist(params.url, params.playlist_id);
     } catch (std::runtime_error&) {
         throw Rpc::Exception("Adding track to playlist failed", ADD_URL_TO_PLAYLIST_FAILED);
     }
@@ -1513,16 +1715,18 @@ RemoveTrack::RemoveTrack(AIMPManager& aimp_manager, Rpc::RequestHandler& rpc_req
     enable_physical_track_deletion_ = settings.misc.enable_physical_track_deletion;
 }
 
-ResponseType RemoveTrack::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
+ResponseType RemoveTrack::execute(const Rpc::Value& root_request, Rpc::Value& root_response, Rpc::CallContext& context)
 {
-    const Rpc::Value& params = root_request["params"];
+    const Rpc::Value& rpc_params = root_request["params"];
+    RemoveTrackParams params;
+    kRemoveTrackParams.bind(rpc_params, &params);
 
-    const bool physically = params.isMember("physically") ? params["physically"] : false;
+    const bool physically = params.physically;
     if (physically && !enable_physical_track_deletion_) {
         throw Rpc::Exception("Physical deletion is disabled", REMOVE_TRACK_PHYSICAL_DELETION_DISABLED);
     } 
 
-    const TrackDescription track_desc(getTrackDesc(params));
+    const TrackDescription track_desc(getTrackDesc(rpc_params));
     bool remove_track_manually = aimp_manager_.getAbsoluteTrackDesc(track_desc) == aimp_manager_.getPlayingTrack();
     fs::path filename_to_delete;
     if (physically && remove_track_manually) {
@@ -1547,7 +1751,7 @@ ResponseType RemoveTrack::execute(const Rpc::Value& root_request, Rpc::Value& ro
         aimp_manager_.playNextTrack();
         // TODO: also here we should check if there is only one track in all playlists to stop playback.
 
-        DelayedResponseSender_ptr comet_delayed_response_sender = rpc_request_handler_.getDelayedResponseSender();
+        DelayedResponseSender_ptr comet_delayed_response_sender = context.delayedResponseSender();
         assert(comet_delayed_response_sender != nullptr);
 
         track_deletion_timer_.expires_from_now( boost::posix_time::seconds(kTRACK_DELETION_DELAY_SEC) );
@@ -1779,8 +1983,9 @@ ResponseType CreatePlaylist::execute(const Rpc::Value& root_request, Rpc::Value&
 {
 	using namespace Utilities;
 
-	const Rpc::Value& params = root_request["params"];
-	PlaylistID playlist_id = aimp_manager_.createPlaylist(StringEncoding::utf8_to_utf16(params["title"]));
+	CreatePlaylistParams params;
+	kCreatePlaylistParams.bind(root_request["params"], &params);
+	PlaylistID playlist_id = aimp_manager_.createPlaylist(StringEncoding::utf8_to_utf16(params.title));
 
 	root_response["result"]["playlist_id"] = playlist_id;
 	return RESPONSE_IMMEDIATE;
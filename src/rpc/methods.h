@@ -22,7 +22,7 @@
 
 namespace MultiUserMode { class MultiUserModeManager; }
 
-namespace Rpc { class DelayedResponseSender; }
+namespace Rpc { class DelayedResponseSender; class CallContext; }
 
 /*! contains RPC methods definitions.
 
@@ -106,6 +106,9 @@ protected:
 
     TrackDescription getTrackDesc(const Rpc::Value& params) const; // throws Rpc::Exception
 
+    //! Returns true if request refers to concrete playlist, not to special ID -1(playing playlist) which meaning changes without playlists content change.
+    static bool concretePlaylistRequested(const Rpc::Value& root_request);
+
     AIMPManager& aimp_manager_;
     Rpc::RequestHandler& rpc_request_handler_;
 
@@ -464,6 +467,9 @@ public:
     }
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+    bool coalescable(const Rpc::Value& /*root_request*/) const
+        { return true; }
 } ;
 typedef GetFormattedEntryTitle get_formatted_entry_title;
 
@@ -491,6 +497,9 @@ public:
     }
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+    bool coalescable(const Rpc::Value& /*root_request*/) const
+        { return true; }
 };
 
 /*! 
@@ -633,6 +642,9 @@ public:
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 
+    bool responseCacheable(const Rpc::Value& /*root_request*/) const
+        { return true; }
+
 private:
 
     std::string getColumnsString() const;
@@ -716,6 +728,10 @@ public:
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 
+    //! Only direct calls are cached: GetQueuedEntries and GetEntryPositionInDataTable call execute() themselves.
+    bool responseCacheable(const Rpc::Value& root_request) const
+        { return concretePlaylistRequested(root_request); }
+
     void activateEntryLocationDeterminationMode(PaginationInfo* pagination_info)
         { pagination_info_ = pagination_info; }
     void activateQueuedEntriesMode()
@@ -750,12 +766,35 @@ private:
     typedef std::map<std::string, std::string> MapFieldnamesRPCToDB;
     MapFieldnamesRPCToDB fieldnames_rpc_to_db_;
 
-    mutable Utilities::QueryArgSetters query_arg_setters_;
-
-    std::string getLimitString(const Rpc::Value& params) const;
-    std::string getWhereString(const Rpc::Value& params, const int playlist_id) const;
+    // Following functions return query parts with parameters instead of values, args are appended to query_arg_setters.
+    std::string getLimitString(const Rpc::Value& params, Utilities::QueryArgSetters* query_arg_setters) const;
+    std::string getWhereString(const Rpc::Value& params, const int playlist_id, Utilities::QueryArgSetters* query_arg_setters) const;
+    //! Returns condition on entry fields which search string requires, or empty string if there is no search.
+    std::string getFilterString(const Rpc::Value& params, const int playlist_id, Utilities::QueryArgSetters* query_arg_setters) const;
     std::string getColumnsString() const;
-    size_t getTotalEntriesCount(sqlite3* playlists_db, const int playlist_id) const; // throws std::runtime_error
+
+    //! Gets total and found entries counts by single pass over entries, or from counts of previous call if DB was not changed since.
+    void getEntriesCounts(sqlite3* playlists_db, const int playlist_id, const Rpc::Value& params,
+                          size_t* total_entries_count, size_t* found_entries_count); // throws std::runtime_error
+
+    // Entries counts do not depend on page and order, so DataTables page switching reuses them.
+    struct EntriesCounts
+    {
+        int db_total_changes; // sqlite3_total_changes() at the moment of counting, any DB modification invalidates counts.
+        int playlist_id;
+        bool queued_entries_mode;
+        std::string search_string;
+        size_t total_entries_count,
+               found_entries_count;
+
+        EntriesCounts()
+            :
+            db_total_changes(-1)
+        {}
+    };
+    EntriesCounts last_entries_counts_;
+
+    Utilities::StatementCache statement_cache_;
 
     const std::string kRQST_KEY_FORMAT_STRING,
                       kRQST_KEY_FIELDS;
@@ -841,6 +880,9 @@ public:
     }
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+    bool responseCacheable(const Rpc::Value& root_request) const
+        { return concretePlaylistRequested(root_request); }
 };
 
 /*! 
@@ -935,6 +977,10 @@ public:
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 
+    //! Clients request cover of new track at once when track is changed, so image is extracted and resized once for all of them.
+    bool coalescable(const Rpc::Value& /*root_request*/) const
+        { return true; }
+
 private:
 
     /*
@@ -1021,6 +1067,9 @@ public:
     }
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+    bool coalescable(const Rpc::Value& /*root_request*/) const
+        { return true; }
 };
 
 /*!
@@ -1098,7 +1147,10 @@ public:
         ;
     }
 
-    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response, Rpc::CallContext& context);
+
+    bool canRespondDelayed() const
+        { return true; }
 
 private:
 
@@ -1112,9 +1164,15 @@ private:
     //! Converts AIMPManager::EVENTS to our EVENTS and calls sendNotifications() for them.
     void aimpEventHandler(AIMPManager::EVENTS event);
 
-    //! Sends notification to all subscribers for specified event.
+    /*!
+        \brief Sends notification to all subscribers for specified event.
+        Subscribers connected through persistent connection(WebSocket) stay subscribed until connection is closed.
+    */
     void sendNotifications(EVENTS event_id);
 
+    //! Removes subscribers whose persistent connections are closed.
+    void removeClosedSubscribers();
+
     //! Formats result Rpc value according to specified event.
     void prepareResponse(EVENTS event_id, Rpc::Value& result) const;
 
@@ -1280,7 +1338,11 @@ public:
         return "";
     }
 
-    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response, Rpc::CallContext& context);
+
+    //! Response is delayed till playing track is deleted.
+    bool canRespondDelayed() const
+        { return true; }
 
 private:
 
@@ -0,0 +1,209 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/value.h"
+#include "rpc/exception.h"
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <sstream>
+#include <vector>
+
+namespace Rpc
+{
+
+/*!
+    \brief Describes how parameter of C++ type T is read from Rpc::Value.
+    Traits are defined only for supported types, so binding field of any other type fails at compile time.
+*/
+template <typename T> struct ParamTraits;
+
+template <> struct ParamTraits<bool>
+{
+    static const char* typeName() { return "boolean"; }
+    static bool match(const Value& value) { return value.type() == Value::TYPE_BOOL; }
+    static bool get(const Value& value) { return value; }
+};
+
+template <> struct ParamTraits<int>
+{
+    static const char* typeName() { return "int"; }
+    static bool match(const Value& value) { return value.type() == Value::TYPE_INT; }
+    static int get(const Value& value) { return value; }
+};
+
+//! JSON does not distinguish 1 and 1.0, so integers are accepted where double is expected.
+template <> struct ParamTraits<double>
+{
+    static const char* typeName() { return "double"; }
+    static bool match(const Value& value)
+        { return value.type() == Value::TYPE_DOUBLE || value.type() == Value::TYPE_INT || value.type() == Value::TYPE_UINT; }
+    static double get(const Value& value)
+    {
+        switch ( value.type() ) {
+        case Value::TYPE_INT:  return static_cast<int>(value);
+        case Value::TYPE_UINT: return static_cast<unsigned int>(value);
+        default:               return value;
+        }
+    }
+};
+
+template <> struct ParamTraits<std::string>
+{
+    static const char* typeName() { return "string"; }
+    static bool match(const Value& value) { return value.type() == Value::TYPE_STRING; }
+    static const std::string& get(const Value& value) { return value; }
+};
+
+//! Parameter of any type(array of fields for example), method checks it itself. Pointer stays valid while request exists.
+template <> struct ParamTraits<const Value*>
+{
+    static const char* typeName() { return "any"; }
+    static bool match(const Value& /*value*/) { return true; }
+    static const Value* get(const Value& value) { return &value; }
+};
+
+/*!
+    \brief Declarative description of RPC method parameters bound into plain struct Params.
+
+    Usage:
+    \code
+    struct Params { int playlist_id; boost::optional<bool> value; };
+    const ParamsSchema<Params> schema = ParamsSchema<Params>().required("playlist_id", &Params::playlist_id)
+                                                              .optional("value", &Params::value);
+    Params params;
+    schema.bind(root_request["params"], &params);
+    \endcode
+
+    Each parameter is looked up once. Missing required parameter and parameter of wrong type are reported with uniform errors:
+    Rpc::OBJECT_ACCESS_ERROR and Rpc::TYPE_ERROR respectively, the same codes Rpc::Value uses.
+    Schema is immutable after construction, so one instance can be shared by all calls.
+*/
+template <typename Params>
+class ParamsSchema
+{
+public:
+
+    //! Parameter must be present in request.
+    template <typename T>
+    ParamsSchema& required(const char* name, T Params::* field)
+    {
+        fields_.push_back( Field(name, FieldBinder<T>(field, true, T()) ) );
+        return *this;
+    }
+
+    //! Parameter may be omitted, default_value is used then.
+    template <typename T>
+    ParamsSchema& optional(const char* name, T Params::* field, const T& default_value)
+    {
+        fields_.push_back( Field(name, FieldBinder<T>(field, false, default_value) ) );
+        return *this;
+    }
+
+    //! Parameter may be omitted, field stays empty then. Use it when method behavior depends on parameter presence.
+    template <typename T>
+    ParamsSchema& optional(const char* name, boost::optional<T> Params::* field)
+    {
+        fields_.push_back( Field(name, OptionalFieldBinder<T>(field) ) );
+        return *this;
+    }
+
+    /*!
+        \brief Fills params from request params value.
+        All parameters are treated as missing if request params is not an object.
+        \throw Rpc::Exception if required parameter is missing or parameter has wrong type.
+    */
+    void bind(const Value& request_params, Params* params) const
+    {
+        assert(params);
+        for (auto it = fields_.begin(), end = fields_.end(); it != end; ++it) {
+            it->binder( it->name, request_params.findMember(it->name), params );
+        }
+    }
+
+private:
+
+    typedef boost::function<void(const char*, const Value*, Params*)> Binder;
+
+    struct Field
+    {
+        Field(const char* name, Binder binder)
+            :
+            name(name),
+            binder(binder)
+        {}
+
+        const char* name;
+        Binder binder;
+    };
+
+    template <typename T>
+    struct FieldBinder
+    {
+        FieldBinder(T Params::* field, bool required, const T& default_value)
+            :
+            field(field),
+            required(required),
+            default_value(default_value)
+        {}
+
+        void operator()(const char* name, const Value* value, Params* params) const
+        {
+            if (!value) {
+                if (required) {
+                    throwMissingParam(name);
+                }
+                params->*field = default_value;
+            } else {
+                checkType<T>(name, *value);
+                params->*field = ParamTraits<T>::get(*value);
+            }
+        }
+
+        T Params::* field;
+        bool required;
+        T default_value;
+    };
+
+    template <typename T>
+    struct OptionalFieldBinder
+    {
+        explicit OptionalFieldBinder(boost::optional<T> Params::* field)
+            :
+            field(field)
+        {}
+
+        void operator()(const char* name, const Value* value, Params* params) const
+        {
+            if (!value) {
+                params->*field = boost::none;
+            } else {
+                checkType<T>(name, *value);
+                params->*field = ParamTraits<T>::get(*value);
+            }
+        }
+
+        boost::optional<T> Params::* field;
+    };
+
+    template <typename T>
+    static void checkType(const char* name, const Value& value)
+    {
+        if ( !ParamTraits<T>::match(value) ) {
+            std::ostringstream os;
+            os << "type error: parameter \"" << name << "\" must be " << ParamTraits<T>::typeName();
+            throw Exception(os.str(), TYPE_ERROR);
+        }
+    }
+
+    static void throwMissingParam(const char* name)
+    {
+        std::ostringstream os;
+        os << "object access error: required parameter \"" << name << "\" is missing";
+        throw Exception(os.str(), OBJECT_ACCESS_ERROR);
+    }
+
+    std::vector<Field> fields_;
+};
+
+} // namespace Rpc
@@ -2,11 +2,14 @@
 
 #pragma once
 
+#include "rpc/response_cache.h"
 #include <boost/logic/tribool.hpp>
-#include <boost/ptr_container/ptr_map.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <unordered_map>
 
 // headers of DelayedResponseSender class
 #include <boost/enable_shared_from_this.hpp>
@@ -22,12 +25,20 @@ class RpcCallerDescription;
 class Frontend;
 class ResponseSerializer;
 
+/*!
+    \brief Dispatches RPC calls to methods.
+    Dispatch state(response cache and coalesced results) is guarded by mutex, so handleRequest() can be called from any thread.
+    Methods themselves use AIMP, so currently they are all called in player's thread.
+*/
 class RequestHandler : boost::noncopyable
 {
-    friend class DelayedResponseSender;
-
 public:
 
+    RequestHandler()
+        :
+        results_generation_(0)
+    {}
+
     void addFrontend(std::auto_ptr<Frontend> frontend);
 
     /*!
@@ -36,9 +47,7 @@ public:
     */
     void addMethod(std::auto_ptr<Method> method);
 
-    boost::shared_ptr<DelayedResponseSender> getDelayedResponseSender() const;
-
-    Frontend* getFrontEnd(const std::string& uri);
+    Frontend* getFrontEnd(boost::string_ref uri);
 
     boost::tribool handleRequest(const std::string& request_uri,
                                  const std::string& request_content,
@@ -48,25 +57,70 @@ public:
                                  std::string* response_content_type
                                  );
 
+    //! Drops cached results of methods. Must be called when playlists content is changed.
+    void invalidateResponseCache();
+
+    /*!
+        \brief Starts new player state generation: results of coalescable methods computed before are not shared anymore.
+               Must be called on each AIMP event. Methods which can change player state call it themselves.
+    */
+    void onPlayerStateChanged();
+
 private:
 
+    /*
+        Calls method and serializes its response.
+        delayed_response_sender is null for batch items, methods which can delay response are rejected then.
+    */
     boost::tribool callMethod(const Value& root,
                               boost::shared_ptr<Http::DelayedResponseSender> delayed_response_sender,
                               ResponseSerializer& response_serializer,
                               std::string* response
                               );
 
+    /*
+        Calls all methods of JSON-RPC 2.0 batch in order and combines their responses in one response.
+        Notifications produce no response, response is empty if batch consists of notifications only.
+    */
+    void callBatch(const Value& root_request,
+                   ResponseSerializer& response_serializer,
+                   std::string* response
+                   );
+
+    // Returns true if request is notification: JSON-RPC 2.0 call without id, client does not expect response.
+    static bool isNotification(const Value& root_request);
+
     // Get method object by name from registered methods.
     Rpc::Method* getMethodByName(const std::string& name);
 
     typedef boost::ptr_vector<Frontend> Frontends;
     Frontends frontends_;
 
-    typedef boost::ptr_map<std::string, Method> RPCMethodsMap; // maps method name to pointer to method object.
-    RPCMethodsMap rpc_methods_; // List of RPC methods.
+    typedef boost::ptr_vector<Method> RPCMethods;
+    RPCMethods rpc_methods_; // List of RPC methods, owns method objects.
+
+    typedef std::unordered_map<std::string, Method*> RPCMethodsIndex; // maps method name to method object. Lookup costs one hash of name instead of series of string comparisons in tree.
+    RPCMethodsIndex rpc_methods_index_;
+
+    // Looks up serialized result of cacheable or coalescable call. Returns false if result is not found.
+    bool findSharedResult(bool cacheable, const std::string& key, std::string* serialized_result);
+
+    // Stores serialized result of call started when results generation was equal to generation.
+    void putSharedResult(bool cacheable, const std::string& key, unsigned int generation, std::string&& serialized_result);
+
+    ResponseCache response_cache_; // serialized results of methods which responses depend only on params and playlists content.
+
+    struct CoalescedResult
+    {
+        std::string serialized_result;
+        boost::posix_time::ptime created; // result is shared only for short time since not every change of player state(track position for example) produces event.
+    };
+
+    typedef std::unordered_map<std::string, CoalescedResult> CoalescedResults; // maps ResponseCache key to serialized result.
+    CoalescedResults coalesced_results_; // results of coalescable calls computed in current player state generation.
 
-    boost::weak_ptr<Http::DelayedResponseSender> active_delayed_response_sender_; // stores response sender while Rpc method is executed. Allows not to pass this handler in Method::execute() as argument since only comet method needs it.
-    ResponseSerializer* active_response_serializer_; // work in pair with active_delayed_response_sender_ member.
+    unsigned int results_generation_; // player state generation, incremented each time shared results are dropped, so result of call which overlapped drop is not stored.
+    boost::mutex results_mutex_; // guards response_cache_, coalesced_results_ and results_generation_, it is not held while method is executed.
 };
 
 
@@ -87,6 +141,12 @@ public:
 
     void sendResponseFault(const Value& root_request, const std::string& error_msg, int error_code);
 
+    //! Returns true if sender can be used for many responses(WebSocket connection).
+    bool persistent() const;
+
+    //! Returns true if connection of persistent sender is closed, sender should be released.
+    bool closed() const;
+
 private:
 
     boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender_;
@@ -96,6 +156,41 @@ private:
 typedef boost::shared_ptr<DelayedResponseSender> DelayedResponseSender_ptr;
 
 
+/*!
+    \brief Describes single RPC call for Method::execute(): where and how response should be sent.
+    RequestHandler creates context on stack for each call, so it keeps no state of executed call
+    and dispatch does not depend on order of calls.
+*/
+class CallContext : boost::noncopyable
+{
+public:
+
+    CallContext(boost::shared_ptr<Http::DelayedResponseSender> http_response_sender,
+                const ResponseSerializer& response_serializer
+                )
+        :
+        http_response_sender_(http_response_sender),
+        response_serializer_(response_serializer)
+    {}
+
+    //! Returns true if call can be completed after Method::execute() returns. It is false for items of batch request.
+    bool canRespondDelayed() const
+        { return http_response_sender_ != nullptr; }
+
+    /*!
+        \brief Returns sender which completes the call after Method::execute() returned RESPONSE_DELAYED.
+               Sender does not depend on RequestHandler state, it can be stored and used from any thread.
+        \return null if call can not be completed later.
+    */
+    DelayedResponseSender_ptr delayedResponseSender() const;
+
+private:
+
+    boost::shared_ptr<Http::DelayedResponseSender> http_response_sender_;
+    const ResponseSerializer& response_serializer_;
+};
+
+
 //! Client descriptor for use in RPC methods.
 class RpcCallerDescription
 {
@@ -0,0 +1,66 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+
+namespace Rpc
+{
+
+class Value;
+class ResponseSerializer;
+
+/*!
+    \brief Keeps serialized results of RPC methods which responses depend only on request params and playlists content.
+    Entry is looked up by frontend's response serializer, method name and params, so each frontend has its own serialized representation
+    and request id does not prevent reuse of result.
+    Whole cache is dropped by invalidate() when playlists are changed. Least recently used entries are evicted when memory limit is reached.
+    Class is not thread safe, Rpc::RequestHandler guards it by its mutex.
+*/
+class ResponseCache : boost::noncopyable
+{
+public:
+
+    static const std::size_t kMEMORY_LIMIT = 16 * 1024 * 1024; //!< results are evicted after limit is reached.
+
+    ResponseCache()
+        :
+        memory_usage_(0)
+    {}
+
+    //! Builds lookup key from method name and params of request. Object members are sorted, so equal params give equal keys.
+    static void makeKey(const ResponseSerializer& response_serializer, const Value& root_request, std::string* key);
+
+    //! Returns cached serialized result or null. Found entry becomes most recently used.
+    const std::string* get(const std::string& key);
+
+    //! Stores serialized result. Result larger than memory limit is not cached.
+    void put(const std::string& key, std::string&& serialized_result);
+
+    //! Drops all cached results.
+    void invalidate();
+
+private:
+
+    struct Entry
+    {
+        std::string key;
+        std::string serialized_result;
+    };
+
+    typedef std::list<Entry> Entries; // most recently used entry is at front.
+    typedef std::unordered_map<std::string, Entries::iterator> EntriesIndex;
+
+    static std::size_t memoryUsage(const Entry& entry);
+
+    void erase(Entries::iterator entry);
+
+    Entries entries_;
+    EntriesIndex entries_index_;
+    std::size_t memory_usage_;
+};
+
+} // namespace Rpc
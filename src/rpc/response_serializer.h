@@ -3,6 +3,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include "rpc/exception.h"
 
 namespace Rpc
 {
@@ -20,6 +22,21 @@ public:
 
     virtual const std::string& mimeType() const = 0;
 
+    //! Combines serialized responses of batch items in one response. Only protocols which have batch requests override it.
+    virtual void serializeBatch(const std::vector<std::string>& /*responses*/, std::string* /*response*/) const
+        { throw Exception("batch requests are not supported", INVALID_REQUEST_ERROR); }
+
+    /*!
+        \brief Serializes result of method alone, so it can be cached and reused in responses to different requests.
+        \return false if protocol does not support composing response from serialized result, result is not cached then.
+    */
+    virtual bool serializeResult(const Rpc::Value& /*result*/, std::string* /*serialized_result*/) const
+        { return false; }
+
+    //! Writes success response with result produced by serializeResult(). Root response contains members except result(id).
+    virtual void serializeSuccessWithResult(const Rpc::Value& /*root_response*/, const std::string& /*serialized_result*/, std::string* /*response*/) const
+        { throw Exception("serialized results are not supported", INTERNAL_ERROR); }
+
 protected:
 
     ~ResponseSerializer() {}
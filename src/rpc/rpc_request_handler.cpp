@@ -11,6 +11,7 @@
 #include "rpc/response_serializer.h"
 #include "utils/util.h"
 #include <boost/foreach.hpp>
+#include <boost/pool/pool_alloc.hpp>
 #include "plugin/logger.h"
 
 namespace Rpc
@@ -24,12 +25,15 @@ ModuleLoggerType& logger()
 
 const int kGENERAL_ERROR_CODE = -1;
 
+const boost::int64_t kCOALESCED_RESULT_TTL_MS = 500; // bounds staleness of state which changes without AIMP events.
+const std::size_t kMAX_COALESCED_RESULTS_COUNT = 256; // results of calls with many different params are not accumulated between state changes.
+
 void RequestHandler::addFrontend(std::auto_ptr<Frontend> frontend)
 {
     frontends_.push_back( frontend.release() );
 }
 
-Frontend* RequestHandler::getFrontEnd(const std::string& uri)
+Frontend* RequestHandler::getFrontEnd(boost::string_ref uri)
 {
     BOOST_FOREACH(Frontend& frontend, frontends_) {
         if ( frontend.canHandleRequest(uri) ) {
@@ -41,9 +45,9 @@ Frontend* RequestHandler::getFrontEnd(const std::string& uri)
 
 Method* RequestHandler::getMethodByName(const std::string& name)
 {
-    auto method_iterator = rpc_methods_.find(name);
+    auto method_iterator = rpc_methods_index_.find(name);
 
-    if ( method_iterator != rpc_methods_.end() ) {
+    if ( method_iterator != rpc_methods_index_.end() ) {
         return method_iterator->second;
     }
 
@@ -52,8 +56,11 @@ Method* RequestHandler::getMethodByName(const std::string& name)
 
 void RequestHandler::addMethod(std::auto_ptr<Method> method)
 {
-    std::string key( method->name() ); // boost::ptr_map::insert() needs reference to non-constant.
-    rpc_methods_.insert( key, method.release() );
+    Method*& indexed_method = rpc_methods_index_[method->name()];
+    if (!indexed_method) { // first registered method with given name is kept, duplicate is destroyed.
+        indexed_method = method.get();
+        rpc_methods_.push_back( method.release() );
+    }
 }
 
 boost::tribool RequestHandler::handleRequest(const std::string& request_uri,
@@ -72,15 +79,25 @@ boost::tribool RequestHandler::handleRequest(const std::string& request_uri,
     Value root_request;
     if ( frontend.requestParser().parse(request_uri, request_content, &root_request) ) {
 
+        if (root_request.type() == Value::TYPE_ARRAY) {
+            callBatch(root_request, frontend.responseSerializer(), response);
+            return true;
+        }
+
+        const bool notification = isNotification(root_request);
         if ( !root_request.isMember("id") ) { // for example xmlrpc does not use request id, so add null value since Rpc methods rely on it.
             root_request["id"] = Value::Null();
         }
 
-        return callMethod(root_request,
-                          delayed_response_sender,
-                          frontend.responseSerializer(),
-                          response
-                          );
+        boost::tribool result = callMethod(root_request,
+                                           delayed_response_sender,
+                                           frontend.responseSerializer(),
+                                           response
+                                           );
+        if ( notification && (result || !result) ) {
+            response->clear(); // client does not wait result of notification.
+        }
+        return result;
     } else {
         frontend.responseSerializer().serializeFault(root_request, "Request parsing error", Rpc::REQUEST_PARSING_ERROR, response);
         return false;
@@ -102,16 +119,42 @@ boost::tribool RequestHandler::callMethod(const Value& root_request,
             response_serializer.serializeFault(root_request, method_name + ": method not found", METHOD_NOT_FOUND_ERROR, response);
             return false;
         }
+
+        CallContext context(delayed_response_sender, response_serializer);
+        if ( !context.canRespondDelayed() && method->canRespondDelayed() ) {
+            response_serializer.serializeFault(root_request, method_name + ": method can not be called in batch request", INVALID_REQUEST_ERROR, response);
+            return false;
+        }
         
+        const bool cacheable = method->responseCacheable(root_request);
+        const bool coalescable = !cacheable && method->coalescable(root_request);
+        if ( !cacheable && !coalescable && !method->canRespondDelayed() ) { // subscription methods do not change player state.
+            onPlayerStateChanged(); // method can change player state, so results of previous calls become obsolete.
+        }
+
+        std::string cache_key;
+        unsigned int results_generation = 0;
+        if (cacheable || coalescable) {
+            ResponseCache::makeKey(response_serializer, root_request, &cache_key);
+            {
+            boost::lock_guard<boost::mutex> lock(results_mutex_);
+            results_generation = results_generation_;
+            }
+            std::string serialized_result;
+            if ( findSharedResult(cacheable, cache_key, &serialized_result) ) {
+                Value root_response;
+                root_response["id"] = root_request["id"];
+                response_serializer.serializeSuccessWithResult(root_response, serialized_result, response);
+                return true;
+            }
+        }
+
         { // execute method
         //PROFILE_EXECUTION_TIME( method_name.c_str() );
 
-        active_delayed_response_sender_ = delayed_response_sender; // save current http request handler ref in weak ptr to use in delayed response.
-        active_response_serializer_ = &response_serializer;
-
         Value root_response;
         root_response["id"] = root_request["id"]; // currently all methods set id of response, so set it here. Method can set it to null if needed.
-        ResponseType response_type = method->execute(root_request, root_response);
+        ResponseType response_type = method->execute(root_request, root_response, context);
         if (RESPONSE_DELAYED == response_type) {
             return boost::indeterminate; // method execution is delayed, say to http response handler not to send answer immediately.
         } else {
@@ -120,7 +163,16 @@ boost::tribool RequestHandler::callMethod(const Value& root_request,
                 root_response = "";
             }
 
-            response_serializer.serializeSuccess(root_response, response);
+            std::string serialized_result;
+            if ( (cacheable || coalescable) && response_serializer.serializeResult(root_response["result"], &serialized_result) ) {
+                // response is composed from serialized result, so it is written once for both response and cache.
+                Value root_response_without_result;
+                root_response_without_result["id"] = root_response["id"];
+                response_serializer.serializeSuccessWithResult(root_response_without_result, serialized_result, response);
+                putSharedResult( cacheable, cache_key, results_generation, std::move(serialized_result) );
+            } else {
+                response_serializer.serializeSuccess(root_response, response);
+            }
             return true;
         }
         }
@@ -137,13 +189,115 @@ boost::tribool RequestHandler::callMethod(const Value& root_request,
     }
 }
 
-boost::shared_ptr<DelayedResponseSender> RequestHandler::getDelayedResponseSender() const
+void RequestHandler::callBatch(const Value& root_request,
+                               ResponseSerializer& response_serializer,
+                               std::string* response
+                               )
 {
-    boost::shared_ptr<Http::DelayedResponseSender> ptr = active_delayed_response_sender_.lock();
-    if (ptr) {
-        return boost::make_shared<DelayedResponseSender>(ptr, *active_response_serializer_);
+    assert(response);
+
+    if (root_request.size() == 0) {
+        response_serializer.serializeFault(Value(), "Empty batch", INVALID_REQUEST_ERROR, response);
+        return;
+    }
+
+    std::vector<std::string> responses;
+    responses.reserve( root_request.size() );
+    std::string item_response;
+
+    // AIMP is not thread safe and all methods use it, so batch items are executed one by one in player's thread.
+    for (size_t i = 0, size = root_request.size(); i != size; ++i) {
+        if (root_request[i].type() != Value::TYPE_OBJECT) {
+            response_serializer.serializeFault(Value(), "Invalid request", INVALID_REQUEST_ERROR, &item_response);
+            responses.push_back(item_response);
+            continue;
+        }
+
+        Value item(root_request[i]);
+        const bool notification = isNotification(item);
+        if ( !item.isMember("id") ) {
+            item["id"] = Value::Null();
+        }
+
+        callMethod( item, Http::DelayedResponseSender_ptr(), response_serializer, &item_response );
+        if (!notification) {
+            responses.push_back(item_response);
+        }
+    }
+
+    if ( responses.empty() ) {
+        response->clear();
     } else {
-        return boost::shared_ptr<DelayedResponseSender>();
+        response_serializer.serializeBatch(responses, response);
+    }
+}
+
+bool RequestHandler::findSharedResult(bool cacheable, const std::string& key, std::string* serialized_result)
+{
+    boost::lock_guard<boost::mutex> lock(results_mutex_);
+    if (cacheable) {
+        if ( const std::string* cached_result = response_cache_.get(key) ) {
+            *serialized_result = *cached_result; // entry can be evicted by other thread after lock is released.
+            return true;
+        }
+    } else {
+        CoalescedResults::iterator it = coalesced_results_.find(key);
+        if ( it != coalesced_results_.end() ) {
+            const boost::posix_time::time_duration age = boost::posix_time::microsec_clock::universal_time() - it->second.created;
+            if ( age.total_milliseconds() < kCOALESCED_RESULT_TTL_MS ) {
+                *serialized_result = it->second.serialized_result;
+                return true;
+            }
+            coalesced_results_.erase(it);
+        }
+    }
+    return false;
+}
+
+void RequestHandler::putSharedResult(bool cacheable, const std::string& key, unsigned int generation, std::string&& serialized_result)
+{
+    boost::lock_guard<boost::mutex> lock(results_mutex_);
+    if (generation != results_generation_) {
+        return; // results were dropped while method was executed, this one may be obsolete too.
+    }
+    if (cacheable) {
+        response_cache_.put( key, std::move(serialized_result) );
+    } else {
+        if (coalesced_results_.size() >= kMAX_COALESCED_RESULTS_COUNT) {
+            coalesced_results_.clear();
+        }
+        CoalescedResult& result = coalesced_results_[key];
+        result.serialized_result = std::move(serialized_result);
+        result.created = boost::posix_time::microsec_clock::universal_time();
+    }
+}
+
+void RequestHandler::invalidateResponseCache()
+{
+    boost::lock_guard<boost::mutex> lock(results_mutex_);
+    response_cache_.invalidate();
+    coalesced_results_.clear();
+    ++results_generation_;
+}
+
+void RequestHandler::onPlayerStateChanged()
+{
+    boost::lock_guard<boost::mutex> lock(results_mutex_);
+    coalesced_results_.clear();
+    ++results_generation_;
+}
+
+bool RequestHandler::isNotification(const Value& root_request)
+{
+    return root_request.isMember("jsonrpc") && !root_request.isMember("id");
+}
+
+DelayedResponseSender_ptr CallContext::delayedResponseSender() const
+{
+    if (http_response_sender_) {
+        return boost::allocate_shared<DelayedResponseSender>(boost::fast_pool_allocator<DelayedResponseSender>(), http_response_sender_, response_serializer_);
+    } else {
+        return DelayedResponseSender_ptr();
     }
 }
 
@@ -152,7 +306,7 @@ void DelayedResponseSender::sendResponseSuccess(const Value& root_response)
 {
     std::string response;
     response_serializer_.serializeSuccess(root_response, &response);
-    comet_http_response_sender_->send(response,
+    comet_http_response_sender_->send(std::move(response),
                                       response_serializer_.mimeType()
                                       );
 }
@@ -161,9 +315,19 @@ void DelayedResponseSender::sendResponseFault(const Value& root_request, const s
 {
     std::string response_string;
     response_serializer_.serializeFault(root_request, error_msg, error_code, &response_string);
-    comet_http_response_sender_->send(response_string,
+    comet_http_response_sender_->send(std::move(response_string),
                                       response_serializer_.mimeType()
                                       );
 }
 
+bool DelayedResponseSender::persistent() const
+{
+    return comet_http_response_sender_->persistent();
+}
+
+bool DelayedResponseSender::closed() const
+{
+    return comet_http_response_sender_->closed();
+}
+
 } // namespace XmlRpc
@@ -0,0 +1,141 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "rpc/response_cache.h"
+#include "rpc/value.h"
+#include <cassert>
+
+namespace Rpc
+{
+
+namespace {
+
+template <typename T>
+void appendBytes(const T& value, std::string* key)
+{
+    key->append( reinterpret_cast<const char*>(&value), sizeof(value) );
+}
+
+void appendString(const std::string& s, std::string* key)
+{
+    appendBytes(s.size(), key);
+    *key += s;
+}
+
+//! Appends unambiguous binary representation of value: type, then size prefixed content.
+void appendValue(const Value& value, std::string* key)
+{
+    key->push_back( static_cast<char>( value.type() ) );
+    switch ( value.type() ) {
+    case Value::TYPE_NONE:
+    case Value::TYPE_NULL:
+        break;
+    case Value::TYPE_BOOL:
+        key->push_back( bool(value) ? '1' : '0' );
+        break;
+    case Value::TYPE_INT:
+        appendBytes( int(value), key );
+        break;
+    case Value::TYPE_UINT:
+        appendBytes( static_cast<unsigned int>(value), key );
+        break;
+    case Value::TYPE_DOUBLE:
+        appendBytes( double(value), key );
+        break;
+    case Value::TYPE_STRING:
+        appendString(value, key);
+        break;
+    case Value::TYPE_ARRAY:
+        appendBytes(value.size(), key);
+        for (size_t i = 0, size = value.size(); i != size; ++i) {
+            appendValue(value[i], key);
+        }
+        break;
+    case Value::TYPE_OBJECT:
+        {
+        appendBytes(value.size(), key);
+        auto member_it = value.getObjectMembersBegin(),
+             end       = value.getObjectMembersEnd();
+        for (; member_it != end; ++member_it) {
+            appendString(member_it->first, key);
+            appendValue(member_it->second, key);
+        }
+        }
+        break;
+    default:
+        assert(!"unknown type");
+        break;
+    }
+}
+
+} // namespace anonymous
+
+void ResponseCache::makeKey(const ResponseSerializer& response_serializer, const Value& root_request, std::string* key)
+{
+    assert(key);
+    key->clear();
+
+    // serializer identifies frontend, its objects live as long as request handler.
+    const ResponseSerializer* serializer = &response_serializer;
+    appendBytes(serializer, key);
+
+    appendString(root_request["method"], key);
+    if ( const Value* params = root_request.findMember("params") ) {
+        appendValue(*params, key);
+    }
+}
+
+const std::string* ResponseCache::get(const std::string& key)
+{
+    EntriesIndex::const_iterator it = entries_index_.find(key);
+    if ( it == entries_index_.end() ) {
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second); // mark as most recently used, iterators stay valid.
+    return &it->second->serialized_result;
+}
+
+void ResponseCache::put(const std::string& key, std::string&& serialized_result)
+{
+    EntriesIndex::iterator it = entries_index_.find(key);
+    if ( it != entries_index_.end() ) {
+        erase(it->second);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.serialized_result = std::move(serialized_result);
+    const std::size_t entry_memory_usage = memoryUsage(entry);
+    if (entry_memory_usage > kMEMORY_LIMIT) {
+        return;
+    }
+
+    while (memory_usage_ + entry_memory_usage > kMEMORY_LIMIT) {
+        erase(--entries_.end()); // least recently used.
+    }
+
+    entries_.push_front( std::move(entry) );
+    entries_index_[key] = entries_.begin();
+    memory_usage_ += entry_memory_usage;
+}
+
+void ResponseCache::invalidate()
+{
+    entries_.clear();
+    entries_index_.clear();
+    memory_usage_ = 0;
+}
+
+void ResponseCache::erase(Entries::iterator entry)
+{
+    memory_usage_ -= memoryUsage(*entry);
+    entries_index_.erase(entry->key);
+    entries_.erase(entry);
+}
+
+std::size_t ResponseCache::memoryUsage(const Entry& entry)
+{
+    return entry.key.size() * 2 + entry.serialized_result.size(); // key is stored in index too.
+}
+
+} // namespace Rpc
@@ -3,7 +3,9 @@
 #include "stdafx.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
+#include <algorithm>
 #include <cassert>
+#include <new>
 #include <sstream>
 
 namespace Rpc
@@ -111,14 +113,14 @@ Value::Value(const char* value)
     :
     type_(TYPE_STRING)
 {
-    value_.string_ = new String(value);
+    new (value_.string_) String(value);
 }
 
 Value::Value(const String& value)
     :
     type_(TYPE_STRING)
 {
-    value_.string_ = new String(value);
+    new (value_.string_) String(value);
 }
 
 Value::Value(const Value::Array& value)
@@ -135,12 +137,6 @@ Value::Value(const Value::Object& value)
     value_.object_ = new Object(value);
 }
 
-Value::String* copyString(const Value::String* rhs)
-{
-    assert(rhs);
-    return new Value::String(*rhs);
-}
-
 Value::Array* copyArray(const Value::Array* rhs)
 {
     assert(rhs);
@@ -174,7 +170,7 @@ Value::Value(const Value& rhs)
         value_.double_ = rhs.value_.double_;
         break;
     case TYPE_STRING:
-        value_.string_ = copyString(rhs.value_.string_);
+        new (value_.string_) String( rhs.string() );
         break;
     case TYPE_ARRAY:
         value_.array_ = copyArray(rhs.value_.array_);
@@ -188,6 +184,33 @@ Value::Value(const Value& rhs)
     }
 }
 
+Value::Value(Value&& rhs) BOOST_NOEXCEPT
+    :
+    type_(TYPE_NONE)
+{
+    moveFrom(rhs);
+}
+
+Value::~Value()
+{
+    reset();
+}
+
+void Value::moveFrom(Value& rhs)
+{
+    assert(type_ == TYPE_NONE);
+
+    if (rhs.type_ == TYPE_STRING) {
+        // inline string can not be moved bitwise since it may point to its own buffer.
+        new (value_.string_) String( std::move( rhs.string() ) );
+        rhs.string().~String();
+    } else {
+        value_ = rhs.value_;
+    }
+    type_ = rhs.type_;
+    rhs.type_ = TYPE_NONE;
+}
+
 void Value::reset()
 {
     switch (type_) {
@@ -199,7 +222,7 @@ void Value::reset()
     case TYPE_DOUBLE:
         break;
     case TYPE_STRING:
-        delete value_.string_;
+        string().~String();
         break;
     case TYPE_ARRAY:
         delete value_.array_;
@@ -217,9 +240,11 @@ void Value::reset()
 
 void Value::swap(Value& rhs)
 {
-    using std::swap;
-    swap(type_, rhs.type_);
-    swap(value_, rhs.value_);
+    if (this != &rhs) {
+        Value temp( std::move(rhs) );
+        rhs.moveFrom(*this);
+        moveFrom(temp);
+    }
 }
 
 Value& Value::operator=(const Value& rhs)
@@ -228,6 +253,15 @@ Value& Value::operator=(const Value& rhs)
     return *this;
 }
 
+Value& Value::operator=(Value&& rhs) BOOST_NOEXCEPT
+{
+    if (this != &rhs) {
+        reset();
+        moveFrom(rhs);
+    }
+    return *this;
+}
+
 Value& Value::operator=(const Value::Null& value)
 {
     Value(value).swap(*this);
@@ -380,22 +414,19 @@ Value::operator double() const
 Value::operator String&()
 {
     ensureTypeIsNoneOrEquals(TYPE_STRING);
-    assert(value_.string_);
-    return *value_.string_;
+    return string();
 }
 
 Value::operator String const&() const
 {
     assertTypeEquals(TYPE_STRING);
-    assert(value_.string_);
-    return *value_.string_;
+    return string();
 }
 
 bool Value::operator==(const char* value) const
 {
     if (type_ == TYPE_STRING) {
-        assert(value_.string_);
-        return *value_.string_ == value;
+        return string() == value;
     }
     return false;
 }
@@ -403,8 +434,7 @@ bool Value::operator==(const char* value) const
 bool Value::operator==(const String& value) const
 {
     if (type_ == TYPE_STRING) {
-        assert(value_.string_);
-        return *value_.string_ == value;
+        return string() == value;
     }
     return false;
 }
@@ -462,12 +492,19 @@ void Value::setSize(size_t size)
     array.resize(size);
 }
 
-const Value* Value::lookup(const Value::String& name) const
+void Value::reserve(size_t size)
+{
+    ensureTypeIsNoneOrEquals(TYPE_ARRAY);
+    assert(value_.array_);
+    value_.array_->reserve(size);
+}
+
+const Value* Value::lookup(const char* name, size_t length) const
 {
     assert(type_ == TYPE_OBJECT);
 
     const Object& object = *value_.object_;
-    const auto it = object.find(name);
+    const auto it = object.find(name, length);
     if ( it != object.end() ) {
         return &it->second;
     }
@@ -484,7 +521,7 @@ Value& Value::operator[](const String& name)
 const Value& Value::operator[](const String& name) const
 {
     assertTypeEquals(TYPE_OBJECT);
-    const Value* value = lookup(name);
+    const Value* value = lookup( name.c_str(), name.size() );
     if (!value) {
         throwObjectAccessException( name.c_str() );
     }
@@ -493,23 +530,63 @@ const Value& Value::operator[](const String& name) const
 
 Value& Value::operator[](const char* name)
 {
-    // till I will find how to perform efficient search by char* in map<std::string> this function will create temp string object.
-    return operator[]( String(name) );
+    ensureTypeIsNoneOrEquals(TYPE_OBJECT);
+    Object& object = *value_.object_;
+    return object[name];
 }
 
 const Value& Value::operator[](const char* name) const
 {
-    // till I will find how to perform efficient search by char* in map<std::string> this function will create temp string object.
-    return operator[]( String(name) );
+    assertTypeEquals(TYPE_OBJECT);
+    const Value* value = lookup( name, strlen(name) );
+    if (!value) {
+        throwObjectAccessException(name);
+    }
+    return *value;
+}
+
+Value& Value::appendMember(const String& name)
+{
+    ensureTypeIsNoneOrEquals(TYPE_OBJECT);
+    return value_.object_->append(name);
+}
+
+void Value::sortMembers(DUPLICATES duplicates)
+{
+    assertTypeEquals(TYPE_OBJECT);
+    value_.object_->sort(duplicates);
+}
+
+void Value::Object::sort(DUPLICATES duplicates)
+{
+    // stable sort keeps members with the same name in order of appending.
+    std::stable_sort( members_.begin(), members_.end(),
+                      [](const Member& lhs, const Member& rhs) { return lhs.first < rhs.first; }
+                     );
+
+    iterator out = members_.begin();
+    for (iterator it = members_.begin(), end = members_.end(); it != end; ) {
+        iterator same_name_end = it + 1;
+        while (same_name_end != end && same_name_end->first == it->first) {
+            ++same_name_end;
+        }
+        iterator kept = duplicates == DUPLICATES_KEEP_FIRST ? it : same_name_end - 1;
+        if (out != kept) {
+            *out = std::move(*kept); // kept is not before out, members after same_name_end are not touched yet.
+        }
+        ++out;
+        it = same_name_end;
+    }
+    members_.erase( out, members_.end() );
 }
 
-Value::Object::const_iterator Value::getObjectMembersBegin() const
+Value::Members::const_iterator Value::getObjectMembersBegin() const
 {
     assertTypeEquals(TYPE_OBJECT);
     return value_.object_->begin();
 }
 
-Value::Object::const_iterator Value::getObjectMembersEnd() const
+Value::Members::const_iterator Value::getObjectMembersEnd() const
 {
     assertTypeEquals(TYPE_OBJECT);
     return value_.object_->end();
@@ -518,15 +595,25 @@ Value::Object::const_iterator Value::getObjectMembersEnd() const
 bool Value::isMember(const String& name) const
 {
     if (type_ == TYPE_OBJECT) {
-        return (lookup(name) != nullptr);
+        return lookup( name.c_str(), name.size() ) != nullptr;
     }
     return false;
 }
 
 bool Value::isMember(const char* name) const
 {
-    // till I will find how to perform efficient search by char* in map<std::string> this function will create temp string object.
-    return isMember( String(name) );
+    if (type_ == TYPE_OBJECT) {
+        return lookup( name, strlen(name) ) != nullptr;
+    }
+    return false;
+}
+
+const Value* Value::findMember(const char* name) const
+{
+    if (type_ == TYPE_OBJECT) {
+        return lookup( name, strlen(name) );
+    }
+    return nullptr;
 }
 
 std::ostream& Value::toStream(std::ostream& os) const
@@ -552,7 +639,7 @@ std::ostream& Value::toStream(std::ostream& os) const
         os << value_.double_;
         break;
     case TYPE_STRING:
-        os << *value_.string_;
+        os << string();
         break;
     case TYPE_ARRAY:
         {
@@ -3,9 +3,11 @@
 #pragma once
 
 #include <iosfwd>
+#include <cstring>
 #include <string>
-#include <map>
 #include <vector>
+#include <utility>
+#include <boost/config.hpp>
 
 namespace Rpc
 {
@@ -32,11 +34,12 @@ public:
 
     typedef std::string String;
     typedef std::vector<Value> Array;
-    typedef std::map<std::string, Value> Object;
+    class Object;
     struct Null {};
 
     Value();
     Value(const Value& rhs);
+    Value(Value&& rhs) BOOST_NOEXCEPT;
     explicit Value(const Null&);
     explicit Value(bool value);
     explicit Value(int value);
@@ -47,7 +50,10 @@ public:
     explicit Value(const Array& value);
     explicit Value(const Object& value);
 
+    ~Value();
+
     Value& operator=(const Value& rhs);
+    Value& operator=(Value&& rhs) BOOST_NOEXCEPT;
     Value& operator=(const Null&);
     Value& operator=(bool value);
     Value& operator=(int value);
@@ -77,18 +83,42 @@ public:
 
     const size_t size() const; // throws Exception
     void setSize(size_t size); // throws Exception
+    //! Preallocates array storage. Use it before series of setSize() calls when final size is known.
+    void reserve(size_t size); // throws Exception
 
+    //! Non-const version inserts missing member. Insertion invalidates references to other members of this object, see Value::Object.
     Value& operator[](const String& name);             // throws Exception
     const Value& operator[](const String& name) const; // throws Exception
     Value& operator[](const char* name);               // throws Exception
     const Value& operator[](const char* name) const;   // throws Exception
 
-    Object::const_iterator getObjectMembersBegin() const;
-    Object::const_iterator getObjectMembersEnd() const;
+    typedef std::pair<String, Value> Member;
+    typedef std::vector<Member> Members;
+
+    //! Which of members with the same name remains after sortMembers().
+    enum DUPLICATES {
+        DUPLICATES_KEEP_FIRST,
+        DUPLICATES_KEEP_LAST
+    };
+
+    /*!
+        \brief Appends member to object without keeping name order. For parsers: one insertion with search costs O(n), so object is built
+               by appending members and sortMembers() is called after the last one. Member lookup is not valid until then.
+    */
+    Value& appendMember(const String& name); // throws Exception
+
+    //! Restores name order of object after appendMember() calls.
+    void sortMembers(DUPLICATES duplicates); // throws Exception
+
+    Members::const_iterator getObjectMembersBegin() const;
+    Members::const_iterator getObjectMembersEnd() const;
 
     bool isMember(const String& name) const;
     bool isMember(const char* name) const;
 
+    //! Returns member or nullptr if value is not an object or does not have such member. Does not throw.
+    const Value* findMember(const char* name) const;
+
     //! destroys current value, sets type to TYPE_NONE.
     void reset();
 
@@ -108,7 +138,15 @@ private:
     void ensureTypeIsNoneOrEquals(TYPE type);   // throws Exception
     void assertIndexIsInRange(int index) const; // throws Exception
     // does not perform check that current type is Object, caller must check it otself.
-    const Value* lookup(const String& name) const;
+    const Value* lookup(const char* name, size_t length) const;
+
+    //! Moves content of rhs to this, rhs becomes none. This must be none before call.
+    void moveFrom(Value& rhs);
+
+    String& string()
+        { return *reinterpret_cast<String*>(value_.string_); }
+    const String& string() const
+        { return *reinterpret_cast<const String*>(value_.string_); }
 
     TYPE type_;
 
@@ -117,7 +155,7 @@ private:
         int int_;
         unsigned int uint_;
         double double_;
-        String* string_;
+        char string_[sizeof(String)]; // string is stored inline, so short strings do not need heap at all. Union's pointer and double members provide alignment.
         Array* array_;
         Object* object_;
     };
@@ -125,6 +163,92 @@ private:
     Value_ value_;
 };
 
+/*!
+    \brief Object members sorted by name.
+    Objects usually have few members, so binary search in vector is cheaper than std::map: one allocation per object instead of node per member.
+    Members are iterated in name order like in std::map, serializers rely on it.
+    Unlike std::map, insertion of member invalidates references and iterators to other members of the same object:
+    do not keep reference to member while adding members to its parent, take reference after last insertion or in nested scope.
+*/
+class Value::Object
+{
+public:
+
+    typedef Members::iterator iterator;
+    typedef Members::const_iterator const_iterator;
+
+    /*!
+        \brief Returns member with given name, member of none type is inserted if it does not exist yet.
+        Insertion invalidates references to other members.
+    */
+    Value& operator[](const String& name)
+        { return insert( name.c_str(), name.size() ); }
+
+    Value& operator[](const char* name)
+        { return insert( name, strlen(name) ); }
+
+    const_iterator find(const char* name, size_t length) const
+    {
+        const_iterator it = lowerBound(members_.begin(), members_.end(), name, length);
+        return it != members_.end() && it->first.compare(0, String::npos, name, length) == 0 ? it : members_.end();
+    }
+
+    const_iterator find(const char* name) const
+        { return find( name, strlen(name) ); }
+
+    const_iterator find(const String& name) const
+        { return find( name.c_str(), name.size() ); }
+
+    iterator begin() { return members_.begin(); }
+    iterator end() { return members_.end(); }
+    const_iterator begin() const { return members_.begin(); }
+    const_iterator end() const { return members_.end(); }
+
+    size_t size() const { return members_.size(); }
+    bool empty() const { return members_.empty(); }
+    void reserve(size_t size) { members_.reserve(size); }
+
+    //! Appends member without search. Order must be restored by sort() after series of appends.
+    Value& append(const String& name)
+    {
+        members_.push_back( Member( name, Value() ) );
+        return members_.back().second;
+    }
+
+    //! Sorts members by name and removes duplicates: O(n log n) for whole object instead of O(n) per insertion.
+    void sort(DUPLICATES duplicates);
+
+private:
+
+    Value& insert(const char* name, size_t length)
+    {
+        iterator it = lowerBound(members_.begin(), members_.end(), name, length);
+        if ( it == members_.end() || it->first.compare(0, String::npos, name, length) != 0 ) {
+            it = members_.insert( it, Member(String(name, length), Value()) );
+        }
+        return it->second;
+    }
+
+    template <typename Iterator>
+    static Iterator lowerBound(Iterator begin, Iterator end, const char* name, size_t length)
+    {
+        size_t count = end - begin;
+        while (count > 0) {
+            const size_t half = count / 2;
+            Iterator middle = begin + half;
+            if (middle->first.compare(0, String::npos, name, length) < 0) {
+                begin = middle + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        return begin;
+    }
+
+    Members members_;
+};
+
 
 inline std::ostream& operator<<(std::ostream& os, const Value& value)
 {
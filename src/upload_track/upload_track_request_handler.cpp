@@ -38,7 +38,7 @@ bool RequestHandler::handle_request(const Http::Request& req, Http::Reply& rep)
     }
 
     try {
-        const PlaylistID playlist_id = getPlaylistID(req.uri);
+        const PlaylistID playlist_id = getPlaylistID( req.uri.to_string() );
         
         if (IPlaylistUpdateManager* playlist_update_manager  = dynamic_cast<IPlaylistUpdateManager*>(&aimp_manager_)) {
             playlist_update_manager->lockPlaylist(playlist_id);
@@ -4,7 +4,10 @@
 #include "util.h"
 #include "scope_guard.h"
 #include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <cassert>
 #include <list>
+#include <map>
 
 namespace Utilities {
 
@@ -30,16 +33,32 @@ inline sqlite3_stmt* createStmt(sqlite3* db, const std::string& query) // throws
 typedef boost::function<void(sqlite3_stmt*, int)> QueryArgSetter;
 typedef std::list<QueryArgSetter> QueryArgSetters;
 
+//! Binds query args in order of setters, first setter gets index 1.
+inline void bindQueryArgs(sqlite3_stmt* stmt, const QueryArgSetters& query_arg_setters) // throws std::runtime_error
+{
+    int bind_index = 1;
+    BOOST_FOREACH(auto& setter, query_arg_setters) {
+        setter(stmt, bind_index++);
+    }
+}
+
+//! QueryArgSetter for int arg: boost::bind(&bindInt, _1, _2, value).
+inline void bindInt(sqlite3_stmt* stmt, int bind_index, int value) // throws std::runtime_error
+{
+    const int rc_db = sqlite3_bind_int(stmt, bind_index, value);
+    if (SQLITE_OK != rc_db) {
+        const std::string msg = MakeString() << "Error sqlite3_bind_int: " << rc_db;
+        throw std::runtime_error(msg);
+    }
+}
+
 inline size_t getRowsCount(sqlite3* db, const std::string& query, const QueryArgSetters* query_arg_setters = nullptr)
 {
     sqlite3_stmt* stmt = createStmt(db, query);
     ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
 
-    if (query_arg_setters) { // bind all query args.
-        size_t bind_index = 1;
-        BOOST_FOREACH(auto& setter, *query_arg_setters) {
-            setter(stmt, bind_index++);
-        }
+    if (query_arg_setters) {
+        bindQueryArgs(stmt, *query_arg_setters);
     }
 
     size_t entries_count = 0;
@@ -60,4 +79,169 @@ inline size_t getRowsCount(sqlite3* db, const std::string& query, const QueryArg
     return entries_count;
 }
 
+/*!
+    \brief Keeps compiled statements by query text, so query executed repeatedly is prepared once.
+    Query should contain parameters('?') instead of literal values, then its text describes only query shape.
+    Statements are prepared by sqlite3_prepare_v2(), so SQLite recompiles them itself after schema change.
+    Cache must be destroyed or cleared before database is closed, all leases must be released before it.
+*/
+class StatementCache : boost::noncopyable
+{
+    struct Entry
+    {
+        sqlite3_stmt* stmt;
+        bool leased;
+        unsigned long long last_use; // value of StatementCache::uses_count_ on last get().
+    };
+
+public:
+
+    static const size_t kMAX_STATEMENTS_COUNT = 64; //!< least recently used statement which is not leased is dropped when limit is reached.
+
+    /*!
+        \brief Statement taken from cache. Cache does not finalize statement while lease exists,
+        statement is reset when lease is released, so caller does not reset it.
+    */
+    class Lease : boost::noncopyable
+    {
+    public:
+
+        Lease(Lease&& other)
+            :
+            stmt_(other.stmt_),
+            entry_(other.entry_)
+        {
+            other.stmt_ = nullptr;
+            other.entry_ = nullptr;
+        }
+
+        ~Lease()
+        {
+            if (entry_) {
+                sqlite3_reset(stmt_);
+                entry_->leased = false;
+            } else if (stmt_) {
+                sqlite3_finalize(stmt_);
+            }
+        }
+
+        sqlite3_stmt* get() const
+            { return stmt_; }
+
+    private:
+
+        friend class StatementCache;
+
+        Lease(sqlite3_stmt* stmt, Entry* entry)
+            :
+            stmt_(stmt),
+            entry_(entry)
+        {}
+
+        sqlite3_stmt* stmt_;
+        Entry* entry_; // null if statement is not cached: it is finalized on release.
+    };
+
+    StatementCache()
+        :
+        db_(nullptr),
+        uses_count_(0)
+    {}
+
+    ~StatementCache()
+        { clear(); }
+
+    /*!
+        \brief Returns statement reset to initial state and without bound args.
+        If statement of the same query is leased already, separate statement is prepared for this lease.
+    */
+    Lease get(sqlite3* db, const std::string& query) // throws std::runtime_error
+    {
+        if (db != db_) {
+            clear();
+            db_ = db;
+        }
+
+        Statements::iterator it = statements_.find(query);
+        if ( it != statements_.end() ) {
+            Entry& entry = it->second;
+            if (entry.leased) {
+                return Lease(prepare(db, query), nullptr);
+            }
+            sqlite3_clear_bindings(entry.stmt); // statement was reset on lease release.
+            entry.leased = true;
+            entry.last_use = ++uses_count_;
+            return Lease(entry.stmt, &entry);
+        }
+
+        if (statements_.size() >= kMAX_STATEMENTS_COUNT) {
+            dropLeastRecentlyUsed();
+        }
+
+        sqlite3_stmt* stmt = prepare(db, query);
+        if (statements_.size() >= kMAX_STATEMENTS_COUNT) { // all statements are leased.
+            return Lease(stmt, nullptr);
+        }
+        Entry& entry = statements_[query];
+        entry.stmt = stmt;
+        entry.leased = true;
+        entry.last_use = ++uses_count_;
+        return Lease(entry.stmt, &entry);
+    }
+
+    //! Finalizes all statements.
+    void clear()
+    {
+        BOOST_FOREACH(auto& query_and_entry, statements_) {
+            assert(!query_and_entry.second.leased);
+            sqlite3_finalize(query_and_entry.second.stmt);
+        }
+        statements_.clear();
+        db_ = nullptr;
+    }
+
+private:
+
+    static sqlite3_stmt* prepare(sqlite3* db, const std::string& query) // throws std::runtime_error
+    {
+        sqlite3_stmt* stmt = nullptr;
+        const int rc_db = sqlite3_prepare_v2( db,
+                                              query.c_str(),
+                                              query.length() + 1, // see createStmt().
+                                              &stmt,
+                                              nullptr
+                                             );
+        if (SQLITE_OK != rc_db) {
+            const std::string msg = MakeString() << "sqlite3_prepare_v2() error "
+                                                 << rc_db << ": " << sqlite3_errmsg(db)
+                                                 << ". Query: " << query;
+            throw std::runtime_error(msg);
+        }
+        return stmt;
+    }
+
+    void dropLeastRecentlyUsed()
+    {
+        Statements::iterator least_recently_used = statements_.end();
+        for (Statements::iterator it = statements_.begin(), end = statements_.end(); it != end; ++it) {
+            if (   !it->second.leased
+                && (least_recently_used == statements_.end() || it->second.last_use < least_recently_used->second.last_use)
+                )
+            {
+                least_recently_used = it;
+            }
+        }
+        if ( least_recently_used != statements_.end() ) {
+            sqlite3_finalize(least_recently_used->second.stmt);
+            statements_.erase(least_recently_used);
+        }
+    }
+
+    typedef std::map<std::string, Entry> Statements; // entries do not move, leases refer to them.
+
+    sqlite3* db_;
+    Statements statements_;
+    unsigned long long uses_count_;
+};
+
 } // namespace Utilities
@@ -17,8 +17,7 @@ namespace Utilities
 //! Returns crc32 of buffer[0, length);
 crc32_t crc32(const void* buffer, unsigned int length)
 {
-    static boost::crc_32_type crc32_calculator;
-    crc32_calculator.reset();
+    boost::crc_32_type crc32_calculator; // not static since function is called from several threads.
     crc32_calculator.process_bytes(buffer, length);
     return crc32_calculator.checksum();
 }
@@ -13,8 +13,8 @@ class Frontend : public Rpc::Frontend
 {
 public:
 
-    virtual bool canHandleRequest(const std::string& uri) const
-        { return uri.find('?') != std::string::npos; }
+    virtual bool canHandleRequest(boost::string_ref uri) const
+        { return uri.find('?') != boost::string_ref::npos; }
 
     virtual Rpc::RequestParser& requestParser()
         { return request_parser_; }
@@ -17,6 +17,10 @@ public:
 
     virtual const std::string& mimeType() const;
 
+    virtual bool serializeResult(const Rpc::Value& result, std::string* serialized_result) const;
+
+    virtual void serializeSuccessWithResult(const Rpc::Value& root_response, const std::string& serialized_result, std::string* response) const;
+
 private:
 
 };
@@ -2,95 +2,368 @@
 
 #include "stdafx.h"
 #include "xmlrpc/request_parser.h"
-#include "xmlrpc/parse_util.h"
-#include "xmlrpc/value.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
+#include <algorithm>
+#include <cstdlib>
 
 namespace XmlRpc
 {
 
-const char * const METHODNAME_TAG = "<methodName>";
-const char * const PARAMS_TAG     = "<params>";
-const char * const PARAMS_ETAG    = "</params>";
-const char * const PARAM_TAG      = "<param>";
-const char * const PARAM_ETAG     = "</param>";
+namespace {
 
-//const std::string SYSTEM_MULTICALL = "system.multicall";
-//const std::string METHODNAME = "methodName";
-//const std::string PARAMS     = "params";
+const char kMETHODNAME_TAG[]  = "<methodName>";
+const char kMETHODNAME_ETAG[] = "</methodName>";
+const char kPARAMS_TAG[]      = "<params>";
+const char kPARAMS_ETAG[]     = "</params>";
+const char kPARAM_TAG[]       = "<param>";
+const char kPARAM_ETAG[]      = "</param>";
 
-void convertXmlRpcValueToRpcValue(const Value& xml_rpc_value, Rpc::Value* rpc_value); // throws Rpc::Exception
+const char kVALUE_TAG[]       = "<value>";
+const char kVALUE_ETAG[]      = "</value>";
+const char kNIL_TAG[]         = "<nil>";
+const char kNIL_TAG_FULL[]    = "<nil/>";
+const char kBOOLEAN_TAG[]     = "<boolean>";
+const char kINT_TAG[]         = "<int>";
+const char kI4_TAG[]          = "<i4>";
+const char kDOUBLE_TAG[]      = "<double>";
+const char kSTRING_TAG[]      = "<string>";
+const char kARRAY_TAG[]       = "<array>";
+const char kDATA_TAG[]        = "<data>";
+const char kDATA_ETAG[]       = "</data>";
+const char kSTRUCT_TAG[]      = "<struct>";
+const char kMEMBER_TAG[]      = "<member>";
+const char kMEMBER_ETAG[]     = "</member>";
+const char kNAME_TAG[]        = "<name>";
+const char kNAME_ETAG[]       = "</name>";
 
-bool RequestParser::parse_(const std::string& /*request_uri*/,
-                           const std::string& request_content,
-                           Rpc::Value* root)
+const int kMAX_NESTING_DEPTH = 256; // protects stack from malicious requests.
+
+/*!
+    \brief Single pass XML-RPC request reader, fills Rpc::Value directly.
+    Works on pointers into request content: tags are compared in place, only string values and member names are copied(decoded) to their destination.
+    Accepts the same dialect as former XmlRpc::Value based parser: type tag is optional for strings,
+    <i4> and <int> are equivalent, text after scalar value up to </value> is ignored, first of duplicated struct members wins.
+    dateTime.iso8601 and base64 values are rejected since Rpc::Value has no such types.
+*/
+class Reader
 {
-    std::size_t offset = 0; // Number of chars parsed from the request
-    (*root)["method"] = Util::parseTag(METHODNAME_TAG, request_content, &offset);
-    const std::string& method_name = (*root)["method"];
-    if (  method_name.size() > 0 && Util::findTag(PARAMS_TAG, request_content, &offset) ) {
-        Value params;
-        std::size_t argc = 0;
-        while ( Util::nextTagIs(PARAM_TAG, request_content, &offset) ) {
-            params[argc++] = Value(request_content, &offset);
-            Util::nextTagIs(PARAM_ETAG, request_content, &offset);
+public:
+
+    Reader(const char* begin, const char* end)
+        :
+        current_(begin),
+        end_(end),
+        depth_(0)
+    {}
+
+    bool parse(Rpc::Value* root);
+
+private:
+
+    template <size_t N>
+    static size_t length(const char (&)[N])
+        { return N - 1; }
+
+    static bool isSpace(char c)
+        { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skipSpaces()
+    {
+        while (current_ != end_ && isSpace(*current_)) {
+            ++current_;
         }
-        if ( Util::nextTagIs(PARAMS_ETAG, request_content, &offset) ) {
-            convertXmlRpcValueToRpcValue(params, &(*root)["params"]);
+    }
+
+    //! Returns true and moves after tag if tag is next non whitespace token. Position is not changed otherwise.
+    template <size_t N>
+    bool nextTagIs(const char (&tag)[N])
+    {
+        const char* c = current_;
+        while (c != end_ && isSpace(*c)) {
+            ++c;
+        }
+        if ( static_cast<size_t>(end_ - c) >= length(tag) && memcmp( c, tag, length(tag) ) == 0 ) {
+            current_ = c + length(tag);
             return true;
         }
+        return false;
     }
-    return false;
+
+    //! Returns pointer to first occurrence of tag at or after from, or end_.
+    template <size_t N>
+    const char* find(const char* from, const char (&tag)[N]) const
+        { return std::search( from, end_, tag, tag + length(tag) ); }
+
+    //! Moves after next occurrence of tag. Position is not changed if there is no such tag.
+    template <size_t N>
+    bool skipPast(const char (&tag)[N])
+    {
+        const char* tag_begin = find(current_, tag);
+        if (tag_begin == end_) {
+            return false;
+        }
+        current_ = tag_begin + length(tag);
+        return true;
+    }
+
+    //! Returns true if text [current_, tag_end) is tag.
+    template <size_t N>
+    bool isTag(const char* tag_end, const char (&tag)[N]) const
+        { return static_cast<size_t>(tag_end - current_) == length(tag) && memcmp( current_, tag, length(tag) ) == 0; }
+
+    bool readValue(Rpc::Value* value);
+    bool readArray(Rpc::Value* value);
+    bool readStruct(Rpc::Value* value);
+    bool readBoolean(Rpc::Value* value);
+    bool readInt(Rpc::Value* value);
+    bool readDouble(Rpc::Value* value);
+    //! Reads text up to next '<' as string.
+    bool readString(Rpc::Value* value);
+
+    //! Appends text [begin, end) with xml entities replaced by characters to out.
+    static void decode(const char* begin, const char* end, std::string* out);
+
+    const char* current_;
+    const char* const end_;
+    int depth_;
+};
+
+bool Reader::parse(Rpc::Value* root)
+{
+    // method name is searched in whole request, so xml declaration and <methodCall> tag are skipped without validation.
+    if ( !skipPast(kMETHODNAME_TAG) ) {
+        return false;
+    }
+    const char* const name_end = find(current_, kMETHODNAME_ETAG);
+    if (name_end == end_ || name_end == current_) {
+        return false;
+    }
+    (*root)["method"] = std::string(current_, name_end);
+    current_ = name_end + length(kMETHODNAME_ETAG);
+
+    if ( !skipPast(kPARAMS_TAG) ) {
+        return false;
+    }
+
+    Rpc::Value& params = (*root)["params"]; // stays none if request has no params, like before.
+    while ( nextTagIs(kPARAM_TAG) ) {
+        if ( params.type() == Rpc::Value::TYPE_NONE ) {
+            Rpc::Value( Rpc::Value::Array() ).swap(params);
+        }
+        const size_t index = params.size();
+        params.setSize(index + 1);
+        if ( !readValue( &params[static_cast<int>(index)] ) ) {
+            return false;
+        }
+        nextTagIs(kPARAM_ETAG);
+    }
+    return nextTagIs(kPARAMS_ETAG);
+}
+
+bool Reader::readValue(Rpc::Value* value)
+{
+    if ( !nextTagIs(kVALUE_TAG) ) {
+        return false;
+    }
+
+    const char* const after_value_tag = current_;
+    skipSpaces();
+    if (current_ == end_) {
+        return false;
+    }
+    if (*current_ != '<') { // string without type tag, leading spaces are part of it.
+        current_ = after_value_tag;
+        return readString(value) && skipPast(kVALUE_ETAG);
+    }
+
+    const char* tag_end = std::find(current_, end_, '>');
+    if (tag_end == end_) {
+        return false;
+    }
+    ++tag_end;
+
+    bool result;
+    if ( isTag(tag_end, kVALUE_ETAG) ) { // empty string without type tag.
+        current_ = after_value_tag;
+        return readString(value) && skipPast(kVALUE_ETAG);
+    } else if ( isTag(tag_end, kNIL_TAG) || isTag(tag_end, kNIL_TAG_FULL) ) {
+        current_ = tag_end;
+        Rpc::Value( Rpc::Value::Null() ).swap(*value);
+        result = true;
+    } else if ( isTag(tag_end, kBOOLEAN_TAG) ) {
+        current_ = tag_end;
+        result = readBoolean(value);
+    } else if ( isTag(tag_end, kI4_TAG) || isTag(tag_end, kINT_TAG) ) {
+        current_ = tag_end;
+        result = readInt(value);
+    } else if ( isTag(tag_end, kDOUBLE_TAG) ) {
+        current_ = tag_end;
+        result = readDouble(value);
+    } else if ( isTag(tag_end, kSTRING_TAG) ) {
+        current_ = tag_end;
+        result = readString(value);
+    } else if ( isTag(tag_end, kARRAY_TAG) ) {
+        current_ = tag_end;
+        result = readArray(value);
+    } else if ( isTag(tag_end, kSTRUCT_TAG) ) {
+        current_ = tag_end;
+        result = readStruct(value);
+    } else {
+        result = false; // unknown tag, dateTime.iso8601 or base64.
+    }
+
+    // closing tag of type(</i4>, </array>...) is skipped together with anything before </value>.
+    return result && skipPast(kVALUE_ETAG);
+}
+
+bool Reader::readBoolean(Rpc::Value* value)
+{
+    char* number_end;
+    const long result = strtol(current_, &number_end, 10);
+    if (number_end == current_ || number_end > end_ || (result != 0 && result != 1) ) {
+        return false;
+    }
+    *value = result == 1;
+    current_ = number_end;
+    return true;
+}
+
+bool Reader::readInt(Rpc::Value* value)
+{
+    // strtol needs null terminated string, request content is std::string so it is terminated after end_.
+    char* number_end;
+    const long result = strtol(current_, &number_end, 10);
+    if (number_end == current_ || number_end > end_) {
+        return false;
+    }
+    *value = static_cast<int>(result);
+    current_ = number_end;
+    return true;
+}
+
+bool Reader::readDouble(Rpc::Value* value)
+{
+    char* number_end;
+    const double result = strtod(current_, &number_end);
+    if (number_end == current_ || number_end > end_) {
+        return false;
+    }
+    *value = result;
+    current_ = number_end;
+    return true;
+}
+
+bool Reader::readString(Rpc::Value* value)
+{
+    const char* const string_end = std::find(current_, end_, '<');
+    if (string_end == end_) {
+        return false; // no end tag.
+    }
+    Rpc::Value::String& string = *value;
+    decode(current_, string_end, &string);
+    current_ = string_end;
+    return true;
+}
+
+bool Reader::readArray(Rpc::Value* value)
+{
+    if ( !nextTagIs(kDATA_TAG) || ++depth_ > kMAX_NESTING_DEPTH ) {
+        return false;
+    }
+
+    Rpc::Value( Rpc::Value::Array() ).swap(*value);
+    for (size_t size = 0; ; ++size) {
+        const char* const item_begin = current_;
+        if ( !nextTagIs(kVALUE_TAG) ) {
+            break;
+        }
+        current_ = item_begin;
+
+        value->setSize(size + 1);
+        if ( !readValue( &(*value)[static_cast<int>(size)] ) ) {
+            return false;
+        }
+    }
+
+    nextTagIs(kDATA_ETAG);
+    --depth_;
+    return true;
 }
 
-void convertXmlRpcValueToRpcValue(const Value& xml_rpc_value, Rpc::Value* rpc_value) // throws Rpc::Exception
+bool Reader::readStruct(Rpc::Value* value)
 {
-    assert(rpc_value);
-
-    switch ( xml_rpc_value.getType() ) {
-    case Value::TypeInvalid:
-        Rpc::Value().swap(*rpc_value);
-        break;
-    case Value::TypeNil:
-        Rpc::Value( Rpc::Value::Null() ).swap(*rpc_value);
-        break;
-    case Value::TypeBoolean:
-        *rpc_value = bool(xml_rpc_value);
-        break;
-    case Value::TypeInt:
-        *rpc_value = int(xml_rpc_value);
-        break;
-    case Value::TypeDouble:
-        *rpc_value = double(xml_rpc_value);
-        break;
-    case Value::TypeString:
-        *rpc_value = static_cast<const std::string&>(xml_rpc_value);
-        break;
-    case Value::TypeArray:
-        rpc_value->setSize( xml_rpc_value.size() );
-        for (size_t i = 0, size = rpc_value->size(); i != size; ++i) {
-            convertXmlRpcValueToRpcValue(xml_rpc_value[i], &((*rpc_value)[i]));
+    if (++depth_ > kMAX_NESTING_DEPTH) {
+        return false;
+    }
+
+    Rpc::Value( Rpc::Value::Object() ).swap(*value);
+    std::string name;
+    while ( nextTagIs(kMEMBER_TAG) ) {
+        if ( !skipPast(kNAME_TAG) ) {
+            return false;
         }
-        break;
-    case Value::TypeStruct:
-        {
-        Rpc::Value::Object object;
-        auto member_it = xml_rpc_value.getStructMembersBegin(),
-             end       = xml_rpc_value.getStructMembersEnd();
-        for (; member_it != end; ++member_it) {
-            convertXmlRpcValueToRpcValue(member_it->second, &object[member_it->first]);
+        const char* const name_end = find(current_, kNAME_ETAG);
+        if (name_end == end_) {
+            return false;
         }
+        name.clear();
+        decode(current_, name_end, &name);
+        current_ = name_end + length(kNAME_ETAG);
 
-        *rpc_value = object;
+        if ( !readValue( &value->appendMember(name) ) ) {
+            return false;
         }
-        break;
-    case Value::TypeDateTime:
-    case Value::TypeBase64:
-        assert(!"Value's DateTime and Base64 types are not supported.");
-    default:
-        throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
+
+        nextTagIs(kMEMBER_ETAG);
     }
+    value->sortMembers(Rpc::Value::DUPLICATES_KEEP_FIRST); // first of duplicated members wins.
+
+    --depth_;
+    return true;
+}
+
+void Reader::decode(const char* begin, const char* end, std::string* out)
+{
+    struct Entity { const char* name; size_t length; char raw; };
+    static const Entity kENTITIES[] = { {"lt;", 3, '<'}, {"gt;", 3, '>'}, {"amp;", 4, '&'}, {"apos;", 5, '\''}, {"quot;", 5, '"'} };
+
+    out->reserve( out->size() + (end - begin) );
+    for (;;) {
+        const char* const amp = std::find(begin, end, '&');
+        out->append(begin, amp); // copy run of plain characters at once.
+        if (amp == end) {
+            break;
+        }
+
+        begin = amp + 1;
+        char raw = '&'; // unrecognized sequence is kept as is.
+        for (const Entity& entity : kENTITIES) {
+            if ( static_cast<size_t>(end - begin) >= entity.length && memcmp(begin, entity.name, entity.length) == 0 ) {
+                raw = entity.raw;
+                begin += entity.length;
+                break;
+            }
+        }
+        out->push_back(raw);
+    }
+}
+
+} // namespace anonymous
+
+bool RequestParser::parse_(const std::string& /*request_uri*/,
+                           const std::string& request_content,
+                           Rpc::Value* root)
+{
+    assert(root);
+
+    Rpc::Value value;
+    Reader reader( request_content.c_str(), request_content.c_str() + request_content.size() );
+    if ( reader.parse(&value) ) {
+        value.swap(*root);
+        return true;
+    }
+    return false;
 }
 
 } // namespace XmlRpc
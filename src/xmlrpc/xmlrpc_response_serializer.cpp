@@ -3,8 +3,6 @@
 #include "stdafx.h"
 #include <cassert>
 #include "xmlrpc/response_serializer.h"
-#include "xmlrpc/parse_util.h"
-#include "xmlrpc/value.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
 
@@ -13,105 +11,220 @@ namespace XmlRpc
 
 const std::string kMIME_TYPE = "text/xml";
 
-void convertRpcValueToXmlRpcValue(const Rpc::Value& rpc_value, Value* xml_rpc_value) // throws Rpc::Exception
+namespace {
+
+const char kRESPONSE_START[] = "<?xml version=\"1.0\"?>\r\n"
+                               "<methodResponse><params><param>\r\n\t";
+const char kRESPONSE_END[]   = "\r\n</param></params></methodResponse>\r\n";
+
+/*!
+    \brief Writes Rpc::Value as XML-RPC value directly to output string, without intermediate XmlRpc::Value tree.
+    Output is the same as XmlRpc::Value::toXml() one: strings have no type tag, integers use <i4>, doubles are formatted by "%f".
+*/
+class Writer
+{
+public:
+
+    explicit Writer(std::string* out)
+        :
+        out_(*out)
+    {}
+
+    void writeValue(const Rpc::Value& value); // throws Rpc::Exception
+
+    void writeInt(int value);
+
+    //! Writes text with xml special characters replaced by entities.
+    void writeEscaped(const std::string& s);
+
+    template <size_t N>
+    void put(const char (&s)[N])
+        { out_.append(s, N - 1); }
+
+    void put(char c)
+        { out_.push_back(c); }
+
+private:
+
+    void writeUInt(unsigned int value);
+
+    void writeDouble(double value);
+
+    std::string& out_;
+};
+
+void Writer::writeEscaped(const std::string& s)
+{
+    const char* run_begin = s.data();
+    const char* const end = s.data() + s.size();
+    for (const char* c = run_begin; c != end; ++c) {
+        const char* entity;
+        switch (*c) {
+        case '<':  entity = "&lt;";   break;
+        case '>':  entity = "&gt;";   break;
+        case '&':  entity = "&amp;";  break;
+        case '\'': entity = "&apos;"; break;
+        case '"':  entity = "&quot;"; break;
+        default:
+            continue;
+        }
+        out_.append(run_begin, c); // copy run of characters which do not need escaping at once.
+        out_ += entity;
+        run_begin = c + 1;
+    }
+    out_.append(run_begin, end);
+}
+
+void Writer::writeUInt(unsigned int value)
 {
-    assert(xml_rpc_value);
+    char buffer[16];
+    char* current = buffer + sizeof(buffer);
+    do {
+        *--current = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    out_.append( current, buffer + sizeof(buffer) );
+}
 
-    switch ( rpc_value.type() ) {
+void Writer::writeInt(int value)
+{
+    if (value < 0) {
+        put('-');
+        writeUInt( 0u - static_cast<unsigned int>(value) ); // safe for minimal int value.
+    } else {
+        writeUInt( static_cast<unsigned int>(value) );
+    }
+}
+
+void Writer::writeDouble(double value)
+{
+    char buffer[400]; // enough for "%f" of any double.
+    const int length = sprintf_s(buffer, "%f", value);
+    if (length > 0) {
+        out_.append(buffer, length);
+    }
+}
+
+void Writer::writeValue(const Rpc::Value& value) // throws Rpc::Exception
+{
+    switch ( value.type() ) {
     case Rpc::Value::TYPE_NONE:
-        Value().swap(*xml_rpc_value);
+        break; // invalid value has no representation.
+    case Rpc::Value::TYPE_NULL:
+        put("<value><nil/></value>");
         break;
     case Rpc::Value::TYPE_BOOL:
-        *xml_rpc_value = bool(rpc_value);
+        put("<value><boolean>");
+        put( bool(value) ? '1' : '0' );
+        put("</boolean></value>");
         break;
     case Rpc::Value::TYPE_INT:
-        *xml_rpc_value = int(rpc_value);
+        put("<value><i4>");
+        writeInt( int(value) );
+        put("</i4></value>");
         break;
     case Rpc::Value::TYPE_UINT:
         {
-        const unsigned int uint_value = unsigned int(rpc_value);
+        const unsigned int uint_value = static_cast<unsigned int>(value);
         if (uint_value > INT_MAX) {
             assert(!"Rpc::Value(uint): cast error uint -> int");
             throw Rpc::Exception("cast error: uint -> int", Rpc::VALUE_RANGE_ERROR);
         }
-        *xml_rpc_value = static_cast<int>(uint_value);
+        put("<value><i4>");
+        writeUInt(uint_value);
+        put("</i4></value>");
         }
         break;
     case Rpc::Value::TYPE_DOUBLE:
-        *xml_rpc_value = double(rpc_value);
+        put("<value><double>");
+        writeDouble( double(value) );
+        put("</double></value>");
         break;
     case Rpc::Value::TYPE_STRING:
-        *xml_rpc_value = static_cast<const std::string&>(rpc_value);
+        put("<value>");
+        writeEscaped( static_cast<const std::string&>(value) );
+        put("</value>");
         break;
     case Rpc::Value::TYPE_ARRAY:
-        xml_rpc_value->setSize( rpc_value.size() );
-        for (size_t i = 0, size = xml_rpc_value->size(); i != size; ++i) {
-            convertRpcValueToXmlRpcValue(rpc_value[i], &((*xml_rpc_value)[i]));
+        put("<value><array><data>");
+        for (size_t i = 0, size = value.size(); i != size; ++i) {
+            writeValue(value[i]);
         }
+        put("</data></array></value>");
         break;
     case Rpc::Value::TYPE_OBJECT:
         {
-        Value::ValueStruct structValue;
-        auto member_it = rpc_value.getObjectMembersBegin(),
-             end       = rpc_value.getObjectMembersEnd();
+        put("<value><struct>");
+        auto member_it = value.getObjectMembersBegin(),
+             end       = value.getObjectMembersEnd();
         for (; member_it != end; ++member_it) {
-            convertRpcValueToXmlRpcValue(member_it->second, &structValue[member_it->first]);
+            put("<member><name>");
+            writeEscaped(member_it->first);
+            put("</name>");
+            writeValue(member_it->second);
+            put("</member>");
         }
-
-        *xml_rpc_value = structValue;
+        put("</struct></value>");
         }
         break;
-    case Rpc::Value::TYPE_NULL:
-        Value( Value::Nil() ).swap(*xml_rpc_value);
-        break;
     default:
         throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
     }
 }
 
-void generateResponse(const std::string& result_xml, std::string* response)
+} // namespace anonymous
+
+void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
 {
-    static const char RESPONSE_START[] =
-        "<?xml version=\"1.0\"?>\r\n"
-        "<methodResponse><params><param>\r\n\t";
-    static const char RESPONSE_END[] =
-        "\r\n</param></params></methodResponse>\r\n";
-
-    *response = RESPONSE_START;
-    *response += result_xml;
-    *response += RESPONSE_END;
+    assert(response);
+    response->clear();
+
+    Writer writer(response);
+    writer.put(kRESPONSE_START);
+    writer.writeValue(root_response["result"]);
+    writer.put(kRESPONSE_END);
 }
 
-void generateFaultResponse(const std::string& error_msg, int error_code, std::string* response)
+bool ResponseSerializer::serializeResult(const Rpc::Value& result, std::string* serialized_result) const
 {
-    static const char RESPONSE_START[] =
-        "<?xml version=\"1.0\"?>\r\n"
-        "<methodResponse><fault>\r\n\t";
-    static const char RESPONSE_END[] =
-        "\r\n</fault></methodResponse>\r\n";
-
-    static const std::string FAULTCODE   = "faultCode";
-    static const std::string FAULTSTRING = "faultString";
-
-    Value fault_struct;
-    fault_struct[FAULTCODE] = error_code;
-    fault_struct[FAULTSTRING] = error_msg;
-    *response = RESPONSE_START;
-    *response += fault_struct.toXml();
-    *response += RESPONSE_END;
-}
+    assert(serialized_result);
+    serialized_result->clear();
 
+    Writer writer(serialized_result);
+    writer.writeValue(result);
+    return true;
+}
 
-void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
+void ResponseSerializer::serializeSuccessWithResult(const Rpc::Value& /*root_response*/, const std::string& serialized_result, std::string* response) const
 {
-    Value xmlrpc_response;
-    convertRpcValueToXmlRpcValue(root_response["result"], &xmlrpc_response);
-    generateResponse(xmlrpc_response.toXml(), response);
+    assert(response);
+    response->clear();
+    response->reserve( sizeof(kRESPONSE_START) + serialized_result.size() + sizeof(kRESPONSE_END) );
+
+    // XML-RPC response has no id, so it is result wrapped in constant envelope.
+    Writer writer(response);
+    writer.put(kRESPONSE_START);
+    *response += serialized_result;
+    writer.put(kRESPONSE_END);
 }
 
 void ResponseSerializer::serializeFault(const Rpc::Value& /*root_request*/, const std::string& error_msg, int error_code, std::string* response) const
 {
-    generateFaultResponse(error_msg, error_code, response);
+    assert(response);
+    response->clear();
+
+    Writer writer(response);
+    writer.put("<?xml version=\"1.0\"?>\r\n"
+               "<methodResponse><fault>\r\n\t"
+               "<value><struct>"
+               "<member><name>faultCode</name><value><i4>");
+    writer.writeInt(error_code);
+    writer.put("</i4></value></member>"
+               "<member><name>faultString</name><value>");
+    writer.writeEscaped(error_msg);
+    writer.put("</value></member>"
+               "</struct></value>"
+               "\r\n</fault></methodResponse>\r\n");
 }
 
 const std::string& ResponseSerializer::mimeType() const